@@ -43,6 +43,7 @@ midaszhou@yahoo.com
 #include "egi_common.h"
 #include "egi_cstring.h"
 #include "egi_FTsymbol.h"
+#include "egi_FTbook.h"
 #include "page_ebook.h"
 
 /* icon code for button symbols */
@@ -67,11 +68,8 @@ static int ebook_hangup(EGI_EBOX * ebox, EGI_TOUCH_DATA * touch_data);
 static int ebook_decorate(EGI_EBOX *ebox);
 
 
-/* ebook file */
-static int fd=-1;;
-static int fsize;
-static struct stat sb;
-static const unsigned char *faddr;
+/* ebook file, paginated in background */
+static EGI_FTBOOK *book;
 
 /* ebook displaying */
 static const char *fpath="/mmc/xyj_uft8.txt";
@@ -81,12 +79,10 @@ static  int fh,fw; /* font Height,Width */
 static  int lines;
 static  int pixpl;
 static  int gap;   /* line gap */
-static  int offp;
+static  int pgnum=-1;	/* Current page, from 0 */
 static  int x0,y0;
-static  int wtotal;
 static  int nwrite;
 static  bool refresh_ebook;
-static  EGI_FILO *filo;
 
 
 /*----------------------------------------------------------
@@ -97,10 +93,10 @@ static  EGI_FILO *filo;
 static int page_refresh_ebook(EGI_PAGE *page)
 {
 
-    /* 1. If (fd<0) open and mmap file */
-    if(fd<0) {
+    /* 1. If book not opened, open it and paginate in background */
+    if(book==NULL) {
 
-	EGI_PLOG(LOGLV_TEST,"%s: Start to open and MMAP file %s.", __func__, fpath);
+	EGI_PLOG(LOGLV_TEST,"%s: Start to open book %s.", __func__, fpath);
 
 	/* init params */
    	x0=5;		/* Offset */
@@ -108,46 +104,17 @@ static int page_refresh_ebook(EGI_PAGE *page)
    	fw=19;		/* font size */
 	fh=19;
 	pixpl=240-x0;	/* pixles per line */
-	offp=0;		/* file position offset */
+	pgnum=-1;	/* No page displayed yet */
    	lines=12;	/* number of txt lines */
    	gap=5;		/* Gap between txt lines */
 
-	/* init filo */
-	if(filo==NULL) {
-	        filo=egi_malloc_filo( 1<<10, sizeof(int), 0b01); //|0b10 ); /* enable double/halve realloc */
-	        if(filo==NULL) {
-			EGI_PLOG(LOGLV_ERROR,"%s:Fail to init EGI FILO, quit.", __func__);
-        	        return -1;
-        	}
+        /* 1.1 open the book, page index is loaded or computed in background */
+	book=FTbook_open(fpath, egi_appfonts.regular, fw, fh, pixpl-x0, lines, gap);
+	if(book==NULL) {
+		EGI_PLOG(LOGLV_ERROR,"%s: Fail to open book %s.", __func__, fpath);
+		return -1;
 	}
 
-        /* 1.1 open wchar book file */
-        fd=open(fpath,O_RDONLY);
-        if(fd<0) {
-		EGI_PLOG(LOGLV_ERROR,"%s: Fail to open %s.", __func__, fpath);
-                perror("---open file---");
-                return -1;
-        }
-        /* 1.2 obtain file stat, OR fseek(fd, 0L, SEEK_END); fsize=ftell(fp); */
-        if( fstat(fd,&sb)<0 ) {
-		EGI_PLOG(LOGLV_ERROR,"%s: Fail to call fstat() for file size.", __func__);
-                perror("---fstat---");
-                return -2;
-        }
-        fsize=sb.st_size;
-        /* 1.3 mmap txt file */
-        faddr=mmap(NULL, fsize, PROT_READ, MAP_PRIVATE, fd, 0);
-        if(faddr==MAP_FAILED) {
-		EGI_PLOG(LOGLV_ERROR,"%s: Fail to call mmap() for file %s.", __func__, fpath);
-                perror("---mmap---");
-                return -3;
-        }
-
-        /* 1.4 get total wchars in the book */
-        wtotal=cstr_strcount_uft8(faddr);
-	EGI_PLOG(LOGLV_TEST,"%s: Finish open and MMAP file %s, totally %d characters in the book.",
-										__func__, fpath, wtotal);
-
         /* 1.5 write book title  */
         FTsymbol_unicstrings_writeFB(&gv_fb_dev, egi_appfonts.bold,  	/* FBdev, fontface */
                                           35, 35, title,               	/* fw,fh, pstr */
@@ -158,18 +125,17 @@ static int page_refresh_ebook(EGI_PAGE *page)
 
 
 #if 1 /* TODO: TXT display area can NOT be auto. refreshed, to define it as a txt_EBOX! later. */
-   /* 2. If (fd>0), write to FB from the last start_reading position of the book */
+   /* 2. If book opened, write current page to FB */
    else if(refresh_ebook==true) {
-	/* reel back to the last start_reading position */
-	//offp = offp-nwrite>0 ? offp-nwrite : 0;
-        /* write book content: UFT-8 string to FB */
-	egi_filo_push(filo,(void *)(&offp)); /* push current starting offp */
-       	nwrite=FTsymbol_uft8strings_writeFB(&gv_fb_dev, egi_appfonts.regular,   /* FBdev, fontface */
-                                          fw, fh, faddr+offp,     	 	 /* fw,fh, pstr */
-                                          pixpl-x0, lines,  gap,         /* pixpl, lines, gap */
-                                          x0, y0,                      	 /* x0,y0, */
-                                          WEGI_COLOR_BLACK, -1, -1 );    /* fontcolor, stranscolor,opaque */
-	offp+=nwrite;
+	if(pgnum<0)
+		pgnum=0;
+
+        /* write book content: page pgnum, O(1) to locate it */
+	nwrite=FTbook_writePage(&gv_fb_dev, book, pgnum, x0, y0, WEGI_COLOR_BLACK);
+	if(nwrite<0 && pgnum>0) {	/* Beyond the last page */
+		pgnum--;
+		nwrite=FTbook_writePage(&gv_fb_dev, book, pgnum, x0, y0, WEGI_COLOR_BLACK);
+	}
 
 	refresh_ebook=false;
    }
@@ -328,9 +294,9 @@ static int ebook_prev(EGI_EBOX * ebox, EGI_TOUCH_DATA * touch_data)
         if(touch_data->status != pressing)
                 return btnret_IDLE;
 
-	/* reel back to the previous offp */
-	egi_filo_pop(filo, NULL);
-	egi_filo_pop(filo,(void *)&offp);
+	/* back to the previous page */
+	if(pgnum>0)
+		pgnum--;
 
 	refresh_ebook=true;
 
@@ -360,6 +326,8 @@ static int ebook_next(EGI_EBOX * ebox, EGI_TOUCH_DATA * touch_data)
         if(touch_data->status != pressing)
                 return btnret_IDLE;
 
+	/* to the next page, checked in page_refresh_ebook() */
+	pgnum++;
 	refresh_ebook=true;
 
 	return pgret_OK; 	/* fore to refresh page */
@@ -408,10 +376,8 @@ static int ebook_hangup(EGI_EBOX * ebox, EGI_TOUCH_DATA * touch_data)
    * 3. To be handled by page routine.
    */
 
-	/* set ebook need_refresh token here */
-	offp-=nwrite;		/* Reel back reading position */
+	/* set ebook need_refresh token here, to rewrite current page */
 	refresh_ebook=true;
-	if(offp<0)offp=0;
 
 	/* need refresh page, a trick here to activate the page after CONT signal */
 	return pgret_OK;
@@ -441,17 +407,8 @@ Release and free all resources
 ------------------------------*/
 void free_ebook_page(void)
 {
-   if(fd>0) {
-	 close(fd);
-	 fd=-1;
-	 munmap(faddr, fsize);
-	 faddr=NULL;
-   }
-
-   if(filo != NULL) {
-	egi_free_filo(filo);
-	filo=NULL;
-   }
+   /* page index is saved if pagination not finished, to resume next time */
+   FTbook_close(&book);
 
 
    /* all EBOXs in the page will be release by calling egi_page_free()
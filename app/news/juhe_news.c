@@ -21,6 +21,7 @@ Midas Zhou
 #include "egi_cstring.h"
 #include "egi_FTsymbol.h"
 #include "egi_utils.h"
+#include "egi_txtsrc.h"
 #include "page_minipanel.h"
 #include "juhe_news.h"
 
@@ -263,15 +264,12 @@ EGI_FILO* juhe_get_newsFilo(const char* url)
 {
 	int ret=0;
 //	int i;
-	int fd=-1;			   /* file descreptor for the input file */
-	int fsize=0;			   /* size of the input file */
-	struct stat  sb;
 	bool URL_Is_FilePath=false;	   /* If the URL is a file path */
 	char buff[CURL_RETDATA_BUFF_SIZE]; /* For CURL returned html text */
         char *content=NULL;		   /* Pointer to content of a piece of news */
         int len;
         char *pstr=NULL;		   /* Pointer to file OR buff */
-	char *pmap=NULL;		   /* mmap of a file */
+	EGI_TXTSRC *src=NULL;		   /* mmaped file, '\0' terminated */
 	EGI_FILO* filo=NULL; 		   /* to buffer content pointers */
 
 
@@ -309,28 +307,15 @@ EGI_FILO* juhe_get_newsFilo(const char* url)
 	/* ELSE :: Input URL is a file path */
 	else
 	{
-	       /* open local file and mmap */
-        	fd=open(url,O_RDONLY);
-	        if(fd<0) {
+	       /* open local file as a txt source, it's mmaped and ends with '\0' for string parsing */
+		src=egi_txtsrc_open(url, 0);
+	        if(src==NULL) {
 			printf("%s: Fail to open file '%s'\n", __func__, url);
 			ret=-2;
                 	goto FUNC_END;
 	        }
-        	/* obtain file stat */
-	        if( fstat(fd,&sb)<0 ) {
-			printf("%s: Fail to get fstat of file '%s'\n", __func__, url);
-			ret=-3;
-                	goto FUNC_END;
-	        }
-        	fsize=sb.st_size;
-	        pmap=mmap(NULL, fsize, PROT_READ, MAP_PRIVATE, fd, 0);
-        	if(pmap==MAP_FAILED) {
-			printf("%s: Fail to mmap file '%s'\n", __func__, url);
-			ret=-4;
-	                goto FUNC_END;
-        	}
-		/* assign pmap to pstr */
-		pstr=pmap;
+		/* assign mmaped txt to pstr */
+		pstr=(char *)src->addr;
 	}
 
         /* Parse HTML and push to FILO */
@@ -353,12 +338,8 @@ EGI_FILO* juhe_get_newsFilo(const char* url)
 FUNC_END:
 	/* Close file and mumap */
 	printf("%s: release file mmap ...\n",__func__);
-	if(URL_Is_FilePath) {
-		if(fd>0)
-		    	close(fd);
-		if( pmap!=MAP_FAILED && pmap!=NULL )
-			munmap(pmap,fsize);
-	}
+	if(URL_Is_FilePath)
+		egi_txtsrc_close(&src);
 
 	/* If fail, free filo */
 	if(ret!=0) {
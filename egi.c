@@ -43,6 +43,8 @@ midaszhou@yahoo.com
 #include "sys_list.h"
 #include "egi_symbol.h"
 #include "egi_color.h"
+#include "egi_page.h"
+#include "egi_scene.h"
 
 /* button touch status and events:
  * corresponding to enum egi_touch_status in egi.h
@@ -309,6 +311,9 @@ EGI_EBOX *egi_hit_pagebox(int px, int py, EGI_PAGE *page, enum egi_ebox_type typ
                         break;
         }
 
+	/* In a retained scene, the topmost one is hit */
+	if(page->retained)
+		return egi_scene_hit(page, x, y, type);
 
         /* traverse the list, not safe */
         list_for_each(tnode, &page->list_head)
@@ -411,8 +416,11 @@ inline void egi_ebox_needrefresh(EGI_EBOX *ebox)
 	/*  Race condition may still exist? */
 	ebox->need_refresh=true;
 
-       if(ebox->container != NULL)
+       if(ebox->container != NULL) {
 		pthread_mutex_unlock(&(ebox->container)->pgmutex);
+		/* Let the page routine refresh it */
+		egi_page_wakeup(ebox->container);
+       }
 
 }
 
@@ -469,6 +477,10 @@ int egi_ebox_forcerefresh(EGI_EBOX *ebox)
 	if(ebox==NULL)
 		return -1;
 
+	/* In a retained scene, the next frame redraws it in z-order */
+	if(egi_scene_retained(ebox))
+		return egi_scene_mark_dirty(ebox);
+
        /* Get pgmutex for parent PAGE resource access/synch */
        if(ebox->container != NULL) {
                 if(pthread_mutex_lock(&(ebox->container)->pgmutex) !=0) {
@@ -689,6 +701,7 @@ EGI_EBOX * egi_ebox_new(enum egi_ebox_type type)  //, void *egi_data)
 	memset(ebox,0,sizeof(EGI_EBOX)); /* clear data */
 
 	ebox->type=type;
+	INIT_LIST_HEAD(&ebox->children);
 
 	/* assign default methods for new ebox */
 	EGI_PDEBUG(DBG_EGI,"egi_ebox_new(): assing default method to ebox ....\n");
@@ -831,6 +844,10 @@ EGI_EBOX *egi_copy_btn_ebox(EGI_EBOX *ebox)
         }
         *newbox=*ebox;
 
+	/* not in any scene, see egi_scene.h */
+	INIT_LIST_HEAD(&newbox->children);
+	newbox->drawn=false;
+
 	/* assign egi_data */
 	newbox->egi_data=(void *)data_btn;
 
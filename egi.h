@@ -15,15 +15,19 @@ midaszhou@yahoo.com
 #include <math.h>
 #include <stdbool.h>
 #include <pthread.h>
+#include <time.h>
 #include "sys_list.h"
 #include "egi_image.h"
 #include "egi_color.h"
 #include "egi_filo.h"
+#include "egi_txtsrc.h"
 //#include <freetype2/ft2build.h>
 
 #define EGI_NOPRIM_COLOR -1 /* Do not draw primer color for an egi object */
 #define EGI_TAG_LENGTH 30 /* ebox tag string length */
 #define EGI_PAGE_MAXTHREADS 5 /* MAX. number of threads in a page routine job */
+#define EGI_PAGE_FRAMEMS 20	/* Min. interval of page refreshes in egi_page_routine(), in ms */
+#define EGI_PAGE_IDLEMS 100	/* Default interval to check need_refresh when idle, see EGI_PAGE.idle_ms */
 
 typedef struct egi_point_coord  EGI_POINT;
 typedef struct egi_box_coords 	EGI_BOX;
@@ -36,6 +40,7 @@ typedef struct egi_data_btn 	EGI_DATA_BTN;
 typedef struct egi_data_list 	EGI_DATA_LIST;
 typedef struct egi_data_slider 	EGI_DATA_SLIDER;
 typedef struct egi_data_pic 	EGI_DATA_PIC;
+struct egi_gesture;		/* EGI_GESTURE in egi_gesture.h */
 
 
 /* A group of pages that logically connected together that serves for an application.
@@ -346,6 +351,12 @@ struct egi_element_box
 
 	/* the father ebox */
 	EGI_EBOX *father;
+
+	/* Retained scene, see egi_scene.h */
+	struct list_head children; /* list head for child eboxes, in order of z */
+	int z;			   /* z-order in its list, a bigger z is drawn above */
+	EGI_BOX drawbox;	   /* bounds where it was drawn last time, if drawn */
+	bool drawn;
 };
 
 
@@ -369,6 +380,9 @@ struct egi_touch_data
         in LCD coordinate */
         int     dx;
         int     dy;
+
+	/* CLOCK_MONOTONIC time when the data is read */
+	struct timespec ts;
 };
 
 
@@ -418,6 +432,11 @@ struct egi_data_txt
 	EGI_FILO *filo_off; /* a FILO buff for push/pop offset position for txt file
 			     *
 			     */
+	EGI_TXTSRC *src;    /* mmaped txt file of fpath, opened by egi_txtbox_readfile() */
+	/* Cached txt surface, see egi_txtbox_set_cache() */
+	bool cache_on;		/* If true, txt is rendered to cache and refresh() blits it */
+	EGI_IMGBUF *cache;	/* Rendered txt, RGB565+A8 */
+	unsigned int cache_key; /* Hash of txt, font, color and size of the cache */
 };
 
 
@@ -653,6 +672,11 @@ struct egi_page
 	/* if a touch sliding handler is defined */
 	int (*slide_handler)(EGI_PAGE *page, EGI_TOUCH_DATA *touch_data);
 
+	/* if a gesture handler is defined, egi_page_routine() calls it with every gesture recognized,
+	 * return btnret_REQUEST_EXIT_PAGE to exit the page. see egi_gesture.h
+	 */
+	int (*gesture_handler)(EGI_PAGE *page, struct egi_gesture *gesture);
+
 	/* if NOT NULL, always do the miscelaneous job when refresh the page in the routine func */
 	int (*page_refresh_misc)(EGI_PAGE *page);
 
@@ -686,6 +710,25 @@ struct egi_page
 	pthread_mutex_t runner_mutex;
 	pthread_cond_t  runner_cond;
 	/* TBD: Whether?/When?/Where? to destroy above mutex and cond variables!?!?! */
+
+	/* Event loop of egi_page_routine(), see egi_evloop.h
+	 *  1. Touch data, timers and signals added to it, and egi_page_wakeup() from runners
+	 *     wake up the routine, it sleeps otherwise.
+	 *  2. A timer or signal handler may return btnret_REQUEST_EXIT_PAGE to exit the page.
+	 */
+	struct egi_evloop *evloop;
+	bool		dirty;		/* Set by egi_page_wakeup(), the routine refreshes the page then */
+	int		idle_ms;	/* Interval to check need_refresh set without egi_page_wakeup(), as by
+					 * runners setting ebox->need_refresh directly. 0 for never, then the
+					 * page sleeps till events come. Default EGI_PAGE_IDLEMS.
+					 */
+
+	/* Retained scene, see egi_scene.h
+	 *  If retained, egi_page_refresh() redraws only the damage, and the wallpaper in it.
+	 */
+	bool		retained;
+	EGI_BOX		damage;		/* Damage added by egi_scene_damage(), valid if damaged */
+	bool		damaged;
 };
 
 
@@ -0,0 +1,464 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Glyph atlas for a FreeType2 face at a fixed size, see egi_FTatlas.h
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "egi_FTatlas.h"
+#include "egi_FTcache.h"
+#include "egi_image.h"
+#include "egi_log.h"
+
+#define FTATLAS_SHELF_ROUND	4	/* Shelf height is rounded up to multiples of it */
+
+/* Registered atlases */
+static EGI_FTATLAS	*atlas_list;
+static pthread_mutex_t	atlas_list_lock=PTHREAD_MUTEX_INITIALIZER;
+
+
+/*----------------------------------------------
+Get a free slot in the glyph pool, the pool is
+enlarged if no free slot.
+Return:
+	>=0	Index of the slot
+	<0	Fails
+-----------------------------------------------*/
+static int FTatlas_newSlot(EGI_FTATLAS *atlas)
+{
+	EGI_FTATLAS_GLYPH *glyphs;
+	int capacity;
+	int i, index;
+
+	if(atlas->freelist<0) {
+		capacity = atlas->capacity>0 ? atlas->capacity*2 : 128;
+		glyphs=realloc(atlas->glyphs, capacity*sizeof(EGI_FTATLAS_GLYPH));
+		if(glyphs==NULL) {
+			printf("%s: Fail to realloc glyphs.\n", __func__);
+			return -1;
+		}
+		for(i=atlas->capacity; i<capacity; i++)
+			glyphs[i].hnext = i+1<capacity ? i+1 : -1;
+		atlas->freelist=atlas->capacity;
+		atlas->glyphs=glyphs;
+		atlas->capacity=capacity;
+	}
+
+	index=atlas->freelist;
+	atlas->freelist=atlas->glyphs[index].hnext;
+
+	return index;
+}
+
+/*----------------------------------------------
+Take a glyph out of the hash table and put its
+slot back to the free list.
+-----------------------------------------------*/
+static void FTatlas_dropGlyph(EGI_FTATLAS *atlas, int index)
+{
+	int *pi;
+
+	pi=&atlas->htable[atlas->glyphs[index].wcode&(EGI_FTATLAS_HSIZE-1)];
+	while(*pi>=0 && *pi!=index)
+		pi=&atlas->glyphs[*pi].hnext;
+	if(*pi==index)
+		*pi=atlas->glyphs[index].hnext;
+
+	atlas->glyphs[index].shelf=-1;
+	atlas->glyphs[index].hnext=atlas->freelist;
+	atlas->freelist=index;
+	atlas->nglyphs--;
+}
+
+/*----------------------------------------------
+Evict all glyphs in a shelf, and empty the shelf.
+-----------------------------------------------*/
+static void FTatlas_evictShelf(EGI_FTATLAS *atlas, int shelf)
+{
+	int i, index;
+
+	for(i=0; i<EGI_FTATLAS_HSIZE; i++) {
+		index=atlas->htable[i];
+		while(index>=0) {
+			int next=atlas->glyphs[index].hnext;
+			if(atlas->glyphs[index].shelf==shelf)
+				FTatlas_dropGlyph(atlas, index);
+			index=next;
+		}
+	}
+
+	atlas->shelves[shelf].xnext=0;
+	atlas->evictions++;
+}
+
+/*----------------------------------------------------
+Find a shelf to hold a w*h box, a new shelf is opened
+or the least recently used one is evicted if no shelf
+has room.
+Return:
+	>=0	Index of the shelf
+	<0	Fails
+-----------------------------------------------------*/
+static int FTatlas_findShelf(EGI_FTATLAS *atlas, int w, int h)
+{
+	EGI_FTATLAS_SHELF *shelf;
+	int i, best=-1, lru=-1;
+	int top, sh;
+
+	/* 1. A shelf with room */
+	for(i=0; i<atlas->nshelves; i++) {
+		shelf=&atlas->shelves[i];
+		if( shelf->h < h || shelf->xnext+w > atlas->img->width )
+			continue;
+		if(atlas->policy==FTATLAS_SHELF_FIRSTFIT) {
+			best=i;
+			break;
+		}
+		if( best<0 || shelf->h < atlas->shelves[best].h )
+			best=i;
+	}
+	if(best>=0)
+		return best;
+
+	/* 2. Open a new shelf */
+	top = atlas->nshelves>0 ? atlas->shelves[atlas->nshelves-1].y+atlas->shelves[atlas->nshelves-1].h : 0;
+	sh = (h+FTATLAS_SHELF_ROUND-1)/FTATLAS_SHELF_ROUND*FTATLAS_SHELF_ROUND;
+	if( top+sh > atlas->img->height )
+		sh=atlas->img->height-top;
+	if( sh>=h && atlas->nshelves < atlas->maxshelves ) {
+		shelf=&atlas->shelves[atlas->nshelves];
+		shelf->y=top;
+		shelf->h=sh;
+		shelf->xnext=0;
+		return atlas->nshelves++;
+	}
+
+	/* 3. Evict the least recently used shelf which is tall enough */
+	for(i=0; i<atlas->nshelves; i++) {
+		if( atlas->shelves[i].h >= h && ( lru<0 || atlas->shelves[i].stamp < atlas->shelves[lru].stamp ) )
+			lru=i;
+	}
+	if(lru>=0) {
+		FTatlas_evictShelf(atlas, lru);
+		return lru;
+	}
+
+	/* 4. All shelves are too short, evict all and start again */
+	for(i=0; i<atlas->nshelves; i++)
+		FTatlas_evictShelf(atlas, i);
+	atlas->nshelves=0;
+	if(h > atlas->img->height)
+		return -1;
+
+	return FTatlas_findShelf(atlas, w, h);
+}
+
+
+/*-------------------------------------------------------------
+Create an atlas for a face at the given size, and register it
+so FTsymbol_unicode_writeFB() will use it.
+
+@face:		A face object in FreeType2 library.
+@fw,fh:		Width and height of the character in pixels.
+@maxmem:	Memory cap of the atlas surface in bytes,
+		0 for EGI_FTATLAS_MAXMEM.
+@policy:	Shelf packing policy, see enum egi_ftatlas_policy.
+
+Return:
+	Pointer to an EGI_FTATLAS	OK
+	NULL				Fails
+--------------------------------------------------------------*/
+EGI_FTATLAS* FTatlas_create(FT_Face face, int fw, int fh, size_t maxmem, int policy)
+{
+	EGI_FTATLAS *atlas;
+	EGI_FTATLAS *pa;
+	int width, height;
+	int i;
+
+	if(face==NULL || fw<=0 || fh<=0)
+		return NULL;
+
+	if(maxmem==0)
+		maxmem=EGI_FTATLAS_MAXMEM;
+
+	/* A square surface if possible, width in power of 2 */
+	for( width=64; width*2<=EGI_FTATLAS_MAXWIDTH && (size_t)width*2*width*2<=maxmem; width*=2 );
+	height=maxmem/width;
+	if(height < fh) {
+		printf("%s: maxmem=%zu is too small for font size %dx%d.\n", __func__, maxmem, fw, fh);
+		return NULL;
+	}
+
+	atlas=calloc(1, sizeof(EGI_FTATLAS));
+	if(atlas==NULL) {
+		printf("%s: Fail to calloc atlas.\n", __func__);
+		return NULL;
+	}
+	atlas->face=face;
+	atlas->fw=fw;
+	atlas->fh=fh;
+	atlas->policy=policy;
+	atlas->freelist=-1;
+	for(i=0; i<EGI_FTATLAS_HSIZE; i++)
+		atlas->htable[i]=-1;
+
+	/* A8 surface */
+	atlas->img=egi_imgbuf_alloc();
+	if(atlas->img==NULL)
+		goto FAILS;
+	atlas->img->width=width;
+	atlas->img->height=height;
+	atlas->img->alpha=calloc(1, width*height);
+	if(atlas->img->alpha==NULL) {
+		printf("%s: Fail to calloc alpha for atlas surface.\n", __func__);
+		goto FAILS;
+	}
+
+	atlas->maxshelves=height/FTATLAS_SHELF_ROUND+1;
+	atlas->shelves=calloc(atlas->maxshelves, sizeof(EGI_FTATLAS_SHELF));
+	if(atlas->shelves==NULL) {
+		printf("%s: Fail to calloc shelves.\n", __func__);
+		goto FAILS;
+	}
+
+	if(pthread_mutex_init(&atlas->lock, NULL) != 0) {
+		printf("%s: Fail to init atlas lock.\n", __func__);
+		goto FAILS;
+	}
+
+	/* Register it */
+	pthread_mutex_lock(&atlas_list_lock);
+	for(pa=atlas_list; pa!=NULL; pa=pa->next) {
+		if( pa->face==face && pa->fw==fw && pa->fh==fh )
+			break;
+	}
+	if(pa) {
+		pthread_mutex_unlock(&atlas_list_lock);
+		printf("%s: An atlas of the face at size %dx%d already exists.\n", __func__, fw, fh);
+		pthread_mutex_destroy(&atlas->lock);
+		goto FAILS;
+	}
+	atlas->next=atlas_list;
+	__atomic_store_n(&atlas_list, atlas, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&atlas_list_lock);
+
+	EGI_PLOG(LOGLV_INFO, "%s: Atlas %dx%d created for font size %dx%d.", __func__, width, height, fw, fh);
+
+	return atlas;
+
+FAILS:
+	egi_imgbuf_free(atlas->img);
+	free(atlas->shelves);
+	free(atlas);
+	return NULL;
+}
+
+
+/*-------------------------------------------------------------
+Unregister and free an atlas.
+--------------------------------------------------------------*/
+void FTatlas_free(EGI_FTATLAS **atlas)
+{
+	EGI_FTATLAS **pp;
+
+	if(atlas==NULL || *atlas==NULL)
+		return;
+
+	pthread_mutex_lock(&atlas_list_lock);
+	for(pp=&atlas_list; *pp!=NULL && *pp!=*atlas; pp=&(*pp)->next);
+	if(*pp==NULL) {
+		/* Not registered, or freed by another thread */
+		pthread_mutex_unlock(&atlas_list_lock);
+		*atlas=NULL;
+		return;
+	}
+	__atomic_store_n(pp, (*atlas)->next, __ATOMIC_RELEASE);
+
+	/* Wait for the last user */
+	pthread_mutex_lock(&(*atlas)->lock);
+	pthread_mutex_unlock(&(*atlas)->lock);
+	pthread_mutex_unlock(&atlas_list_lock);
+
+	EGI_PLOG(LOGLV_INFO, "%s: Atlas for font size %dx%d: hits %u, misses %u, evictions %u, %d glyphs in %d shelves.",
+			__func__, (*atlas)->fw, (*atlas)->fh, (*atlas)->hits, (*atlas)->misses,
+			(*atlas)->evictions, (*atlas)->nglyphs, (*atlas)->nshelves);
+
+	pthread_mutex_destroy(&(*atlas)->lock);
+	egi_imgbuf_free((*atlas)->img);
+	free((*atlas)->shelves);
+	free((*atlas)->glyphs);
+	free(*atlas);
+	*atlas=NULL;
+}
+
+
+/*-------------------------------------------------------------
+Free all atlases of a face, call it before the face is released
+by FT_Done_Face().
+--------------------------------------------------------------*/
+void FTatlas_freeFace(FT_Face face)
+{
+	EGI_FTATLAS *atlas;
+
+	if(face==NULL)
+		return;
+
+	while(1) {
+		pthread_mutex_lock(&atlas_list_lock);
+		for(atlas=atlas_list; atlas!=NULL && atlas->face!=face; atlas=atlas->next);
+		pthread_mutex_unlock(&atlas_list_lock);
+
+		if(atlas==NULL)
+			break;
+		FTatlas_free(&atlas);
+	}
+}
+
+
+/*-------------------------------------------------------------
+Find the atlas of a face/size and lock it.
+
+Return:
+	Pointer to the locked atlas	OK
+	NULL				No atlas for the face/size
+--------------------------------------------------------------*/
+EGI_FTATLAS* FTatlas_lock(FT_Face face, int fw, int fh)
+{
+	EGI_FTATLAS *atlas;
+
+	/* Nothing to lock if no atlas at all */
+	if( __atomic_load_n(&atlas_list, __ATOMIC_ACQUIRE)==NULL )
+		return NULL;
+
+	pthread_mutex_lock(&atlas_list_lock);
+	for(atlas=atlas_list; atlas!=NULL; atlas=atlas->next) {
+		if( atlas->face==face && atlas->fw==fw && atlas->fh==fh )
+			break;
+	}
+	if(atlas)
+		pthread_mutex_lock(&atlas->lock);
+	pthread_mutex_unlock(&atlas_list_lock);
+
+	return atlas;
+}
+
+/*-------------------------------------------------------------
+Unlock an atlas locked by FTatlas_lock().
+--------------------------------------------------------------*/
+void FTatlas_unlock(EGI_FTATLAS *atlas)
+{
+	if(atlas)
+		pthread_mutex_unlock(&atlas->lock);
+}
+
+
+/*-------------------------------------------------------------
+Get a glyph from the atlas, it's rendered by FreeType and packed
+into the atlas surface if missed. The returned glyph is valid
+until the next call or the atlas is unlocked.
+
+Alpha of the glyph bitmap is at:
+	atlas->img->alpha + glyph->y*atlas->img->width + glyph->x
+with a row pitch of atlas->img->width.
+
+@atlas:		An atlas locked by FTatlas_lock().
+@wcode:		UNICODE of the character.
+
+Return:
+	Pointer to an EGI_FTATLAS_GLYPH		OK
+	NULL					Fails
+--------------------------------------------------------------*/
+const EGI_FTATLAS_GLYPH* FTatlas_getGlyph(EGI_FTATLAS *atlas, wchar_t wcode)
+{
+	EGI_FTATLAS_GLYPH *glyph;
+	EGI_FTATLAS_SHELF *shelf;
+	FT_GlyphSlot slot;
+	int index, s;
+	int i, w, h;
+
+	if(atlas==NULL)
+		return NULL;
+
+	/* Search in the atlas */
+	for( index=atlas->htable[wcode&(EGI_FTATLAS_HSIZE-1)]; index>=0; index=atlas->glyphs[index].hnext ) {
+		glyph=&atlas->glyphs[index];
+		if(glyph->wcode==wcode) {
+			if(glyph->shelf>=0)
+				atlas->shelves[glyph->shelf].stamp=++atlas->stamp;
+			atlas->hits++;
+			return glyph;
+		}
+	}
+
+	atlas->misses++;
+
+	/* Render it by FreeType, the face is shared with the glyph cache */
+	if(FTcache_lockFace(atlas->face)!=0)
+		return NULL;
+	if( FT_Set_Pixel_Sizes(atlas->face, atlas->fw, atlas->fh) ) {
+		printf("%s: FT_Set_Pixel_Sizes() fails!\n",__func__);
+		goto END_FAIL;
+	}
+	if( FT_Load_Char(atlas->face, wcode, FT_LOAD_RENDER) ) {
+		printf("%s: FT_Load_Char() fails!\n",__func__);
+		goto END_FAIL;
+	}
+	slot=atlas->face->glyph;
+	w=slot->bitmap.width;
+	h=slot->bitmap.rows;
+
+	/* Pack the bitmap */
+	s=-1;
+	if( slot->bitmap.buffer!=NULL && w>0 && h>0 ) {
+		if( w > atlas->img->width ) {
+			printf("%s: Glyph width %d is out of atlas.\n", __func__, w);
+			goto END_FAIL;
+		}
+		s=FTatlas_findShelf(atlas, w, h);
+		if(s<0) {
+			printf("%s: No room for glyph %dx%d.\n", __func__, w, h);
+			goto END_FAIL;
+		}
+	}
+
+	index=FTatlas_newSlot(atlas);
+	if(index<0)
+		goto END_FAIL;
+	glyph=&atlas->glyphs[index];
+	glyph->wcode=wcode;
+	glyph->w=w;
+	glyph->h=h;
+	glyph->advanceX=slot->advance.x>>6;
+	glyph->left=slot->bitmap_left;
+	glyph->top=slot->bitmap_top;
+	glyph->shelf=s;
+	glyph->x=0;
+	glyph->y=0;
+	if(s>=0) {
+		shelf=&atlas->shelves[s];
+		glyph->x=shelf->xnext;
+		glyph->y=shelf->y;
+		shelf->xnext += w;
+		shelf->stamp=++atlas->stamp;
+		for(i=0; i<h; i++)
+			memcpy(atlas->img->alpha+(glyph->y+i)*atlas->img->width+glyph->x,
+				slot->bitmap.buffer+i*slot->bitmap.pitch, w);
+	}
+	FTcache_unlockFace(atlas->face);
+
+	glyph->hnext=atlas->htable[wcode&(EGI_FTATLAS_HSIZE-1)];
+	atlas->htable[wcode&(EGI_FTATLAS_HSIZE-1)]=index;
+	atlas->nglyphs++;
+
+	return glyph;
+
+END_FAIL:
+	FTcache_unlockFace(atlas->face);
+	return NULL;
+}
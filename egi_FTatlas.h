@@ -0,0 +1,112 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Glyph atlas for a FreeType2 face at a fixed size.
+
+1. All glyph bitmaps of the face/size are packed into ONE A8 surface
+   (an EGI_IMGBUF with alpha only), each glyph keeps its box(x,y,w,h)
+   in the surface, so text blits read from one contiguous block instead
+   of scattered small allocations.
+2. Boxes are packed in shelves: a shelf is a horizontal strip, glyphs
+   are put in it from left to right. The policy selects a shelf among
+   those tall enough:
+	FTATLAS_SHELF_FIRSTFIT	The first one with room.
+	FTATLAS_SHELF_BESTFIT	The one wasting the least height.
+   A new shelf is opened below the last one if no shelf has room.
+3. When the surface is full, the least recently used shelf is evicted
+   as a whole(all glyphs in it are dropped), and reused.
+4. The surface size is set by maxmem at creation, it's the memory cap
+   of the atlas. For CJK text with thousands of distinct glyphs, give
+   it enough memory to hold the glyphs of a page at least.
+5. An atlas is registered after creation, FTsymbol_unicode_writeFB()
+   uses it for the face/size instead of the glyph cache(egi_FTcache).
+
+Example:
+	FTatlas_create(face, 18, 18, 512*1024, FTATLAS_SHELF_BESTFIT);
+	... FTsymbol_uft8strings_writeFB(fbdev, face, 18, 18, ...) ...
+	FTatlas_freeFace(face);
+
+Note:
+1. Glyph data is valid only when the atlas is locked, see FTatlas_lock().
+2. Call FTatlas_freeFace() before FT_Done_Face().
+3. A glyph is rendered under the face lock shared with the glyph cache,
+   see FTcache_lockFace().
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#ifndef __EGI_FTATLAS_H__
+#define __EGI_FTATLAS_H__
+
+#include <stddef.h>
+#include <wchar.h>
+#include <pthread.h>
+#include <freetype2/ft2build.h>
+#include FT_FREETYPE_H
+#include "egi_imgbuf.h"
+
+#define EGI_FTATLAS_MAXMEM	(256*1024)	/* Default memory cap of an atlas surface */
+#define EGI_FTATLAS_MAXWIDTH	1024		/* Max. width of an atlas surface */
+#define EGI_FTATLAS_HSIZE	256		/* Hash table size, power of 2 */
+
+enum egi_ftatlas_policy {
+	FTATLAS_SHELF_FIRSTFIT	=0,
+	FTATLAS_SHELF_BESTFIT	=1,
+};
+
+typedef struct egi_ftatlas_glyph {
+	wchar_t		wcode;
+	int		x;		/* Box of the bitmap in the atlas surface */
+	int		y;
+	int		w;
+	int		h;
+	int		advanceX;	/* slot->advance.x>>6 */
+	int		left;		/* slot->bitmap_left */
+	int		top;		/* slot->bitmap_top */
+	int		shelf;		/* Index of the shelf, <0 if no bitmap(such as SPACE) */
+	int		hnext;		/* Hash chain, index of the next glyph, <0 as end */
+} EGI_FTATLAS_GLYPH;
+
+typedef struct egi_ftatlas_shelf {
+	int		y;		/* Top of the shelf */
+	int		h;		/* Height of the shelf */
+	int		xnext;		/* Next free X in the shelf */
+	unsigned int	stamp;		/* Last used */
+} EGI_FTATLAS_SHELF;
+
+typedef struct egi_ftatlas EGI_FTATLAS;
+struct egi_ftatlas {
+	FT_Face			face;
+	int			fw;
+	int			fh;
+	int			policy;		/* enum egi_ftatlas_policy */
+
+	EGI_IMGBUF		*img;		/* A8 surface, img->imgbuf is NULL */
+	EGI_FTATLAS_SHELF	*shelves;
+	int			nshelves;
+	int			maxshelves;
+
+	EGI_FTATLAS_GLYPH	*glyphs;	/* Glyph pool, glyphs are referred by index */
+	int			capacity;
+	int			freelist;	/* Free glyph slots, linked by hnext */
+	int			htable[EGI_FTATLAS_HSIZE];
+	unsigned int		stamp;
+
+	unsigned int		hits;		/* Statistics, read with the atlas locked */
+	unsigned int		misses;
+	unsigned int		evictions;	/* Evicted shelves */
+	int			nglyphs;
+
+	pthread_mutex_t		lock;
+	EGI_FTATLAS		*next;		/* Registry list */
+};
+
+EGI_FTATLAS*		FTatlas_create(FT_Face face, int fw, int fh, size_t maxmem, int policy);
+void			FTatlas_free(EGI_FTATLAS **atlas);
+void			FTatlas_freeFace(FT_Face face);
+EGI_FTATLAS*		FTatlas_lock(FT_Face face, int fw, int fh);
+void			FTatlas_unlock(EGI_FTATLAS *atlas);
+const EGI_FTATLAS_GLYPH* FTatlas_getGlyph(EGI_FTATLAS *atlas, wchar_t wcode);	/* Call with the atlas locked */
+
+#endif
@@ -0,0 +1,637 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Pagination of an UTF-8 txt book, see egi_FTbook.h
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "egi_FTbook.h"
+#include "egi_FTsymbol.h"
+#include "egi_image.h"
+#include "egi_log.h"
+
+#define FTBOOK_IDX_MAGIC	"EGIPGIDX"
+#define FTBOOK_IDX_VERSION	1
+
+/* Header of the sidecar page index file, followed by npages uint32 offsets */
+typedef struct egi_ftbook_idxhead {
+	char		magic[8];
+	int		version;
+	unsigned int	key;
+	long long	fsize;
+	long long	mtime;
+	int		fw;
+	int		fh;
+	unsigned int	pixpl;
+	unsigned int	lines;
+	unsigned int	gap;
+	int		npages;
+	int		done;
+} EGI_FTBOOK_IDXHEAD;
+
+
+/*------------------------------------------------
+FNV-1a hash of a block, continued from hash.
+-------------------------------------------------*/
+static unsigned int FTbook_hash(unsigned int hash, const void *data, size_t size)
+{
+	const unsigned char *p=data;
+
+	while(size--)
+		hash=(hash^*p++)*16777619U;
+
+	return hash;
+}
+
+/*-------------------------------------------------
+Append a page offset to the index.
+Call with book->lock locked.
+Return:
+	0	OK
+	<0	Fails
+--------------------------------------------------*/
+static int FTbook_addPage(EGI_FTBOOK *book, unsigned int off)
+{
+	unsigned int *pgoffs;
+	int capacity;
+
+	if(book->npages==book->capacity) {
+		capacity = book->capacity>0 ? book->capacity*2 : 1024;
+		pgoffs=realloc(book->pgoffs, capacity*sizeof(unsigned int));
+		if(pgoffs==NULL)
+			return -1;
+		book->pgoffs=pgoffs;
+		book->capacity=capacity;
+	}
+	book->pgoffs[book->npages++]=off;
+
+	return 0;
+}
+
+/*-------------------------------------------------
+Load the sidecar page index of the book, if it
+matches the book.
+Return:
+	0	OK
+	<0	No index, or it doesn't match.
+--------------------------------------------------*/
+static int FTbook_loadIndex(EGI_FTBOOK *book)
+{
+	EGI_FTBOOK_IDXHEAD head;
+	FILE *fil;
+	int ret=0;
+
+	fil=fopen(book->idxpath, "rb");
+	if(fil==NULL)
+		return -1;
+
+	if( fread(&head, sizeof(head), 1, fil)!=1 || memcmp(head.magic, FTBOOK_IDX_MAGIC, 8)!=0
+	    || head.version!=FTBOOK_IDX_VERSION || head.key!=book->key
+	    || head.fsize!=(long long)book->fsize || head.mtime!=book->mtime
+	    || head.fw!=book->fw || head.fh!=book->fh || head.pixpl!=book->pixpl
+	    || head.lines!=book->lines || head.gap!=book->gap || head.npages<=0 ) {
+		ret=-2;
+		goto END_FUNC;
+	}
+
+	book->pgoffs=malloc(head.npages*sizeof(unsigned int));
+	if(book->pgoffs==NULL) {
+		ret=-3;
+		goto END_FUNC;
+	}
+	if( fread(book->pgoffs, sizeof(unsigned int), head.npages, fil) != head.npages ) {
+		free(book->pgoffs);
+		book->pgoffs=NULL;
+		ret=-4;
+		goto END_FUNC;
+	}
+	book->npages=head.npages;
+	book->capacity=head.npages;
+	book->nsaved=head.npages;
+	book->done=head.done;
+
+END_FUNC:
+	fclose(fil);
+	return ret;
+}
+
+/*-------------------------------------------------------
+Save the page index to the sidecar file, it's written to
+a temporary file and then renamed.
+Only the pagination thread modifies pgoffs and npages,
+so it can call this without book->lock.
+
+Return:
+	0	OK
+	<0	Fails
+--------------------------------------------------------*/
+static int FTbook_saveIndex(EGI_FTBOOK *book, int npages, bool done)
+{
+	EGI_FTBOOK_IDXHEAD head;
+	char tmppath[strlen(book->idxpath)+8];
+	FILE *fil;
+	int ret=0;
+
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, FTBOOK_IDX_MAGIC, 8);
+	head.version=FTBOOK_IDX_VERSION;
+	head.key=book->key;
+	head.fsize=book->fsize;
+	head.mtime=book->mtime;
+	head.fw=book->fw;
+	head.fh=book->fh;
+	head.pixpl=book->pixpl;
+	head.lines=book->lines;
+	head.gap=book->gap;
+	head.npages=npages;
+	head.done=done;
+
+	sprintf(tmppath, "%s.tmp", book->idxpath);
+	fil=fopen(tmppath, "wb");
+	if(fil==NULL)
+		return -1;
+
+	if( fwrite(&head, sizeof(head), 1, fil)!=1
+	    || fwrite(book->pgoffs, sizeof(unsigned int), npages, fil)!=npages )
+		ret=-2;
+	if( fclose(fil)!=0 )
+		ret=-3;
+
+	if( ret==0 && rename(tmppath, book->idxpath)!=0 )
+		ret=-4;
+	if(ret!=0)
+		remove(tmppath);
+
+	return ret;
+}
+
+/*---------------------------------------------------------------
+Render a page to a surface of pixpl*(lines*(fh+gap)), txt starts
+from its left top.
+
+@off:	Start offset of the page.
+@pimg:	Pointer to the surface, it's reused if not NULL, or a new
+	one is created.
+Return:
+	0	OK
+	<0	Fails
+----------------------------------------------------------------*/
+static int FTbook_renderPage(EGI_FTBOOK *book, unsigned int off, int color, EGI_IMGBUF **pimg)
+{
+	EGI_IMGBUF *img=*pimg;
+	FBDEV vfb={0};
+	int w=book->pixpl;
+	int h=book->lines*(book->fh+book->gap);
+	int i,k;
+
+	if(img==NULL) {
+		img=egi_imgbuf_create(h, w, 0, color);
+		if(img==NULL)
+			return -1;
+		*pimg=img;
+	}
+	else {
+		for(i=0; i<w*h; i++)
+			img->imgbuf[i]=color;
+		memset(img->alpha, 0, w*h);
+	}
+
+	if( init_virt_fbdev(&vfb, img)!=0 )
+		return -2;
+	FTsymbol_uft8strings_writeFB(&vfb, book->face, book->fw, book->fh, book->faddr+off,
+					book->pixpl, book->lines, book->gap, 0, 0,
+					color, -1, 255, NULL, NULL, NULL, NULL);
+	release_virt_fbdev(&vfb);
+
+	/* As egi_16bitColor_blend() takes alpha*3/2 for glyphs */
+	for(i=0; i<w*h; i++) {
+		k=img->alpha[i]*3/2;
+		img->alpha[i]= k>255 ? 255 : k;
+	}
+	egi_imgbuf_enableAlphaRLE(img, true);
+	egi_imgbuf_freeAlphaRLE(img);
+
+	return 0;
+}
+
+/*-------------------------------------------------
+Get the slot holding page n of color.
+Call with book->lock locked.
+--------------------------------------------------*/
+static EGI_FTBOOK_SLOT* FTbook_findSlot(EGI_FTBOOK *book, int n, int color)
+{
+	int i;
+
+	for(i=0; i<EGI_FTBOOK_SLOTS; i++) {
+		if( book->slots[i].page==n && book->slots[i].color==color && book->slots[i].img )
+			return &book->slots[i];
+	}
+
+	return NULL;
+}
+
+/*------------------------------------------------------------------
+The pagination thread:
+1. Render neighbours of curpage when asked by FTbook_writePage().
+2. Otherwise index pages one by one, and save the index every
+   EGI_FTBOOK_SAVESTEP pages and when finished.
+-------------------------------------------------------------------*/
+static void* FTbook_thread(void *arg)
+{
+	EGI_FTBOOK *book=arg;
+	EGI_FTBOOK_SLOT *slot;
+	EGI_IMGBUF *img;
+	unsigned int off;
+	int nbytes;
+	int cur, color;
+	int i, k, n;
+	int ret;
+
+	pthread_mutex_lock(&book->lock);
+	while(!book->quit) {
+
+		/* 1. Render neighbour pages */
+		if(book->prefetch) {
+			book->prefetch=false;
+			cur=book->curpage;
+			color=book->color;
+			for(k=cur+1; k>=cur-1 && !book->quit; k-=2) {
+				if( k<0 || k>=book->npages || FTbook_findSlot(book, k, color) )
+					continue;
+
+				off=book->pgoffs[k];
+				img=book->spare;
+				book->spare=NULL;
+				pthread_mutex_unlock(&book->lock);
+
+				ret=FTbook_renderPage(book, off, color, &img);
+
+				pthread_mutex_lock(&book->lock);
+				if(ret!=0) {
+					book->spare=img;
+					continue;
+				}
+
+				/* Take an empty slot, or the one farthest from curpage */
+				slot=&book->slots[0];
+				for(i=0; i<EGI_FTBOOK_SLOTS; i++) {
+					if(book->slots[i].page<0) {
+						slot=&book->slots[i];
+						break;
+					}
+					if( abs(book->slots[i].page-book->curpage) > abs(slot->page-book->curpage) )
+						slot=&book->slots[i];
+				}
+				book->spare=slot->img;
+				slot->img=img;
+				slot->page=k;
+				slot->color=color;
+			}
+			continue;
+		}
+
+		/* 2. Index the next page */
+		if(!book->done) {
+			off=book->pgoffs[book->npages-1];
+			pthread_mutex_unlock(&book->lock);
+
+			/* Read ahead of the pages, and drop those indexed */
+			egi_txtsrc_advise(book->src, off);
+
+			nbytes=FTsymbol_uft8strings_writeFB(NULL, book->face, book->fw, book->fh,
+							book->faddr+off, book->pixpl, book->lines,
+							book->gap, 0, 0, -1, -1, 255, NULL, NULL, NULL, NULL);
+
+			pthread_mutex_lock(&book->lock);
+			if( nbytes<=0 || off+nbytes>=book->fsize ) {
+				book->done=true;
+			}
+			else if( FTbook_addPage(book, off+nbytes)!=0 ) {
+				EGI_PLOG(LOGLV_ERROR, "%s: Fail to add page offset, stop at page %d.",
+											__func__, book->npages);
+				book->done=true;
+			}
+			pthread_cond_broadcast(&book->cond);
+
+			/* Save the index */
+			n=book->npages;
+			if( book->nsaved>=0 && ( (book->done && book->nsaved!=n) || n-book->nsaved>=EGI_FTBOOK_SAVESTEP ) ) {
+				pthread_mutex_unlock(&book->lock);
+				ret=FTbook_saveIndex(book, n, book->done);
+				pthread_mutex_lock(&book->lock);
+				if(ret==0) {
+					book->nsaved=n;
+				}
+				else {
+					EGI_PLOG(LOGLV_WARN, "%s: Fail to save page index to '%s'.", __func__, book->idxpath);
+					book->nsaved=-1;
+				}
+			}
+			continue;
+		}
+
+		pthread_cond_wait(&book->cond, &book->lock);
+	}
+	pthread_mutex_unlock(&book->lock);
+
+	return (void *)0;
+}
+
+
+/*-----------------------------------------------------------------------
+Open a txt book and start to paginate it in background, see egi_FTbook.h
+
+@fpath:		Path of the UTF-8 txt file.
+@face:		Font face.
+@fw,fh:		Font size.
+@pixpl:		Pixels per line of the text box.
+@lines:		Lines of the text box.
+@gap:		Gap between lines.
+
+Return:
+	Pointer to EGI_FTBOOK	OK
+	NULL			Fails
+------------------------------------------------------------------------*/
+EGI_FTBOOK* FTbook_open(const char *fpath, FT_Face face, int fw, int fh,
+			unsigned int pixpl, unsigned int lines, unsigned int gap)
+{
+	EGI_FTBOOK *book;
+	int i;
+	int param[5];
+
+	if( fpath==NULL || face==NULL || fw<=0 || fh<=0 || pixpl==0 || lines==0 ) {
+		printf("%s: Input param invalid!\n",__func__);
+		return NULL;
+	}
+
+	book=calloc(1, sizeof(EGI_FTBOOK));
+	if(book==NULL)
+		return NULL;
+
+	/* The txt source is mmaped with '\0' after the end of it */
+	book->src=egi_txtsrc_open(fpath, 0);
+	if( book->src==NULL || book->src->size >= 0xFFFFFFFFULL ) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to open '%s', or it's too big.", __func__, fpath);
+		egi_txtsrc_close(&book->src);
+		free(book);
+		return NULL;
+	}
+	book->faddr=book->src->addr;
+	book->fsize=book->src->size;
+	book->mtime=book->src->mtime;
+	book->face=face;
+	book->fw=fw;
+	book->fh=fh;
+	book->pixpl=pixpl;
+	book->lines=lines;
+	book->gap=gap;
+	book->curpage=-1;
+	for(i=0; i<EGI_FTBOOK_SLOTS; i++)
+		book->slots[i].page=-1;
+
+	/* Key of the file, font and box */
+	book->key=FTbook_hash(2166136261U, &book->fsize, sizeof(book->fsize));
+	book->key=FTbook_hash(book->key, &book->mtime, sizeof(book->mtime));
+	if(face->family_name)
+		book->key=FTbook_hash(book->key, face->family_name, strlen(face->family_name));
+	if(face->style_name)
+		book->key=FTbook_hash(book->key, face->style_name, strlen(face->style_name));
+	param[0]=face->num_glyphs; param[1]=fw; param[2]=fh; param[3]=pixpl; param[4]=lines;
+	book->key=FTbook_hash(book->key, param, sizeof(param));
+	book->key=FTbook_hash(book->key, &gap, sizeof(gap));
+
+	book->fpath=strdup(fpath);
+	book->idxpath=malloc(strlen(fpath)+32);
+	if( book->fpath==NULL || book->idxpath==NULL )
+		goto END_FAIL;
+	sprintf(book->idxpath, "%s.%08x.pgidx", fpath, book->key);
+
+	/* Load the saved index, or start from page 0 */
+	if( FTbook_loadIndex(book)==0 ) {
+		EGI_PLOG(LOGLV_INFO, "%s: Load %d pages from '%s'%s.", __func__, book->npages,
+							book->idxpath, book->done ? "" : ", to resume");
+	}
+	else if(book->fsize>0) {
+		if( FTbook_addPage(book, 0)!=0 )
+			goto END_FAIL;
+	}
+	else {
+		book->done=true;
+	}
+
+	if( pthread_mutex_init(&book->lock, NULL)!=0 )
+		goto END_FAIL;
+	if( pthread_cond_init(&book->cond, NULL)!=0 ) {
+		pthread_mutex_destroy(&book->lock);
+		goto END_FAIL;
+	}
+	if( pthread_create(&book->thread, NULL, FTbook_thread, book)!=0 ) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to create pagination thread.", __func__);
+		pthread_cond_destroy(&book->cond);
+		pthread_mutex_destroy(&book->lock);
+		goto END_FAIL;
+	}
+
+	return book;
+
+END_FAIL:
+	egi_txtsrc_close(&book->src);
+	free(book->pgoffs);
+	free(book->idxpath);
+	free(book->fpath);
+	free(book);
+	return NULL;
+}
+
+
+/*---------------------------------------------------
+Stop pagination and close a book. The page index is
+saved if pages are indexed since last saving, so it
+will resume next time.
+----------------------------------------------------*/
+void FTbook_close(EGI_FTBOOK **book)
+{
+	EGI_FTBOOK *bk;
+	int i;
+
+	if(book==NULL || *book==NULL)
+		return;
+	bk=*book;
+
+	pthread_mutex_lock(&bk->lock);
+	bk->quit=true;
+	pthread_cond_broadcast(&bk->cond);
+	pthread_mutex_unlock(&bk->lock);
+	pthread_join(bk->thread, NULL);
+
+	if( bk->nsaved>=0 && bk->nsaved!=bk->npages )
+		FTbook_saveIndex(bk, bk->npages, bk->done);
+
+	for(i=0; i<EGI_FTBOOK_SLOTS; i++)
+		egi_imgbuf_free(bk->slots[i].img);
+	egi_imgbuf_free(bk->spare);
+
+	pthread_cond_destroy(&bk->cond);
+	pthread_mutex_destroy(&bk->lock);
+	egi_txtsrc_close(&bk->src);
+	free(bk->pgoffs);
+	free(bk->idxpath);
+	free(bk->fpath);
+	free(bk);
+
+	*book=NULL;
+}
+
+
+/*---------------------------------------------------
+Get pages indexed.
+
+@done:	If not NULL, set true if all pages indexed.
+
+Return:
+	Pages indexed, it's the total pages if done.
+----------------------------------------------------*/
+int FTbook_totalPages(EGI_FTBOOK *book, bool *done)
+{
+	int n;
+
+	if(book==NULL)
+		return 0;
+
+	pthread_mutex_lock(&book->lock);
+	n=book->npages;
+	if(done)
+		*done=book->done;
+	pthread_mutex_unlock(&book->lock);
+
+	return n;
+}
+
+
+/*---------------------------------------------------
+Get start offset of page n in the book file.
+
+@n:	Page index, from 0.
+@wait:	If true, wait until page n is indexed.
+
+Return:
+	>=0	Offset of the page
+	<0	Page n doesn't exist, or not indexed yet.
+----------------------------------------------------*/
+long FTbook_pageOffset(EGI_FTBOOK *book, int n, bool wait)
+{
+	long off=-1;
+
+	if(book==NULL || n<0)
+		return -1;
+
+	pthread_mutex_lock(&book->lock);
+	while( wait && n>=book->npages && !book->done )
+		pthread_cond_wait(&book->cond, &book->lock);
+	if(n<book->npages)
+		off=book->pgoffs[n];
+	pthread_mutex_unlock(&book->lock);
+
+	return off;
+}
+
+
+/*---------------------------------------------------
+Get the page where an offset of the book file is.
+
+@off:	Offset in the book file.
+@wait:	If true, wait until the page is indexed.
+
+Return:
+	>=0	Page index
+	<0	Fails, or not indexed yet.
+----------------------------------------------------*/
+int FTbook_pageOfOffset(EGI_FTBOOK *book, long off, bool wait)
+{
+	int low, high, mid;
+	int n=-1;
+
+	if(book==NULL || off<0 || off>=book->fsize)
+		return -1;
+
+	pthread_mutex_lock(&book->lock);
+	while( wait && !book->done && book->pgoffs[book->npages-1]<=off )
+		pthread_cond_wait(&book->cond, &book->lock);
+
+	/* The last page is known to hold off only if done */
+	if( book->npages>0 && ( book->done || book->pgoffs[book->npages-1]>off ) ) {
+		low=0;
+		high=book->npages-1;
+		while(low<high) {
+			mid=(low+high+1)/2;
+			if(book->pgoffs[mid]<=off)
+				low=mid;
+			else
+				high=mid-1;
+		}
+		n=low;
+	}
+	pthread_mutex_unlock(&book->lock);
+
+	return n;
+}
+
+
+/*----------------------------------------------------------------------
+Write page n of the book to FB, the text box starts at x0,y0.
+If the page is rendered already, it's blitted to FB. Then its
+previous and next pages are rendered in background.
+
+@fb_dev:	FB device
+@book:		The book
+@n:		Page index, from 0. It waits until page n is indexed.
+@x0,y0:		Left top of the text box.
+@fontcolor:	Font color
+
+Return:
+	>=0	Bytes of the page.
+	<0	Fails, or page n doesn't exist.
+-----------------------------------------------------------------------*/
+int FTbook_writePage(FBDEV *fb_dev, EGI_FTBOOK *book, int n, int x0, int y0, int fontcolor)
+{
+	EGI_FTBOOK_SLOT *slot;
+	long off;
+	int nbytes;
+
+	if(fb_dev==NULL || book==NULL)
+		return -1;
+
+	off=FTbook_pageOffset(book, n, true);
+	if(off<0)
+		return -2;
+
+	pthread_mutex_lock(&book->lock);
+	nbytes= n+1<book->npages ? book->pgoffs[n+1]-off : -1;
+	slot=FTbook_findSlot(book, n, fontcolor);
+	if(slot) {
+		egi_imgbuf_windisplay(slot->img, fb_dev, -1, 0, 0, x0, y0, slot->img->width, slot->img->height);
+		pthread_mutex_unlock(&book->lock);
+	}
+	else {
+		pthread_mutex_unlock(&book->lock);
+		nbytes=FTsymbol_uft8strings_writeFB(fb_dev, book->face, book->fw, book->fh, book->faddr+off,
+						book->pixpl, book->lines, book->gap, x0, y0,
+						fontcolor, -1, 255, NULL, NULL, NULL, NULL);
+	}
+
+	/* Render neighbours in background */
+	pthread_mutex_lock(&book->lock);
+	book->curpage=n;
+	book->color=fontcolor;
+	book->prefetch=true;
+	pthread_cond_broadcast(&book->cond);
+	pthread_mutex_unlock(&book->lock);
+
+	return nbytes>=0 ? nbytes : (int)(book->fsize-off);
+}
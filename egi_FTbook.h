@@ -0,0 +1,93 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Pagination of an UTF-8 txt book for a text box and font.
+
+1. FTbook_open() opens the book file as an EGI_TXTSRC(mmaped), and a
+   thread computes start
+   offsets of all pages in background, a page is what
+   FTsymbol_uft8strings_writeFB() writes in the box(pixpl, lines, gap)
+   with the face and size.
+2. The page index is saved to a sidecar file(fpath.KEY.pgidx) every
+   EGI_FTBOOK_SAVESTEP pages and when finished, KEY is a hash of the
+   file(size,mtime), the font and the box. Next time the index is
+   loaded at once, or pagination resumes from where it stopped.
+3. Offset of any indexed page is fetched in O(1), see FTbook_pageOffset().
+4. FTbook_writePage() writes a page to FB, and the thread renders its
+   previous and next pages to surfaces(RGB565+A8) in background, so
+   turning to a neighbour page is just a blit.
+
+Example:
+	book=FTbook_open("/mmc/xyj_uft8.txt", egi_appfonts.regular, 18, 18, 230, 12, 5);
+	FTbook_writePage(&gv_fb_dev, book, 0, 5, 30, WEGI_COLOR_BLACK);
+	FTbook_writePage(&gv_fb_dev, book, 1, 5, 30, WEGI_COLOR_BLACK);
+	FTbook_close(&book);
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#ifndef __EGI_FTBOOK_H__
+#define __EGI_FTBOOK_H__
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <freetype2/ft2build.h>
+#include FT_FREETYPE_H
+#include "egi_fbdev.h"
+#include "egi_imgbuf.h"
+#include "egi_txtsrc.h"
+
+#define EGI_FTBOOK_SLOTS	3	/* Rendered pages kept: current page and its neighbours */
+#define EGI_FTBOOK_SAVESTEP	256	/* Save the page index every N pages */
+
+typedef struct egi_ftbook_slot {
+	int		page;		/* <0 as empty */
+	int		color;
+	EGI_IMGBUF	*img;		/* Rendered page, pixpl*(lines*(fh+gap)) */
+} EGI_FTBOOK_SLOT;
+
+typedef struct egi_ftbook EGI_FTBOOK;
+struct egi_ftbook {
+	char			*fpath;
+	EGI_TXTSRC		*src;		/* Text source of the file */
+	const unsigned char	*faddr;		/* src->addr, followed by '\0' at least */
+	size_t			fsize;
+	long long		mtime;
+
+	FT_Face			face;
+	int			fw;
+	int			fh;
+	unsigned int		pixpl;		/* Pixels per line */
+	unsigned int		lines;
+	unsigned int		gap;
+	unsigned int		key;		/* Hash of the file, font and box */
+	char			*idxpath;	/* Sidecar page index file */
+
+	unsigned int		*pgoffs;	/* Start offset of each page */
+	int			npages;		/* Pages indexed */
+	int			capacity;
+	bool			done;		/* All pages indexed */
+	int			nsaved;		/* Pages in the sidecar file, <0 if it can't be saved */
+
+	EGI_FTBOOK_SLOT		slots[EGI_FTBOOK_SLOTS];
+	EGI_IMGBUF		*spare;		/* Surface to render next */
+	int			curpage;	/* Last page written to FB */
+	int			color;		/* Font color of curpage */
+	bool			prefetch;	/* To render neighbours of curpage */
+
+	pthread_t		thread;
+	bool			quit;
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;		/* Signaled when pages indexed, or job comes */
+};
+
+EGI_FTBOOK*	FTbook_open(const char *fpath, FT_Face face, int fw, int fh,
+				unsigned int pixpl, unsigned int lines, unsigned int gap);
+void		FTbook_close(EGI_FTBOOK **book);
+int		FTbook_totalPages(EGI_FTBOOK *book, bool *done);
+long		FTbook_pageOffset(EGI_FTBOOK *book, int n, bool wait);
+int		FTbook_pageOfOffset(EGI_FTBOOK *book, long off, bool wait);
+int		FTbook_writePage(FBDEV *fb_dev, EGI_FTBOOK *book, int n, int x0, int y0, int fontcolor);
+
+#endif
@@ -0,0 +1,479 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Glyph cache for FreeType2 characters, see egi_FTcache.h
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "egi_FTcache.h"
+#include "egi_log.h"
+
+#define FTCACHE_HSIZE	1024	/* Hash table size, power of 2 */
+
+static struct {
+	pthread_mutex_t		lock;
+	EGI_FTGLYPH		**htable;
+	EGI_FTGLYPH		*lru_head;
+	EGI_FTGLYPH		*lru_tail;
+	int			nglyphs;
+	size_t			memsize;
+	size_t			budget;
+
+	unsigned int		hits;
+	unsigned int		misses;
+	unsigned int		evictions;
+	EGI_FTCACHE_SIZE	sizes[EGI_FTCACHE_MAXSIZES];
+} ftcache = { .lock=PTHREAD_MUTEX_INITIALIZER, .budget=EGI_FTCACHE_BUDGET };
+
+/* Lock of a face, see FTcache_lockFace() */
+typedef struct ftcache_facelock FTCACHE_FACELOCK;
+struct ftcache_facelock {
+	FT_Face			face;
+	pthread_mutex_t		lock;
+	FTCACHE_FACELOCK	*next;
+};
+static FTCACHE_FACELOCK	*facelocks;
+static pthread_mutex_t	facelocks_lock=PTHREAD_MUTEX_INITIALIZER;	/* For the list only */
+
+
+/*----------------------------------------
+Hash value of a glyph key.
+-----------------------------------------*/
+static inline unsigned int FTcache_hash(FT_Face face, int fw, int fh, wchar_t wcode)
+{
+	unsigned int h;
+
+	h=(unsigned int)((uintptr_t)face>>4);
+	h=h*31+fw;
+	h=h*31+fh;
+	h=h*31+(unsigned int)wcode;
+	h ^= h>>13;
+	h *= 0x5bd1e995;
+	h ^= h>>15;
+
+	return h&(FTCACHE_HSIZE-1);
+}
+
+/*----------------------------------------------
+Get statistics slot of a face/size. If not found
+and create is true, a new slot is taken.
+Return NULL if not found or all slots are used.
+-----------------------------------------------*/
+static EGI_FTCACHE_SIZE* FTcache_getSize(FT_Face face, int fw, int fh, bool create)
+{
+	EGI_FTCACHE_SIZE *empty=NULL;
+	int i;
+
+	for(i=0; i<EGI_FTCACHE_MAXSIZES; i++) {
+		if(ftcache.sizes[i].face==NULL) {
+			if(empty==NULL)
+				empty=&ftcache.sizes[i];
+		}
+		else if( ftcache.sizes[i].face==face && ftcache.sizes[i].fw==fw && ftcache.sizes[i].fh==fh )
+			return &ftcache.sizes[i];
+	}
+
+	if(create && empty) {
+		memset(empty, 0, sizeof(EGI_FTCACHE_SIZE));
+		empty->face=face;
+		empty->fw=fw;
+		empty->fh=fh;
+	}
+
+	return create ? empty : NULL;
+}
+
+/*----------------------------------------
+Unlink a glyph from the LRU list.
+-----------------------------------------*/
+static void FTcache_lruUnlink(EGI_FTGLYPH *glyph)
+{
+	if(glyph->prev)
+		glyph->prev->next=glyph->next;
+	else
+		ftcache.lru_head=glyph->next;
+	if(glyph->next)
+		glyph->next->prev=glyph->prev;
+	else
+		ftcache.lru_tail=glyph->prev;
+	glyph->prev=NULL;
+	glyph->next=NULL;
+}
+
+/*----------------------------------------
+Put a glyph at the head of the LRU list.
+-----------------------------------------*/
+static void FTcache_lruPush(EGI_FTGLYPH *glyph)
+{
+	glyph->prev=NULL;
+	glyph->next=ftcache.lru_head;
+	if(ftcache.lru_head)
+		ftcache.lru_head->prev=glyph;
+	ftcache.lru_head=glyph;
+	if(ftcache.lru_tail==NULL)
+		ftcache.lru_tail=glyph;
+}
+
+/*----------------------------------------
+Remove a glyph from the cache and free it.
+-----------------------------------------*/
+static void FTcache_remove(EGI_FTGLYPH *glyph)
+{
+	EGI_FTGLYPH **pp;
+	EGI_FTCACHE_SIZE *size;
+
+	pp=&ftcache.htable[FTcache_hash(glyph->face, glyph->fw, glyph->fh, glyph->wcode)];
+	while(*pp && *pp!=glyph)
+		pp=&(*pp)->hnext;
+	if(*pp)
+		*pp=glyph->hnext;
+
+	FTcache_lruUnlink(glyph);
+
+	size=FTcache_getSize(glyph->face, glyph->fw, glyph->fh, false);
+	if(size)
+		size->nglyphs--;
+
+	ftcache.nglyphs--;
+	ftcache.memsize -= glyph->memsize;
+	free(glyph);
+}
+
+/*----------------------------------------------
+Evict LRU glyphs until memsize+need <= budget.
+-----------------------------------------------*/
+static void FTcache_evict(size_t need)
+{
+	while( ftcache.lru_tail && ftcache.memsize+need > ftcache.budget ) {
+		FTcache_remove(ftcache.lru_tail);
+		ftcache.evictions++;
+	}
+}
+
+
+/*------------------------------------------
+Lock the glyph cache.
+Return:
+	0	OK
+	<0	Fails
+-------------------------------------------*/
+int FTcache_lock(void)
+{
+	if( pthread_mutex_lock(&ftcache.lock)!=0 ) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to lock ftcache.", __func__);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*------------------------------------------
+Unlock the glyph cache.
+-------------------------------------------*/
+void FTcache_unlock(void)
+{
+	pthread_mutex_unlock(&ftcache.lock);
+}
+
+
+/*-------------------------------------------------------------
+Find the lock of a face, it's created if not found.
+Return NULL if fails.
+--------------------------------------------------------------*/
+static FTCACHE_FACELOCK* FTcache_getFacelock(FT_Face face, bool create)
+{
+	FTCACHE_FACELOCK *flock;
+
+	pthread_mutex_lock(&facelocks_lock);
+
+	for(flock=facelocks; flock!=NULL; flock=flock->next) {
+		if(flock->face==face)
+			break;
+	}
+	if(flock==NULL && create) {
+		flock=calloc(1, sizeof(FTCACHE_FACELOCK));
+		if(flock==NULL)
+			printf("%s: Fail to calloc flock.\n", __func__);
+		else if( pthread_mutex_init(&flock->lock, NULL)!=0 ) {
+			printf("%s: Fail to init flock->lock.\n", __func__);
+			free(flock);
+			flock=NULL;
+		}
+		else {
+			flock->face=face;
+			flock->next=facelocks;
+			facelocks=flock;
+		}
+	}
+
+	pthread_mutex_unlock(&facelocks_lock);
+
+	return flock;
+}
+
+/*-------------------------------------------------------------
+Lock a face before calling FT functions with it, such as
+FT_Set_Pixel_Sizes(), FT_Load_Char() and FT_Get_Kerning().
+A face keeps its size and glyph slot as states, so all users
+of a face shall share this one lock.
+
+Return:
+	0	OK
+	<0	Fails
+--------------------------------------------------------------*/
+int FTcache_lockFace(FT_Face face)
+{
+	FTCACHE_FACELOCK *flock;
+
+	if(face==NULL)
+		return -1;
+
+	flock=FTcache_getFacelock(face, true);
+	if( flock==NULL || pthread_mutex_lock(&flock->lock)!=0 ) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to lock the face.", __func__);
+		return -2;
+	}
+
+	return 0;
+}
+
+/*-------------------------------------------------------------
+Unlock a face locked by FTcache_lockFace().
+--------------------------------------------------------------*/
+void FTcache_unlockFace(FT_Face face)
+{
+	FTCACHE_FACELOCK *flock;
+
+	flock=FTcache_getFacelock(face, false);
+	if(flock)
+		pthread_mutex_unlock(&flock->lock);
+}
+
+
+/*-------------------------------------------------------------
+Get a glyph from the cache, it's rendered by FreeType and put
+into the cache if missed. The caller shall lock the cache by
+FTcache_lock() first, the returned glyph is valid until the
+cache is unlocked.
+
+@face:		A face object in FreeType2 library.
+@fw,fh:		Width and height of the character in pixels.
+@wcode:		UNICODE of the character.
+
+Return:
+	Pointer to an EGI_FTGLYPH	OK
+	NULL				Fails
+--------------------------------------------------------------*/
+const EGI_FTGLYPH* FTcache_getGlyph(FT_Face face, int fw, int fh, wchar_t wcode)
+{
+	EGI_FTGLYPH *glyph;
+	EGI_FTCACHE_SIZE *size;
+	FT_GlyphSlot slot;
+	FT_Error error;
+	unsigned int hash;
+	size_t memsize;
+	int i;
+
+	if(face==NULL)
+		return NULL;
+
+	if(ftcache.htable==NULL) {
+		ftcache.htable=calloc(FTCACHE_HSIZE, sizeof(EGI_FTGLYPH *));
+		if(ftcache.htable==NULL) {
+			printf("%s: Fail to calloc htable.\n", __func__);
+			return NULL;
+		}
+	}
+
+	size=FTcache_getSize(face, fw, fh, true);
+
+	/* Search in the cache */
+	hash=FTcache_hash(face, fw, fh, wcode);
+	for(glyph=ftcache.htable[hash]; glyph!=NULL; glyph=glyph->hnext) {
+		if( glyph->wcode==wcode && glyph->face==face && glyph->fw==fw && glyph->fh==fh ) {
+			if(glyph!=ftcache.lru_head) {
+				FTcache_lruUnlink(glyph);
+				FTcache_lruPush(glyph);
+			}
+			ftcache.hits++;
+			if(size)
+				size->hits++;
+			return glyph;
+		}
+	}
+
+	ftcache.misses++;
+	if(size)
+		size->misses++;
+
+	/* Render it by FreeType, the glyph slot is kept till the bitmap is copied */
+	if(FTcache_lockFace(face)!=0)
+		return NULL;
+	error = FT_Set_Pixel_Sizes(face, fw, fh);
+	if(error) {
+		printf("%s: FT_Set_Pixel_Sizes() fails!\n",__func__);
+		FTcache_unlockFace(face);
+		return NULL;
+	}
+	error = FT_Load_Char( face, wcode, FT_LOAD_RENDER );
+	if(error) {
+		printf("%s: FT_Load_Char() fails!\n",__func__);
+		FTcache_unlockFace(face);
+		return NULL;
+	}
+	slot=face->glyph;
+
+	memsize=sizeof(EGI_FTGLYPH);
+	if(slot->bitmap.buffer)
+		memsize += slot->bitmap.width*slot->bitmap.rows;
+
+	FTcache_evict(memsize);
+
+	glyph=calloc(1, memsize);
+	if(glyph==NULL) {
+		printf("%s: Fail to calloc glyph.\n", __func__);
+		FTcache_unlockFace(face);
+		return NULL;
+	}
+	glyph->face=face;
+	glyph->fw=fw;
+	glyph->fh=fh;
+	glyph->wcode=wcode;
+	glyph->advanceX=slot->advance.x>>6;
+	glyph->left=slot->bitmap_left;
+	glyph->top=slot->bitmap_top;
+	glyph->width=slot->bitmap.width;
+	glyph->rows=slot->bitmap.rows;
+	glyph->memsize=memsize;
+	if(slot->bitmap.buffer) {
+		glyph->alpha=(unsigned char *)(glyph+1);
+		for(i=0; i<glyph->rows; i++)
+			memcpy(glyph->alpha+i*glyph->width, slot->bitmap.buffer+i*slot->bitmap.pitch, glyph->width);
+	}
+	FTcache_unlockFace(face);
+
+	glyph->hnext=ftcache.htable[hash];
+	ftcache.htable[hash]=glyph;
+	FTcache_lruPush(glyph);
+	ftcache.nglyphs++;
+	ftcache.memsize += memsize;
+	if(size)
+		size->nglyphs++;
+
+	return glyph;
+}
+
+
+/*-------------------------------------------------------------
+Set memory budget of the cache, glyphs are evicted if it's
+exceeded now.
+@budget:	Budget in bytes, 0 for EGI_FTCACHE_BUDGET.
+--------------------------------------------------------------*/
+void FTcache_setBudget(size_t budget)
+{
+	if(FTcache_lock()!=0)
+		return;
+
+	ftcache.budget = budget>0 ? budget : EGI_FTCACHE_BUDGET;
+	FTcache_evict(0);
+
+	FTcache_unlock();
+}
+
+
+/*-------------------------------------------------------------
+Remove all glyphs and the lock of a face from the cache, call it
+before the face is released by FT_Done_Face(), and when no one
+uses the face any more.
+--------------------------------------------------------------*/
+void FTcache_flushFace(FT_Face face)
+{
+	EGI_FTGLYPH *glyph, *next;
+	FTCACHE_FACELOCK **pp, *flock;
+	int i;
+
+	if(face==NULL)
+		return;
+
+	/* Remove the face lock */
+	pthread_mutex_lock(&facelocks_lock);
+	for(pp=&facelocks; *pp!=NULL && (*pp)->face!=face; pp=&(*pp)->next);
+	flock=*pp;
+	if(flock)
+		*pp=flock->next;
+	pthread_mutex_unlock(&facelocks_lock);
+	if(flock) {
+		pthread_mutex_destroy(&flock->lock);
+		free(flock);
+	}
+
+	if(FTcache_lock()!=0)
+		return;
+
+	for(glyph=ftcache.lru_head; glyph!=NULL; glyph=next) {
+		next=glyph->next;
+		if(glyph->face==face)
+			FTcache_remove(glyph);
+	}
+	for(i=0; i<EGI_FTCACHE_MAXSIZES; i++) {
+		if(ftcache.sizes[i].face==face)
+			ftcache.sizes[i].face=NULL;
+	}
+
+	FTcache_unlock();
+}
+
+
+/*-------------------------------------------------------------
+Get statistics of the cache.
+--------------------------------------------------------------*/
+void FTcache_getStats(EGI_FTCACHE_STATS *stats)
+{
+	int i;
+
+	if(stats==NULL || FTcache_lock()!=0)
+		return;
+
+	memset(stats, 0, sizeof(EGI_FTCACHE_STATS));
+	stats->hits=ftcache.hits;
+	stats->misses=ftcache.misses;
+	stats->evictions=ftcache.evictions;
+	stats->nglyphs=ftcache.nglyphs;
+	stats->memsize=ftcache.memsize;
+	stats->budget=ftcache.budget;
+	for(i=0; i<EGI_FTCACHE_MAXSIZES; i++) {
+		if(ftcache.sizes[i].face)
+			stats->sizes[stats->nsizes++]=ftcache.sizes[i];
+	}
+
+	FTcache_unlock();
+}
+
+
+/*-------------------------------------------------------------
+Free all glyphs and the hash table, statistics are logged.
+--------------------------------------------------------------*/
+void FTcache_release(void)
+{
+	if(FTcache_lock()!=0)
+		return;
+
+	EGI_PLOG(LOGLV_INFO, "%s: hits %u, misses %u, evictions %u, %d glyphs in %zu bytes.", __func__,
+			ftcache.hits, ftcache.misses, ftcache.evictions, ftcache.nglyphs, ftcache.memsize);
+
+	while(ftcache.lru_head)
+		FTcache_remove(ftcache.lru_head);
+	free(ftcache.htable);
+	ftcache.htable=NULL;
+	memset(ftcache.sizes, 0, sizeof(ftcache.sizes));
+
+	FTcache_unlock();
+}
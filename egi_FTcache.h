@@ -0,0 +1,98 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Glyph cache for FreeType2 characters.
+
+1. A glyph is keyed by (FT_Face, fw, fh, unicode), its rendered A8
+   bitmap, bearings and advance are kept, so FT_Set_Pixel_Sizes() and
+   FT_Load_Char() are called only when it's missed.
+2. Glyphs are kept in an LRU list, and the least recently used ones are
+   evicted when total memory exceeds the byte budget.
+3. Hits/misses are counted for the whole cache and for each face/size.
+4. One global cache is shared by all FTsymbol writeFB functions, it's
+   created at the first use. Glyph data is valid only when the cache
+   is locked by FTcache_lock().
+
+Example:
+	FTcache_lock();
+	glyph=FTcache_getGlyph(face, fw, fh, wcode);
+	... use glyph->alpha ...
+	FTcache_unlock();
+
+Note:
+1. Call FTcache_flushFace() before FT_Done_Face(), or cached glyphs of
+   the face may be mistaken for those of a new face at the same address.
+2. An FT_Face is NOT thread safe. Each face has a lock, see FTcache_lockFace(),
+   and the glyph cache, glyph atlases(egi_FTatlas) and layouts(egi_FTlayout)
+   call FT functions with a face only under its lock. Others calling FT
+   functions with a shared face shall do the same.
+   The face lock is the innermost one, take no other lock while holding it.
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#ifndef __EGI_FTCACHE_H__
+#define __EGI_FTCACHE_H__
+
+#include <stddef.h>
+#include <wchar.h>
+#include <freetype2/ft2build.h>
+#include FT_FREETYPE_H
+
+#define EGI_FTCACHE_BUDGET	(256*1024)	/* Default memory budget in bytes */
+#define EGI_FTCACHE_MAXSIZES	16		/* Max. number of face/size statistics */
+
+typedef struct egi_ftglyph EGI_FTGLYPH;
+struct egi_ftglyph {
+	FT_Face		face;
+	int		fw;
+	int		fh;
+	wchar_t		wcode;
+
+	int		advanceX;	/* slot->advance.x>>6 */
+	int		left;		/* slot->bitmap_left */
+	int		top;		/* slot->bitmap_top */
+	int		width;		/* Bitmap size, alpha is width*rows without padding */
+	int		rows;
+	unsigned char	*alpha;		/* Follows the struct in the same block, NULL if no bitmap(such as SPACE) */
+	size_t		memsize;	/* Size of the block */
+
+	EGI_FTGLYPH	*prev;		/* LRU list, lru_head is the most recently used */
+	EGI_FTGLYPH	*next;
+	EGI_FTGLYPH	*hnext;		/* Hash chain */
+};
+
+/* Statistics of a face/size */
+typedef struct egi_ftcache_size {
+	FT_Face		face;		/* NULL for an empty slot */
+	int		fw;
+	int		fh;
+	unsigned int	hits;
+	unsigned int	misses;
+	int		nglyphs;	/* Glyphs in the cache */
+} EGI_FTCACHE_SIZE;
+
+typedef struct egi_ftcache_stats {
+	unsigned int	hits;
+	unsigned int	misses;
+	unsigned int	evictions;
+	int		nglyphs;
+	size_t		memsize;
+	size_t		budget;
+	int		nsizes;
+	EGI_FTCACHE_SIZE sizes[EGI_FTCACHE_MAXSIZES];
+} EGI_FTCACHE_STATS;
+
+
+int			FTcache_lock(void);
+void			FTcache_unlock(void);
+const EGI_FTGLYPH*	FTcache_getGlyph(FT_Face face, int fw, int fh, wchar_t wcode);	/* Call with FTcache locked */
+int			FTcache_lockFace(FT_Face face);
+void			FTcache_unlockFace(FT_Face face);
+void			FTcache_setBudget(size_t budget);
+void			FTcache_flushFace(FT_Face face);
+void			FTcache_getStats(EGI_FTCACHE_STATS *stats);
+void			FTcache_release(void);
+
+#endif
@@ -0,0 +1,481 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Text layout for FreeType2 fonts, see egi_FTlayout.h
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "egi_FTlayout.h"
+#include "egi_FTsymbol.h"
+#include "egi_FTcache.h"
+#include "egi_cstring.h"
+
+/* Layout cache */
+static EGI_FTLAYOUT	*layout_cache[EGI_FTLAYOUT_CACHE_SIZE];
+static unsigned int	layout_stamps[EGI_FTLAYOUT_CACHE_SIZE];
+static unsigned int	layout_stamp;
+static pthread_mutex_t	layout_lock=PTHREAD_MUTEX_INITIALIZER;	/* For the cache and layout->refs */
+
+/* Punctuations which shall not start or end a line */
+static const wchar_t *nostart_chars=L"，。、！？；：）》」』】〉”’…．,.!?;:)]}%";
+static const wchar_t *noend_chars=L"（《「『【〈“‘([{";
+
+
+/*-------------------------------------------
+Return true if wcode is a CJK character.
+--------------------------------------------*/
+static inline bool FTlayout_isCJK(wchar_t wcode)
+{
+	return  ( wcode>=0x2E80 && wcode<=0x9FFF )	/* CJK radicals, punctuations, Kana, ideographs */
+		|| ( wcode>=0xAC00 && wcode<=0xD7AF )	/* Hangul */
+		|| ( wcode>=0xF900 && wcode<=0xFAFF )	/* CJK compatibility ideographs */
+		|| ( wcode>=0xFF00 && wcode<=0xFFEF );	/* Fullwidth forms */
+}
+
+/*-------------------------------------------
+Return true if wcode is in the set.
+--------------------------------------------*/
+static inline bool FTlayout_inSet(const wchar_t *set, wchar_t wcode)
+{
+	for( ; *set; set++) {
+		if(*set==wcode)
+			return true;
+	}
+
+	return false;
+}
+
+/*-------------------------------------------
+Return true if a line may break between prev
+and wcode.
+--------------------------------------------*/
+static bool FTlayout_canBreak(wchar_t prev, wchar_t wcode)
+{
+	if( FTlayout_inSet(nostart_chars, wcode) || FTlayout_inSet(noend_chars, prev) )
+		return false;
+	if( prev==' ' || prev==0x3000 || prev=='-' )
+		return true;
+	if( FTlayout_isCJK(prev) || FTlayout_isCJK(wcode) )
+		return true;
+
+	return false;
+}
+
+/*-------------------------------------------
+Pixels taken by a character in a line, by the
+same rule as FTsymbol_unicode_writeFB().
+--------------------------------------------*/
+static int FTlayout_advance(FT_Face face, int fw, int fh, wchar_t wcode)
+{
+	int xleft=(1<<30);
+
+	FTsymbol_unicode_writeFB(NULL, face, fw, fh, wcode, &xleft, 0, 0, 0, -1, -1);
+
+	return (1<<30)-xleft;
+}
+
+/*-------------------------------------------
+Kerning between two characters in pixels.
+--------------------------------------------*/
+static int FTlayout_kerning(FT_Face face, int fw, int fh, wchar_t prev, wchar_t wcode)
+{
+	FT_Vector delta;
+	int kern=0;
+
+	/* FT_Face is shared with the glyph cache and atlases */
+	if(FTcache_lockFace(face)!=0)
+		return 0;
+	if( FT_Set_Pixel_Sizes(face, fw, fh)==0
+	    && FT_Get_Kerning(face, FT_Get_Char_Index(face, prev), FT_Get_Char_Index(face, wcode),
+				FT_KERNING_DEFAULT, &delta)==0 )
+		kern=delta.x>>6;
+	FTcache_unlockFace(face);
+
+	return kern;
+}
+
+/*-------------------------------------------
+Hash value of a string.
+--------------------------------------------*/
+static unsigned int FTlayout_hash(const unsigned char *pstr)
+{
+	unsigned int h=2166136261u;
+
+	while(*pstr) {
+		h ^= *pstr++;
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+/*-------------------------------------------
+Start a new line.
+Return:
+	0	OK
+	<0	Fails
+--------------------------------------------*/
+static int FTlayout_newLine(EGI_FTLAYOUT *layout, int *capacity)
+{
+	EGI_FTLAYOUT_LINE *lns;
+
+	if(layout->nlines >= *capacity) {
+		*capacity = *capacity>0 ? *capacity*2 : 16;
+		lns=realloc(layout->lns, (*capacity)*sizeof(EGI_FTLAYOUT_LINE));
+		if(lns==NULL) {
+			printf("%s: Fail to realloc lns.\n", __func__);
+			return -1;
+		}
+		layout->lns=lns;
+	}
+
+	layout->lns[layout->nlines].first=layout->nglyphs;
+	layout->lns[layout->nlines].nglyphs=0;
+	layout->lns[layout->nlines].width=0;
+	layout->lns[layout->nlines].y=layout->nlines*(layout->fh+layout->gap);
+	layout->nlines++;
+
+	return 0;
+}
+
+/*-------------------------------------------
+Free data of a layout.
+--------------------------------------------*/
+static void FTlayout_destroy(EGI_FTLAYOUT *layout)
+{
+	free(layout->glyphs);
+	free(layout->lns);
+	free(layout->text);
+	free(layout);
+}
+
+
+/*-------------------------------------------------------------------------------
+Lay out a UTF-8 string in a text box.
+
+@face:		A face object in FreeType2 library.
+@fw,fh:		Width and height of the character in pixels.
+@pstr:		Pointer to a UTF-8 string.
+@pixpl:		Pixels per line.
+@lines:		Max. number of lines.
+@gap:		Gap between lines in pixels.
+@flags:		FTLAYOUT_WORDWRAP, FTLAYOUT_KERNING, or 0.
+
+Return:
+	Pointer to an EGI_FTLAYOUT	OK, free it by FTlayout_free().
+	NULL				Fails
+--------------------------------------------------------------------------------*/
+EGI_FTLAYOUT* FTlayout_create(FT_Face face, int fw, int fh, const unsigned char *pstr,
+				unsigned int pixpl, unsigned int lines, unsigned int gap, int flags)
+{
+	EGI_FTLAYOUT *layout;
+	EGI_FTLAYOUT_GLYPH *glyph;
+	EGI_FTLAYOUT_LINE *line;
+	const unsigned char *p=pstr;
+	int lncapacity=0;
+	int size;
+	wchar_t wcode;
+	wchar_t prev=0;		/* Previous character in the line, 0 at line start */
+	int brk=-1;		/* Index of the glyph a line may start with, in the current line */
+	int penx=0;
+	int adv, kern;
+	int i, dx;
+
+	if(face==NULL || pstr==NULL || pixpl==0 || lines==0) {
+		printf("%s: Invalid input!\n", __func__);
+		return NULL;
+	}
+
+	layout=calloc(1, sizeof(EGI_FTLAYOUT));
+	if(layout==NULL) {
+		printf("%s: Fail to calloc layout.\n", __func__);
+		return NULL;
+	}
+	layout->face=face;
+	layout->fw=fw;
+	layout->fh=fh;
+	layout->pixpl=pixpl;
+	layout->lines=lines;
+	layout->gap=gap;
+	layout->flags=flags;
+	layout->refs=1;
+
+	/* Glyphs are no more than bytes */
+	layout->glyphs=malloc((strlen((const char *)pstr)+1)*sizeof(EGI_FTLAYOUT_GLYPH));
+	if(layout->glyphs==NULL || FTlayout_newLine(layout, &lncapacity)!=0) {
+		printf("%s: Fail to alloc glyphs.\n", __func__);
+		FTlayout_destroy(layout);
+		return NULL;
+	}
+	if(!FT_HAS_KERNING(face))
+		flags &= ~FTLAYOUT_KERNING;
+
+	while(*p) {
+		size=char_uft8_to_unicode(p, &wcode);
+		if(size<=0) {	/* Step 1 byte forward to locate next recognizable unicode */
+			p++;
+			continue;
+		}
+
+		line=&layout->lns[layout->nlines-1];
+
+		/* Return to next line */
+		if(wcode=='\n') {
+			if( (unsigned int)layout->nlines >= lines )
+				break;
+			p+=size;
+			if(FTlayout_newLine(layout, &lncapacity)!=0)
+				break;
+			penx=0;
+			prev=0;
+			brk=-1;
+			continue;
+		}
+		/* Other control codes or DEL */
+		else if( wcode < 32 || wcode==127 ) {
+			p+=size;
+			continue;
+		}
+
+		adv=FTlayout_advance(face, fw, fh, wcode);
+		kern=0;
+		if( (flags&FTLAYOUT_KERNING) && prev!=0 )
+			kern=FTlayout_kerning(face, fw, fh, prev, wcode);
+
+		if( (flags&FTLAYOUT_WORDWRAP) && prev!=0 && FTlayout_canBreak(prev, wcode) )
+			brk=layout->nglyphs;
+
+		/* Wrap the line */
+WRAP_LINE:
+		if( penx+kern+adv > (int)pixpl && line->nglyphs>0 ) {
+			/* A space at the end of a line is dropped */
+			if( (flags&FTLAYOUT_WORDWRAP) && (wcode==' ' || wcode==0x3000) ) {
+				p+=size;
+				if( (unsigned int)layout->nlines >= lines )
+					break;
+				if(FTlayout_newLine(layout, &lncapacity)!=0)
+					break;
+				penx=0;
+				prev=0;
+				brk=-1;
+				continue;
+			}
+
+			/* Move the last word to the next line */
+			if( !(flags&FTLAYOUT_WORDWRAP) || brk<=line->first )
+				brk=layout->nglyphs;
+			line->nglyphs=brk-line->first;
+			line->width = brk>line->first ? layout->glyphs[brk-1].x+layout->glyphs[brk-1].adv : 0;
+
+			/* Out of the box, the last word is dropped */
+			if( (unsigned int)layout->nlines >= lines ) {
+				if(brk<layout->nglyphs) {
+					p=pstr+layout->glyphs[brk].offset;
+					layout->nglyphs=brk;
+				}
+				penx=line->width;
+				break;
+			}
+
+			if(FTlayout_newLine(layout, &lncapacity)!=0) {
+				if(brk<layout->nglyphs) {
+					p=pstr+layout->glyphs[brk].offset;
+					layout->nglyphs=brk;
+				}
+				break;
+			}
+			line=&layout->lns[layout->nlines-1];
+			line->first=brk;
+			penx=0;
+			if(brk<layout->nglyphs) {
+				dx=layout->glyphs[brk].x;
+				for(i=brk; i<layout->nglyphs; i++) {
+					layout->glyphs[i].x -= dx;
+					layout->glyphs[i].y = line->y;
+				}
+				penx=layout->glyphs[layout->nglyphs-1].x+layout->glyphs[layout->nglyphs-1].adv;
+				line->nglyphs=layout->nglyphs-brk;
+				line->width=penx;
+			}
+			else
+				kern=0;
+			brk=-1;
+
+			/* The moved word may still leave no room for the glyph, then break it at the glyph */
+			goto WRAP_LINE;
+		}
+
+		glyph=&layout->glyphs[layout->nglyphs++];
+		glyph->wcode=wcode;
+		glyph->x=penx+kern;
+		glyph->y=line->y;
+		glyph->adv=adv;
+		glyph->offset=p-pstr;
+		penx=glyph->x+adv;
+		line->nglyphs++;
+		line->width=penx;
+		prev=wcode;
+
+		p+=size;
+	}
+
+	layout->bytes=p-pstr;
+
+	for(i=0; i<layout->nlines; i++) {
+		if(layout->lns[i].width > layout->width)
+			layout->width=layout->lns[i].width;
+	}
+	layout->height=layout->nlines*(fh+gap)-gap;
+	layout->penx=penx;
+	layout->peny=layout->lns[layout->nlines-1].y;
+
+	return layout;
+}
+
+
+/*-------------------------------------------------------------------------------
+Get a layout from the layout cache, it's created and put into the cache if missed.
+Params are the same as FTlayout_create().
+
+Return:
+	Pointer to an EGI_FTLAYOUT	OK, release it by FTlayout_free().
+	NULL				Fails
+--------------------------------------------------------------------------------*/
+EGI_FTLAYOUT* FTlayout_get(FT_Face face, int fw, int fh, const unsigned char *pstr,
+				unsigned int pixpl, unsigned int lines, unsigned int gap, int flags)
+{
+	EGI_FTLAYOUT *layout, *old;
+	unsigned int hash;
+	int i, slot;
+
+	if(pstr==NULL)
+		return NULL;
+
+	hash=FTlayout_hash(pstr);
+
+	pthread_mutex_lock(&layout_lock);
+	for(i=0; i<EGI_FTLAYOUT_CACHE_SIZE; i++) {
+		layout=layout_cache[i];
+		if( layout && layout->hash==hash && layout->face==face && layout->fw==fw && layout->fh==fh
+		    && layout->pixpl==pixpl && layout->lines==lines && layout->gap==gap && layout->flags==flags
+		    && strcmp(layout->text, (const char *)pstr)==0 )
+		{
+			layout->refs++;
+			layout_stamps[i]=++layout_stamp;
+			pthread_mutex_unlock(&layout_lock);
+			return layout;
+		}
+	}
+	pthread_mutex_unlock(&layout_lock);
+
+	layout=FTlayout_create(face, fw, fh, pstr, pixpl, lines, gap, flags);
+	if(layout==NULL)
+		return NULL;
+	layout->text=strdup((const char *)pstr);
+	if(layout->text==NULL)
+		return layout;	/* Not cached */
+	layout->hash=hash;
+
+	/* Put it in an empty or the least recently used slot */
+	pthread_mutex_lock(&layout_lock);
+	slot=0;
+	for(i=0; i<EGI_FTLAYOUT_CACHE_SIZE; i++) {
+		if(layout_cache[i]==NULL) {
+			slot=i;
+			break;
+		}
+		if(layout_stamps[i] < layout_stamps[slot])
+			slot=i;
+	}
+	old=layout_cache[slot];
+	if(old && --old->refs==0)
+		FTlayout_destroy(old);
+	layout->refs++;
+	layout_cache[slot]=layout;
+	layout_stamps[slot]=++layout_stamp;
+	pthread_mutex_unlock(&layout_lock);
+
+	return layout;
+}
+
+
+/*-------------------------------------------------------------------------------
+Release a layout from FTlayout_create() or FTlayout_get(), it's freed when no
+user holds it.
+--------------------------------------------------------------------------------*/
+void FTlayout_free(EGI_FTLAYOUT **layout)
+{
+	if(layout==NULL || *layout==NULL)
+		return;
+
+	pthread_mutex_lock(&layout_lock);
+	if(--(*layout)->refs==0)
+		FTlayout_destroy(*layout);
+	pthread_mutex_unlock(&layout_lock);
+
+	*layout=NULL;
+}
+
+
+/*-------------------------------------------------------------------------------
+Drop layouts of a face from the layout cache, call it before the face is
+released by FT_Done_Face().
+
+@face:	A face object, or NULL for all faces.
+--------------------------------------------------------------------------------*/
+void FTlayout_flushCache(FT_Face face)
+{
+	int i;
+
+	pthread_mutex_lock(&layout_lock);
+	for(i=0; i<EGI_FTLAYOUT_CACHE_SIZE; i++) {
+		if( layout_cache[i] && (face==NULL || layout_cache[i]->face==face) ) {
+			if(--layout_cache[i]->refs==0)
+				FTlayout_destroy(layout_cache[i]);
+			layout_cache[i]=NULL;
+			layout_stamps[i]=0;
+		}
+	}
+	pthread_mutex_unlock(&layout_lock);
+}
+
+
+/*-------------------------------------------------------------------------------
+Write a layout to FB.
+
+@fb_dev:	FB device, or Virt FB.
+@layout:	An EGI_FTLAYOUT.
+@x0,y0:		Left top of the text box, relative to FB coord system.
+@fontcolor, transpcolor, opaque:
+		See FTsymbol_unicode_writeFB().
+
+Return:
+	0	OK
+	<0	Fails
+--------------------------------------------------------------------------------*/
+int FTlayout_writeFB(FBDEV *fb_dev, const EGI_FTLAYOUT *layout, int x0, int y0,
+			int fontcolor, int transpcolor, int opaque)
+{
+	const EGI_FTLAYOUT_GLYPH *glyph;
+	int xleft;
+	int i;
+
+	if(fb_dev==NULL || layout==NULL)
+		return -1;
+
+	for(i=0; i<layout->nglyphs; i++) {
+		glyph=&layout->glyphs[i];
+		xleft=(1<<30);	/* Already measured */
+		FTsymbol_unicode_writeFB(fb_dev, layout->face, layout->fw, layout->fh, glyph->wcode, &xleft,
+						x0+glyph->x, y0+glyph->y, fontcolor, transpcolor, opaque);
+	}
+
+	return 0;
+}
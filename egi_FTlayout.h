@@ -0,0 +1,98 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Text layout for FreeType2 fonts.
+
+1. FTlayout_create() shapes a UTF-8 string into positioned glyphs for a
+   text box(pixpl pixels per line, max. lines, line gap) with a face
+   and size: each glyph gets its pen position relative to the box,
+   and lines get their glyph ranges and pixel widths.
+2. Layout is apart from rendering: FTlayout_writeFB() draws a layout at
+   any position, with any color, without measuring the text again.
+3. Wrapping:
+	Default			Character by character, same as
+				FTsymbol_uft8strings_writeFB().
+	FTLAYOUT_WORDWRAP	Lines break at spaces and around CJK characters,
+				a word is moved to the next line as a whole.
+				CJK punctuations such as '，' '。' never start a line,
+				and opening ones such as '（' '《' never end a line.
+   FTLAYOUT_KERNING applies pair kerning of the face, if it has any.
+4. Layouts are cacheable: FTlayout_get() returns a shared layout of the
+   same string/face/size/box if it's in the layout cache, so headlines
+   and list items are measured once and redrawn cheaply.
+
+Example:
+	layout=FTlayout_get(face, 18, 18, pstr, 300, 5, 4, FTLAYOUT_WORDWRAP);
+	FTlayout_writeFB(fbdev, layout, 10, 10, WEGI_COLOR_BLACK, -1, -1);
+	printf("%d lines, %dx%d pixels\n", layout->nlines, layout->width, layout->height);
+	FTlayout_free(&layout);
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#ifndef __EGI_FTLAYOUT_H__
+#define __EGI_FTLAYOUT_H__
+
+#include <wchar.h>
+#include "egi_fbdev.h"
+#include <freetype2/ft2build.h>
+#include FT_FREETYPE_H
+
+#define FTLAYOUT_WORDWRAP	(1<<0)	/* Break lines at word boundaries, CJK aware */
+#define FTLAYOUT_KERNING	(1<<1)	/* Apply pair kerning */
+
+#define EGI_FTLAYOUT_CACHE_SIZE	32	/* Max. layouts in the layout cache */
+
+typedef struct egi_ftlayout_glyph {
+	wchar_t		wcode;
+	int		x;		/* Pen position(left top of the bbox) relative to the box */
+	int		y;
+	int		adv;		/* Pixels taken in the line */
+	int		offset;		/* Offset of the UTF-8 char in the string, in bytes */
+} EGI_FTLAYOUT_GLYPH;
+
+typedef struct egi_ftlayout_line {
+	int		first;		/* Index of the first glyph */
+	int		nglyphs;
+	int		width;		/* Width of the line in pixels */
+	int		y;		/* Top of the line relative to the box */
+} EGI_FTLAYOUT_LINE;
+
+typedef struct egi_ftlayout EGI_FTLAYOUT;
+struct egi_ftlayout {
+	FT_Face			face;
+	int			fw;
+	int			fh;
+	unsigned int		pixpl;		/* Pixels per line */
+	unsigned int		lines;		/* Max. lines */
+	unsigned int		gap;		/* Gap between lines */
+	int			flags;
+
+	EGI_FTLAYOUT_GLYPH	*glyphs;
+	int			nglyphs;
+	EGI_FTLAYOUT_LINE	*lns;
+	int			nlines;
+
+	int			width;		/* Max. line width in pixels */
+	int			height;		/* nlines*(fh+gap)-gap */
+	int			bytes;		/* Bytes of the string laid out, the rest is out of the box */
+	int			penx;		/* Pen position after the last glyph, relative to the box */
+	int			peny;
+
+	/* For the layout cache */
+	char			*text;		/* Copy of the string */
+	unsigned int		hash;
+	int			refs;
+};
+
+EGI_FTLAYOUT*	FTlayout_create(FT_Face face, int fw, int fh, const unsigned char *pstr,
+				unsigned int pixpl, unsigned int lines, unsigned int gap, int flags);
+EGI_FTLAYOUT*	FTlayout_get(FT_Face face, int fw, int fh, const unsigned char *pstr,
+				unsigned int pixpl, unsigned int lines, unsigned int gap, int flags);
+void		FTlayout_free(EGI_FTLAYOUT **layout);
+void		FTlayout_flushCache(FT_Face face);
+int		FTlayout_writeFB(FBDEV *fb_dev, const EGI_FTLAYOUT *layout, int x0, int y0,
+				int fontcolor, int transpcolor, int opaque);
+
+#endif
@@ -8,12 +8,25 @@ Midas Zhou
 -------------------------------------------------------------------*/
 #include "egi_log.h"
 #include "egi_FTsymbol.h"
+#include "egi_FTcache.h"
+#include "egi_FTatlas.h"
+#include "egi_FTlayout.h"
 #include "egi_symbol.h"
 #include "egi_cstring.h"
 #include "egi_utils.h"
+#include "egi_timer.h"
 #include <freetype2/ft2build.h>
 #include <freetype2/ftglyph.h>
 #include <arpa/inet.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <pthread.h>
 //#include FT_FREETYPE_H
 
 /* <<<<<<<<<<<<<<<<<<   FreeType Fonts  >>>>>>>>>>>>>>>>>>>>>>*/
@@ -23,6 +36,189 @@ EGI_SYMPAGE sympg_ascii={0}; /* default  LiberationMono-Regular */
 EGI_FONTS  egi_sysfonts = {.ftname="sysfonts",};
 EGI_FONTS  egi_appfonts = {.ftname="appfonts",};
 
+/* <<<<<<<<<<<<<<<<<<   Font file registry  >>>>>>>>>>>>>>>>>>>>>>*/
+
+/* A font file mmapped for memory faces, shared by all faces of the file in the process */
+typedef struct egi_fontfile EGI_FONTFILE;
+struct egi_fontfile {
+	char		*fpath;
+	void		*base;		/* mmapped font file */
+	size_t		size;
+	int		refs;		/* Faces on the file now */
+	unsigned int	opens;		/* Faces ever opened on the file */
+	unsigned int	open_us;	/* Time cost of the last FT_New_Memory_Face() */
+	EGI_FONTFILE	*next;
+};
+
+static EGI_FONTFILE	*fontfiles;
+static pthread_mutex_t	fontfiles_lock=PTHREAD_MUTEX_INITIALIZER;
+
+
+/*---------------------------------------------
+Finalizer of a face, called by FT_Done_Face().
+The mapping of the font file is kept until
+FTsymbol_release_allfonts(), since FreeType may
+access the file in FT_Done_Face() after this.
+----------------------------------------------*/
+static void FTsymbol_face_finalizer(void *object)
+{
+	FT_Face face=(FT_Face)object;
+	EGI_FONTFILE *ffile=(EGI_FONTFILE *)face->generic.data;
+
+	if(ffile==NULL)
+		return;
+
+	pthread_mutex_lock(&fontfiles_lock);
+	ffile->refs--;
+	pthread_mutex_unlock(&fontfiles_lock);
+}
+
+/*---------------------------------------------
+Unmap font files which have no face on them.
+----------------------------------------------*/
+static void FTsymbol_release_fontfiles(void)
+{
+	EGI_FONTFILE **pp, *ffile;
+
+	pthread_mutex_lock(&fontfiles_lock);
+	pp=&fontfiles;
+	while(*pp) {
+		ffile=*pp;
+		if(ffile->refs>0) {
+			pp=&ffile->next;
+			continue;
+		}
+		*pp=ffile->next;
+		munmap(ffile->base, ffile->size);
+		free(ffile->fpath);
+		free(ffile);
+	}
+	pthread_mutex_unlock(&fontfiles_lock);
+}
+
+
+/*-------------------------------------------------------------------
+Open a face as FT_New_Face() does, but the font file is mmapped and
+the face is created by FT_New_Memory_Face().
+
+1. A font file is mapped only once in a process, all its faces share
+   the mapping.
+2. FreeType reads font data in place, pages of the file are loaded
+   by the kernel when they are used first, and shared among processes
+   through the page cache. A 10MB CJK font costs only pages of the
+   glyphs ever rendered.
+3. Release the face by FT_Done_Face() as usual.
+
+@library:	An FT_Library.
+@fpath:		Font file path.
+@face_index:	Index of the face in the font file.
+@aface:		Pointer to pass out the face.
+
+Return:
+	0		OK
+	FT_Error	Fails
+--------------------------------------------------------------------*/
+FT_Error FTsymbol_new_face(FT_Library library, const char *fpath, FT_Long face_index, FT_Face *aface)
+{
+	EGI_FONTFILE *ffile;
+	struct stat sb;
+	struct timeval tm_start, tm_end;
+	FT_Error error;
+	int fd;
+
+	if(library==NULL || fpath==NULL || aface==NULL)
+		return FT_Err_Invalid_Argument;
+
+	pthread_mutex_lock(&fontfiles_lock);
+
+	/* Search in the registry */
+	for(ffile=fontfiles; ffile!=NULL; ffile=ffile->next) {
+		if(strcmp(ffile->fpath, fpath)==0)
+			break;
+	}
+
+	/* Map the font file */
+	if(ffile==NULL) {
+		fd=open(fpath, O_RDONLY);
+		if(fd<0) {
+			pthread_mutex_unlock(&fontfiles_lock);
+			return FT_Err_Cannot_Open_Resource;
+		}
+		if( fstat(fd, &sb)<0 || sb.st_size==0 ) {
+			close(fd);
+			pthread_mutex_unlock(&fontfiles_lock);
+			return FT_Err_Cannot_Open_Resource;
+		}
+		ffile=calloc(1, sizeof(EGI_FONTFILE));
+		if(ffile==NULL) {
+			close(fd);
+			pthread_mutex_unlock(&fontfiles_lock);
+			return FT_Err_Out_Of_Memory;
+		}
+		ffile->size=sb.st_size;
+		ffile->base=mmap(NULL, ffile->size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		ffile->fpath=strdup(fpath);
+		if(ffile->base==MAP_FAILED || ffile->fpath==NULL) {
+			if(ffile->base!=MAP_FAILED)
+				munmap(ffile->base, ffile->size);
+			free(ffile->fpath);
+			free(ffile);
+			pthread_mutex_unlock(&fontfiles_lock);
+			return FT_Err_Cannot_Open_Resource;
+		}
+		ffile->next=fontfiles;
+		fontfiles=ffile;
+	}
+
+	gettimeofday(&tm_start, NULL);
+	error=FT_New_Memory_Face(library, (const FT_Byte *)ffile->base, (FT_Long)ffile->size, face_index, aface);
+	gettimeofday(&tm_end, NULL);
+	if(error==0) {
+		ffile->refs++;
+		ffile->opens++;
+		ffile->open_us=tm_diffus(tm_start, tm_end);
+		(*aface)->generic.data=ffile;
+		(*aface)->generic.finalizer=FTsymbol_face_finalizer;
+	}
+
+	pthread_mutex_unlock(&fontfiles_lock);
+
+	return error;
+}
+
+
+/*-------------------------------------------------------------------
+Print usage of font files in the process: faces on each file, times
+opened, cost of the last open, and memory of the file in the page
+cache(shared by all processes).
+--------------------------------------------------------------------*/
+void FTsymbol_print_fontfiles(void)
+{
+	EGI_FONTFILE *ffile;
+	long pgsize=sysconf(_SC_PAGESIZE);
+	unsigned char *vec;
+	size_t npages, i, resident;
+
+	pthread_mutex_lock(&fontfiles_lock);
+	for(ffile=fontfiles; ffile!=NULL; ffile=ffile->next) {
+		npages=(ffile->size+pgsize-1)/pgsize;
+		resident=0;
+		vec=malloc(npages);
+		if( vec && mincore(ffile->base, ffile->size, (void *)vec)==0 ) {
+			for(i=0; i<npages; i++)
+				resident += vec[i]&1;
+		}
+		free(vec);
+
+		EGI_PLOG(LOGLV_INFO, "%s: '%s' %zuKB, %zuKB in page cache, faces %d, opens %u, last open cost %uus.",
+				__func__, ffile->fpath, ffile->size>>10, (resident*pgsize)>>10,
+				ffile->refs, ffile->opens, ffile->open_us);
+	}
+	pthread_mutex_unlock(&fontfiles_lock);
+}
+
+
 
 /*--------------------------------------
 Load FreeType2 EGI_FONT egi_sysfonts
@@ -103,6 +299,10 @@ void FTsymbol_release_allfonts(void)
 	/* release FT fonts libraries */
 	FTsymbol_release_library(&egi_sysfonts);
 	FTsymbol_release_library(&egi_appfonts);
+
+	/* unmap font files */
+	FTsymbol_print_fontfiles();
+	FTsymbol_release_fontfiles();
 }
 
 
@@ -110,6 +310,10 @@ void FTsymbol_release_allfonts(void)
 Load all FT type symbol pages.
 
 1. sympg_ascii
+   If 'ascii_cache' is set in egi.conf, the page is
+   mmapped from the cache file. At the first run, or
+   if the font file is changed, the cache file is
+   created then.
 
 return:
 	0	OK
@@ -118,13 +322,28 @@ return:
 int  FTsymbol_load_allpages(void)
 {
 	char fpath_ascii[EGI_PATH_MAX+EGI_NAME_MAX]={0};
+	char fpath_cache[EGI_PATH_MAX+EGI_NAME_MAX]={0};
+	const int sizes[2]={18,18};
 
 	/* read egi.conf and get fonts paths */
-	if ( egi_get_config_value("FTSYMBOL_PAGE","ascii",fpath_ascii) == 0 &&
-        	/* load ASCII font, bitmap size 18x18 in pixels, each line abt.18x2 pixels in height */
-        	FTsymbol_load_asciis_from_fontfile( &sympg_ascii, fpath_ascii, 18, 18) ==0 )
-        {
+	if ( egi_get_config_value("FTSYMBOL_PAGE","ascii",fpath_ascii) != 0 ) {
+		EGI_PLOG( LOGLV_CRITICAL,"%s: Fail to load FTsymbol page sympg_ascii!", __func__ );
+		return -1;
+	}
 
+	/* Try the cache file first, no FreeType work */
+	if ( egi_get_config_value("FTSYMBOL_PAGE","ascii_cache",fpath_cache) == 0 ) {
+		if( FTsymbol_load_asciis_from_cache(&sympg_ascii, fpath_cache, fpath_ascii, 18, 18)==0
+		    || ( FTsymbol_save_asciis_cache(fpath_cache, fpath_ascii, 1, sizes)==0
+			 && FTsymbol_load_asciis_from_cache(&sympg_ascii, fpath_cache, fpath_ascii, 18, 18)==0 ) )
+		{
+			EGI_PLOG(LOGLV_CRITICAL,"%s: Succeed to load FTsymbol page sympg_ascii from cache!", __func__ );
+			return 0;
+		}
+	}
+
+       	/* load ASCII font, bitmap size 18x18 in pixels, each line abt.18x2 pixels in height */
+	if( FTsymbol_load_asciis_from_fontfile( &sympg_ascii, fpath_ascii, 18, 18) ==0 ) {
 		EGI_PLOG(LOGLV_CRITICAL,"%s: Succeed to load FTsymbol page sympg_ascii!", __func__ );
 		return 0;
 	}
@@ -184,7 +403,7 @@ int FTsymbol_load_library( EGI_FONTS *symlib )
         }
 
 	/* 2. create face object: Regular */
-        error = FT_New_Face( symlib->library, symlib->fpath_regular, 0, &symlib->regular );
+        error = FTsymbol_new_face( symlib->library, symlib->fpath_regular, 0, &symlib->regular );
         if(error==FT_Err_Unknown_File_Format) {
                 EGI_PLOG(LOGLV_WARN,"%s: [%s] font file '%s' opens, but its font format is unsupported!",
 								__func__, symlib->ftname,symlib->fpath_regular);
@@ -202,7 +421,7 @@ int FTsymbol_load_library( EGI_FONTS *symlib )
  							__func__, symlib->ftname, symlib->fpath_regular);
 
 	/* 3. create face object: Light */
-        error = FT_New_Face( symlib->library, symlib->fpath_light, 0, &symlib->light );
+        error = FTsymbol_new_face( symlib->library, symlib->fpath_light, 0, &symlib->light );
         if(error==FT_Err_Unknown_File_Format) {
                 EGI_PLOG(LOGLV_WARN,"%s: [%s] font file '%s' opens, but its font format is unsupported!",
 						     	__func__, symlib->ftname, symlib->fpath_light);
@@ -220,7 +439,7 @@ int FTsymbol_load_library( EGI_FONTS *symlib )
 						 	__func__, symlib->ftname, symlib->fpath_light);
 
 	/* 4. create face object: Bold */
-        error = FT_New_Face( symlib->library, symlib->fpath_bold, 0, &symlib->bold );
+        error = FTsymbol_new_face( symlib->library, symlib->fpath_bold, 0, &symlib->bold );
         if(error==FT_Err_Unknown_File_Format) {
                 EGI_PLOG(LOGLV_WARN,"%s: [%s] font file '%s' opens, but its font format is unsupported!",
 							__func__, symlib->ftname, symlib->fpath_bold);
@@ -238,7 +457,7 @@ int FTsymbol_load_library( EGI_FONTS *symlib )
 							__func__, symlib->ftname,symlib->fpath_bold);
 
 	/* 5. create face object: Special */
-        error = FT_New_Face( symlib->library, symlib->fpath_special, 0, &symlib->special );
+        error = FTsymbol_new_face( symlib->library, symlib->fpath_special, 0, &symlib->special );
         if(error==FT_Err_Unknown_File_Format) {
                 EGI_PLOG(LOGLV_WARN,"%s: [%s] font file '%s' opens, but its font format is unsupported!",
 							__func__, symlib->ftname, symlib->fpath_special);
@@ -296,7 +515,7 @@ FT_Face FTsymbol_create_newFace( EGI_FONTS *symlib, const char *ftpath)
         }
 
 	/* Create a new face according to the input file path */
-        error = FT_New_Face( symlib->library, ftpath, 0, &face);
+        error = FTsymbol_new_face( symlib->library, ftpath, 0, &face);
         if(error==FT_Err_Unknown_File_Format) {
                 EGI_PLOG(LOGLV_WARN,"%s: font file '%s' opens, but its font format is unsupported!",
 							__func__, ftpath);
@@ -321,6 +540,20 @@ void FTsymbol_release_library( EGI_FONTS *symlib )
 	if(symlib==NULL)
 		return;
 
+	/* Layouts, atlases and cached glyphs of the faces */
+	FTlayout_flushCache(symlib->regular);
+	FTlayout_flushCache(symlib->light);
+	FTlayout_flushCache(symlib->bold);
+	FTlayout_flushCache(symlib->special);
+	FTatlas_freeFace(symlib->regular);
+	FTatlas_freeFace(symlib->light);
+	FTatlas_freeFace(symlib->bold);
+	FTatlas_freeFace(symlib->special);
+	FTcache_flushFace(symlib->regular);
+	FTcache_flushFace(symlib->light);
+	FTcache_flushFace(symlib->bold);
+	FTcache_flushFace(symlib->special);
+
  	FT_Done_Face    ( symlib->regular );
   	FT_Done_Face    ( symlib->light );
   	FT_Done_Face    ( symlib->bold );
@@ -437,7 +670,7 @@ int  FTsymbol_load_asciis_from_fontfile(  EGI_SYMPAGE *symfont_page, const char
 	}
 
 	/* A2. create face object, face_index=0 */
- 	error = FT_New_Face( library, font_path, 0, &face );
+ 	error = FTsymbol_new_face( library, font_path, 0, &face );
 	if(error==FT_Err_Unknown_File_Format) {
 		printf("%s: Font file opens, but its font format is unsupported!\n",__func__);
 		FT_Done_FreeType( library );
@@ -703,12 +936,315 @@ FT_FAILS:
 }
 
 
+/* Cache file of ASCII symbol pages:
+ *	[ header ][ entry 0 ... entry nsizes-1 ][ page data 0 ][ page data 1 ] ...
+ * page data: symwidth[maxnum+1], symoffset[maxnum+1], alpha[], each 4-bytes aligned.
+ */
+#define FTSYMPG_CACHE_MAGIC	"EGISYMPG"
+#define FTSYMPG_CACHE_VERSION	1
+#define FTSYMPG_FONT_HASHLEN	(64*1024)	/* Bytes of the font file in its hash */
+
+typedef struct {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	intsize;	/* sizeof(int), cache files are native to the machine */
+	uint64_t	font_hash;
+	uint32_t	nsizes;
+	uint32_t	reserved;
+} FTSYMPG_CACHE_HEADER;
+
+typedef struct {
+	int32_t		Wp;
+	int32_t		Hp;
+	int32_t		symheight;
+	int32_t		maxnum;
+	uint32_t	symwidth_off;	/* Offsets in the file */
+	uint32_t	symoffset_off;
+	uint32_t	alpha_off;
+	uint32_t	alpha_size;
+} FTSYMPG_CACHE_ENTRY;
+
+
+/*------------------------------------------------------------------
+Get hash value of a font file, from its size, mtime and the first
+FTSYMPG_FONT_HASHLEN bytes, so it's cheap to check at startup.
+
+Return:
+	0	OK
+	<0	Fails
+------------------------------------------------------------------*/
+static int FTsymbol_font_hash(const char *font_path, uint64_t *hash)
+{
+	struct stat sb;
+	unsigned char *buf;
+	uint64_t h=14695981039346656037ULL;
+	ssize_t nread;
+	int fd;
+	int i;
+
+	fd=open(font_path, O_RDONLY);
+	if(fd<0) {
+		printf("%s: Fail to open '%s'.\n", __func__, font_path);
+		return -1;
+	}
+	if(fstat(fd, &sb)<0) {
+		close(fd);
+		return -1;
+	}
+	buf=malloc(FTSYMPG_FONT_HASHLEN);
+	if(buf==NULL) {
+		close(fd);
+		return -1;
+	}
+	nread=read(fd, buf, FTSYMPG_FONT_HASHLEN);
+	close(fd);
+	if(nread<0) {
+		free(buf);
+		return -1;
+	}
+
+	for(i=0; i<nread; i++) {
+		h ^= buf[i];
+		h *= 1099511628211ULL;
+	}
+	h ^= (uint64_t)sb.st_size;
+	h *= 1099511628211ULL;
+	h ^= (uint64_t)sb.st_mtime;
+	h *= 1099511628211ULL;
+
+	free(buf);
+	*hash=h;
+
+	return 0;
+}
+
+
+/*-------------------------------------------------------------------------------
+Render ASCII symbol pages of a font file at given sizes, and save them to a cache
+file, which can be loaded by FTsymbol_load_asciis_from_cache() later without any
+FreeType work.
+
+Note:
+1. The cache file is written as cache_path.tmp and renamed at last, so processes
+   loading it never see a half written file.
+2. The cache file is native to the machine(int size and byte order), build it
+   on the target or at the first run.
+
+@cache_path:	Path of the cache file.
+@font_path:	Font file path.
+@nsizes:	Number of sizes.
+@sizes:		Wp,Hp pairs, sizes[2*i]=Wp, sizes[2*i+1]=Hp.
+
+Return:
+	0	OK
+	<0	Fails
+--------------------------------------------------------------------------------*/
+int FTsymbol_save_asciis_cache(const char *cache_path, const char *font_path, int nsizes, const int *sizes)
+{
+	FTSYMPG_CACHE_HEADER header={0};
+	FTSYMPG_CACHE_ENTRY *entries=NULL;
+	EGI_SYMPAGE page={0};
+	char tmp_path[EGI_PATH_MAX+EGI_NAME_MAX];
+	static const char zeros[4]={0};
+	uint32_t off;
+	int pad;
+	FILE *fil;
+	int i, k;
+	int ret=0;
+
+	if(cache_path==NULL || font_path==NULL || nsizes<=0 || sizes==NULL)
+		return -1;
+
+	memcpy(header.magic, FTSYMPG_CACHE_MAGIC, 8);
+	header.version=FTSYMPG_CACHE_VERSION;
+	header.intsize=sizeof(int);
+	header.nsizes=nsizes;
+	if(FTsymbol_font_hash(font_path, &header.font_hash)!=0)
+		return -2;
+
+	entries=calloc(nsizes, sizeof(FTSYMPG_CACHE_ENTRY));
+	if(entries==NULL)
+		return -3;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cache_path);
+	fil=fopen(tmp_path, "wb");
+	if(fil==NULL) {
+		printf("%s: Fail to open '%s'.\n", __func__, tmp_path);
+		free(entries);
+		return -4;
+	}
+
+	/* Header and entries are written at last */
+	off=sizeof(FTSYMPG_CACHE_HEADER)+nsizes*sizeof(FTSYMPG_CACHE_ENTRY);
+	if( fseek(fil, off, SEEK_SET)!=0 ) {
+		ret=-5; goto END_FUNC;
+	}
+
+	for(i=0; i<nsizes; i++) {
+		if( FTsymbol_load_asciis_from_fontfile(&page, font_path, sizes[2*i], sizes[2*i+1]) !=0 ) {
+			printf("%s: Fail to load ASCIIs at size %dx%d.\n", __func__, sizes[2*i], sizes[2*i+1]);
+			ret=-6; goto END_FUNC;
+		}
+
+		entries[i].Wp=sizes[2*i];
+		entries[i].Hp=sizes[2*i+1];
+		entries[i].symheight=page.symheight;
+		entries[i].maxnum=page.maxnum;
+		entries[i].alpha_size=0;
+		for(k=0; k<=page.maxnum; k++)
+			entries[i].alpha_size += page.symwidth[k]*page.symheight;
+
+		entries[i].symwidth_off=off;
+		off += (page.maxnum+1)*sizeof(int);
+		entries[i].symoffset_off=off;
+		off += (page.maxnum+1)*sizeof(int);
+		entries[i].alpha_off=off;
+		off += entries[i].alpha_size;
+		pad = (4-(off&3))&3;
+		off += pad;
+
+		if( fwrite(page.symwidth, sizeof(int), page.maxnum+1, fil) != (size_t)(page.maxnum+1)
+		    || fwrite(page.symoffset, sizeof(int), page.maxnum+1, fil) != (size_t)(page.maxnum+1)
+		    || fwrite(page.alpha, 1, entries[i].alpha_size, fil) != entries[i].alpha_size
+		    || fwrite(zeros, 1, pad, fil) != (size_t)pad )
+		{
+			printf("%s: Fail to write page data.\n", __func__);
+			ret=-7; goto END_FUNC;
+		}
+
+		symbol_release_page(&page);
+		free(page.symwidth);
+		page.symwidth=NULL;
+	}
+
+	rewind(fil);
+	if( fwrite(&header, sizeof(header), 1, fil) != 1
+	    || fwrite(entries, sizeof(FTSYMPG_CACHE_ENTRY), nsizes, fil) != (size_t)nsizes ) {
+		printf("%s: Fail to write header.\n", __func__);
+		ret=-7;
+	}
+
+END_FUNC:
+	symbol_release_page(&page);
+	free(page.symwidth);
+	free(entries);
+	if( fclose(fil)!=0 && ret==0 )
+		ret=-7;
+
+	if(ret==0 && rename(tmp_path, cache_path)!=0) {
+		printf("%s: Fail to rename '%s' to '%s'.\n", __func__, tmp_path, cache_path);
+		ret=-8;
+	}
+	if(ret!=0)
+		unlink(tmp_path);
+	else
+		EGI_PLOG(LOGLV_INFO, "%s: ASCII pages of '%s' at %d sizes are saved to '%s'.",
+					__func__, font_path, nsizes, cache_path);
+
+	return ret;
+}
+
+
+/*-------------------------------------------------------------------------------
+Load an ASCII symbol page from a cache file saved by FTsymbol_save_asciis_cache().
+The cache file is mmapped, and the page refers to it directly, so processes
+loading the same cache share its memory. symbol_release_page() munmaps it.
+
+@symfont_page:	Pointer to a font symbol_page.
+@cache_path:	Path of the cache file.
+@font_path:	Font file path, the cache is valid only if hash of the font matches.
+@Wp, Hp:	Font size in pixels, as for FTsymbol_load_asciis_from_fontfile().
+
+Return:
+	0	OK
+	<0	Fails, or no valid page in the cache.
+--------------------------------------------------------------------------------*/
+int FTsymbol_load_asciis_from_cache(EGI_SYMPAGE *symfont_page, const char *cache_path,
+					const char *font_path, int Wp, int Hp)
+{
+	const FTSYMPG_CACHE_HEADER *header;
+	const FTSYMPG_CACHE_ENTRY *entry=NULL;
+	struct stat sb;
+	uint64_t font_hash;
+	unsigned char *base;
+	size_t tblsize;
+	uint32_t i;
+	int fd;
+
+	if(symfont_page==NULL || cache_path==NULL || font_path==NULL)
+		return -1;
+
+	fd=open(cache_path, O_RDONLY);
+	if(fd<0)
+		return -2;	/* No cache yet */
+	if( fstat(fd, &sb)<0 || sb.st_size < (off_t)sizeof(FTSYMPG_CACHE_HEADER) ) {
+		close(fd);
+		return -3;
+	}
+	base=mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(base==MAP_FAILED) {
+		printf("%s: Fail to mmap '%s': %s\n", __func__, cache_path, strerror(errno));
+		return -3;
+	}
+
+	/* Check header */
+	header=(const FTSYMPG_CACHE_HEADER *)base;
+	tblsize=sizeof(FTSYMPG_CACHE_HEADER)+(size_t)header->nsizes*sizeof(FTSYMPG_CACHE_ENTRY);
+	if( memcmp(header->magic, FTSYMPG_CACHE_MAGIC, 8)!=0 || header->version!=FTSYMPG_CACHE_VERSION
+	    || header->intsize!=sizeof(int) || tblsize > (size_t)sb.st_size ) {
+		printf("%s: '%s' is not a valid cache file.\n", __func__, cache_path);
+		goto FAILS;
+	}
+	if( FTsymbol_font_hash(font_path, &font_hash)!=0 || font_hash!=header->font_hash ) {
+		printf("%s: '%s' is out of date for '%s'.\n", __func__, cache_path, font_path);
+		goto FAILS;
+	}
+
+	/* Find the page */
+	for(i=0; i<header->nsizes; i++) {
+		entry=(const FTSYMPG_CACHE_ENTRY *)(base+sizeof(FTSYMPG_CACHE_HEADER))+i;
+		if(entry->Wp==Wp && entry->Hp==Hp)
+			break;
+	}
+	if(i==header->nsizes) {
+		printf("%s: No page of size %dx%d in '%s'.\n", __func__, Wp, Hp, cache_path);
+		goto FAILS;
+	}
+	if( entry->maxnum<0 || (entry->symwidth_off&3) || (entry->symoffset_off&3)
+	    || entry->symwidth_off+(entry->maxnum+1)*sizeof(int) > (size_t)sb.st_size
+	    || entry->symoffset_off+(entry->maxnum+1)*sizeof(int) > (size_t)sb.st_size
+	    || (size_t)entry->alpha_off+entry->alpha_size > (size_t)sb.st_size ) {
+		printf("%s: Page %dx%d in '%s' is broken.\n", __func__, Wp, Hp, cache_path);
+		goto FAILS;
+	}
+
+	/* release all data before loading it */
+	symbol_release_page(symfont_page);
+
+	symfont_page->symheight=entry->symheight;
+	symfont_page->maxnum=entry->maxnum;
+	symfont_page->data=NULL;
+	symfont_page->symwidth=(int *)(base+entry->symwidth_off);
+	symfont_page->symoffset=(int *)(base+entry->symoffset_off);
+	symfont_page->alpha=base+entry->alpha_off;
+	symfont_page->mmap_base=base;
+	symfont_page->mmap_size=sb.st_size;
+
+	return 0;
+
+FAILS:
+	munmap(base, sb.st_size);
+	return -4;
+}
+
+
 /*--------------------------------------------------------------------------
 To get actual Max. symHeight/bitmapHeight of a string, with dedicated FT_Face
 and font size.
 
-1. Try NOT to use this function, it's slow. and use CAPITAL LETTERs instead
-   of small letters.
+1. Glyphs are taken from the glyph cache(egi_FTcache), use CAPITAL LETTERs
+   instead of small letters.
 2. The purpose of this function is use the result symHeight to put the pstr in
 the middle of some space.
 
@@ -723,18 +1259,15 @@ int FTsymbol_get_symheight(FT_Face face, const unsigned char *pstr, int fw, int
 {
 	int symheight=0;
 	int size;
-  	FT_Error      error;
-  	FT_GlyphSlot slot = face->glyph;
+	const EGI_FTGLYPH *glyph;
 	wchar_t 	wcode;
 
-   	/* Set character size in pixels */
-   	error = FT_Set_Pixel_Sizes(face, fw, fh); /* width,height */
-	if(error) {
-		printf("%s: Fail to set pixel size!\n",__func__);
+	if(face==NULL || pstr==NULL)
 		return -1;
-	}
 
-   	/* Default transformation matrix */
+	/* Take bitmap heights from the glyph cache, it shares the face with others */
+	if(FTcache_lock()!=0)
+		return -1;
 
 	while( *pstr != L'\0' ) {  /* wchar_t string end token */
 
@@ -745,18 +1278,21 @@ int FTsymbol_get_symheight(FT_Face face, const unsigned char *pstr, int fw, int
 		else
 			pstr +=size;
 
-	    	error = FT_Load_Char( face, wcode, FT_LOAD_RENDER );
-	    	if ( error ) {
-			printf("%s: FT_Load_Char() error!\n",__func__);
+		glyph=FTcache_getGlyph(face, fw, fh, wcode);
+		if(glyph==NULL) {
+			printf("%s: Fail to get glyph!\n",__func__);
+			FTcache_unlock();
 			return -1;
 		}
 
-		if(symheight < slot->bitmap.rows) {
-			symheight=slot->bitmap.rows;
-			// printf("%s: symheight=%d, deltY=%d \n", (char *)&wcode, symheight, -slot->bitmap_top + fh);
+		if(symheight < glyph->rows) {
+			symheight=glyph->rows;
+			// printf("%s: symheight=%d, deltY=%d \n", (char *)&wcode, symheight, -glyph->top + fh);
 		}
 	}
 
+	FTcache_unlock();
+
 	return symheight;
 }
 
@@ -805,8 +1341,9 @@ use following COLOR:
 void FTsymbol_unicode_writeFB(FBDEV *fb_dev, FT_Face face, int fw, int fh, wchar_t wcode, int *xleft,
 				int x0, int y0, int fontcolor, int transpcolor,int opaque )
 {
-  	FT_Error      error;
-  	FT_GlyphSlot slot = face->glyph;
+	const EGI_FTGLYPH *glyph=NULL;
+	const EGI_FTATLAS_GLYPH *aglyph=NULL;
+	EGI_FTATLAS *atlas;
 	EGI_SYMPAGE ftsympg={0};	/* a symbol page to hold the character bitmap */
 	ftsympg.symtype=symtype_FT2;
 
@@ -814,34 +1351,51 @@ void FTsymbol_unicode_writeFB(FBDEV *fb_dev, FT_Face face, int fw, int fh, wchar
 	int bbox_W;	/* boundary box width, taken bbox_H=fh */
 	int delX;	/* adjust bitmap position in boundary box, according to bitmap_top */
 	int delY;
+	int left,top;	/* bitmap_left, bitmap_top */
 
-	/* set character size in pixels */
-	error = FT_Set_Pixel_Sizes(face, fw, fh);
-   	/* OR set character size in 26.6 fractional points, and resolution in dpi
-   	   error = FT_Set_Char_Size( face, 32*32, 0, 100,0 ); */
-	if(error) {
-		printf("%s: FT_Set_Pixel_Sizes() fails!\n",__func__);
-		return;
+	/* Get the rendered character from the glyph atlas of the face/size if any, or from the glyph
+	 * cache. It's valid until the atlas/cache is unlocked.
+	 */
+	atlas=FTatlas_lock(face, fw, fh);
+	if(atlas) {
+		aglyph=FTatlas_getGlyph(atlas, wcode);
+		if(aglyph==NULL) {
+			/* Not packed, such as too big for the atlas, try the glyph cache then */
+			FTatlas_unlock(atlas);
+			atlas=NULL;
+		}
 	}
-
-	/* Do not set transform, keep up_right and pen position(0,0)
-    		FT_Set_Transform( face, &matrix, &pen ); */
-
-	/* Load char and render, old data in face->glyph will be cleared */
-    	error = FT_Load_Char( face, wcode, FT_LOAD_RENDER );
-    	if (error) {
-		printf("%s: FT_Load_Char() fails!\n",__func__);
-		return;
+	if(atlas==NULL) {
+		if(FTcache_lock()!=0)
+			return;
+		glyph=FTcache_getGlyph(face, fw, fh, wcode);
+		if(glyph==NULL) {
+			printf("%s: Fail to get glyph of unicode 0x%x!\n",__func__, wcode);
+			goto END_FUNC;
+		}
 	}
 
 	/* Assign alpha to ftsympg, Ownership IS NOT transfered! */
-	ftsympg.alpha 	  = slot->bitmap.buffer;
-	ftsympg.symheight = slot->bitmap.rows; //fh; /* font height in pixels is bigger than bitmap.rows! */
-	ftsympg.ftwidth   = slot->bitmap.width; /* ftwidth <= (slot->advance.x>>6) */
+	if(aglyph) {
+		ftsympg.alpha 	  = aglyph->shelf<0 ? NULL : atlas->img->alpha+aglyph->y*atlas->img->width+aglyph->x;
+		ftsympg.symheight = aglyph->h;
+		ftsympg.ftwidth   = aglyph->w;
+		ftsympg.ftpitch   = atlas->img->width;
+		advanceX = aglyph->advanceX;
+		left	 = aglyph->left;
+		top	 = aglyph->top;
+	}
+	else {
+		ftsympg.alpha 	  = glyph->alpha;
+		ftsympg.symheight = glyph->rows; //fh; /* font height in pixels is bigger than bitmap.rows! */
+		ftsympg.ftwidth   = glyph->width; /* ftwidth <= advanceX */
+		advanceX = glyph->advanceX;
+		left	 = glyph->left;
+		top	 = glyph->top;
+	}
 
 	/* Check whether xleft is used up first. */
-	advanceX = slot->advance.x>>6;
-	bbox_W = (advanceX > slot->bitmap.width ? advanceX : slot->bitmap.width);
+	bbox_W = (advanceX > ftsympg.ftwidth ? advanceX : ftsympg.ftwidth);
 
 	/* check bitmap data, we need bbox_W here */
 	if(ftsympg.alpha==NULL) {
@@ -861,18 +1415,18 @@ void FTsymbol_unicode_writeFB(FBDEV *fb_dev, FT_Face face, int fw, int fh, wchar
 		else {/* Maybe other unicode, it is supposed to have defined bitmap.width and advanceX */
 			*xleft -= bbox_W;
 		}
-			return;
+		goto END_FUNC;
 	}
 
 	/* reduce xleft */
 	*xleft -= bbox_W;
 	if( *xleft < 0 )
-		return;
+		goto END_FUNC;
 	/* taken bbox_H as fh */
 
 	/* adjust bitmap position relative to boundary box */
-	delX= slot->bitmap_left;
-	delY= -slot->bitmap_top + fh;
+	delX= left;
+	delY= -top + fh;
 
 #if 0 /* ----TEST: Display Boundary BOX------- */
 	/* Note: Assume boundary box start from x0,y0(same as bitmap)
@@ -887,6 +1441,12 @@ void FTsymbol_unicode_writeFB(FBDEV *fb_dev, FT_Face face, int fw, int fh, wchar
 		//printf("%s: symbol_writeFB...\n",__func__);
 		symbol_writeFB(fb_dev, &ftsympg, fontcolor, transpcolor, x0+delX, y0+delY, 0, opaque);
 	}
+
+END_FUNC:
+	if(atlas)
+		FTatlas_unlock(atlas);
+	else
+		FTcache_unlock();
 }
 
 
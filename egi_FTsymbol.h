@@ -51,6 +51,8 @@ extern EGI_SYMPAGE sympg_ascii;  /* default font  LiberationMono-Regular */
 extern EGI_FONTS   egi_sysfonts; /* system font set */
 extern EGI_FONTS   egi_appfonts; /* APP font set */
 
+FT_Error FTsymbol_new_face(FT_Library library, const char *fpath, FT_Long face_index, FT_Face *aface);
+void	FTsymbol_print_fontfiles(void);
 int 	FTsymbol_load_library( EGI_FONTS *symlib );
 FT_Face FTsymbol_create_newFace( EGI_FONTS *symlib, const char *ftpath);
 void 	FTsymbol_release_library( EGI_FONTS *symlib );
@@ -60,6 +62,9 @@ int  	FTsymbol_load_sysfonts(void);
 int  	FTsymbol_load_appfonts(void);
 void	FTsymbol_release_allfonts(void);
 int  	FTsymbol_load_asciis_from_fontfile( EGI_SYMPAGE *symfont_page, const char *font_path, int Wp, int Hp );
+int	FTsymbol_save_asciis_cache(const char *cache_path, const char *font_path, int nsizes, const int *sizes);
+int	FTsymbol_load_asciis_from_cache(EGI_SYMPAGE *symfont_page, const char *cache_path,
+					const char *font_path, int Wp, int Hp);
 int 	FTsymbol_get_symheight(FT_Face face, const unsigned char *pstr, int fw, int fh );
 void 	FTsymbol_unicode_writeFB(FBDEV *fb_dev, FT_Face face, int fw, int fh, wchar_t wcode, int *xleft,
 				int x0, int y0, int fontcolor, int transpcolor,int opaque);
@@ -15,6 +15,8 @@ Midas Zhou
 #include "egi.h"
 #include "egi_btn.h"
 #include "egi_debug.h"
+#include "egi_page.h"
+#include "egi_scene.h"
 #include "egi_symbol.h"
 #include "egi_timer.h"
 
@@ -342,7 +344,7 @@ int egi_btnbox_refresh(EGI_EBOX *ebox)
 	}
 
 
-   if(ebox->movable && ebox->bkimg_valid) /* only if ebox is movable and bkimg valid */
+   if(ebox->movable && ebox->bkimg_valid && !egi_scene_retained(ebox)) /* only if ebox is movable and bkimg valid */
    {
 	/* 2. restore bk image use old bkbox data, before refresh */
 	#if 0 /* DEBUG */
@@ -413,7 +415,7 @@ int egi_btnbox_refresh(EGI_EBOX *ebox)
 	int height=ebox->height;
 	int width=ebox->width;
 
-   if(ebox->movable) /* only if ebox is movale, TODO: or prmcolor < 0 */
+   if(ebox->movable && !egi_scene_retained(ebox)) /* only if ebox is movale, TODO: or prmcolor < 0 */
    {
        /* ---- 4. redefine bkimg box range, in case it changes
 	* check ebox height and font lines in case it changes, then adjust the height
@@ -685,7 +687,7 @@ void egi_btngroup_refresh(EGI_EBOX **ebox_group, int num)
 	}
 
 
-   if(ebox->movable && ebox->bkimg_valid) /* only if ebox is movale and bkimg is valid*/
+   if(ebox->movable && ebox->bkimg_valid && !egi_scene_retained(ebox)) /* only if ebox is movale and bkimg is valid*/
    {
 	/* 2. restore bk image use old bkbox data, before refresh */
 	#if 0 /* DEBUG */
@@ -744,7 +746,7 @@ void egi_btngroup_refresh(EGI_EBOX **ebox_group, int num)
 	x0=ebox->x0;
 	y0=ebox->y0;
 
-   if(ebox->movable) /* only if ebox is movale */
+   if(ebox->movable && !egi_scene_retained(ebox)) /* only if ebox is movale */
    {
        /* ---- 4. redefine bkimg box range, in case it changes */
 	/* check ebox height and font lines in case it changes, then adjust the height */
@@ -952,7 +954,7 @@ int egi_btnbox_hide(EGI_EBOX *ebox)
                 return -1;
         }
 
-        if( ebox->movable && ebox->bkimg !=NULL ) { /* only for movable ebox, it holds bkimg. */
+        if( ebox->movable && ebox->bkimg !=NULL && !egi_scene_retained(ebox) ) { /* only for movable ebox, it holds bkimg. */
                 /* restore bkimg */
                 if(fb_cpyfrom_buf(&gv_fb_dev, ebox->bkbox.startxy.x, ebox->bkbox.startxy.y,
                                ebox->bkbox.endxy.x, ebox->bkbox.endxy.y, ebox->bkimg) <0 )
@@ -965,6 +967,10 @@ int egi_btnbox_hide(EGI_EBOX *ebox)
         /* reset status */
         ebox->status=status_hidden;
 
+        /* In a retained scene, the next frame erases it */
+        if(egi_scene_retained(ebox))
+                egi_page_wakeup(egi_scene_page(ebox));
+
         EGI_PDEBUG(DBG_BTN,"A '%s' ebox is put to hide.\n",ebox->tag);
 
         return 0;
@@ -1161,6 +1167,10 @@ EGI_EBOX *egi_copy_btn_ebox(EGI_EBOX *ebox)
         }
         *newbox=*ebox;
 
+        /* not in any scene, see egi_scene.h */
+        INIT_LIST_HEAD(&newbox->children);
+        newbox->drawn=false;
+
         /* assign egi_data */
         newbox->egi_data=(void *)data_btn;
 
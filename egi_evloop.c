@@ -0,0 +1,405 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+An event loop on epoll, see egi_evloop.h
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include "egi_evloop.h"
+
+enum evsrc_type
+{
+	evsrc_none=0,
+	evsrc_fd,
+	evsrc_timer,		/* timerfd, owned by the loop */
+	evsrc_signal,		/* signalfd, owned by the loop */
+};
+
+typedef struct egi_evsrc {
+	enum evsrc_type	type;
+	int		fd;
+	int		signo;		/* For evsrc_signal */
+	EGI_EVHANDLER	handler;
+	void		*arg;
+} EGI_EVSRC;
+
+struct egi_evloop
+{
+	int		epfd;
+	int		wakefd;		/* eventfd for egi_evloop_wakeup() */
+	EGI_EVSRC	srcs[EGI_EVLOOP_MAXSRCS];
+};
+
+static EGI_EVSRC *evloop_add_src(EGI_EVLOOP *evloop, enum evsrc_type type, int fd, EGI_EVHANDLER handler, void *arg);
+
+
+/*--------------------------------------
+Create an event loop.
+Return:
+	Pointer to EGI_EVLOOP	OK
+	NULL			Fails
+--------------------------------------*/
+EGI_EVLOOP* egi_evloop_new(void)
+{
+	EGI_EVLOOP *evloop;
+	struct epoll_event ev;
+
+	evloop=calloc(1, sizeof(EGI_EVLOOP));
+	if(evloop==NULL) {
+		printf("%s: Fail to calloc evloop.\n", __func__);
+		return NULL;
+	}
+
+	evloop->epfd=epoll_create(EGI_EVLOOP_MAXSRCS);
+	evloop->wakefd=eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+	if(evloop->epfd<0 || evloop->wakefd<0) {
+		printf("%s: Fail to create epoll or eventfd: %s\n", __func__, strerror(errno));
+		goto END_FAIL;
+	}
+	fcntl(evloop->epfd, F_SETFD, FD_CLOEXEC);
+
+	/* data.ptr NULL for the wakeup eventfd */
+	memset(&ev, 0, sizeof(ev));
+	ev.events=EPOLLIN;
+	ev.data.ptr=NULL;
+	if( epoll_ctl(evloop->epfd, EPOLL_CTL_ADD, evloop->wakefd, &ev)<0 ) {
+		printf("%s: Fail to add eventfd to epoll: %s\n", __func__, strerror(errno));
+		goto END_FAIL;
+	}
+
+	return evloop;
+
+END_FAIL:
+	if(evloop->epfd>=0)
+		close(evloop->epfd);
+	if(evloop->wakefd>=0)
+		close(evloop->wakefd);
+	free(evloop);
+	return NULL;
+}
+
+/*------------------------------------------------------
+Free an event loop, and close timerfds and signalfds.
+Fds added by egi_evloop_add_fd() are NOT closed.
+------------------------------------------------------*/
+void egi_evloop_free(EGI_EVLOOP **evloop)
+{
+	int i;
+
+	if(evloop==NULL || *evloop==NULL)
+		return;
+
+	for(i=0; i<EGI_EVLOOP_MAXSRCS; i++) {
+		if( (*evloop)->srcs[i].type!=evsrc_none )
+			egi_evloop_del_fd(*evloop, (*evloop)->srcs[i].fd);
+	}
+	close((*evloop)->epfd);
+	close((*evloop)->wakefd);
+	free(*evloop);
+	*evloop=NULL;
+}
+
+/* Take a free slot and add the fd to epoll */
+static EGI_EVSRC *evloop_add_src(EGI_EVLOOP *evloop, enum evsrc_type type, int fd, EGI_EVHANDLER handler, void *arg)
+{
+	struct epoll_event ev;
+	int i;
+
+	for(i=0; i<EGI_EVLOOP_MAXSRCS; i++) {
+		if(evloop->srcs[i].type==evsrc_none)
+			break;
+	}
+	if(i==EGI_EVLOOP_MAXSRCS) {
+		printf("%s: No more than %d sources in an evloop!\n", __func__, EGI_EVLOOP_MAXSRCS);
+		return NULL;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events=EPOLLIN;
+	ev.data.ptr=&evloop->srcs[i];
+	if( epoll_ctl(evloop->epfd, EPOLL_CTL_ADD, fd, &ev)<0 ) {
+		printf("%s: Fail to add fd %d to epoll: %s\n", __func__, fd, strerror(errno));
+		return NULL;
+	}
+
+	evloop->srcs[i].type=type;
+	evloop->srcs[i].fd=fd;
+	evloop->srcs[i].handler=handler;
+	evloop->srcs[i].arg=arg;
+
+	return &evloop->srcs[i];
+}
+
+/*-----------------------------------------------------
+Add an fd to the loop, the handler is called when it's
+readable. The handler shall read it out, as epoll is
+level triggered.
+
+Return:
+	0	OK
+	<0	Fails
+------------------------------------------------------*/
+int egi_evloop_add_fd(EGI_EVLOOP *evloop, int fd, EGI_EVHANDLER handler, void *arg)
+{
+	if(evloop==NULL || fd<0 || handler==NULL)
+		return -1;
+
+	if( evloop_add_src(evloop, evsrc_fd, fd, handler, arg)==NULL )
+		return -2;
+
+	return 0;
+}
+
+/*-------------------------------------------------------
+Remove an fd, a timer or a signal from the loop. Timerfd
+and signalfd are closed, and the signal is unblocked.
+It's safe to call in a handler.
+
+Return:
+	0	OK
+	<0	Fails, or not found.
+--------------------------------------------------------*/
+int egi_evloop_del_fd(EGI_EVLOOP *evloop, int fd)
+{
+	EGI_EVSRC *src=NULL;
+	sigset_t mask;
+	int i;
+
+	if(evloop==NULL || fd<0)
+		return -1;
+
+	for(i=0; i<EGI_EVLOOP_MAXSRCS; i++) {
+		if( evloop->srcs[i].type!=evsrc_none && evloop->srcs[i].fd==fd ) {
+			src=&evloop->srcs[i];
+			break;
+		}
+	}
+	if(src==NULL)
+		return -2;
+
+	epoll_ctl(evloop->epfd, EPOLL_CTL_DEL, fd, NULL);
+	if(src->type==evsrc_signal) {
+		sigemptyset(&mask);
+		sigaddset(&mask, src->signo);
+		pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+	}
+	if(src->type==evsrc_timer || src->type==evsrc_signal)
+		close(fd);
+
+	memset(src, 0, sizeof(EGI_EVSRC));
+	src->fd=-1;
+
+	return 0;
+}
+
+/*--------------------------------------------------------
+Add a timer to the loop.
+
+@ms:		Time in ms, to expire the first time, and then
+		the interval if periodic.
+		If 0, the timer is disarmed, see egi_evloop_set_timer().
+@periodic:	If true, expire every ms.
+
+Return:
+	>=0	The timerfd, as the ID of the timer.
+	<0	Fails
+---------------------------------------------------------*/
+int egi_evloop_add_timer(EGI_EVLOOP *evloop, int ms, bool periodic, EGI_EVHANDLER handler, void *arg)
+{
+	int tfd;
+
+	if(evloop==NULL || ms<0 || handler==NULL)
+		return -1;
+
+	tfd=timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+	if(tfd<0) {
+		printf("%s: Fail to create timerfd: %s\n", __func__, strerror(errno));
+		return -2;
+	}
+
+	if( evloop_add_src(evloop, evsrc_timer, tfd, handler, arg)==NULL ) {
+		close(tfd);
+		return -3;
+	}
+
+	if( egi_evloop_set_timer(evloop, tfd, ms, periodic)!=0 ) {
+		egi_evloop_del_fd(evloop, tfd);
+		return -4;
+	}
+
+	return tfd;
+}
+
+/*--------------------------------------------------------
+Re-arm or disarm a timer of the loop.
+
+@tfd:		The timer, as egi_evloop_add_timer() returns.
+@ms:		Time in ms to expire, 0 to disarm.
+@periodic:	If true, expire every ms.
+
+Return:
+	0	OK
+	<0	Fails
+---------------------------------------------------------*/
+int egi_evloop_set_timer(EGI_EVLOOP *evloop, int tfd, int ms, bool periodic)
+{
+	struct itimerspec its;
+
+	if(evloop==NULL || tfd<0 || ms<0)
+		return -1;
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec=ms/1000;
+	its.it_value.tv_nsec=ms%1000*1000000;
+	if(periodic)
+		its.it_interval=its.it_value;
+
+	if( timerfd_settime(tfd, 0, &its, NULL)<0 ) {
+		printf("%s: Fail to set timerfd: %s\n", __func__, strerror(errno));
+		return -2;
+	}
+
+	return 0;
+}
+
+/*-------------------------------------------------------------
+Add a signal to the loop, it's blocked in the calling thread
+and read by a signalfd. See 1. in egi_evloop.h.
+
+Return:
+	>=0	The signalfd
+	<0	Fails
+-------------------------------------------------------------*/
+int egi_evloop_add_signal(EGI_EVLOOP *evloop, int signo, EGI_EVHANDLER handler, void *arg)
+{
+	EGI_EVSRC *src;
+	sigset_t mask;
+	int sfd;
+
+	if(evloop==NULL || handler==NULL)
+		return -1;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, signo);
+	if( pthread_sigmask(SIG_BLOCK, &mask, NULL)!=0 ) {
+		printf("%s: Fail to block signal %d.\n", __func__, signo);
+		return -2;
+	}
+
+	sfd=signalfd(-1, &mask, SFD_NONBLOCK|SFD_CLOEXEC);
+	if(sfd<0) {
+		printf("%s: Fail to create signalfd: %s\n", __func__, strerror(errno));
+		pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+		return -3;
+	}
+
+	src=evloop_add_src(evloop, evsrc_signal, sfd, handler, arg);
+	if(src==NULL) {
+		close(sfd);
+		pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+		return -4;
+	}
+	src->signo=signo;
+
+	return sfd;
+}
+
+/*----------------------------------------------
+Wake up egi_evloop_wait(), from any thread.
+Return:
+	0	OK
+	<0	Fails
+----------------------------------------------*/
+int egi_evloop_wakeup(EGI_EVLOOP *evloop)
+{
+	uint64_t one=1;
+
+	if(evloop==NULL)
+		return -1;
+
+	/* EAGAIN: the counter is full, it's awake anyway */
+	if( write(evloop->wakefd, &one, sizeof(one))<0 && errno!=EAGAIN )
+		return -2;
+
+	return 0;
+}
+
+/*-------------------------------------------------------------
+Wait for events, and call handlers of sources which are ready.
+
+@ms:	Timeout in ms, <0 persistent wait.
+
+Return:
+	0	OK, events are handled, or time out.
+	<0	Fails
+	>0	A handler returns it, see 2. in egi_evloop.h.
+		Return values >0 in handlers to tell them from
+		fails.
+--------------------------------------------------------------*/
+int egi_evloop_wait(EGI_EVLOOP *evloop, int ms)
+{
+	struct epoll_event evs[EGI_EVLOOP_MAXSRCS+1];
+	struct signalfd_siginfo sinfo;
+	EGI_EVSRC *src;
+	uint64_t count;
+	int fd;
+	int nev;
+	int i, ret;
+
+	if(evloop==NULL)
+		return -1;
+
+	nev=epoll_wait(evloop->epfd, evs, EGI_EVLOOP_MAXSRCS+1, ms);
+	if(nev<0) {
+		if(errno==EINTR)
+			return 0;
+		printf("%s: epoll_wait fails: %s\n", __func__, strerror(errno));
+		return -2;
+	}
+
+	for(i=0; i<nev; i++) {
+		src=evs[i].data.ptr;
+
+		/* Wakeup */
+		if(src==NULL) {
+			if( read(evloop->wakefd, &count, sizeof(count))<0 && errno!=EAGAIN )
+				printf("%s: Fail to read eventfd: %s\n", __func__, strerror(errno));
+			continue;
+		}
+
+		/* Deleted by a handler before */
+		if(src->type==evsrc_none)
+			continue;
+
+		fd=src->fd;
+		if(src->type==evsrc_timer) {
+			if( read(fd, &count, sizeof(count))<0 )
+				continue;	/* Re-armed before, not expired now */
+		}
+		else if(src->type==evsrc_signal) {
+			if( read(fd, &sinfo, sizeof(sinfo))!=sizeof(sinfo) )
+				continue;
+		}
+
+		ret=src->handler(evloop, fd, src->arg);
+		if(ret!=0)
+			return ret;
+	}
+
+	return 0;
+}
@@ -0,0 +1,64 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+An event loop on epoll, for a page routine or any thread which waits
+for more than one kind of event.
+
+1. Sources of events:
+	fd	Any fd readable, as the touch eventfd, see egi_touch_eventfd().
+	timer	A timerfd, one-shot or periodic, it may be re-armed.
+	signal	A signalfd for a signal. The signal is blocked in the calling
+		thread, so add it before other threads are created, which
+		inherit the signal mask, or it may go to a thread unblocked.
+	wakeup	An eventfd, egi_evloop_wakeup() from any thread makes
+		egi_evloop_wait() return.
+2. egi_evloop_wait() sleeps till events come, then calls their handlers.
+   Expirations of a timer and the siginfo of a signal are read out before
+   its handler is called. If a handler returns non-zero, the rest are
+   skipped and egi_evloop_wait() returns the value, so use values >0.
+3. All functions except egi_evloop_wakeup() are called in the thread of
+   egi_evloop_wait().
+
+Example:
+	static int tick(EGI_EVLOOP *evloop, int fd, void *arg)
+	{
+		printf("tick\n");
+		return 0;
+	}
+
+	evloop=egi_evloop_new();
+	egi_evloop_add_timer(evloop, 1000, true, tick, NULL);
+	while( egi_evloop_wait(evloop, -1)==0 ) {
+		... check what egi_evloop_wakeup() callers ask ...
+	}
+	egi_evloop_free(&evloop);
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#ifndef __EGI_EVLOOP_H__
+#define __EGI_EVLOOP_H__
+
+#include <stdbool.h>
+
+#define EGI_EVLOOP_MAXSRCS	16		/* Max. sources of events in a loop */
+
+typedef struct egi_evloop	EGI_EVLOOP;
+
+/* Handler of an event source, fd is the source as it's added, or the
+ * timerfd/signalfd. Return non-zero to end egi_evloop_wait().
+ */
+typedef int (*EGI_EVHANDLER)(EGI_EVLOOP *evloop, int fd, void *arg);
+
+EGI_EVLOOP*	egi_evloop_new(void);
+void		egi_evloop_free(EGI_EVLOOP **evloop);
+int		egi_evloop_add_fd(EGI_EVLOOP *evloop, int fd, EGI_EVHANDLER handler, void *arg);
+int		egi_evloop_del_fd(EGI_EVLOOP *evloop, int fd);
+int		egi_evloop_add_timer(EGI_EVLOOP *evloop, int ms, bool periodic, EGI_EVHANDLER handler, void *arg);
+int		egi_evloop_set_timer(EGI_EVLOOP *evloop, int tfd, int ms, bool periodic);
+int		egi_evloop_add_signal(EGI_EVLOOP *evloop, int signo, EGI_EVHANDLER handler, void *arg);
+int		egi_evloop_wakeup(EGI_EVLOOP *evloop);
+int		egi_evloop_wait(EGI_EVLOOP *evloop, int ms);
+
+#endif
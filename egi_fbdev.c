@@ -11,6 +11,7 @@ Midas Zhou
 #include "egi_fbgeom.h"
 #include "egi_filo.h"
 #include "egi_debug.h"
+#include "egi_latency.h"
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
@@ -496,6 +497,9 @@ int fb_page_refresh(FBDEV *dev, unsigned int numpg)
 		}
 	}
 
+	/* A frame reaches FB, see egi_latency.h */
+	egi_lat_frame();
+
 	return 0;
 }
 
@@ -726,8 +730,10 @@ int fb_render(FBDEV *dev)
                 return -1;
 
 	/* If directFB mode */
-	if( dev->map_bk==dev->map_fb )
+	if( dev->map_bk==dev->map_fb ) {
+		egi_lat_frame();
 		return 0;
+	}
 
 	fb_page_refresh(dev, 0);  /* Input data check inside */
 
@@ -22,6 +22,7 @@ midaszhou@yahoo.com
 #include "egi_debug.h"
 #include "egi_math.h"
 #include "egi_color.h"
+#include "egi_image.h"
 #include <unistd.h>
 #include <string.h> /*memset*/
 #include <errno.h>
@@ -403,6 +404,56 @@ EGI_16BIT_COLOR fbget_pixColor(FBDEV *fb_dev, int x, int y)
 }
 
 
+/*------------------------------------------------------------------
+Get a pointer to pixel (x,y) in the FB working buffer, for writing a
+row span of 16bit pixels directly, instead of calling draw_dot() for
+each pixel.
+
+Note:
+1. Only applicable when the FB can be written as rows of pixels:
+   real 16bpp FBDEV, FB.pos_rotate==0 and FB FILO is off. For other
+   cases NULL is returned, and the caller shall fall back to draw_dot().
+2. Pixels from (x,y) to (xres-1,y) are in the same span, the caller
+   shall clip its span within the screen.
+
+Return:
+	Pointer to the pixel	OK
+	NULL			Not applicable, or (x,y) out of screen.
+-------------------------------------------------------------------*/
+EGI_16BIT_COLOR* fb_get_spanptr(FBDEV *fb_dev, int x, int y)
+{
+#ifdef LETS_NOTE
+	return NULL;
+#else
+	unsigned char *map;
+	long int location;
+
+	if(fb_dev==NULL || fb_dev->virt_fb!=NULL || fb_dev->pos_rotate!=0 || fb_dev->filo_on )
+		return NULL;
+	if(fb_dev->vinfo.bits_per_pixel != 16)
+		return NULL;
+
+	if( x<0 || x>fb_dev->vinfo.xres-1 || y<0 || y>fb_dev->vinfo.yres-1 )
+		return NULL;
+
+	/* <<<<<<  FB BUFFER SELECT, same as draw_dot()  >>>>>> */
+	#if defined(ENABLE_BACK_BUFFER)
+	map=fb_dev->map_bk;
+	#else
+	map=fb_dev->map_fb;
+	#endif
+	if(map==NULL)
+		return NULL;
+
+        location=(x+fb_dev->vinfo.xoffset)*2+(y+fb_dev->vinfo.yoffset)*fb_dev->finfo.line_length;
+	if( location<0 || location > fb_dev->screensize-sizeof(uint16_t) )
+		return NULL;
+
+	return (EGI_16BIT_COLOR *)(map+location);
+#endif
+}
+
+
 /*------------------------------------------------------------------
 Assign color value to a pixel in framebuffer.
 Note:
@@ -550,6 +601,10 @@ int draw_dot(FBDEV *fb_dev,int x,int y)
 	        sumalpha=virt_fb->alpha[location]+fb_dev->pixalpha;
         	if( sumalpha > 255 ) sumalpha=255;
 	        virt_fb->alpha[location]=sumalpha;
+
+		/* alpha data changed, RLE alpha is out of date */
+		if(virt_fb->alpha_rle)
+			egi_imgbuf_freeAlphaRLE(virt_fb);
 	}
 
 	/* reset alpha to 255 as default, at last!!! */
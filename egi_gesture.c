@@ -0,0 +1,270 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Gesture recognition from timestamped touch data, see egi_gesture.h
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "egi_gesture.h"
+
+static const char *str_gesture[]=
+{
+	"gesture_none", "gesture_tap", "gesture_dbtap", "gesture_longpress",
+	"gesture_drag_start", "gesture_drag", "gesture_drag_end", "gesture_swipe",
+};
+
+static void gesture_begin(EGI_GESTURE_TRACKER *gt, int x, int y, long long us);
+static void gesture_push(EGI_GESTURE_TRACKER *gt, int x, int y, long long us);
+
+
+/*-----------------------------------------------
+Reset a gesture tracker, before feeding it with
+the first touch data.
+-----------------------------------------------*/
+void egi_gesture_reset(EGI_GESTURE_TRACKER *gt)
+{
+	if(gt==NULL)
+		return;
+
+	memset(gt, 0, sizeof(EGI_GESTURE_TRACKER));
+}
+
+
+/* A touch starts */
+static void gesture_begin(EGI_GESTURE_TRACKER *gt, int x, int y, long long us)
+{
+	gt->down=true;
+	gt->dragging=false;
+	gt->longpressed=false;
+	gt->start.x=x;
+	gt->start.y=y;
+	gt->start_us=us;
+	gt->nsamples=0;
+	gesture_push(gt, x, y, us);
+}
+
+
+/* Push a sample into the ring */
+static void gesture_push(EGI_GESTURE_TRACKER *gt, int x, int y, long long us)
+{
+	gt->head=(gt->head+1)%EGI_GESTURE_SAMPLES;
+	gt->samples[gt->head].x=x;
+	gt->samples[gt->head].y=y;
+	gt->samples[gt->head].us=us;
+	if(gt->nsamples < EGI_GESTURE_SAMPLES)
+		gt->nsamples++;
+}
+
+
+/*----------------------------------------------------------------------
+Estimate velocity of the touch, by least-squares fitting of positions of
+samples within GESTURE_VWINDOW_MS before the latest one.
+
+@gt:		Pointer to an EGI_GESTURE_TRACKER
+@vx,vy:		To pass out the velocity, in pixels/s.
+
+Return:
+	>=2	OK, number of samples fitted.
+	<2	Not enough samples, velocity is 0.
+-----------------------------------------------------------------------*/
+int egi_gesture_velocity(const EGI_GESTURE_TRACKER *gt, float *vx, float *vy)
+{
+	const EGI_GESTURE_SAMPLE *s, *last;
+	double t, st=0, stt=0, sx=0, sy=0, stx=0, sty=0;
+	double den;
+	int i,n;
+
+	if(vx)
+		*vx=0;
+	if(vy)
+		*vy=0;
+	if(gt==NULL || gt->nsamples<1)
+		return 0;
+
+	/* t in seconds, relative to the latest sample */
+	last=&gt->samples[gt->head];
+	for(n=0, i=0; i<gt->nsamples; i++, n++) {
+		s=&gt->samples[(gt->head-i+EGI_GESTURE_SAMPLES)%EGI_GESTURE_SAMPLES];
+		if( last->us - s->us > GESTURE_VWINDOW_MS*1000LL )
+			break;
+		t=(s->us - last->us)/1000000.0;
+		st += t;
+		stt += t*t;
+		sx += s->x;
+		sy += s->y;
+		stx += t*s->x;
+		sty += t*s->y;
+	}
+	if(n<2)
+		return n;
+
+	den=n*stt-st*st;
+	if(den < 1.0e-12)	/* All in the same time */
+		return n;
+
+	if(vx)
+		*vx=(n*stx-st*sx)/den;
+	if(vy)
+		*vy=(n*sty-st*sy)/den;
+
+	return n;
+}
+
+
+/*------------------------------------------------------------------------
+Feed a touch data to a gesture tracker, and get gestures recognized.
+Touch data with status other than pressing, db_pressing, pressed_hold and
+releasing are ignored. If touch_data->ts is not set, the current time is
+applied.
+
+@gt:		Pointer to an EGI_GESTURE_TRACKER
+@touch_data:	Touch data read by egi_touch_getdata()
+@gestures:	To pass out gestures recognized, in time order.
+@max:		Max. number of gestures to pass out, EGI_GESTURE_MAXOUT
+		is enough.
+
+Return:
+	>=0	Number of gestures recognized.
+	<0	Fails
+-------------------------------------------------------------------------*/
+int egi_gesture_feed(EGI_GESTURE_TRACKER *gt, const EGI_TOUCH_DATA *touch_data,
+						EGI_GESTURE *gestures, int max)
+{
+	enum egi_gesture_type types[EGI_GESTURE_MAXOUT];
+	const EGI_GESTURE_SAMPLE *last;
+	struct timespec ts;
+	long long us;
+	float vx=0, vy=0;
+	int x,y,dx,dy;
+	int i,n=0;
+
+	if(gt==NULL || touch_data==NULL || gestures==NULL || max<0) {
+		printf("%s: Input param invalid!\n",__func__);
+		return -1;
+	}
+
+	ts=touch_data->ts;
+	if(ts.tv_sec==0 && ts.tv_nsec==0)
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+	us=ts.tv_sec*1000000LL+ts.tv_nsec/1000;
+	x=touch_data->coord.x;
+	y=touch_data->coord.y;
+
+	switch(touch_data->status)
+	{
+	case pressing:
+	case db_pressing:
+		gesture_begin(gt, x, y, us);
+		return 0;
+
+	case pressed_hold:
+		/* The 'pressing' is missed */
+		if(!gt->down) {
+			gesture_begin(gt, x, y, us);
+			return 0;
+		}
+		last=&gt->samples[gt->head];
+		if( gt->dragging && last->x==x && last->y==y ) {
+			/* Held still, only let the velocity fall */
+			gesture_push(gt, x, y, us);
+			return 0;
+		}
+		gesture_push(gt, x, y, us);
+
+		dx=x-gt->start.x;
+		dy=y-gt->start.y;
+		if(gt->dragging) {
+			types[n++]=gesture_drag;
+		}
+		else if( dx>GESTURE_SLOP || dx<-GESTURE_SLOP || dy>GESTURE_SLOP || dy<-GESTURE_SLOP ) {
+			gt->dragging=true;
+			types[n++]=gesture_drag_start;
+		}
+		else if( !gt->longpressed && us-gt->start_us >= GESTURE_LONGPRESS_MS*1000LL ) {
+			gt->longpressed=true;
+			gt->lasttap_us=0;
+			types[n++]=gesture_longpress;
+		}
+		break;
+
+	case releasing:
+		if(!gt->down)
+			return 0;
+		gt->down=false;
+		last=&gt->samples[gt->head];
+		if( last->x!=x || last->y!=y )
+			gesture_push(gt, x, y, us);
+
+		if(gt->dragging) {
+			gt->dragging=false;
+			gt->lasttap_us=0;
+			types[n++]=gesture_drag_end;
+			egi_gesture_velocity(gt, &vx, &vy);
+			if( vx>=GESTURE_SWIPE_VMIN || vx<=-GESTURE_SWIPE_VMIN
+			    || vy>=GESTURE_SWIPE_VMIN || vy<=-GESTURE_SWIPE_VMIN )
+				types[n++]=gesture_swipe;
+		}
+		else if(!gt->longpressed) {
+			dx=gt->start.x-gt->lasttap.x;
+			dy=gt->start.y-gt->lasttap.y;
+			if( gt->lasttap_us>0 && gt->start_us-gt->lasttap_us <= GESTURE_DBTAP_MS*1000LL
+			    && dx<=2*GESTURE_SLOP && dx>=-2*GESTURE_SLOP && dy<=2*GESTURE_SLOP && dy>=-2*GESTURE_SLOP ) {
+				gt->lasttap_us=0;
+				types[n++]=gesture_dbtap;
+			}
+			else {
+				gt->lasttap=gt->start;
+				gt->lasttap_us=us;
+				types[n++]=gesture_tap;
+			}
+		}
+		break;
+
+	default:
+		return 0;
+	}
+
+	/* Pass out gestures */
+	if( n>0 && types[0]!=gesture_longpress && types[0]!=gesture_tap && types[0]!=gesture_dbtap )
+		egi_gesture_velocity(gt, &vx, &vy);
+	if(n>max)
+		n=max;
+	for(i=0; i<n; i++) {
+		gestures[i].type=types[i];
+		gestures[i].dir=gesture_dir_none;
+		gestures[i].start=gt->start;
+		gestures[i].coord.x=x;
+		gestures[i].coord.y=y;
+		gestures[i].dx=x-gt->start.x;
+		gestures[i].dy=y-gt->start.y;
+		gestures[i].vx=vx;
+		gestures[i].vy=vy;
+		gestures[i].ts=ts;
+
+		if(types[i]==gesture_swipe) {
+			if( vx*vx >= vy*vy )
+				gestures[i].dir= vx<0 ? gesture_dir_left : gesture_dir_right;
+			else
+				gestures[i].dir= vy<0 ? gesture_dir_up : gesture_dir_down;
+		}
+	}
+
+	return n;
+}
+
+
+/*-----------------------------------
+Return name of a gesture type.
+-----------------------------------*/
+const char* egi_str_gesture(enum egi_gesture_type type)
+{
+	if( type<gesture_none || type>gesture_swipe )
+		return "gesture_unknown";
+
+	return str_gesture[type];
+}
@@ -0,0 +1,128 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Gesture recognition from timestamped touch data.
+
+1. Feed every EGI_TOUCH_DATA read by egi_touch_getdata() to
+   egi_gesture_feed(), and it passes out gestures recognized:
+
+   gesture_tap		Pressed and released within GESTURE_SLOP,
+			and earlier than GESTURE_LONGPRESS_MS.
+   gesture_dbtap	A tap soon after a tap at the same place, it
+			comes after the gesture_tap of the first tap.
+   gesture_longpress	Held still for GESTURE_LONGPRESS_MS, no tap
+			follows it.
+   gesture_drag_start	Moved out of GESTURE_SLOP.
+   gesture_drag		Moved while dragging.
+   gesture_drag_end	Released after dragging.
+   gesture_swipe	Released after dragging fast, with direction.
+			It comes after gesture_drag_end.
+
+2. Velocity is estimated by least-squares fitting of positions of the
+   last EGI_GESTURE_SAMPLES samples within GESTURE_VWINDOW_MS, so one
+   jittering sample doesn't make a flick, and a pause before releasing
+   makes no flick. Kinetic scrolling may start with vx/vy of
+   gesture_drag_end.
+
+3. Set EGI_PAGE.gesture_handler, then egi_page_routine() feeds touch
+   data and calls the handler with every gesture.
+
+Example:
+	EGI_GESTURE_TRACKER gt;
+	EGI_GESTURE gs[EGI_GESTURE_MAXOUT];
+
+	egi_gesture_reset(&gt);
+	while(1) {
+		if(!egi_touch_getdata(&touch_data))
+			continue;
+		n=egi_gesture_feed(&gt, &touch_data, gs, EGI_GESTURE_MAXOUT);
+		for(i=0; i<n; i++)
+			printf("%s vx=%.0f\n", egi_str_gesture(gs[i].type), gs[i].vx);
+	}
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#ifndef __EGI_GESTURE_H__
+#define __EGI_GESTURE_H__
+
+#include <stdbool.h>
+#include <time.h>
+#include "egi.h"
+#include "egi_timer.h"
+
+#define EGI_GESTURE_SAMPLES	8	/* Max. samples for velocity fitting */
+#define EGI_GESTURE_MAXOUT	4	/* Max. gestures out of one touch data */
+
+#define GESTURE_SLOP		10	/* in pixels, moves within it are still */
+#define GESTURE_LONGPRESS_MS	600
+#define GESTURE_DBTAP_MS	(TM_DBCLICK_INTERVAL/1000)
+#define GESTURE_VWINDOW_MS	100	/* Samples older than it are not fitted */
+#define GESTURE_SWIPE_VMIN	300	/* in pixels/s, min. velocity of a swipe */
+
+enum egi_gesture_type
+{
+	gesture_none=0,
+	gesture_tap,
+	gesture_dbtap,
+	gesture_longpress,
+	gesture_drag_start,
+	gesture_drag,
+	gesture_drag_end,
+	gesture_swipe,
+};
+
+enum egi_gesture_dir
+{
+	gesture_dir_none=0,
+	gesture_dir_left,
+	gesture_dir_right,
+	gesture_dir_up,
+	gesture_dir_down,
+};
+
+typedef struct egi_gesture	EGI_GESTURE;
+struct egi_gesture
+{
+	enum egi_gesture_type	type;
+	enum egi_gesture_dir	dir;		/* For gesture_swipe */
+	EGI_POINT		start;		/* Where the touch starts */
+	EGI_POINT		coord;		/* Where it is now */
+	int			dx;		/* coord-start */
+	int			dy;
+	float			vx;		/* Velocity in pixels/s */
+	float			vy;
+	struct timespec		ts;		/* Of the touch data */
+};
+
+typedef struct egi_gesture_sample {
+	int		x;
+	int		y;
+	long long	us;		/* CLOCK_MONOTONIC time in us */
+} EGI_GESTURE_SAMPLE;
+
+typedef struct egi_gesture_tracker EGI_GESTURE_TRACKER;
+struct egi_gesture_tracker
+{
+	EGI_GESTURE_SAMPLE	samples[EGI_GESTURE_SAMPLES];	/* A ring */
+	int			head;		/* Index of the latest sample */
+	int			nsamples;
+
+	bool			down;
+	bool			dragging;
+	bool			longpressed;
+	EGI_POINT		start;
+	long long		start_us;
+
+	EGI_POINT		lasttap;
+	long long		lasttap_us;	/* 0 if no tap to pair with */
+};
+
+void		egi_gesture_reset(EGI_GESTURE_TRACKER *gt);
+int		egi_gesture_feed(EGI_GESTURE_TRACKER *gt, const EGI_TOUCH_DATA *touch_data,
+							EGI_GESTURE *gestures, int max);
+int		egi_gesture_velocity(const EGI_GESTURE_TRACKER *gt, float *vx, float *vy);
+const char*	egi_str_gesture(enum egi_gesture_type type);
+
+#endif
@@ -38,6 +38,20 @@ inline static void egi_gif_rasterWriteFB( FBDEV *fbdev, EGI_GIF *egif,
 				   bool ImgTransp_ON );
 
 static void *egi_gif_threadDisplay(void *argv);
+static int egi_gif_streamReadFunc(GifFileType *GifFile, GifByteType *buf, int len);
+static int egi_gif_streamRewind(EGI_GIF_STREAM *stream);
+static int egi_gif_streamRead(EGI_GIF_STREAM *stream, bool decode);
+static SavedImage* egi_gif_streamFrame(EGI_GIF_STREAM *stream, int index);
+static void egi_gif_streamClose(EGI_GIF_STREAM **stream);
+static void egi_gif_freeCFrame(EGI_GIF_COMPILED *cgif, EGI_GIF_CFRAME *cframe);
+static int egi_gif_diffPatches(EGI_GIF_COMPILED *cgif, EGI_GIF_CFRAME *cframe, int width, int height,
+				const EGI_16BIT_COLOR *color, const EGI_8BIT_ALPHA *alpha,
+				const EGI_16BIT_COLOR *pcolor, const EGI_8BIT_ALPHA *palpha);
+static void egi_gif_recordFrame(EGI_GIF *egif, int DelayMs);
+static void egi_gif_replayFrame(EGI_GIF_CONTEXT *gif_ctxt);
+static int egi_gif_playCtxt(EGI_GIF_CONTEXT *gif_ctxt, int nloop, bool Delay_ON);
+static void egi_gif_mapRect(const EGI_GIF *egif, int *x0, int *y0, int *w, int *h);
+static void egi_gif_resizeRect(EGI_GIF *egif, int x0, int y0, int w, int h);
 
 
 /*****************************************************************************
@@ -1049,6 +1063,383 @@ EGI_GIF*  egi_gif_slurpFile(const char *fpath, bool ImgTransp_ON)
 }
 
 
+/*----------------------------------------------------------------------
+GIFLIB input function for a GIF in memory.
+----------------------------------------------------------------------*/
+static int egi_gif_streamReadFunc(GifFileType *GifFile, GifByteType *buf, int len)
+{
+    EGI_GIF_STREAM *stream=(EGI_GIF_STREAM *)GifFile->UserData;
+
+    if( len > stream->fsize-stream->fpos )
+	len=stream->fsize-stream->fpos;
+
+    memcpy(buf, stream->fdata+stream->fpos, len);
+    stream->fpos += len;
+
+    return len;
+}
+
+
+/*----------------------------------------------------------------------
+(Re)open the GIF handle of a stream, so next frame to read is the first
+one.
+
+Return:
+	0	OK
+	<0	Fails
+----------------------------------------------------------------------*/
+static int egi_gif_streamRewind(EGI_GIF_STREAM *stream)
+{
+    int Error;
+
+    if(stream->GifFile) {
+	if (DGifCloseFile(stream->GifFile, &Error) == GIF_ERROR)
+		PrintGifError(Error);
+	stream->GifFile=NULL;
+	stream->rewinds++;
+    }
+
+    if(stream->fdata) {
+	stream->fpos=0;
+	stream->GifFile=DGifOpen(stream, egi_gif_streamReadFunc, &Error);
+    }
+    else
+	stream->GifFile=DGifOpenFileName(stream->fpath, &Error);
+
+    if(stream->GifFile==NULL) {
+	PrintGifError(Error);
+	return -1;
+    }
+
+    stream->index=-1;
+    stream->next=0;
+
+    return 0;
+}
+
+
+/*----------------------------------------------------------------------
+Read next frame of a stream. If decode is true, its raster data is
+decompressed into stream->frame, otherwise the LZW data is just skipped.
+
+Return:
+	0	OK
+	1	End of GIF
+	<0	Fails
+----------------------------------------------------------------------*/
+static int egi_gif_streamRead(EGI_GIF_STREAM *stream, bool decode)
+{
+    GifFileType *GifFile=stream->GifFile;
+    GifRecordType RecordType;
+    GifByteType *ExtData;
+    GifByteType *CodeBlock;
+    SavedImage *frame=&stream->frame;
+    int ExtCode, CodeSize;
+    int InterlacedOffset[] = { 0, 4, 2, 1 };
+    int InterlacedJumps[] = { 8, 8, 4, 2 };
+    int i, j;
+
+    /* Extension blocks before the image */
+    frame->ExtensionBlockCount=0;
+    frame->ExtensionBlocks=NULL;
+
+    while(1) {
+	if (DGifGetRecordType(GifFile, &RecordType) == GIF_ERROR) {
+	    PrintGifError(GifFile->Error);
+	    return -1;
+	}
+
+	switch (RecordType) {
+	    case EXTENSION_RECORD_TYPE:
+		if (DGifGetExtension(GifFile, &ExtCode, &ExtData) == GIF_ERROR) {
+		    PrintGifError(GifFile->Error);
+		    return -2;
+		}
+		/* Keep graphics control block only, ExtData[0] is the block size */
+		if( ExtCode==GRAPHICS_EXT_FUNC_CODE && ExtData!=NULL && ExtData[0]==4 ) {
+		    memcpy(stream->gcb_bytes, ExtData+1, 4);
+		    stream->gcb_block.Function=GRAPHICS_EXT_FUNC_CODE;
+		    stream->gcb_block.ByteCount=4;
+		    stream->gcb_block.Bytes=stream->gcb_bytes;
+		    frame->ExtensionBlocks=&stream->gcb_block;
+		    frame->ExtensionBlockCount=1;
+		}
+		while(ExtData != NULL) {
+		    if (DGifGetExtensionNext(GifFile, &ExtData) == GIF_ERROR) {
+			PrintGifError(GifFile->Error);
+			return -3;
+		    }
+		}
+		break;
+
+	    case IMAGE_DESC_RECORD_TYPE:
+		if (DGifGetImageDesc(GifFile) == GIF_ERROR) {
+		    PrintGifError(GifFile->Error);
+		    return -4;
+		}
+		/* DGifGetImageDesc() appends a SavedImage for each image, drop them to keep memory bounded */
+		GifFreeSavedImages(GifFile);
+		GifFile->ImageCount=0;
+
+		if ( GifFile->Image.Left + GifFile->Image.Width > GifFile->SWidth ||
+		     GifFile->Image.Top + GifFile->Image.Height > GifFile->SHeight ) {
+		    EGI_PLOG(LOGLV_ERROR,"%s: Image %d is not confined to screen dimension!",
+									__func__, stream->next);
+		    return -5;
+		}
+		if( GifFile->Image.ColorMap==NULL && GifFile->SColorMap==NULL ) {
+		    EGI_PLOG(LOGLV_ERROR,"%s: Image %d has no color map!", __func__, stream->next);
+		    return -5;
+		}
+
+		if(!decode) {
+		    /* Skip LZW data without decompressing */
+		    if (DGifGetCode(GifFile, &CodeSize, &CodeBlock) == GIF_ERROR) {
+			PrintGifError(GifFile->Error);
+			return -6;
+		    }
+		    while(CodeBlock != NULL) {
+			if (DGifGetCodeNext(GifFile, &CodeBlock) == GIF_ERROR) {
+			    PrintGifError(GifFile->Error);
+			    return -6;
+			}
+		    }
+		}
+		else {
+		    frame->ImageDesc=GifFile->Image;	/* ColorMap is a reference */
+		    if (GifFile->Image.Interlace) {
+			for (i = 0; i < 4; i++) {
+			    for (j = InterlacedOffset[i]; j < GifFile->Image.Height; j += InterlacedJumps[i]) {
+				if ( DGifGetLine(GifFile, frame->RasterBits+j*GifFile->Image.Width,
+								GifFile->Image.Width) == GIF_ERROR ) {
+				    PrintGifError(GifFile->Error);
+				    return -7;
+				}
+			    }
+			}
+			/* De-interlaced already */
+			frame->ImageDesc.Interlace=false;
+		    }
+		    else {
+			if ( DGifGetLine(GifFile, frame->RasterBits,
+				   GifFile->Image.Width*GifFile->Image.Height) == GIF_ERROR ) {
+			    PrintGifError(GifFile->Error);
+			    return -7;
+			}
+		    }
+		    stream->index=stream->next;
+		}
+		stream->next++;
+		return 0;
+
+	    case TERMINATE_RECORD_TYPE:
+		return 1;
+
+	    default:
+		break;
+	}
+    }
+}
+
+
+/*----------------------------------------------------------------------
+Get a frame of a streaming GIF. If it's not the look-ahead frame, the
+stream is read forward to it, and it's rewound first if index is
+behind the read position.
+
+@stream:	An EGI_GIF_STREAM.
+@index:		Index of the frame.
+
+Return:
+	Pointer to the frame, valid until next call	OK
+	NULL						Fails
+----------------------------------------------------------------------*/
+static SavedImage* egi_gif_streamFrame(EGI_GIF_STREAM *stream, int index)
+{
+    if(stream==NULL || index<0)
+	return NULL;
+
+    if(stream->index==index)
+	return &stream->frame;
+
+    if(index < stream->next) {
+	if(egi_gif_streamRewind(stream)!=0)
+		return NULL;
+    }
+
+    while(stream->next <= index) {
+	if( egi_gif_streamRead(stream, stream->next==index) != 0 ) {
+	    EGI_PLOG(LOGLV_ERROR,"%s: Fail to read frame %d of '%s'.", __func__, index, stream->fpath);
+	    stream->index=-1;
+	    return NULL;
+	}
+    }
+
+    return &stream->frame;
+}
+
+
+/*----------------------------------------------------------------------
+Close a stream and free it.
+----------------------------------------------------------------------*/
+static void egi_gif_streamClose(EGI_GIF_STREAM **stream)
+{
+    int Error;
+
+    if(stream==NULL || *stream==NULL)
+	return;
+
+    if( (*stream)->GifFile && DGifCloseFile((*stream)->GifFile, &Error) == GIF_ERROR )
+	PrintGifError(Error);
+
+    free((*stream)->frame.RasterBits);
+    free((*stream)->fdata);
+    free((*stream)->fpath);
+
+    free(*stream);
+    *stream=NULL;
+}
+
+
+/*------------------------------------------------------------------------------
+Open a GIF file as a streaming EGI_GIF. Unlike egi_gif_slurpFile(), frames are
+NOT decompressed into SavedImages, instead egi_gif_displayGifCtxt() decodes one
+frame at a time into a raster buffer of canvas size, and decodes next frame
+ahead during the frame delay. At the end of the GIF, the stream is rewound to
+loop.
+
+Memory use is about SWidth*SHeight*(1+3) bytes for the raster buffer and Simgbuf,
+plus the file size if InMemory.
+
+@fpath: 	 File path
+@ImgTransp_ON:	 See egi_gif_slurpFile().
+@InMemory:	 If true, the compressed GIF file is read into memory, and it's
+		 replayed from there. Otherwise the file is reopened to rewind.
+
+Return:
+	A pointer to EGI_GIF	OK
+	NULL			Fail
+--------------------------------------------------------------------------------*/
+EGI_GIF*  egi_gif_openStream(const char *fpath, bool ImgTransp_ON, bool InMemory)
+{
+    EGI_GIF* egif=NULL;
+    EGI_GIF_STREAM *stream=NULL;
+    GifFileType *GifFile;
+    GifColorType *ColorMapEntry;
+    FILE *fil;
+    long fsize;
+    int ret;
+
+    if(fpath==NULL)
+	return NULL;
+
+    egif=calloc(1, sizeof(EGI_GIF));
+    stream=calloc(1, sizeof(EGI_GIF_STREAM));
+    if(egif==NULL || stream==NULL) {
+	printf("%s: Fail to calloc EGI_GIF or EGI_GIF_STREAM.\n", __func__);
+	goto END_FAIL;
+    }
+    egif->stream=stream;
+
+    stream->fpath=strdup(fpath);
+    if(stream->fpath==NULL)
+	goto END_FAIL;
+
+    /* Read compressed data into memory */
+    if(InMemory) {
+	fil=fopen(fpath, "rbe");
+	if(fil==NULL) {
+	    printf("%s: Fail to open '%s', %s.\n", __func__, fpath, strerror(errno));
+	    goto END_FAIL;
+	}
+	fseek(fil, 0, SEEK_END);
+	fsize=ftell(fil);
+	fseek(fil, 0, SEEK_SET);
+	if(fsize>0)
+	    stream->fdata=malloc(fsize);
+	if( stream->fdata==NULL || fread(stream->fdata, 1, fsize, fil) != fsize ) {
+	    printf("%s: Fail to read '%s' into memory.\n", __func__, fpath);
+	    fclose(fil);
+	    goto END_FAIL;
+	}
+	stream->fsize=fsize;
+	fclose(fil);
+    }
+
+    if( egi_gif_streamRewind(stream)!=0 )
+	goto END_FAIL;
+    GifFile=stream->GifFile;
+    if(GifFile->SHeight == 0 || GifFile->SWidth == 0) {
+	printf("%s: Image width or height is 0.\n",__func__);
+	goto END_FAIL;
+    }
+
+    /* Count frames by skipping LZW data */
+    while( (ret=egi_gif_streamRead(stream, false))==0 );
+    if(ret<0 || stream->next<1) {
+	printf("%s: Fail to parse '%s'.\n", __func__, fpath);
+	goto END_FAIL;
+    }
+    egif->ImageTotal=stream->next;
+    if( egi_gif_streamRewind(stream)!=0 )
+	goto END_FAIL;
+    stream->rewinds=0;
+    GifFile=stream->GifFile;
+
+    /* Raster buffer for the biggest frame */
+    stream->frame.RasterBits=malloc(GifFile->SWidth*GifFile->SHeight);
+    if(stream->frame.RasterBits==NULL) {
+	printf("%s: Fail to malloc RasterBits.\n", __func__);
+	goto END_FAIL;
+    }
+
+    /* Assign EGI_GIF members */
+    egif->VerGIF89 = ( strcmp(DGifGetGifVersion(GifFile), GIF89_STAMP)==0 );
+    egif->ImgTransp_ON=ImgTransp_ON;
+    egif->SWidth =       GifFile->SWidth;
+    egif->SHeight =      GifFile->SHeight;
+    egif->SColorResolution =     GifFile->SColorResolution;
+    egif->SBackGroundColor =     GifFile->SBackGroundColor;
+    egif->AspectByte =   GifFile->AspectByte;
+    egif->ImageCount =   0;
+    egif->SavedImages=   NULL;
+    egif->Is_DataOwner=  true;		/* SColorMap to be freed by egi_gif_free() */
+
+    /* A copy of the global colormap, since GifFile is reopened to rewind */
+    if(GifFile->SColorMap) {
+	egif->SColorMap=GifMakeMapObject(GifFile->SColorMap->ColorCount, GifFile->SColorMap->Colors);
+	if(egif->SColorMap==NULL)
+		goto END_FAIL;
+	if( egif->SBackGroundColor<0 || egif->SBackGroundColor >= egif->SColorMap->ColorCount )
+		egif->SBackGroundColor=0;
+	ColorMapEntry = &(egif->SColorMap->Colors[egif->SBackGroundColor]);
+	egif->bkcolor=COLOR_RGB_TO16BITS( ColorMapEntry->Red,
+                                    	  ColorMapEntry->Green,
+                                    	  ColorMapEntry->Blue );
+    }
+
+    /* create imgbuf, with bkg alpha == 0!!!*/
+    egif->Simgbuf=egi_imgbuf_create(egif->SHeight, egif->SWidth,
+					egif->ImgTransp_ON==true ? 0:255, egif->bkcolor);
+    if(egif->Simgbuf==NULL) {
+	printf("%s: Fail to create Simgbuf!\n", __func__);
+	goto END_FAIL;
+    }
+
+    EGI_PLOG(LOGLV_INFO,"%s: '%s' %dx%d, %d frames, streaming %s.", __func__, fpath,
+			egif->SWidth, egif->SHeight, egif->ImageTotal, InMemory ? "from memory":"from file");
+
+    return egif;
+
+END_FAIL:
+    egi_gif_streamClose(&stream);
+    if(egif)
+	GifFreeMapObject(egif->SColorMap);
+    free(egif);
+    return NULL;
+}
+
+
 /*----------------------------------------------------------------------
 Free array of struct SavedImage.
 
@@ -1130,6 +1521,11 @@ void egi_gif_free(EGI_GIF **egif)
 	egi_imgbuf_free((*egif)->Simgbuf);
 	(*egif)->Simgbuf=NULL;
     }
+    egi_imgtribuf_free(&(*egif)->Stribuf);
+    egi_gif_streamClose(&(*egif)->stream);
+    egi_gif_freeCompiled(*egif);
+    egi_imgbuf_free((*egif)->RSimgbuf);
+    free((*egif)->Rxmap);
 
    /* free itself */
    free(*egif);
@@ -1138,6 +1534,592 @@ void egi_gif_free(EGI_GIF **egif)
 
 
 
+/*-------------------------------------------------------------
+Create egif->Stribuf, after then every updated Simgbuf(or RSimgbuf
+if resizing is set) is also published to it. Call it before starting
+the displaying thread.
+
+Return:
+	0	OK
+	<0	Fails
+--------------------------------------------------------------*/
+int egi_gif_enableTribuf(EGI_GIF *egif)
+{
+    if(egif==NULL || egif->Simgbuf==NULL)
+	return -1;
+
+    if(egif->Stribuf)
+	return 0;
+
+    if(egif->RSimgbuf)
+	egif->Stribuf=egi_imgtribuf_create(egif->RHeight, egif->RWidth, true);
+    else
+	egif->Stribuf=egi_imgtribuf_create(egif->SHeight, egif->SWidth, egif->Simgbuf->alpha!=NULL);
+    if(egif->Stribuf==NULL) {
+	EGI_PLOG(LOGLV_ERROR,"%s: Fail to create Stribuf!",__func__);
+	return -2;
+    }
+
+    return 0;
+}
+
+/*-------------------------------------------------------------
+Get the latest complete GIF frame published to egif->Stribuf,
+for ONE display thread. Simgbuf->img_mutex is NOT locked.
+The returned image is valid until next call.
+
+@egif:	An EGI_GIF with Stribuf enabled.
+@fresh:	To pass out whether it's a new frame since last call,
+	or NULL.
+
+Return:
+	Pointer to an EGI_IMGBUF	OK
+	NULL				Fails, or Stribuf is NOT enabled.
+--------------------------------------------------------------*/
+EGI_IMGBUF* egi_gif_readFrame(EGI_GIF *egif, bool *fresh)
+{
+    if(egif==NULL)
+	return NULL;
+
+    return egi_imgtribuf_readLatest(egif->Stribuf, fresh);
+}
+
+
+/*-------------------------------------------------------------------
+Set size for playing the GIF resized, and create egif->RSimgbuf.
+Per-axis index tables from RSimgbuf to the canvas are computed
+once here, then for each frame only the blocks changed in Simgbuf
+are rescaled to RSimgbuf(nearest neighbour), and RSimgbuf is
+displayed and published to Stribuf instead of Simgbuf.
+xp,yp,winw,winh of EGI_GIF_CONTEXT are in RSimgbuf then.
+Call it when the GIF is NOT being displayed.
+
+@egif:		An EGI_GIF.
+@RWidth,RHeight: New size. If one of them <=0, it's calculated
+		by the aspect ratio of the canvas.
+		If both <=0, resizing is disabled and RSimgbuf is freed.
+
+Return:
+	0	OK
+	<0	Fails
+-------------------------------------------------------------------*/
+int egi_gif_setResize(EGI_GIF *egif, int RWidth, int RHeight)
+{
+    int SWidth, SHeight;
+    int *maps;
+    int i, k;
+
+    if(egif==NULL || egif->Simgbuf==NULL)
+	return -1;
+
+    if(egif->thread_running) {
+	printf("%s: EGI_GIF is being displayed by a thread!\n", __func__);
+	return -2;
+    }
+
+    SWidth=egif->Simgbuf->width;
+    SHeight=egif->Simgbuf->height;
+
+    /* Free old RSimgbuf and tables */
+    egi_imgbuf_free(egif->RSimgbuf);
+    egif->RSimgbuf=NULL;
+    free(egif->Rxmap);
+    egif->Rxmap=NULL;	egif->Rymap=NULL;
+    egif->Rxinv=NULL;	egif->Ryinv=NULL;
+    egif->RWidth=0;	egif->RHeight=0;
+
+    if(RWidth>0 || RHeight>0) {
+	/* Keep aspect ratio */
+	if(RWidth<=0)
+		RWidth=SWidth*RHeight/SHeight;
+	if(RHeight<=0)
+		RHeight=SHeight*RWidth/SWidth;
+	if(RWidth<1) RWidth=1;
+	if(RHeight<1) RHeight=1;
+
+	egif->RSimgbuf=egi_imgbuf_create(RHeight, RWidth, 0, 0);
+	maps=malloc( (RWidth+RHeight+SWidth+1+SHeight+1)*sizeof(int) );
+	if(egif->RSimgbuf==NULL || maps==NULL) {
+		EGI_PLOG(LOGLV_ERROR,"%s: Fail to create RSimgbuf or index tables!",__func__);
+		egi_imgbuf_free(egif->RSimgbuf);
+		egif->RSimgbuf=NULL;
+		free(maps);
+		return -3;
+	}
+	egif->Rxmap=maps;
+	egif->Rymap=egif->Rxmap+RWidth;
+	egif->Rxinv=egif->Rymap+RHeight;
+	egif->Ryinv=egif->Rxinv+SWidth+1;
+	egif->RWidth=RWidth;
+	egif->RHeight=RHeight;
+
+	/* Sample at pixel centers, the tables are nondecreasing */
+	for(i=0; i<RWidth; i++)
+		egif->Rxmap[i]=(2*i+1)*SWidth/(2*RWidth);
+	for(i=0; i<RHeight; i++)
+		egif->Rymap[i]=(2*i+1)*SHeight/(2*RHeight);
+	for(i=0, k=0; i<=SWidth; i++) {
+		while(k<RWidth && egif->Rxmap[k]<i)
+			k++;
+		egif->Rxinv[i]=k;
+	}
+	for(i=0, k=0; i<=SHeight; i++) {
+		while(k<RHeight && egif->Rymap[k]<i)
+			k++;
+		egif->Ryinv[i]=k;
+	}
+
+	/* Rescale the current canvas */
+	egi_gif_resizeRect(egif, 0, 0, SWidth, SHeight);
+    }
+
+    /* Stribuf is for the displayed image */
+    if(egif->Stribuf) {
+	egi_imgtribuf_free(&egif->Stribuf);
+	if(egi_gif_enableTribuf(egif)!=0)
+		return -4;
+    }
+
+    return 0;
+}
+
+/*-------------------------------------------------------------
+Map a rectangle in the canvas to the one in RSimgbuf, which
+covers all RSimgbuf pixels sampled from it. The result may be
+empty(w or h is 0) when downsizing.
+--------------------------------------------------------------*/
+static void egi_gif_mapRect(const EGI_GIF *egif, int *x0, int *y0, int *w, int *h)
+{
+    int rx0, ry0;
+
+    rx0=egif->Rxinv[*x0];
+    ry0=egif->Ryinv[*y0];
+    *w=egif->Rxinv[*x0+*w]-rx0;
+    *h=egif->Ryinv[*y0+*h]-ry0;
+    *x0=rx0;
+    *y0=ry0;
+}
+
+/*-------------------------------------------------------------
+Rescale a changed block of Simgbuf to RSimgbuf. The caller shall
+keep Simgbuf unchanged during the call(as the writer, or with
+Simgbuf->img_mutex locked). RSimgbuf->img_mutex is locked here.
+--------------------------------------------------------------*/
+static void egi_gif_resizeRect(EGI_GIF *egif, int x0, int y0, int w, int h)
+{
+    EGI_IMGBUF *Simgbuf=egif->Simgbuf;
+    EGI_IMGBUF *RSimgbuf=egif->RSimgbuf;
+    int SWidth=Simgbuf->width;
+    int RWidth=RSimgbuf->width;
+    int spos, rpos;
+    int i, j;
+
+    /* Limit to the canvas */
+    if(x0<0) { w+=x0; x0=0; }
+    if(y0<0) { h+=y0; y0=0; }
+    if(x0+w > SWidth) w=SWidth-x0;
+    if(y0+h > Simgbuf->height) h=Simgbuf->height-y0;
+    if(w<=0 || h<=0)
+	return;
+
+    egi_gif_mapRect(egif, &x0, &y0, &w, &h);
+    if(w<=0 || h<=0)
+	return;
+
+    if(pthread_mutex_lock(&RSimgbuf->img_mutex) !=0){
+	EGI_PLOG(LOGLV_ERROR,"%s: Fail to lock RSimgbuf->img_mutex!",__func__);
+	return;
+    }
+
+    for(i=y0; i<y0+h; i++) {
+	spos=egif->Rymap[i]*SWidth;
+	rpos=i*RWidth;
+	for(j=x0; j<x0+w; j++) {
+		RSimgbuf->imgbuf[rpos+j]=Simgbuf->imgbuf[spos+egif->Rxmap[j]];
+		RSimgbuf->alpha[rpos+j]=Simgbuf->alpha[spos+egif->Rxmap[j]];
+	}
+    }
+    egi_imgbuf_freeAlphaRLE(RSimgbuf);
+
+    pthread_mutex_unlock(&RSimgbuf->img_mutex);
+}
+
+
+/*-------------------------------------------------------------
+Enable compiled frames for an EGI_GIF. In next complete loop of
+egi_gif_displayGifCtxt()(from ImageCount 0), each updated canvas
+is diffed with the previous one, and changed rectangles are saved
+as patches. After then, frames are replayed by copying patches to
+Simgbuf, and only patches are written to FB if no pixel turns
+transparent, LZW decoding and colormap lookup are all skipped.
+Call it before starting the displaying thread.
+
+Note:
+1. Patches are recorded with parameters of the gif_ctxt(User_DisposalMode,
+   User_TransColor,...) in that loop, keep them unchanged after then.
+2. If memory of patches exceeds max_memsize, recording is aborted and
+   egif->compiled is freed, frames are decoded as usual.
+3. NOT applied if DirectFB_ON.
+
+@egif:		An EGI_GIF.
+@max_memsize:	Memory limit for patches, 0 for EGI_GIF_COMPILED_MAXMEM.
+
+Return:
+	0	OK
+	<0	Fails
+--------------------------------------------------------------*/
+int egi_gif_enableCompiled(EGI_GIF *egif, size_t max_memsize)
+{
+    if(egif==NULL || egif->Simgbuf==NULL || egif->Simgbuf->alpha==NULL || egif->ImageTotal<1)
+	return -1;
+
+    if(egif->compiled)
+	return 0;
+
+    egif->compiled=calloc(1, sizeof(EGI_GIF_COMPILED));
+    if(egif->compiled==NULL) {
+	EGI_PLOG(LOGLV_ERROR,"%s: Fail to calloc compiled!",__func__);
+	return -2;
+    }
+    egif->compiled->frames=calloc(egif->ImageTotal, sizeof(EGI_GIF_CFRAME));
+    if(egif->compiled->frames==NULL) {
+	EGI_PLOG(LOGLV_ERROR,"%s: Fail to calloc compiled frames!",__func__);
+	free(egif->compiled);
+	egif->compiled=NULL;
+	return -2;
+    }
+    egif->compiled->max_memsize = max_memsize>0 ? max_memsize : EGI_GIF_COMPILED_MAXMEM;
+
+    return 0;
+}
+
+/*-------------------------------------------------------------
+Free compiled frames of an EGI_GIF. If frames have been replayed,
+ImageCount is reset to 0, so decoding restarts from the first frame.
+Call it when the displaying thread is NOT running.
+--------------------------------------------------------------*/
+void egi_gif_freeCompiled(EGI_GIF *egif)
+{
+    EGI_GIF_COMPILED *cgif;
+    int i;
+
+    if(egif==NULL || egif->compiled==NULL)
+	return;
+
+    cgif=egif->compiled;
+    for(i=0; i<cgif->nframes; i++)
+	egi_gif_freeCFrame(cgif, &cgif->frames[i]);
+    free(cgif->frames);
+    free(cgif->prev_color);
+    free(cgif->prev_alpha);
+    if(cgif->complete)
+	egif->ImageCount=0;
+    free(cgif);
+    egif->compiled=NULL;
+}
+
+/*-----------------------------------------
+Free patches of a compiled frame.
+------------------------------------------*/
+static void egi_gif_freeCFrame(EGI_GIF_COMPILED *cgif, EGI_GIF_CFRAME *cframe)
+{
+    int i;
+
+    if(cframe->patches==NULL)
+	return;
+
+    for(i=0; i<cframe->npatches; i++) {
+	if(cframe->patches[i].color) {
+		free(cframe->patches[i].color);
+		cgif->memsize -= cframe->patches[i].w*cframe->patches[i].h*3;
+	}
+    }
+    free(cframe->patches);
+    cframe->patches=NULL;
+    cframe->npatches=0;
+}
+
+/*-------------------------------------------------------------------
+Diff a canvas with the previous one, and save changed rectangles as
+patches of a compiled frame. The canvas is scanned in bands of
+EGI_GIF_PATCH_BAND rows, changed area in each band is bounded by one
+rectangle, and it's merged with the one of the band above if they
+are adjacent and overlapped horizontally.
+A pixel is unchanged if its alpha is the same, and so is the color
+unless it's transparent.
+
+@cgif:		The EGI_GIF_COMPILED.
+@cframe:	The compiled frame, its patches shall be empty.
+@width,height:	Size of the canvas.
+@color,alpha:	The canvas.
+@pcolor,palpha:	The previous canvas. If NULL, the whole canvas is
+		saved as one patch.
+
+Return:
+	0	OK
+	<0	Fails, or memory exceeds cgif->max_memsize.
+-------------------------------------------------------------------*/
+static int egi_gif_diffPatches(EGI_GIF_COMPILED *cgif, EGI_GIF_CFRAME *cframe, int width, int height,
+				const EGI_16BIT_COLOR *color, const EGI_8BIT_ALPHA *alpha,
+				const EGI_16BIT_COLOR *pcolor, const EGI_8BIT_ALPHA *palpha)
+{
+    EGI_GIF_PATCH *patch;
+    int nbands=(height+EGI_GIF_PATCH_BAND-1)/EGI_GIF_PATCH_BAND;
+    int minx, maxx, miny, maxy;
+    int x, y, y0;
+    int pos;
+    int i;
+    size_t size;
+
+    cframe->patches=calloc(nbands, sizeof(EGI_GIF_PATCH));
+    if(cframe->patches==NULL)
+	return -1;
+    cframe->npatches=0;
+    cframe->need_restore=false;
+
+    /* Get patch rectangles */
+    if(pcolor==NULL || palpha==NULL) {
+	patch=&cframe->patches[cframe->npatches++];
+	patch->x0=0;	patch->y0=0;
+	patch->w=width;	patch->h=height;
+	cframe->need_restore=true;
+    }
+    else {
+	for(y0=0; y0<height; y0+=EGI_GIF_PATCH_BAND) {
+	    minx=width; maxx=-1;
+	    miny=-1;    maxy=-1;
+	    for(y=y0; y<height && y<y0+EGI_GIF_PATCH_BAND; y++) {
+		pos=y*width;
+		for(x=0; x<width; x++, pos++) {
+		    if( alpha[pos]==palpha[pos] && ( alpha[pos]==0 || color[pos]==pcolor[pos] ) )
+			continue;
+		    if(alpha[pos]==0)
+			cframe->need_restore=true;
+		    if(x<minx) minx=x;
+		    if(x>maxx) maxx=x;
+		    if(miny<0) miny=y;
+		    maxy=y;
+		}
+	    }
+	    if(maxx<0)
+		continue;
+
+	    patch= cframe->npatches>0 ? &cframe->patches[cframe->npatches-1] : NULL;
+	    if( patch && patch->y0+patch->h==miny && minx < patch->x0+patch->w && maxx >= patch->x0 ) {
+		if(patch->x0+patch->w-1 > maxx)
+			maxx=patch->x0+patch->w-1;
+		if(patch->x0 < minx)
+			minx=patch->x0;
+		patch->x0=minx;
+		patch->w=maxx-minx+1;
+		patch->h=maxy-patch->y0+1;
+	    }
+	    else {
+		patch=&cframe->patches[cframe->npatches++];
+		patch->x0=minx;		 patch->y0=miny;
+		patch->w=maxx-minx+1;	 patch->h=maxy-miny+1;
+	    }
+	}
+    }
+
+    /* Save pixels of patches */
+    for(i=0; i<cframe->npatches; i++) {
+	patch=&cframe->patches[i];
+	size=patch->w*patch->h*3;
+	if(cgif->memsize+size > cgif->max_memsize)
+		return -2;
+	patch->color=malloc(size);
+	if(patch->color==NULL)
+		return -1;
+	patch->alpha=(EGI_8BIT_ALPHA *)(patch->color+patch->w*patch->h);
+	cgif->memsize += size;
+
+	for(y=0; y<patch->h; y++) {
+		pos=(patch->y0+y)*width+patch->x0;
+		memcpy(patch->color+y*patch->w, color+pos, patch->w*sizeof(EGI_16BIT_COLOR));
+		memcpy(patch->alpha+y*patch->w, alpha+pos, patch->w);
+	}
+    }
+
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+Record the updated Simgbuf as a compiled frame, called just after
+egi_gif_rasterWriteFB() in the displaying thread, which is the only
+writer of Simgbuf. Recording starts(or restarts) at ImageCount 0,
+and frames are recorded in sequence. The first frame is saved as a
+whole canvas, when all frames are recorded, it's diffed again with
+the canvas of the last frame, which it follows in replaying.
+
+@egif:		An EGI_GIF with compiled enabled.
+@DelayMs:	Delay time of the frame.
+-------------------------------------------------------------------*/
+static void egi_gif_recordFrame(EGI_GIF *egif, int DelayMs)
+{
+    EGI_GIF_COMPILED *cgif=egif->compiled;
+    EGI_IMGBUF *Simgbuf=egif->Simgbuf;
+    int npix=Simgbuf->width*Simgbuf->height;
+    EGI_GIF_CFRAME *cframe;
+    EGI_GIF_CFRAME cframe0={0};
+    EGI_GIF_PATCH *patch;
+    int ret;
+
+    if(cgif->complete)
+	return;
+
+    /* Restart from the first frame */
+    if(egif->ImageCount==0) {
+	while(cgif->nframes>0)
+		egi_gif_freeCFrame(cgif, &cgif->frames[--cgif->nframes]);
+    }
+    if(egif->ImageCount!=cgif->nframes)
+	return;
+
+    if(cgif->prev_color==NULL) {
+	cgif->prev_color=malloc(npix*sizeof(EGI_16BIT_COLOR));
+	cgif->prev_alpha=malloc(npix);
+	if(cgif->prev_color==NULL || cgif->prev_alpha==NULL) {
+		EGI_PLOG(LOGLV_ERROR,"%s: Fail to malloc prev canvas, compiling aborted.",__func__);
+		egi_gif_freeCompiled(egif);
+		return;
+	}
+    }
+
+    cframe=&cgif->frames[cgif->nframes];
+    cframe->DelayMs=DelayMs;
+    if(cgif->nframes==0)
+	ret=egi_gif_diffPatches(cgif, cframe, Simgbuf->width, Simgbuf->height,
+					Simgbuf->imgbuf, Simgbuf->alpha, NULL, NULL);
+    else
+	ret=egi_gif_diffPatches(cgif, cframe, Simgbuf->width, Simgbuf->height,
+					Simgbuf->imgbuf, Simgbuf->alpha, cgif->prev_color, cgif->prev_alpha);
+    cgif->nframes++;	/* To free patches of cframe anyway */
+    if(ret!=0) {
+	EGI_PLOG(LOGLV_WARN,"%s: Frame %d, patches exceed %zu bytes or fail to save, compiling aborted.",
+								__func__, egif->ImageCount, cgif->max_memsize);
+	egi_gif_freeCompiled(egif);
+	return;
+    }
+
+    memcpy(cgif->prev_color, Simgbuf->imgbuf, npix*sizeof(EGI_16BIT_COLOR));
+    memcpy(cgif->prev_alpha, Simgbuf->alpha, npix);
+
+    if(cgif->nframes < egif->ImageTotal)
+	return;
+
+    /* Diff the first frame with the last one */
+    patch=&cgif->frames[0].patches[0];
+    cframe0.DelayMs=cgif->frames[0].DelayMs;
+    ret=egi_gif_diffPatches(cgif, &cframe0, Simgbuf->width, Simgbuf->height,
+					patch->color, patch->alpha, cgif->prev_color, cgif->prev_alpha);
+    if(ret!=0) {
+	EGI_PLOG(LOGLV_WARN,"%s: Frame 0, patches exceed %zu bytes or fail to save, compiling aborted.",
+								__func__, cgif->max_memsize);
+	egi_gif_freeCFrame(cgif, &cframe0);
+	egi_gif_freeCompiled(egif);
+	return;
+    }
+    egi_gif_freeCFrame(cgif, &cgif->frames[0]);
+    cgif->frames[0]=cframe0;
+
+    free(cgif->prev_color);	cgif->prev_color=NULL;
+    free(cgif->prev_alpha);	cgif->prev_alpha=NULL;
+    cgif->complete=true;
+
+    EGI_PLOG(LOGLV_INFO,"%s: %d frames compiled, %zu bytes of patches.", __func__, cgif->nframes, cgif->memsize);
+}
+
+/*-------------------------------------------------------------------
+Replay a compiled frame at egif->ImageCount: copy its patches to
+Simgbuf and publish it, then display it if gif_ctxt->fbdev is not
+NULL. If no pixel turns transparent, only the patches(or their
+rescaled areas in RSimgbuf) are written to FB, since the rest of the FB buffer is already the same as the
+previous frame. Otherwise FB background is restored and the whole
+window is displayed, as egi_gif_displayGifCtxt() does.
+The whole window is also restored and displayed for the first frame of
+each cycle, and for the frame after any restore, so that the FB buffer
+is always rebuilt from a complete canvas.
+-------------------------------------------------------------------*/
+static void egi_gif_replayFrame(EGI_GIF_CONTEXT *gif_ctxt)
+{
+    EGI_GIF *egif=gif_ctxt->egif;
+    FBDEV *fbdev=gif_ctxt->fbdev;
+    EGI_IMGBUF *Simgbuf=egif->Simgbuf;
+    EGI_IMGBUF *Dimgbuf=egif->Simgbuf;		/* Image to display */
+    EGI_GIF_CFRAME *cframe=&egif->compiled->frames[egif->ImageCount];
+    EGI_GIF_PATCH *patch;
+    int SWidth=Simgbuf->width;
+    int x0, y0, x1, y1;
+    int pos;
+    int i, j;
+
+    if(pthread_mutex_lock(&Simgbuf->img_mutex) !=0){
+	EGI_PLOG(LOGLV_ERROR,"%s: Fail to lock Simgbuf->img_mutex!",__func__);
+	return;
+    }
+
+    for(i=0; i<cframe->npatches; i++) {
+	patch=&cframe->patches[i];
+	for(j=0; j<patch->h; j++) {
+		pos=(patch->y0+j)*SWidth+patch->x0;
+		memcpy(Simgbuf->imgbuf+pos, patch->color+j*patch->w, patch->w*sizeof(EGI_16BIT_COLOR));
+		memcpy(Simgbuf->alpha+pos, patch->alpha+j*patch->w, patch->w);
+	}
+    }
+    egi_imgbuf_freeAlphaRLE(Simgbuf);
+
+    /* Rescale patches to RSimgbuf */
+    if(egif->RSimgbuf) {
+	for(i=0; i<cframe->npatches; i++) {
+		patch=&cframe->patches[i];
+		egi_gif_resizeRect(egif, patch->x0, patch->y0, patch->w, patch->h);
+	}
+	Dimgbuf=egif->RSimgbuf;
+    }
+
+    egif->Simgbuf_ready=true;
+    if(egif->Stribuf)
+	egi_imgtribuf_publishCopy(egif->Stribuf, Dimgbuf);
+
+    pthread_mutex_unlock(&Simgbuf->img_mutex);
+
+    if(fbdev==NULL)
+	return;
+
+    if( cframe->need_restore || egif->ImageCount==0 || egif->compiled->restored ) {
+	memcpy(fbdev->map_bk, fbdev->map_buff+fbdev->screensize, fbdev->screensize);
+	egi_imgbuf_windisplay( Dimgbuf, fbdev, -1, gif_ctxt->xp, gif_ctxt->yp,
+				gif_ctxt->xw, gif_ctxt->yw, gif_ctxt->winw, gif_ctxt->winh );
+	/* Not for a frame redrawn only for the last restore */
+	egif->compiled->restored= cframe->need_restore || egif->ImageCount==0;
+	return;
+    }
+    egif->compiled->restored=false;
+
+    /* Display patches within the window */
+    for(i=0; i<cframe->npatches; i++) {
+	patch=&cframe->patches[i];
+	x0=patch->x0;	y0=patch->y0;
+	x1=patch->w;	y1=patch->h;
+	if(egif->RSimgbuf)
+		egi_gif_mapRect(egif, &x0, &y0, &x1, &y1);
+	x1 += x0;
+	y1 += y0;
+
+	if(x0 < gif_ctxt->xp) x0=gif_ctxt->xp;
+	if(y0 < gif_ctxt->yp) y0=gif_ctxt->yp;
+	if(x1 > gif_ctxt->xp+gif_ctxt->winw) x1=gif_ctxt->xp+gif_ctxt->winw;
+	if(y1 > gif_ctxt->yp+gif_ctxt->winh) y1=gif_ctxt->yp+gif_ctxt->winh;
+	if( x1<=x0 || y1<=y0 )
+		continue;
+
+	egi_imgbuf_windisplay( Dimgbuf, fbdev, -1, x0, y0,
+				gif_ctxt->xw+x0-gif_ctxt->xp, gif_ctxt->yw+y0-gif_ctxt->yp, x1-x0, y1-y0 );
+    }
+}
+
+
 /*---------------------------------------------------------------------------------------
 Update Simgbuf with raster data of a sequence GIF frame and its colormap. If fbdev is
 not NULL, then display the Simgbuf.
@@ -1320,9 +2302,25 @@ inline static void egi_gif_rasterWriteFB( FBDEV *fbdev, EGI_GIF *egif,
           }
     }
 
+    /* Rescale changed blocks to RSimgbuf */
+    if(egif->RSimgbuf) {
+	if(egif->ImageCount==0)		/* Simgbuf is reset for the first frame */
+		egi_gif_resizeRect(egif, 0, 0, SWidth, Simgbuf->height);
+	else {
+		if( !DirectFB_ON && egif->last_Disposal_Mode==2 )
+			egi_gif_resizeRect(egif, egif->last_offx, egif->last_offy,
+						 egif->last_BWidth, egif->last_BHeight);
+		egi_gif_resizeRect(egif, offx, offy, BWidth, BHeight);
+	}
+    }
+
     /* set Simgbuf_read */
     egif->Simgbuf_ready=true;
 
+    /* Publish the complete frame to display threads */
+    if(egif->Stribuf)
+	egi_imgtribuf_publishCopy(egif->Stribuf, egif->RSimgbuf ? egif->RSimgbuf : Simgbuf);
+
     /* --- FOR TEST : add boundary box for the imgbuf, NO mutexlock in this func. */
     //egi_imgbuf_addBoundaryBox(Simgbuf, WEGI_COLOR_BLACK, 2);
 
@@ -1335,8 +2333,8 @@ inline static void egi_gif_rasterWriteFB( FBDEV *fbdev, EGI_GIF *egif,
 	return;
     }
 
-    /* display Simgbuf as a frame */
-    egi_imgbuf_windisplay( Simgbuf, fbdev, -1,              /* img, fb, subcolor */
+    /* display Simgbuf(or RSimgbuf) as a frame */
+    egi_imgbuf_windisplay( egif->RSimgbuf ? egif->RSimgbuf : Simgbuf, fbdev, -1,   /* img, fb, subcolor */
 			   xp, yp,				/* xp, yp */
 			   xw, yw,				/* xw, yw */
                      	   winw, winh   /* winw, winh */
@@ -1391,12 +2389,49 @@ Note: If dev is NOT NULL, it will affect whole FB data with memcpy and page fres
 //					   	int User_DisposalMode, int User_TransColor, int User_BkgColor,
 //	   			   		int xp, int yp, int xw, int yw, int winw, int winh )
 void egi_gif_displayGifCtxt( EGI_GIF_CONTEXT *gif_ctxt )
+{
+    if(gif_ctxt==NULL)
+	return;
+
+    egi_gif_playCtxt(gif_ctxt, gif_ctxt->nloop, true);
+}
+
+
+/*-------------------------------------------------------------------
+Display one frame of the GIF as egi_gif_displayGifCtxt() does, then
+ImageCount++, but do NOT hold on for its delay time, which is left
+to the caller, such as an EGI_GIFSCHED. gif_ctxt->nloop is ignored.
+
+Return:
+	>=0	OK, delay time of the frame in ms.
+	<0	Fails
+-------------------------------------------------------------------*/
+int egi_gif_stepFrame( EGI_GIF_CONTEXT *gif_ctxt )
+{
+    return egi_gif_playCtxt(gif_ctxt, 0, false);
+}
+
+
+/*-------------------------------------------------------------------
+Parse and display frames of the GIF, for egi_gif_displayGifCtxt()
+and egi_gif_stepFrame().
+
+@gif_ctxt:	Context of the GIF.
+@nloop:		Loop times, see egi_gif_displayGifCtxt().
+@Delay_ON:	If true, hold on for the delay time after each frame.
+
+Return:
+	>=0	OK, delay time of the last frame in ms.
+	<0	Fails
+-------------------------------------------------------------------*/
+static int egi_gif_playCtxt(EGI_GIF_CONTEXT *gif_ctxt, int nloop, bool Delay_ON)
 {
     int j,k;
 
     int BWidth=0, BHeight=0;  	/* image block size */
     int offx, offy;		/* image block offset relative to gif canvas */
     int DelayMs=0;            	/* delay time in ms */
+    long long unsigned int tm_start;
 
     EGI_GIF *egif=NULL;
     FBDEV *fbdev=NULL;
@@ -1425,9 +2460,10 @@ void egi_gif_displayGifCtxt( EGI_GIF_CONTEXT *gif_ctxt )
     //int spos;
 
     /* sanity check */
-    if( gif_ctxt==NULL || gif_ctxt->egif==NULL || gif_ctxt->egif->SavedImages==NULL ) {
+    if( gif_ctxt==NULL || gif_ctxt->egif==NULL
+	|| ( gif_ctxt->egif->SavedImages==NULL && gif_ctxt->egif->stream==NULL ) ) {
 	printf("%s: input gif_ctxt or EGI_GIF(data) is NULL.\n", __func__);
-	return;
+	return -1;
     }
 
     /* Assign fixed varaibles */
@@ -1456,9 +2492,28 @@ void egi_gif_displayGifCtxt( EGI_GIF_CONTEXT *gif_ctxt )
  /* Do nloop times, or just one frame if nloop==0 */
  k=0;
  do {
+     /* Delay of this frame, from its GCE */
+     DelayMs=0;
+
+     /* Replay a compiled frame, without decoding */
+     if( egif->compiled && egif->compiled->complete && !DirectFB_ON ) {
+	DelayMs=egif->compiled->frames[egif->ImageCount].DelayMs;
+	egi_gif_replayFrame(gif_ctxt);
+	if(fbdev != NULL)
+		fb_page_refresh(fbdev,0);
+	if(Delay_ON)
+		tm_delayms(DelayMs);
+	goto NEXT_FRAME;
+     }
 
-     /* Get saved image data sequence */
-     ImageData=&egif->SavedImages[egif->ImageCount];
+     /* Get saved image data sequence, or decode it from the stream */
+     if(egif->stream) {
+	ImageData=egi_gif_streamFrame(egif->stream, egif->ImageCount);
+	if(ImageData==NULL)
+		return -2;
+     }
+     else
+	ImageData=&egif->SavedImages[egif->ImageCount];
 
      /* Get image colorMap */
      if(ImageData->ImageDesc.ColorMap) {
@@ -1608,12 +2663,28 @@ void egi_gif_displayGifCtxt( EGI_GIF_CONTEXT *gif_ctxt )
                trans_color, gif_ctxt->User_TransColor,   //bkg_color,   /* trans_color, user_trans_color, bkg_color */
 			     egif->ImgTransp_ON ); 	/* DirectFB_ON, Img_Transp_ON, BkgTransp_ON */
 
+     /* Record the updated canvas as patches */
+     if( egif->compiled && !DirectFB_ON )
+	egi_gif_recordFrame(egif, DelayMs);
+
     /* Refresh FB page if NOT DirectFB_ON */
     if(!DirectFB_ON && fbdev != NULL )
     	fb_page_refresh(fbdev,0);
 
+    /* Decode next frame of a streaming GIF ahead, during the delay */
+    if(egif->stream) {
+	tm_start=tm_get_tmstampms();
+	egi_gif_streamFrame(egif->stream, egif->ImageCount+1 > egif->ImageTotal-1 ? 0 : egif->ImageCount+1);
+	if(Delay_ON) {
+		DelayMs -= (int)(tm_get_tmstampms()-tm_start);
+		if(DelayMs<0)
+			DelayMs=0;
+	}
+    }
+
     /* Delay */
-    tm_delayms(DelayMs); /* Need to hold on here, even fddev==NULL */
+    if(Delay_ON)
+	tm_delayms(DelayMs); /* Need to hold on here, even fddev==NULL */
 
 
     /* ----- Parse Disposal_Mode: Actions after GIF displaying  ----- */
@@ -1698,6 +2769,7 @@ void egi_gif_displayGifCtxt( EGI_GIF_CONTEXT *gif_ctxt )
     /* record last Disposal mode */
     egif->last_Disposal_Mode=Disposal_Mode;
 
+NEXT_FRAME:
     /* ImageCount incremental */
     egif->ImageCount++;
 
@@ -1717,10 +2789,11 @@ void egi_gif_displayGifCtxt( EGI_GIF_CONTEXT *gif_ctxt )
 
     /* check request for quitting displaying */
     if(egif->request_quit_display)
-	return;
+	return DelayMs;
 
- }  while( k < gif_ctxt->nloop || gif_ctxt->nloop < 0 );  /* Do nloop times! OR loop forever if nloop<0 */
+ }  while( k < nloop || nloop < 0 );  /* Do nloop times! OR loop forever if nloop<0 */
 
+ return DelayMs;
 }
 
 
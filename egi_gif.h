@@ -16,6 +16,7 @@ Midas-Zhou
 #define __EGI_GIF_H__
 #include "gif_lib.h"
 #include "egi_imgbuf.h"
+#include "egi_imgtribuf.h"
 
 typedef struct fbdev FBDEV;  /* Just a declaration, referring to definition in egi_fbdev.h */
 
@@ -40,8 +41,66 @@ typedef struct  {
 } EGI_GIF_DATA;
 
 
+/*** Streaming source of an EGI_GIF, see egi_gif_openStream().
+ * Frames are decoded one at a time from the file(or its compressed copy in memory),
+ * so memory use is O(canvas) instead of O(frames).
+ */
+typedef struct egi_gif_stream {
+    GifFileType		*GifFile;	/* Current decoding handle, reopened to rewind */
+    char		*fpath;
+    unsigned char	*fdata;		/* Compressed GIF data in memory, NULL if read from the file */
+    size_t		fsize;
+    size_t		fpos;		/* Read position in fdata */
+
+    SavedImage		frame;		/* The look-ahead frame, RasterBits of SWidth*SHeight bytes is reused.
+					 * frame.ImageDesc.ColorMap refers to GifFile->Image.ColorMap.
+					 */
+    ExtensionBlock	gcb_block;	/* Graphics control block of the frame */
+    GifByteType		gcb_bytes[4];
+    int			index;		/* Index of the look-ahead frame, <0 if none */
+    int			next;		/* Index of next frame to read in GifFile */
+    unsigned int	rewinds;	/* Times of rewinding */
+} EGI_GIF_STREAM;
+
+
+/*** Compiled frames of an EGI_GIF, see egi_gif_enableCompiled().
+ * Each frame is recorded as rectangles of the canvas changed by decoding and disposal,
+ * so replaying a frame is only to copy its patches, without LZW decoding and colormap lookup.
+ */
+#define EGI_GIF_PATCH_BAND	16		/* Canvas is diffed in bands of 16 rows */
+#define EGI_GIF_COMPILED_MAXMEM	(4*1024*1024)	/* Default memory limit of patches */
+
+typedef struct egi_gif_patch {
+    int			x0;		/* Patch position and size in the canvas */
+    int			y0;
+    int			w;
+    int			h;
+    EGI_16BIT_COLOR	*color;		/* w*h, color and alpha in one block */
+    EGI_8BIT_ALPHA	*alpha;
+} EGI_GIF_PATCH;
+
+typedef struct egi_gif_cframe {
+    EGI_GIF_PATCH	*patches;
+    int			npatches;
+    int			DelayMs;
+    bool		need_restore;	/* Some pixels turn transparent, FB background has to be restored */
+} EGI_GIF_CFRAME;
+
+typedef struct egi_gif_compiled {
+    EGI_GIF_CFRAME	*frames;	/* [ImageTotal] */
+    int			nframes;	/* Number of recorded frames */
+    bool		complete;	/* All frames recorded, and they are replayed then */
+    size_t		memsize;	/* Memory used by patches */
+    size_t		max_memsize;	/* Recording is aborted if memsize exceeds it */
+    EGI_16BIT_COLOR	*prev_color;	/* Canvas of last recorded frame, freed when complete */
+    EGI_8BIT_ALPHA	*prev_alpha;
+    bool		restored;	/* FB background was restored at the last replayed frame */
+} EGI_GIF_COMPILED;
+
+
 /*** 				--- NOTE ---
  * 1. For big GIF file, be careful to use EGI_GIF, it needs large mem space!
+ *    Or open it by egi_gif_openStream().
  * 2. No mutex lock applied for EGI_GIF, however EGI_IMGBUF HAS mutex lock imbedded.
  */
 typedef struct egi_gif {
@@ -54,6 +113,12 @@ typedef struct egi_gif {
 
     int		RWidth;			/* Size for RSimgbuf, Unapplicable if both <=0, */
     int		RHeight;		/* At lease either RWidth or RHeigth to be >0 */
+    int		*Rxmap;			/* Source canvas x for each RSimgbuf column, [RWidth] */
+    int		*Rymap;			/* Source canvas y for each RSimgbuf row, [RHeight] */
+    int		*Rxinv;			/* First RSimgbuf column mapped from canvas x and after, [SWidth+1] */
+    int		*Ryinv;			/* First RSimgbuf row mapped from canvas y and after, [SHeight+1]
+					 * All 4 tables are in one block allocated for Rxmap.
+					 */
 
     int 	BWidth;			/* Size of current block image */
     int 	BHeight;
@@ -88,6 +153,8 @@ typedef struct egi_gif {
 					 * if(!Is_DataOwner): A refrence poiner to  EGI_GIF_DATA.SavedImages, to be freed by egi_gifdata_free()
 					 */
 
+   EGI_GIF_STREAM  *stream;		/* Not NULL for a streaming EGI_GIF, and SavedImages is NULL then. */
+
 
 
     int			ImageCount;     /* Index of current image (both APIs), starts from 0
@@ -107,8 +174,19 @@ typedef struct egi_gif {
 					       * leave a blank on the screen and cause flickering.
 					       */
 
-    /* To be applied when at lease either RWidth or RHeigth to be >0 */
-    EGI_IMGBUF		*RSimgbuf;	      /* resized to RWidthxRHeight, NOT applied yet. */
+    EGI_IMGTRIBUF	*Stribuf;	      /* If not NULL, every updated Simgbuf is published to it, so display threads
+					       * get complete frames by egi_gif_readFrame() without locking Simgbuf->img_mutex.
+					       * see egi_gif_enableTribuf().
+					       */
+
+    EGI_GIF_COMPILED	*compiled;	      /* If not NULL, frames are recorded as patches in the first loop and then
+					       * replayed, see egi_gif_enableCompiled().
+					       */
+
+    /* To be applied when at lease either RWidth or RHeigth to be >0, see egi_gif_setResize() */
+    EGI_IMGBUF		*RSimgbuf;	      /* Simgbuf resized to RWidthxRHeight, only blocks changed by each frame
+					       * are rescaled. If not NULL, it's displayed and published instead of Simgbuf.
+					       */
 
     /*  Following for one producer and one consumer scenario only! */
     pthread_t		thread_display;	 	/* displaying thread ID */
@@ -161,14 +239,21 @@ int  	  egi_gif_playFile(const char *fpath, bool Silent_Mode, bool ImgTransp_ON,
 EGI_GIF_DATA*  egi_gifdata_readFile(const char *fpath);
 EGI_GIF*  egi_gif_create(const EGI_GIF_DATA *gif_data, bool ImgTransp_ON);
 EGI_GIF*  egi_gif_slurpFile(const char *fpath, bool ImgTransp_ON);
+EGI_GIF*  egi_gif_openStream(const char *fpath, bool ImgTransp_ON, bool InMemory);
 void 	  egi_gifdata_free(EGI_GIF_DATA **gif_data);
 void	  egi_gif_free(EGI_GIF **egif);
+int	  egi_gif_enableTribuf(EGI_GIF *egif);
+int	  egi_gif_setResize(EGI_GIF *egif, int RWidth, int RHeight);
+EGI_IMGBUF* egi_gif_readFrame(EGI_GIF *egif, bool *fresh);
+int	  egi_gif_enableCompiled(EGI_GIF *egif, size_t max_memsize);
+void	  egi_gif_freeCompiled(EGI_GIF *egif);
 
 //void 	  egi_gif_displayFrame(FBDEV *fbdev, EGI_GIF *egif, int nloop, bool DirectFB_ON,
 //                                             int User_DisposalMode, int User_TransColor,int User_BkgColor,
 //                                             int xp, int yp, int xw, int yw, int winw, int winh );
 
 void 	  egi_gif_displayGifCtxt( EGI_GIF_CONTEXT *gif_ctxt );
+int	  egi_gif_stepFrame( EGI_GIF_CONTEXT *gif_ctxt );
 
 int 	  egi_gif_runDisplayThread(EGI_GIF_CONTEXT *gif_ctxt);
 
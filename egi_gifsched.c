@@ -0,0 +1,397 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+GIF animation scheduler, see egi_gifsched.h
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "egi_gifsched.h"
+#include "egi_log.h"
+
+static void *egi_gifsched_thread(void *arg);
+
+
+/*-------------------------------------------
+Return time a-b in us.
+--------------------------------------------*/
+static inline long long egi_gifsched_diffus(const struct timespec *a, const struct timespec *b)
+{
+	return (a->tv_sec-b->tv_sec)*1000000LL + (a->tv_nsec-b->tv_nsec)/1000;
+}
+
+/*-------------------------------------------
+Add ms to a timespec.
+--------------------------------------------*/
+static inline void egi_gifsched_addms(struct timespec *ts, int ms)
+{
+	ts->tv_sec += ms/1000;
+	ts->tv_nsec += (ms%1000)*1000000L;
+	if(ts->tv_nsec >= 1000000000L) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000L;
+	}
+}
+
+/*------------------------------------------------
+Move heap[index] up or down to its place.
+-------------------------------------------------*/
+static void egi_gifsched_heapFix(EGI_GIFSCHED *sched, int index)
+{
+	EGI_GIFSCHED_ENTRY **heap=sched->heap;
+	EGI_GIFSCHED_ENTRY *entry=heap[index];
+	int parent, child;
+
+	/* Sift up */
+	while(index>0) {
+		parent=(index-1)/2;
+		if( egi_gifsched_diffus(&heap[parent]->deadline, &entry->deadline) <= 0 )
+			break;
+		heap[index]=heap[parent];
+		index=parent;
+	}
+
+	/* Sift down */
+	while( (child=index*2+1) < sched->nentries ) {
+		if( child+1 < sched->nentries
+		    && egi_gifsched_diffus(&heap[child+1]->deadline, &heap[child]->deadline) < 0 )
+			child++;
+		if( egi_gifsched_diffus(&heap[child]->deadline, &entry->deadline) >= 0 )
+			break;
+		heap[index]=heap[child];
+		index=child;
+	}
+
+	heap[index]=entry;
+}
+
+/*------------------------------------------------
+Take heap[index] out of the heap, and free it.
+-------------------------------------------------*/
+static void egi_gifsched_heapDelete(EGI_GIFSCHED *sched, int index)
+{
+	free(sched->heap[index]);
+
+	sched->nentries--;
+	if(index < sched->nentries) {
+		sched->heap[index]=sched->heap[sched->nentries];
+		egi_gifsched_heapFix(sched, index);
+	}
+}
+
+/*------------------------------------------------
+Return index of the entry in the heap, or -1.
+-------------------------------------------------*/
+static int egi_gifsched_find(EGI_GIFSCHED *sched, EGI_GIF_CONTEXT *gif_ctxt)
+{
+	int i;
+
+	for(i=0; i<sched->nentries; i++) {
+		if(sched->heap[i]->gif_ctxt==gif_ctxt)
+			return i;
+	}
+
+	return -1;
+}
+
+
+/*-------------------------------------------------------------
+Create a GIF scheduler and start its thread.
+
+Return:
+	Pointer to an EGI_GIFSCHED	OK
+	NULL				Fails
+-------------------------------------------------------------*/
+EGI_GIFSCHED* egi_gifsched_create(void)
+{
+	EGI_GIFSCHED *sched;
+	pthread_condattr_t attr;
+
+	sched=calloc(1, sizeof(EGI_GIFSCHED));
+	if(sched==NULL) {
+		printf("%s: Fail to calloc sched.\n", __func__);
+		return NULL;
+	}
+
+	if( pthread_mutex_init(&sched->lock, NULL)!=0 ) {
+		free(sched);
+		return NULL;
+	}
+	/* Deadlines are CLOCK_MONOTONIC, so is the cond timedwait */
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	if( pthread_cond_init(&sched->cond, &attr)!=0 ) {
+		pthread_condattr_destroy(&attr);
+		pthread_mutex_destroy(&sched->lock);
+		free(sched);
+		return NULL;
+	}
+	pthread_condattr_destroy(&attr);
+
+	if( pthread_create(&sched->thread, NULL, egi_gifsched_thread, sched)!=0 ) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to create scheduler thread.", __func__);
+		pthread_cond_destroy(&sched->cond);
+		pthread_mutex_destroy(&sched->lock);
+		free(sched);
+		return NULL;
+	}
+
+	return sched;
+}
+
+
+/*-------------------------------------------------------------
+Stop the scheduler thread and free the scheduler. Statistics of
+animations still in the scheduler are logged.
+-------------------------------------------------------------*/
+void egi_gifsched_free(EGI_GIFSCHED **sched)
+{
+	EGI_GIFSCHED *psched;
+	EGI_GIFSCHED_STATS *stats;
+	int i;
+
+	if(sched==NULL || *sched==NULL)
+		return;
+
+	psched=*sched;
+
+	pthread_mutex_lock(&psched->lock);
+	psched->request_quit=true;
+	pthread_cond_broadcast(&psched->cond);
+	pthread_mutex_unlock(&psched->lock);
+
+	if( pthread_join(psched->thread, NULL)!=0 )
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to join scheduler thread.", __func__);
+
+	for(i=0; i<psched->nentries; i++) {
+		stats=&psched->heap[i]->stats;
+		EGI_PLOG(LOGLV_INFO, "%s: GIF %dx%d, %u frames, %u late, %u resyncs, lateness avg. %lluus max. %uus.",
+			__func__, psched->heap[i]->gif_ctxt->egif->SWidth, psched->heap[i]->gif_ctxt->egif->SHeight,
+			stats->frames, stats->late_frames, stats->resyncs,
+			stats->frames ? stats->sum_late_us/stats->frames : 0, stats->max_late_us );
+		free(psched->heap[i]);
+	}
+	free(psched->heap);
+
+	pthread_cond_destroy(&psched->cond);
+	pthread_mutex_destroy(&psched->lock);
+
+	free(psched);
+	*sched=NULL;
+}
+
+
+/*-------------------------------------------------------------
+Add a GIF animation to the scheduler, its next frame is due at
+once. gif_ctxt->nloop is applied as in egi_gif_displayGifCtxt(),
+after the last loop the animation is removed by the scheduler.
+
+@sched:		An EGI_GIFSCHED.
+@gif_ctxt:	Context of the GIF, it shall be kept valid until
+		it's removed, and NOT be displayed by other threads.
+
+Return:
+	0	OK
+	<0	Fails
+-------------------------------------------------------------*/
+int egi_gifsched_add(EGI_GIFSCHED *sched, EGI_GIF_CONTEXT *gif_ctxt)
+{
+	EGI_GIFSCHED_ENTRY *entry;
+	EGI_GIFSCHED_ENTRY **heap;
+	int ret=0;
+
+	if(sched==NULL || gif_ctxt==NULL || gif_ctxt->egif==NULL)
+		return -1;
+
+	if(gif_ctxt->egif->thread_running) {
+		printf("%s: EGI_GIF is being displayed by a thread!\n", __func__);
+		return -2;
+	}
+
+	pthread_mutex_lock(&sched->lock);
+
+	if( egi_gifsched_find(sched, gif_ctxt)>=0 ) {
+		printf("%s: gif_ctxt is already in the scheduler.\n", __func__);
+		ret=-3;
+		goto END_FUNC;
+	}
+
+	/* Grow the heap */
+	if(sched->nentries==sched->capacity) {
+		heap=realloc(sched->heap, (sched->capacity+8)*sizeof(EGI_GIFSCHED_ENTRY *));
+		if(heap==NULL) {
+			printf("%s: Fail to realloc heap.\n", __func__);
+			ret=-4;
+			goto END_FUNC;
+		}
+		sched->heap=heap;
+		sched->capacity += 8;
+	}
+
+	entry=calloc(1, sizeof(EGI_GIFSCHED_ENTRY));
+	if(entry==NULL) {
+		printf("%s: Fail to calloc entry.\n", __func__);
+		ret=-4;
+		goto END_FUNC;
+	}
+	entry->gif_ctxt=gif_ctxt;
+	clock_gettime(CLOCK_MONOTONIC, &entry->deadline);
+
+	sched->heap[sched->nentries++]=entry;
+	egi_gifsched_heapFix(sched, sched->nentries-1);
+
+	pthread_cond_signal(&sched->cond);
+
+END_FUNC:
+	pthread_mutex_unlock(&sched->lock);
+
+	return ret;
+}
+
+
+/*-------------------------------------------------------------
+Remove a GIF animation from the scheduler. If its frame is being
+rendered, wait until it finishes.
+
+@sched:		An EGI_GIFSCHED.
+@gif_ctxt:	Context of the GIF.
+
+Return:
+	0	OK
+	<0	Fails, or it's not in the scheduler(it may have
+		finished all loops).
+-------------------------------------------------------------*/
+int egi_gifsched_remove(EGI_GIFSCHED *sched, EGI_GIF_CONTEXT *gif_ctxt)
+{
+	int index;
+
+	if(sched==NULL || gif_ctxt==NULL)
+		return -1;
+
+	pthread_mutex_lock(&sched->lock);
+
+	index=egi_gifsched_find(sched, gif_ctxt);
+	if(index>=0) {
+		egi_gifsched_heapDelete(sched, index);
+		pthread_cond_signal(&sched->cond);
+	}
+
+	pthread_mutex_unlock(&sched->lock);
+
+	return index>=0 ? 0 : -2;
+}
+
+
+/*-------------------------------------------------------------
+Get frame lateness statistics of a GIF animation.
+
+@sched:		An EGI_GIFSCHED.
+@gif_ctxt:	Context of the GIF.
+@stats:		To pass out the statistics.
+
+Return:
+	0	OK
+	<0	Fails, or it's not in the scheduler.
+-------------------------------------------------------------*/
+int egi_gifsched_getStats(EGI_GIFSCHED *sched, EGI_GIF_CONTEXT *gif_ctxt, EGI_GIFSCHED_STATS *stats)
+{
+	int index;
+
+	if(sched==NULL || gif_ctxt==NULL || stats==NULL)
+		return -1;
+
+	pthread_mutex_lock(&sched->lock);
+
+	index=egi_gifsched_find(sched, gif_ctxt);
+	if(index>=0)
+		*stats=sched->heap[index]->stats;
+
+	pthread_mutex_unlock(&sched->lock);
+
+	return index>=0 ? 0 : -2;
+}
+
+
+/*-------------------------------------------------------------
+The scheduler thread.
+Render the frame at the top of the heap if it's due, otherwise
+wait on the cond until its deadline, or until an entry is added
+or removed.
+-------------------------------------------------------------*/
+static void *egi_gifsched_thread(void *arg)
+{
+	EGI_GIFSCHED *sched=(EGI_GIFSCHED *)arg;
+	EGI_GIFSCHED_ENTRY *entry;
+	EGI_GIF_CONTEXT *gif_ctxt;
+	struct timespec now, wake;
+	long long late_us;
+	int DelayMs;
+
+	pthread_mutex_lock(&sched->lock);
+
+	while(!sched->request_quit) {
+
+		if(sched->nentries==0) {
+			pthread_cond_wait(&sched->cond, &sched->lock);
+			continue;
+		}
+
+		entry=sched->heap[0];
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		late_us=egi_gifsched_diffus(&now, &entry->deadline);
+
+		/* Wait until the deadline, the heap may change meanwhile */
+		if(late_us<0) {
+			wake=entry->deadline;
+			pthread_cond_timedwait(&sched->cond, &sched->lock, &wake);
+			continue;
+		}
+
+		/* Lateness statistics */
+		entry->stats.frames++;
+		entry->stats.sum_late_us += late_us;
+		if(late_us > entry->stats.max_late_us)
+			entry->stats.max_late_us=late_us;
+		if(late_us > EGI_GIFSCHED_LATE_US)
+			entry->stats.late_frames++;
+
+		/* Render the frame */
+		gif_ctxt=entry->gif_ctxt;
+		DelayMs=egi_gif_stepFrame(gif_ctxt);
+		clock_gettime(CLOCK_MONOTONIC, &wake);
+		entry->stats.rend_us=egi_gifsched_diffus(&wake, &now);
+		if(DelayMs<0) {
+			EGI_PLOG(LOGLV_ERROR, "%s: Fail to render a GIF frame, remove it.", __func__);
+			egi_gifsched_heapDelete(sched, 0);
+			continue;
+		}
+		/* No GCE, or a delay too short: otherwise the thread would spin on the GIF */
+		if(DelayMs < EGI_GIFSCHED_MIN_DELAYMS)
+			DelayMs=EGI_GIFSCHED_DEFAULT_DELAYMS;
+
+		/* Count loops, ImageCount is reset to 0 at the end of a loop */
+		if(gif_ctxt->egif->ImageCount==0)
+			entry->loops++;
+		if( gif_ctxt->nloop==0 || ( gif_ctxt->nloop>0 && entry->loops>=gif_ctxt->nloop ) ) {
+			egi_gifsched_heapDelete(sched, 0);
+			continue;
+		}
+
+		/* Next deadline, reset it if it's still behind */
+		egi_gifsched_addms(&entry->deadline, DelayMs);
+		if( egi_gifsched_diffus(&entry->deadline, &wake) < 0 ) {
+			entry->deadline=wake;
+			entry->stats.resyncs++;
+		}
+		egi_gifsched_heapFix(sched, 0);
+	}
+
+	pthread_mutex_unlock(&sched->lock);
+
+	return (void *)0;
+}
@@ -0,0 +1,81 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+GIF animation scheduler: ONE thread plays many EGI_GIFs.
+
+1. Each registered EGI_GIF_CONTEXT has a deadline for its next frame,
+   all deadlines are kept in a min-heap.
+2. The scheduler thread renders the due frame by egi_gif_stepFrame(),
+   moves its deadline forward by the frame delay, and waits on its cond
+   (CLOCK_MONOTONIC) until the earliest deadline. Deadlines are absolute, so delays do NOT drift with the
+   rendering time. A frame delay less than EGI_GIFSCHED_MIN_DELAYMS,
+   or without GCE, takes EGI_GIFSCHED_DEFAULT_DELAYMS, as browsers do.
+3. Lateness of each frame(time from its deadline to rendering) is
+   recorded per animation, see egi_gifsched_getStats().
+4. egi_gifsched_remove() returns after the animation is taken out,
+   it's never rendered by the scheduler after then.
+5. Adding or removing an animation signals the cond, so the thread
+   picks up the new earliest deadline at once.
+
+Example:
+	sched=egi_gifsched_create();
+	egi_gifsched_add(sched, &gif_ctxt);	// gif_ctxt.fbdev=NULL, display Simgbuf in the page
+	...
+	egi_gifsched_remove(sched, &gif_ctxt);
+	egi_gifsched_free(&sched);
+
+Note:
+1. GIFs sharing an FBDEV shall set gif_ctxt.fbdev as NULL, and be displayed
+   by the page, since a GIF resets the whole FB working buffer for its first
+   frame and disposal.
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#ifndef __EGI_GIFSCHED_H__
+#define __EGI_GIFSCHED_H__
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include "egi_gif.h"
+
+#define EGI_GIFSCHED_LATE_US	5000	/* A frame later than this is counted in late_frames */
+#define EGI_GIFSCHED_MIN_DELAYMS	20	/* A frame delay less than it takes the default one */
+#define EGI_GIFSCHED_DEFAULT_DELAYMS	100
+
+typedef struct egi_gifsched_stats {
+	unsigned int		frames;		/* Number of rendered frames */
+	unsigned int		late_frames;	/* Frames later than EGI_GIFSCHED_LATE_US */
+	unsigned int		resyncs;	/* Times the deadline is reset, as it's behind more than one frame */
+	unsigned long long	sum_late_us;	/* Sum of lateness */
+	unsigned int		max_late_us;	/* Max. lateness */
+	unsigned int		rend_us;	/* Rendering time of the last frame */
+} EGI_GIFSCHED_STATS;
+
+typedef struct egi_gifsched_entry {
+	EGI_GIF_CONTEXT		*gif_ctxt;	/* Reference pointer, kept by the caller */
+	struct timespec		deadline;	/* Deadline of the next frame, CLOCK_MONOTONIC */
+	int			loops;		/* Finished loops */
+	EGI_GIFSCHED_STATS	stats;
+} EGI_GIFSCHED_ENTRY;
+
+typedef struct egi_gifsched {
+	EGI_GIFSCHED_ENTRY	**heap;		/* Min-heap of entries by deadline */
+	int			nentries;
+	int			capacity;
+
+	pthread_mutex_t		lock;		/* Held while rendering a frame */
+	pthread_cond_t		cond;		/* CLOCK_MONOTONIC, signaled when an entry is added/removed or to quit */
+	pthread_t		thread;
+	bool			request_quit;
+} EGI_GIFSCHED;
+
+EGI_GIFSCHED*	egi_gifsched_create(void);
+void		egi_gifsched_free(EGI_GIFSCHED **sched);
+int		egi_gifsched_add(EGI_GIFSCHED *sched, EGI_GIF_CONTEXT *gif_ctxt);
+int		egi_gifsched_remove(EGI_GIFSCHED *sched, EGI_GIF_CONTEXT *gif_ctxt);
+int		egi_gifsched_getStats(EGI_GIFSCHED *sched, EGI_GIF_CONTEXT *gif_ctxt, EGI_GIFSCHED_STATS *stats);
+
+#endif
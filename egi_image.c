@@ -110,6 +110,7 @@ void egi_imgbuf_cleardata(EGI_IMGBUF *egi_imgbuf)
 		        egi_free_buff2D(egi_imgbuf->palphas, egi_imgbuf->height);
 			egi_imgbuf->palphas=NULL;
 		}
+		egi_imgbuf_freeAlphaRLE(egi_imgbuf);
 
 		/* reset size and submax */
 		egi_imgbuf->height=0;
@@ -237,6 +238,9 @@ int egi_imgbuf_addBoundaryBox(EGI_IMGBUF *ineimg, EGI_16BIT_COLOR color, int lw)
 	if(ineimg==NULL || ineimg->imgbuf==NULL)
 		return -1;
 
+	/* alpha data will be changed */
+	egi_imgbuf_freeAlphaRLE(ineimg);
+
 	/* limit wl */
 	if(lw <= 0 )
 		lw=1;
@@ -512,6 +516,9 @@ int  egi_imgbuf_copyBlock( EGI_IMGBUF *destimg, const EGI_IMGBUF *srcimg, bool b
 	if( bw <=0 || bh <=0 )
 		return -1;
 
+	/* alpha data will be changed */
+	egi_imgbuf_freeAlphaRLE(destimg);
+
 	/* Assume width/heigth of EGI_IMGBUF are sane! */
 
 	/* Check (xd,yd) and  (xs,ys), rule out situations that block does NOT cover any part of the image. */
@@ -642,6 +649,9 @@ int egi_imgbuf_setFrame( EGI_IMGBUF *eimg, enum imgframe_type type,
 		return -1;
 	}
 
+	/* alpha data will be changed */
+	egi_imgbuf_freeAlphaRLE(eimg);
+
 	int height=eimg->height;
 	int width=eimg->width;
 
@@ -828,6 +838,9 @@ int egi_imgbuf_fadeOutEdges(EGI_IMGBUF *eimg, EGI_8BIT_ALPHA max_alpha, int widt
 	if( ssmode==0 || width<=0 )
 		return 1;
 
+	/* alpha data will be changed */
+	egi_imgbuf_freeAlphaRLE(eimg);
+
 	/* Create alpha data if NULL */
 	if(eimg->alpha==NULL) {
                 eimg->alpha=calloc(1, eimg->height*eimg->width*sizeof(unsigned char)); /* alpha value 8bpp */
@@ -942,6 +955,9 @@ int egi_imgbuf_fadeOutCircle(EGI_IMGBUF *eimg, EGI_8BIT_ALPHA max_alpha, int rad
 	if( width<=0 )
 		return 1;
 
+	/* alpha data will be changed */
+	egi_imgbuf_freeAlphaRLE(eimg);
+
 	/* Check rad */
 	if(rad<0)rad=0;
 
@@ -1942,6 +1958,9 @@ int egi_imgbuf_blend_imgbuf(EGI_IMGBUF *eimg, int xb, int yb, const EGI_IMGBUF *
                 return -2;
         }
 
+	/* alpha data will be changed */
+	egi_imgbuf_freeAlphaRLE(eimg);
+
         /* calloc and assign alpha, if NULL */
         if( eimg->alpha==NULL ) {
                 size=eimg->height*eimg->width;
@@ -2293,6 +2312,256 @@ int egi_imgbuf_rotate_update(EGI_IMGBUF **eimg, int angle)
 	return 0;
 }
 
+/*------------------------------------------------------------------
+Enable/disable RLE alpha for an EGI_IMGBUF.
+If enabled, RLE alpha data will be built on its first blit, then
+egi_imgbuf_windisplay() and egi_subimg_writeFB() will copy opaque runs
+as spans, skip transparent runs and blend only partial pixels.
+
+Suitable for images that are blitted many times but seldom changed,
+such as icons, button images and glyph images.
+
+Note:
+1. EGI_IMGBUF functions that change alpha data will free RLE alpha,
+   and it will be rebuilt on next blit. If alpha[] is changed directly
+   by the caller, egi_imgbuf_freeAlphaRLE() MUST be called.
+
+@eimg:		An EGI_IMGBUF
+@enable:	True to enable, false to disable and free RLE data.
+
+Return:
+	0	OK
+	<0	Fails
+-------------------------------------------------------------------*/
+int egi_imgbuf_enableAlphaRLE(EGI_IMGBUF *eimg, bool enable)
+{
+	if(eimg==NULL)
+		return -1;
+
+	if(pthread_mutex_lock(&eimg->img_mutex) !=0 ) {
+		printf("%s: Fail to lock image mutex!\n",__func__);
+		return -2;
+	}
+
+	eimg->rle_on=enable;
+	if(!enable)
+		egi_imgbuf_freeAlphaRLE(eimg);
+
+	pthread_mutex_unlock(&eimg->img_mutex);
+
+	return 0;
+}
+
+/*------------------------------------------------------------
+Free RLE alpha data of an EGI_IMGBUF, if any.
+
+NOTE:
+  1. No mutex operation here, the caller shall take care of
+     imgbuf mutex lock.
+------------------------------------------------------------*/
+void egi_imgbuf_freeAlphaRLE(EGI_IMGBUF *eimg)
+{
+	if(eimg==NULL || eimg->alpha_rle==NULL)
+		return;
+
+	free(eimg->alpha_rle->rowruns);
+	free(eimg->alpha_rle->runs);
+	free(eimg->alpha_rle);
+	eimg->alpha_rle=NULL;
+}
+
+/*-----------------------------------------------------------------
+Build RLE alpha data for an EGI_IMGBUF, old data will be replaced.
+Each row is encoded into runs of transparent(alpha==0), opaque
+(alpha==255) and partial pixels.
+
+NOTE:
+  1. No mutex operation here, the caller shall take care of
+     imgbuf mutex lock.
+
+Return:
+	0	OK
+	<0	Fails
+-----------------------------------------------------------------*/
+int egi_imgbuf_buildAlphaRLE(EGI_IMGBUF *eimg)
+{
+	int i,j;
+	int n;
+	int type, ptype;
+	int capacity;
+	EGI_ALPHA_RLE *rle;
+	EGI_ALPHA_RUN *ptmp;
+	unsigned char *alpha;
+
+	if( eimg==NULL || eimg->alpha==NULL || eimg->width<=0 || eimg->height<=0 )
+		return -1;
+
+	egi_imgbuf_freeAlphaRLE(eimg);
+
+	rle=calloc(1, sizeof(EGI_ALPHA_RLE));
+	if(rle==NULL)
+		return -2;
+	rle->rowruns=calloc(eimg->height+1, sizeof(int));
+	capacity=eimg->height*4;	/* Assume 4 runs per row, realloc if not enough */
+	rle->runs=calloc(capacity, sizeof(EGI_ALPHA_RUN));
+	if(rle->rowruns==NULL || rle->runs==NULL) {
+		printf("%s: Fail to calloc rle data.\n",__func__);
+		goto END_FAIL;
+	}
+
+	n=0;
+	for(i=0; i<eimg->height; i++) {
+		rle->rowruns[i]=n;
+		alpha=eimg->alpha+i*eimg->width;
+		ptype=-1;
+		for(j=0; j<eimg->width; j++) {
+			if(alpha[j]==0)
+				type=ALPHA_RUN_TRANSP;
+			else if(alpha[j]==255)
+				type=ALPHA_RUN_OPAQUE;
+			else
+				type=ALPHA_RUN_PARTIAL;
+
+			/* Extend current run */
+			if( type==ptype && rle->runs[n-1].len < 0xFFFF ) {
+				rle->runs[n-1].len++;
+				continue;
+			}
+
+			/* Start a new run */
+			if(n==capacity) {
+				ptmp=realloc(rle->runs, 2*capacity*sizeof(EGI_ALPHA_RUN));
+				if(ptmp==NULL) {
+					printf("%s: Fail to realloc runs.\n",__func__);
+					goto END_FAIL;
+				}
+				rle->runs=ptmp;
+				capacity *= 2;
+			}
+			rle->runs[n].len=1;
+			rle->runs[n].type=type;
+			n++;
+			ptype=type;
+		}
+	}
+	rle->rowruns[eimg->height]=n;
+	rle->nruns=n;
+
+	eimg->alpha_rle=rle;
+
+	return 0;
+
+END_FAIL:
+	free(rle->rowruns);
+	free(rle->runs);
+	free(rle);
+	return -3;
+}
+
+
+/*---------------------------------------------------------------------------
+Display image in a defined window by its RLE alpha data.
+Called by egi_imgbuf_windisplay() with image mutex locked, parameters are
+the same as egi_imgbuf_windisplay().
+
+1. Transparent runs are skipped.
+2. Opaque runs are memcpy()ed(or filled with subcolor) into FB as spans,
+   if the FB supports span writing(see fb_get_spanptr()), otherwise draw_dot()
+   is called for each pixel.
+3. Partial pixels are blended with FB pixels.
+---------------------------------------------------------------------------*/
+static void egi_imgbuf_windisplayRLE( EGI_IMGBUF *egi_imgbuf, FBDEV *fb_dev, int subcolor,
+			   		int xp, int yp, int xw, int yw, int winw, int winh)
+{
+	int i,j,k;
+	int xres, yres;
+	int imgw=egi_imgbuf->width;
+	int imgh=egi_imgbuf->height;
+	int ix0, ix1;		/* Image X range of the window in current row, [ix0 ix1) */
+	int x, rx0, rx1;	/* Image X range of current run, and its clipped part */
+	int iy;
+	EGI_16BIT_COLOR *imgrow;
+	unsigned char *alpharow;
+	EGI_16BIT_COLOR *span;
+	EGI_ALPHA_RUN *run;
+	EGI_ALPHA_RLE *rle=egi_imgbuf->alpha_rle;
+
+	/* If FB position rotate 90deg or 270deg, swap xres and yres */
+	if(fb_dev->virt_fb) {
+		xres=fb_dev->virt_fb->width;
+		yres=fb_dev->virt_fb->height;
+	}
+	else if(fb_dev->pos_rotate & 0x1) {
+		xres=fb_dev->vinfo.yres;
+		yres=fb_dev->vinfo.xres;
+	}
+	else {
+		xres=fb_dev->vinfo.xres;
+		yres=fb_dev->vinfo.yres;
+	}
+
+	/* Image X range of the window, clipped by the image and the screen */
+	ix0=xp;
+	if(ix0<0) ix0=0;
+	if(ix0 < xp-xw) ix0=xp-xw;
+	ix1=xp+winw;
+	if(ix1>imgw) ix1=imgw;
+	if(ix1 > xp-xw+xres) ix1=xp-xw+xres;
+	if(ix0>=ix1)
+		return;
+
+	for(i=0; i<winh; i++) {
+		iy=yp+i;
+		if( iy<0 || iy>imgh-1 || i+yw<0 || i+yw>yres-1 )
+			continue;
+
+		imgrow=egi_imgbuf->imgbuf+iy*imgw;
+		alpharow=egi_imgbuf->alpha+iy*imgw;
+		span=fb_get_spanptr(fb_dev, ix0-xp+xw, i+yw);
+		if(span!=NULL)
+			span -= ix0-xp+xw;	/* Then span[0] maps to screen X=0 */
+
+		x=0;
+		for(k=rle->rowruns[iy]; k<rle->rowruns[iy+1] && x<ix1; k++) {
+			run=rle->runs+k;
+			rx0=x;
+			rx1=x+run->len;
+			x=rx1;
+
+			if(run->type==ALPHA_RUN_TRANSP || rx1<=ix0 )
+				continue;
+			if(rx0<ix0) rx0=ix0;
+			if(rx1>ix1) rx1=ix1;
+
+			/* Write spans directly to FB */
+			if(span!=NULL) {
+				if(run->type==ALPHA_RUN_OPAQUE) {
+					if(subcolor<0)
+						memcpy(span+rx0-xp+xw, imgrow+rx0, (rx1-rx0)*sizeof(EGI_16BIT_COLOR));
+					else {
+						for(j=rx0; j<rx1; j++)
+							span[j-xp+xw]=subcolor;
+					}
+				}
+				else {  /* ALPHA_RUN_PARTIAL */
+					for(j=rx0; j<rx1; j++)
+						span[j-xp+xw]=COLOR_16BITS_BLEND( subcolor<0 ? imgrow[j]:subcolor,
+									span[j-xp+xw], alpharow[j] );
+				}
+			}
+			/* Otherwise call draw_dot() */
+			else {
+				for(j=rx0; j<rx1; j++) {
+					fb_dev->pixalpha=alpharow[j];
+					fbset_color2(fb_dev, subcolor<0 ? imgrow[j]:subcolor);
+					draw_dot(fb_dev, j-xp+xw, i+yw);
+				}
+			}
+		}
+	}
+}
+
+
 /*--------------------------------------------------------------------------------------
 Display image in a defined window.
 For 16bits color only!!!!
@@ -2434,6 +2703,11 @@ int egi_imgbuf_windisplay( EGI_IMGBUF *egi_imgbuf, FBDEV *fb_dev, int subcolor,
                 }
         }
   }
+  /* with alpha channel, and RLE alpha enabled */
+  else if( egi_imgbuf->rle_on && ( egi_imgbuf->alpha_rle!=NULL || egi_imgbuf_buildAlphaRLE(egi_imgbuf)==0 ) )
+  {
+	egi_imgbuf_windisplayRLE(egi_imgbuf, fb_dev, subcolor, xp, yp, xw, yw, winw, winh);
+  }
   else /* with alpha channel */
   {
 	//printf("----- alpha ON -----\n");
@@ -2883,6 +3157,9 @@ int egi_imgbuf_resetColorAlpha(EGI_IMGBUF *egi_imgbuf, int color, int alpha )
 		return -2;
 	}
 
+	/* alpha data will be changed */
+	egi_imgbuf_freeAlphaRLE(egi_imgbuf);
+
 	/* limit */
 	if(color>0xFFFF) color=0xFFFF;
 	if(alpha>0xFF) alpha=0xFF;
@@ -2949,6 +3226,9 @@ int egi_imgbuf_reset(EGI_IMGBUF *egi_imgbuf, int subindex, int color, int alpha)
 		return -3;
 	}
 
+	/* alpha data will be changed */
+	egi_imgbuf_freeAlphaRLE(egi_imgbuf);
+
 	height=egi_imgbuf->height;
 	width=egi_imgbuf->width;
 
@@ -3062,6 +3342,9 @@ int egi_imgbuf_blend_FTbitmap(EGI_IMGBUF* eimg, int xb, int yb, FT_Bitmap *bitma
 		printf("%s: input FT_Bitmap or its buffer is NULL!\n", __func__);
 		return -2;
 	}
+
+	/* alpha data will be changed */
+	egi_imgbuf_freeAlphaRLE(eimg);
 	/* calloc and assign alpha, if NULL */
 	if(eimg->alpha==NULL) {
 		size=eimg->height*eimg->width;
@@ -89,6 +89,11 @@ int egi_imgbuf_windisplay2( EGI_IMGBUF *egi_imgbuf, FBDEV *fb_dev,			/* mutex_lo
 int egi_image_rotdisplay( EGI_IMGBUF *egi_imgbuf, FBDEV *fb_dev, int angle,		/* mutex_lock for input egi_imgbuf */
                                                 int xri, int yri, int xrl, int yrl);
 
+/* RLE alpha, applied in egi_imgbuf_windisplay() */
+int 	egi_imgbuf_enableAlphaRLE(EGI_IMGBUF *eimg, bool enable);			/* mutex_lock */
+int 	egi_imgbuf_buildAlphaRLE(EGI_IMGBUF *eimg);
+void 	egi_imgbuf_freeAlphaRLE(EGI_IMGBUF *eimg);
+
 /* display sub_image of an EGI_IMAGBUF */
 int egi_subimg_writeFB(EGI_IMGBUF *egi_imgbuf, FBDEV *fb_dev, int subnum,		/* mutex_lock */
                                                         int subcolor, int x0,   int y0);
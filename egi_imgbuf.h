@@ -1,6 +1,9 @@
 #ifndef __EGI_IMGBUF_H__
 #define __EGI_IMGBUF_H__
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
 #include "egi_color.h"
 #include <freetype2/ft2build.h>
 #include FT_FREETYPE_H
@@ -21,6 +24,25 @@ typedef struct {
 }EGI_16BIT_PIXEL;			/* also see PIXEL in egi_bjp.h */
 
 
+/* Run-length encoded alpha data, see egi_imgbuf_buildAlphaRLE() */
+enum egi_alpha_run_type {
+	ALPHA_RUN_TRANSP	=0,	/* alpha==0, skip */
+	ALPHA_RUN_OPAQUE	=1,	/* alpha==255, copy color data */
+	ALPHA_RUN_PARTIAL	=2,	/* 0<alpha<255, blend */
+};
+
+typedef struct {
+		uint16_t	len;	/* Number of pixels, a run never crosses a row */
+		uint8_t		type;	/* enum egi_alpha_run_type */
+}EGI_ALPHA_RUN;
+
+typedef struct {
+		int		nruns;		/* Total number of runs */
+		int		*rowruns;	/* rowruns[height+1], index of the first run of each row in runs[] */
+		EGI_ALPHA_RUN	*runs;
+}EGI_ALPHA_RLE;
+
+
 typedef struct
 {
 	/* TODO NOTE: mutex only applied to several functions now....
@@ -37,6 +59,13 @@ typedef struct
 					 */
 	unsigned char 	*alpha;    	/* 8bit, alpha channel value, if applicable: alpha=0,100%backcolor, alpha=1, 100% frontcolor */
 
+	bool		rle_on;		/* If true, RLE alpha data will be built on first blit and used by
+					 * egi_imgbuf_windisplay(), see egi_imgbuf_enableAlphaRLE().
+					 */
+	EGI_ALPHA_RLE	*alpha_rle;	/* RLE alpha data, freed whenever alpha data is changed by EGI functions.
+					 * If alpha[] is modified directly, call egi_imgbuf_freeAlphaRLE().
+					 */
+
 #if 0   /* Now it is applied in EGI_GIF */
     	bool            imgbuf_ready;       /* To indicate that imgbuf data is ready!
                                                * In some case imgbuf may be emptied before it is updated, so all alpha values may be
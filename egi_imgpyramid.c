@@ -0,0 +1,855 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Tiled multi-resolution image(pyramid), see egi_imgpyramid.h
+
+Note:
+1. A tile pointer got from the cache is valid only until next tile is
+   inserted, since the LRU tail may be evicted then. So a tile is always
+   used up before fetching another one.
+2. libjpeg error_exit() is redirected with setjmp/longjmp, a broken
+   JPG file only fails the band decoding.
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+#include <jerror.h>
+#include "egi_imgpyramid.h"
+#include "egi_image.h"
+#include "egi_log.h"
+
+/* libjpeg-turbo 1.5+ supports partial decoding of scanlines */
+#if defined(LIBJPEG_TURBO_VERSION_NUMBER) && LIBJPEG_TURBO_VERSION_NUMBER >= 1005000
+ #define PYRAMID_JPEG_CROP_SKIP
+#endif
+
+/* libjpeg error manager with a return point */
+struct pyramid_jpeg_error {
+	struct jpeg_error_mgr	pub;
+	jmp_buf			setjmp_buffer;
+};
+
+static void pyramid_jpeg_error_exit(j_common_ptr cinfo);
+static unsigned int pyramid_hash(const EGI_IMGPYRAMID *pyr, int level, int col, int row);
+static EGI_PYRAMID_TILE* pyramid_lookup(EGI_IMGPYRAMID *pyr, int level, int col, int row);
+static int pyramid_insert(EGI_IMGPYRAMID *pyr, int level, int col, int row, EGI_IMGBUF *eimg);
+static void pyramid_evict(EGI_IMGPYRAMID *pyr);
+static int pyramid_decodeBand(EGI_IMGPYRAMID *pyr, int level, int row, int c0, int c1);
+static int pyramid_buildTile(EGI_IMGPYRAMID *pyr, int level, int col, int row);
+static EGI_PYRAMID_TILE* pyramid_fetchTile(EGI_IMGPYRAMID *pyr, int level, int col, int row);
+static int pyramid_loadRegion(EGI_IMGPYRAMID *pyr, int level, int c0, int r0, int c1, int r1);
+static int pyramid_viewTiles(const EGI_IMGPYRAMID *pyr, int level, float zoom, int xp, int yp,
+			     int winw, int winh, int *c0, int *r0, int *c1, int *r1);
+
+
+/*--------------------------------------------
+libjpeg error_exit: print the message and
+jump back to the decoding function.
+--------------------------------------------*/
+static void pyramid_jpeg_error_exit(j_common_ptr cinfo)
+{
+	struct pyramid_jpeg_error *jerr=(struct pyramid_jpeg_error *)cinfo->err;
+
+	(*cinfo->err->output_message)(cinfo);
+	longjmp(jerr->setjmp_buffer, 1);
+}
+
+
+/*-----------------------------------------------------------------
+Open a JPG file as an image pyramid. Only the header is read here.
+
+@fpath:		Full path of the JPG file.
+@tsize:		Tile size, an even number in [16 1024].
+		If 0, EGI_PYRAMID_TILE_SIZE is applied.
+@max_tiles:	Capacity of the tile cache, at least 4.
+		Memory of the cache is about max_tiles*tsize*tsize*2 bytes.
+
+Return:
+	Pointer to an EGI_IMGPYRAMID	OK
+	NULL				Fails
+------------------------------------------------------------------*/
+EGI_IMGPYRAMID* egi_imgpyramid_open(const char *fpath, int tsize, int max_tiles)
+{
+	struct jpeg_decompress_struct cinfo;
+	struct pyramid_jpeg_error jerr;
+	EGI_IMGPYRAMID *pyr;
+	EGI_PYRAMID_LEVEL *plv;
+	FILE *fil;
+	int i;
+
+	if(fpath==NULL)
+		return NULL;
+
+	if(tsize==0)
+		tsize=EGI_PYRAMID_TILE_SIZE;
+	if( tsize<16 || tsize>1024 || (tsize&1) ) {
+		printf("%s: Invalid tile size %d.\n", __func__, tsize);
+		return NULL;
+	}
+	if(max_tiles<4)
+		max_tiles=4;
+
+	fil=fopen(fpath, "rbe");
+	if(fil==NULL) {
+		printf("%s: Fail to open '%s', %s.\n", __func__, fpath, strerror(errno));
+		return NULL;
+	}
+
+	pyr=calloc(1, sizeof(EGI_IMGPYRAMID));
+	if(pyr==NULL) {
+		printf("%s: Fail to calloc pyr.\n", __func__);
+		fclose(fil);
+		return NULL;
+	}
+
+	cinfo.err=jpeg_std_error(&jerr.pub);
+	jerr.pub.error_exit=pyramid_jpeg_error_exit;
+	if(setjmp(jerr.setjmp_buffer)) {
+		printf("%s: Fail to read JPG header of '%s'.\n", __func__, fpath);
+		jpeg_destroy_decompress(&cinfo);
+		fclose(fil);
+		free(pyr);
+		return NULL;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_stdio_src(&cinfo, fil);
+	jpeg_read_header(&cinfo, TRUE);
+
+	pyr->width=cinfo.image_width;
+	pyr->height=cinfo.image_height;
+	pyr->tsize=tsize;
+
+	/* Level 0-3: sizes as libjpeg outputs with DCT scaling */
+	for(i=0; i<EGI_PYRAMID_DCT_LEVELS; i++) {
+		cinfo.scale_num=1;
+		cinfo.scale_denom=1<<i;
+		jpeg_calc_output_dimensions(&cinfo);
+		pyr->levels[i].width=cinfo.output_width;
+		pyr->levels[i].height=cinfo.output_height;
+		pyr->nlevels=i+1;
+		if( cinfo.output_width<=tsize && cinfo.output_height<=tsize )
+			break;
+	}
+
+	jpeg_destroy_decompress(&cinfo);
+	fclose(fil);
+
+	/* Level 4 and up: half of the level below, until it fits in one tile */
+	while( pyr->nlevels<EGI_PYRAMID_LEVELS_MAX ) {
+		plv=&pyr->levels[pyr->nlevels-1];
+		if( plv->width<=tsize && plv->height<=tsize )
+			break;
+		pyr->levels[pyr->nlevels].width=(plv->width+1)/2;
+		pyr->levels[pyr->nlevels].height=(plv->height+1)/2;
+		pyr->nlevels++;
+	}
+
+	for(i=0; i<pyr->nlevels; i++) {
+		pyr->levels[i].cols=(pyr->levels[i].width+tsize-1)/tsize;
+		pyr->levels[i].rows=(pyr->levels[i].height+tsize-1)/tsize;
+	}
+
+	/* Tile cache */
+	pyr->max_tiles=max_tiles;
+	for(pyr->hsize=16; pyr->hsize < 2*max_tiles; pyr->hsize<<=1);
+	pyr->htable=calloc(pyr->hsize, sizeof(EGI_PYRAMID_TILE *));
+	if(pyr->htable==NULL) {
+		printf("%s: Fail to calloc htable.\n", __func__);
+		free(pyr);
+		return NULL;
+	}
+
+	if(pthread_mutex_init(&pyr->lock, NULL) != 0) {
+		printf("%s: Fail to init mutex.\n", __func__);
+		free(pyr->htable);
+		free(pyr);
+		return NULL;
+	}
+
+	strncpy(pyr->fpath, fpath, EGI_PATH_MAX-1);
+	pyr->bkcolor=WEGI_COLOR_BLACK;
+
+	EGI_PLOG(LOGLV_INFO, "%s: '%s' %dx%d, %d levels, tile size %d.",
+				__func__, fpath, pyr->width, pyr->height, pyr->nlevels, tsize);
+
+	return pyr;
+}
+
+
+/*-----------------------------------------
+Free all tiles and the pyramid.
+------------------------------------------*/
+void egi_imgpyramid_close(EGI_IMGPYRAMID **pyr)
+{
+	EGI_PYRAMID_TILE *tile, *next;
+
+	if(pyr==NULL || *pyr==NULL)
+		return;
+
+	for(tile=(*pyr)->lru_head; tile!=NULL; tile=next) {
+		next=tile->next;
+		egi_imgbuf_free(tile->eimg);
+		free(tile);
+	}
+	free((*pyr)->htable);
+	egi_imgbuf_free((*pyr)->view);
+	pthread_mutex_destroy(&(*pyr)->lock);
+
+	free(*pyr);
+	*pyr=NULL;
+}
+
+
+/*-----------------------------------------------------------
+Pick the level for a zoom factor, it's the smallest level
+that is not smaller than the view resolution.
+
+@zoom:	Screen pixels per full resolution image pixel.
+
+Return:
+	Level index.
+-----------------------------------------------------------*/
+int egi_imgpyramid_pickLevel(const EGI_IMGPYRAMID *pyr, float zoom)
+{
+	int level;
+
+	if(pyr==NULL)
+		return 0;
+
+	for(level=pyr->nlevels-1; level>0; level--) {
+		if( (float)pyr->levels[level].width/pyr->width >= zoom*0.999f )
+			break;
+	}
+
+	return level;
+}
+
+
+/*---------------------------------------------
+Hash index of a tile.
+---------------------------------------------*/
+static unsigned int pyramid_hash(const EGI_IMGPYRAMID *pyr, int level, int col, int row)
+{
+	unsigned int h;
+
+	h=(unsigned int)level*2654435761u ^ (unsigned int)col*73856093u ^ (unsigned int)row*19349663u;
+
+	return h & (pyr->hsize-1);
+}
+
+
+/*---------------------------------------------
+Look up a tile in the cache, and move it to
+the head of the LRU list if found.
+
+Return:
+	Pointer to the tile	OK
+	NULL			Not in the cache
+---------------------------------------------*/
+static EGI_PYRAMID_TILE* pyramid_lookup(EGI_IMGPYRAMID *pyr, int level, int col, int row)
+{
+	EGI_PYRAMID_TILE *tile;
+
+	for(tile=pyr->htable[pyramid_hash(pyr, level, col, row)]; tile!=NULL; tile=tile->hnext) {
+		if( tile->level==level && tile->col==col && tile->row==row )
+			break;
+	}
+	if(tile==NULL || tile==pyr->lru_head)
+		return tile;
+
+	/* Move to the LRU head */
+	tile->prev->next=tile->next;
+	if(tile->next)
+		tile->next->prev=tile->prev;
+	else
+		pyr->lru_tail=tile->prev;
+	tile->prev=NULL;
+	tile->next=pyr->lru_head;
+	pyr->lru_head->prev=tile;
+	pyr->lru_head=tile;
+
+	return tile;
+}
+
+
+/*---------------------------------------------
+Evict the least recently used tile.
+---------------------------------------------*/
+static void pyramid_evict(EGI_IMGPYRAMID *pyr)
+{
+	EGI_PYRAMID_TILE *tile=pyr->lru_tail;
+	EGI_PYRAMID_TILE **pp;
+
+	if(tile==NULL)
+		return;
+
+	/* Unlink from the hash chain */
+	for( pp=&pyr->htable[pyramid_hash(pyr, tile->level, tile->col, tile->row)];
+							*pp!=NULL; pp=&(*pp)->hnext ) {
+		if(*pp==tile) {
+			*pp=tile->hnext;
+			break;
+		}
+	}
+
+	/* Unlink from the LRU list */
+	pyr->lru_tail=tile->prev;
+	if(tile->prev)
+		tile->prev->next=NULL;
+	else
+		pyr->lru_head=NULL;
+
+	egi_imgbuf_free(tile->eimg);
+	free(tile);
+	pyr->ntiles--;
+}
+
+
+/*------------------------------------------------------
+Insert a tile image into the cache, the LRU tile is
+evicted if the cache is full. Ownership of eimg is
+taken in any case.
+
+Return:
+	0	OK
+	<0	Fails
+-------------------------------------------------------*/
+static int pyramid_insert(EGI_IMGPYRAMID *pyr, int level, int col, int row, EGI_IMGBUF *eimg)
+{
+	EGI_PYRAMID_TILE *tile;
+	unsigned int h;
+
+	/* Already in the cache */
+	if( pyramid_lookup(pyr, level, col, row)!=NULL ) {
+		egi_imgbuf_free(eimg);
+		return 0;
+	}
+
+	tile=calloc(1, sizeof(EGI_PYRAMID_TILE));
+	if(tile==NULL) {
+		printf("%s: Fail to calloc tile.\n", __func__);
+		egi_imgbuf_free(eimg);
+		return -1;
+	}
+
+	while(pyr->ntiles >= pyr->max_tiles)
+		pyramid_evict(pyr);
+
+	tile->level=level;
+	tile->col=col;
+	tile->row=row;
+	tile->eimg=eimg;
+
+	h=pyramid_hash(pyr, level, col, row);
+	tile->hnext=pyr->htable[h];
+	pyr->htable[h]=tile;
+
+	tile->next=pyr->lru_head;
+	if(pyr->lru_head)
+		pyr->lru_head->prev=tile;
+	else
+		pyr->lru_tail=tile;
+	pyr->lru_head=tile;
+
+	pyr->ntiles++;
+
+	return 0;
+}
+
+
+/*-----------------------------------------------------------------
+Decode tiles [c0 c1] in a tile row of a DCT level at one pass,
+and put them into the cache.
+
+Return:
+	0	OK
+	<0	Fails
+------------------------------------------------------------------*/
+static int pyramid_decodeBand(EGI_IMGPYRAMID *pyr, int level, int row, int c0, int c1)
+{
+	struct jpeg_decompress_struct cinfo;
+	struct pyramid_jpeg_error jerr;
+	EGI_PYRAMID_LEVEL *plv=&pyr->levels[level];
+	EGI_IMGBUF ** volatile timgs=NULL;
+	unsigned char * volatile rowbuf=NULL;
+	FILE *fil;
+	JSAMPROW jrow;
+	JDIMENSION xoff, cwidth;
+	unsigned char *pt;
+	EGI_16BIT_COLOR *pc;
+	int ts=pyr->tsize;
+	int ntimg=c1-c0+1;
+	int y0, bh, tw;
+	int i,j,k;
+
+	y0=row*ts;
+	bh = plv->height-y0 > ts ? ts : plv->height-y0;
+
+	fil=fopen(pyr->fpath, "rbe");
+	if(fil==NULL) {
+		printf("%s: Fail to open '%s', %s.\n", __func__, pyr->fpath, strerror(errno));
+		return -1;
+	}
+
+	cinfo.err=jpeg_std_error(&jerr.pub);
+	jerr.pub.error_exit=pyramid_jpeg_error_exit;
+	if(setjmp(jerr.setjmp_buffer)) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to decode band %d of level %d, '%s'.",
+							__func__, row, level, pyr->fpath);
+		jpeg_destroy_decompress(&cinfo);
+		fclose(fil);
+		free(rowbuf);
+		if(timgs) {
+			for(k=0; k<ntimg; k++)
+				egi_imgbuf_free(timgs[k]);
+			free(timgs);
+		}
+		return -2;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_stdio_src(&cinfo, fil);
+	jpeg_read_header(&cinfo, TRUE);
+
+	cinfo.scale_num=1;
+	cinfo.scale_denom=1<<level;
+	cinfo.out_color_space=JCS_RGB;		/* Also for grayscale */
+	cinfo.dct_method=JDCT_IFAST;
+	cinfo.do_fancy_upsampling=FALSE;
+
+	jpeg_start_decompress(&cinfo);
+	if( cinfo.output_width!=plv->width || cinfo.output_height!=plv->height )
+		ERREXIT(&cinfo, JERR_IMAGE_TOO_BIG);
+
+	timgs=calloc(ntimg, sizeof(EGI_IMGBUF *));
+	rowbuf=malloc(cinfo.output_width*cinfo.output_components);
+	if(timgs==NULL || rowbuf==NULL)
+		ERREXIT(&cinfo, JERR_OUT_OF_MEMORY);
+	for(k=0; k<ntimg; k++) {
+		tw = plv->width-(c0+k)*ts > ts ? ts : plv->width-(c0+k)*ts;
+		timgs[k]=egi_imgbuf_createWithoutAlpha(bh, tw, 0);
+		if(timgs[k]==NULL)
+			ERREXIT(&cinfo, JERR_OUT_OF_MEMORY);
+	}
+
+	/* Columns to decode, xoff may be moved left to an iMCU boundary */
+	xoff=c0*ts;
+	cwidth=timgs[ntimg-1]->width+(ntimg-1)*ts;
+#ifdef PYRAMID_JPEG_CROP_SKIP
+	if(cwidth < cinfo.output_width)
+		jpeg_crop_scanline(&cinfo, &xoff, &cwidth);
+	else
+		xoff=0;
+	if(y0>0)
+		jpeg_skip_scanlines(&cinfo, y0);
+#else
+	xoff=0;
+	while(cinfo.output_scanline < y0) {
+		jrow=rowbuf;
+		jpeg_read_scanlines(&cinfo, &jrow, 1);
+	}
+#endif
+
+	for(i=0; i<bh; i++) {
+		jrow=rowbuf;
+		jpeg_read_scanlines(&cinfo, &jrow, 1);
+		for(k=0; k<ntimg; k++) {
+			tw=timgs[k]->width;
+			pt=rowbuf+((c0+k)*ts-xoff)*3;
+			pc=timgs[k]->imgbuf+i*tw;
+			for(j=0; j<tw; j++, pt+=3)
+				pc[j]=COLOR_RGB_TO16BITS(pt[0], pt[1], pt[2]);
+		}
+	}
+
+	/* Rest of scanlines are NOT needed */
+	jpeg_destroy_decompress(&cinfo);
+	fclose(fil);
+	free(rowbuf);
+
+	pyr->decodes++;
+	for(k=0; k<ntimg; k++)
+		pyramid_insert(pyr, level, c0+k, row, timgs[k]);
+	free(timgs);
+
+	return 0;
+}
+
+
+/*-----------------------------------------------------------------
+Build a tile of a level above the DCT levels by downsampling
+2x2 tiles of the level below, then put it into the cache.
+
+Return:
+	0	OK
+	<0	Fails
+------------------------------------------------------------------*/
+static int pyramid_buildTile(EGI_IMGPYRAMID *pyr, int level, int col, int row)
+{
+	EGI_PYRAMID_LEVEL *plv=&pyr->levels[level];
+	EGI_PYRAMID_LEVEL *clv=&pyr->levels[level-1];
+	EGI_PYRAMID_TILE *ctile;
+	EGI_IMGBUF *eimg, *cimg;
+	EGI_16BIT_COLOR color;
+	int ts=pyr->tsize;
+	int half=pyr->tsize/2;
+	int tw, th, px, py;
+	int dx, dy, x, y, sx, sy, n;
+	int r, g, b;
+
+	tw = plv->width-col*ts > ts ? ts : plv->width-col*ts;
+	th = plv->height-row*ts > ts ? ts : plv->height-row*ts;
+	eimg=egi_imgbuf_createWithoutAlpha(th, tw, 0);
+	if(eimg==NULL)
+		return -1;
+
+	for(dy=0; dy<2; dy++) {
+		for(dx=0; dx<2; dx++) {
+			if( 2*col+dx >= clv->cols || 2*row+dy >= clv->rows )
+				continue;
+
+			/* Use the child tile up before fetching next one */
+			ctile=pyramid_fetchTile(pyr, level-1, 2*col+dx, 2*row+dy);
+			if(ctile==NULL) {
+				egi_imgbuf_free(eimg);
+				return -2;
+			}
+			cimg=ctile->eimg;
+
+			for(y=0; 2*y < cimg->height; y++) {
+				py=dy*half+y;
+				if(py>=th)
+					break;
+				for(x=0; 2*x < cimg->width; x++) {
+					px=dx*half+x;
+					if(px>=tw)
+						break;
+					/* Average of 2x2 pixels, less at edges */
+					r=g=b=n=0;
+					for(sy=2*y; sy<2*y+2 && sy<cimg->height; sy++) {
+						for(sx=2*x; sx<2*x+2 && sx<cimg->width; sx++) {
+							color=cimg->imgbuf[sy*cimg->width+sx];
+							r += color>>11;
+							g += (color>>5)&0x3F;
+							b += color&0x1F;
+							n++;
+						}
+					}
+					eimg->imgbuf[py*tw+px]=((r/n)<<11)|((g/n)<<5)|(b/n);
+				}
+			}
+		}
+	}
+
+	return pyramid_insert(pyr, level, col, row, eimg);
+}
+
+
+/*-----------------------------------------------------------------
+Get a tile from the cache, or load it if it's not in the cache.
+The returned pointer is valid until next tile is inserted.
+
+Return:
+	Pointer to the tile	OK
+	NULL			Fails
+------------------------------------------------------------------*/
+static EGI_PYRAMID_TILE* pyramid_fetchTile(EGI_IMGPYRAMID *pyr, int level, int col, int row)
+{
+	EGI_PYRAMID_TILE *tile;
+	int ret;
+
+	if( level<0 || level>=pyr->nlevels || col<0 || col>=pyr->levels[level].cols
+	    || row<0 || row>=pyr->levels[level].rows )
+		return NULL;
+
+	tile=pyramid_lookup(pyr, level, col, row);
+	if(tile) {
+		pyr->hits++;
+		return tile;
+	}
+
+	pyr->misses++;
+	if(level<EGI_PYRAMID_DCT_LEVELS)
+		ret=pyramid_decodeBand(pyr, level, row, col, col);
+	else
+		ret=pyramid_buildTile(pyr, level, col, row);
+	if(ret!=0)
+		return NULL;
+
+	return pyramid_lookup(pyr, level, col, row);
+}
+
+
+/*-----------------------------------------------------------------
+Load all missing tiles in a region of a level into the cache.
+For DCT levels, missing tiles in a tile row are decoded at one pass.
+For upper levels, the region of the level below is loaded first if
+it fits in the cache.
+
+Return:
+	0	OK
+	<0	Fails
+------------------------------------------------------------------*/
+static int pyramid_loadRegion(EGI_IMGPYRAMID *pyr, int level, int c0, int r0, int c1, int r1)
+{
+	EGI_PYRAMID_LEVEL *plv=&pyr->levels[level];
+	int mc0, mc1;
+	int c, r;
+	int nmiss=0;
+
+	if(c0<0) c0=0;
+	if(r0<0) r0=0;
+	if(c1>plv->cols-1) c1=plv->cols-1;
+	if(r1>plv->rows-1) r1=plv->rows-1;
+	if(c0>c1 || r0>r1)
+		return 0;
+
+	for(r=r0; r<=r1; r++) {
+		mc0=-1; mc1=-1;
+		for(c=c0; c<=c1; c++) {
+			if(pyramid_lookup(pyr, level, c, r)==NULL) {
+				if(mc0<0) mc0=c;
+				mc1=c;
+			}
+		}
+		if(mc0<0)
+			continue;
+		nmiss += mc1-mc0+1;
+
+		if(level<EGI_PYRAMID_DCT_LEVELS) {
+			pyr->misses += mc1-mc0+1;
+			if(pyramid_decodeBand(pyr, level, r, mc0, mc1)!=0)
+				return -1;
+		}
+	}
+
+	if(level<EGI_PYRAMID_DCT_LEVELS || nmiss==0)
+		return 0;
+
+	/* Load the region below in a batch, then build missing tiles */
+	if( (2*(c1-c0+1))*(2*(r1-r0+1)) <= pyr->max_tiles/2 )
+		pyramid_loadRegion(pyr, level-1, 2*c0, 2*r0, 2*c1+1, 2*r1+1);
+
+	for(r=r0; r<=r1; r++) {
+		for(c=c0; c<=c1; c++) {
+			if( pyramid_lookup(pyr, level, c, r)==NULL ) {
+				pyr->misses++;
+				if(pyramid_buildTile(pyr, level, c, r)!=0)
+					return -2;
+			}
+		}
+	}
+
+	return 0;
+}
+
+
+/*-----------------------------------------------------------------
+Get tiles range of a level covered by a view.
+
+Return:
+	0	OK
+	<0	The view is out of the picture.
+------------------------------------------------------------------*/
+static int pyramid_viewTiles(const EGI_IMGPYRAMID *pyr, int level, float zoom, int xp, int yp,
+			     int winw, int winh, int *c0, int *r0, int *c1, int *r1)
+{
+	const EGI_PYRAMID_LEVEL *plv=&pyr->levels[level];
+	double sx=(double)plv->width/pyr->width;
+	double sy=(double)plv->height/pyr->height;
+	int lx0, ly0, lx1, ly1;
+
+	lx0=floor(xp*sx);
+	ly0=floor(yp*sy);
+	lx1=floor((xp+winw/zoom)*sx);
+	ly1=floor((yp+winh/zoom)*sy);
+
+	if(lx0<0) lx0=0;
+	if(ly0<0) ly0=0;
+	if(lx1>plv->width-1) lx1=plv->width-1;
+	if(ly1>plv->height-1) ly1=plv->height-1;
+	if(lx0>lx1 || ly0>ly1)
+		return -1;
+
+	*c0=lx0/pyr->tsize;
+	*r0=ly0/pyr->tsize;
+	*c1=lx1/pyr->tsize;
+	*r1=ly1/pyr->tsize;
+
+	return 0;
+}
+
+
+/*-----------------------------------------------------------------
+Load tiles of a view and its margin into the cache in advance,
+call it in idle time when the view is expected to move.
+
+@pyr:		An EGI_IMGPYRAMID.
+@zoom:		Screen pixels per full resolution image pixel.
+@xp,yp:		Left top of the view, in full resolution image coordinates.
+@winw,winh:	Size of the view.
+@margin:	Margin around the view, in screen pixels.
+
+Return:
+	0	OK
+	<0	Fails
+------------------------------------------------------------------*/
+int egi_imgpyramid_prefetch(EGI_IMGPYRAMID *pyr, float zoom, int xp, int yp,
+					int winw, int winh, int margin)
+{
+	int level;
+	int c0, r0, c1, r1;
+	int ret=0;
+
+	if(pyr==NULL || zoom<=0.0 || winw<=0 || winh<=0)
+		return -1;
+	if(margin<0)
+		margin=0;
+
+	if(pthread_mutex_lock(&pyr->lock) != 0)
+		return -1;
+
+	level=egi_imgpyramid_pickLevel(pyr, zoom);
+	if( pyramid_viewTiles(pyr, level, zoom, xp-margin/zoom, yp-margin/zoom,
+				winw+2*margin, winh+2*margin, &c0, &r0, &c1, &r1)==0 )
+		ret=pyramid_loadRegion(pyr, level, c0, r0, c1, r1);
+
+	pthread_mutex_unlock(&pyr->lock);
+
+	return ret;
+}
+
+
+/*-----------------------------------------------------------------
+Render a view of the picture at a zoom factor and display it in a
+window. Tiles of the level picked by egi_imgpyramid_pickLevel() are
+sampled into pyr->view by index tables, then pyr->view is displayed
+by egi_imgbuf_windisplay().
+
+@pyr:		An EGI_IMGPYRAMID.
+@fb_dev:	FB device.
+@zoom:		Screen pixels per full resolution image pixel.
+@xp,yp:		Left top of the view, in full resolution image coordinates.
+@xw,yw:		Left top of the window on screen.
+@winw,winh:	Size of the window.
+
+Return:
+	0	OK
+	<0	Fails
+------------------------------------------------------------------*/
+int egi_imgpyramid_renderView(EGI_IMGPYRAMID *pyr, FBDEV *fb_dev, float zoom,
+				int xp, int yp, int xw, int yw, int winw, int winh)
+{
+	EGI_PYRAMID_LEVEL *plv;
+	EGI_PYRAMID_TILE *tile;
+	EGI_IMGBUF *view;
+	int *xmap=NULL, *ymap=NULL;
+	double sx, sy;
+	bool outside=false;
+	int level, ts;
+	int c0, r0, c1, r1;
+	int c, r;
+	int i, j, i0, i1, j0, j1;
+	int ret=0;
+
+	if(pyr==NULL || fb_dev==NULL || zoom<=0.0 || winw<=0 || winh<=0)
+		return -1;
+
+	if(pthread_mutex_lock(&pyr->lock) != 0)
+		return -1;
+
+	level=egi_imgpyramid_pickLevel(pyr, zoom);
+	plv=&pyr->levels[level];
+	ts=pyr->tsize;
+
+	/* Viewport buffer */
+	if( pyr->view==NULL || pyr->view->width!=winw || pyr->view->height!=winh ) {
+		egi_imgbuf_free(pyr->view);
+		pyr->view=egi_imgbuf_createWithoutAlpha(winh, winw, pyr->bkcolor);
+		if(pyr->view==NULL) {
+			ret=-2;
+			goto END_FUNC;
+		}
+	}
+	view=pyr->view;
+
+	/* Index tables: screen x/y to level x/y, -1 for out of picture */
+	xmap=malloc(winw*sizeof(int));
+	ymap=malloc(winh*sizeof(int));
+	if(xmap==NULL || ymap==NULL) {
+		printf("%s: Fail to malloc index tables.\n", __func__);
+		ret=-2;
+		goto END_FUNC;
+	}
+	sx=(double)plv->width/pyr->width;
+	sy=(double)plv->height/pyr->height;
+	for(i=0; i<winw; i++) {
+		xmap[i]=floor((xp+(i+0.5)/zoom)*sx);
+		if(xmap[i]<0 || xmap[i]>=plv->width) {
+			xmap[i]=-1;
+			outside=true;
+		}
+	}
+	for(j=0; j<winh; j++) {
+		ymap[j]=floor((yp+(j+0.5)/zoom)*sy);
+		if(ymap[j]<0 || ymap[j]>=plv->height) {
+			ymap[j]=-1;
+			outside=true;
+		}
+	}
+
+	if(outside) {
+		for(i=0; i<winw*winh; i++)
+			view->imgbuf[i]=pyr->bkcolor;
+	}
+
+	if( pyramid_viewTiles(pyr, level, zoom, xp, yp, winw, winh, &c0, &r0, &c1, &r1)!=0 )
+		goto DISPLAY;
+
+	/* Decode missing tiles in batches */
+	pyramid_loadRegion(pyr, level, c0, r0, c1, r1);
+
+	/* Sample tile by tile, maps are monotonic so each tile covers a screen block */
+	for(r=r0, j0=0; r<=r1; r++) {
+		while( j0<winh && ymap[j0] < r*ts ) j0++;
+		for( j1=j0; j1<winh && ymap[j1]>=0 && ymap[j1] < (r+1)*ts; j1++ );
+
+		for(c=c0, i0=0; c<=c1; c++) {
+			while( i0<winw && xmap[i0] < c*ts ) i0++;
+			for( i1=i0; i1<winw && xmap[i1]>=0 && xmap[i1] < (c+1)*ts; i1++ );
+			if(i1==i0 || j1==j0)
+				continue;
+
+			tile=pyramid_fetchTile(pyr, level, c, r);
+			if(tile==NULL) {
+				ret=-3;
+				continue;
+			}
+			for(j=j0; j<j1; j++) {
+				EGI_16BIT_COLOR *src=tile->eimg->imgbuf+(ymap[j]-r*ts)*tile->eimg->width-c*ts;
+				EGI_16BIT_COLOR *dest=view->imgbuf+j*winw;
+				for(i=i0; i<i1; i++)
+					dest[i]=src[xmap[i]];
+			}
+		}
+	}
+
+DISPLAY:
+	egi_imgbuf_windisplay(view, fb_dev, -1, 0, 0, xw, yw, winw, winh);
+
+END_FUNC:
+	pthread_mutex_unlock(&pyr->lock);
+	free(xmap);
+	free(ymap);
+
+	return ret;
+}
@@ -0,0 +1,95 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Tiled multi-resolution image(pyramid) for pan and zoom of big pictures.
+
+1. A JPG file is viewed as a pyramid of levels, level 0 is the full
+   resolution, level N is 1/2^N of it.
+2. Each level is divided into fixed size tiles. Tiles are decoded only
+   when they are needed, and kept in an LRU tile cache. The whole
+   picture is never loaded into memory.
+3. Tiles of level 0-3 are decoded by libjpeg DCT scaling(1/1,1/2,1/4,1/8),
+   a band of tiles in the same tile row is decoded at one pass.
+   Tiles of level 4 and up are downsampled from 2x2 tiles of the level
+   below.
+4. egi_imgpyramid_renderView() renders a window of the picture at any
+   zoom, by picking the smallest level that is not smaller than the
+   view resolution.
+
+Note:
+1. With libjpeg-turbo, jpeg_crop_scanline() and jpeg_skip_scanlines()
+   are applied, so only the requested part of a band is decoded.
+2. A progressive JPG is decoded into a whole coefficient buffer by
+   libjpeg, use baseline JPG files for really big pictures.
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#ifndef __EGI_IMGPYRAMID_H__
+#define __EGI_IMGPYRAMID_H__
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "egi_imgbuf.h"
+#include "egi_fbdev.h"
+#include "egi_utils.h"
+
+#define EGI_PYRAMID_TILE_SIZE	128	/* Default tile size */
+#define EGI_PYRAMID_DCT_LEVELS	4	/* Level 0-3 are decoded by libjpeg DCT scaling */
+#define EGI_PYRAMID_LEVELS_MAX	16
+
+typedef struct egi_pyramid_tile	EGI_PYRAMID_TILE;
+struct egi_pyramid_tile {
+	int			level;
+	int			col;
+	int			row;
+	EGI_IMGBUF		*eimg;		/* Tile image, tiles at right/bottom edges may be smaller */
+	EGI_PYRAMID_TILE	*prev;		/* LRU list, lru_head is the most recently used */
+	EGI_PYRAMID_TILE	*next;
+	EGI_PYRAMID_TILE	*hnext;		/* Hash chain */
+};
+
+typedef struct egi_pyramid_level {
+	int	width;				/* Image size at this level */
+	int	height;
+	int	cols;				/* Number of tiles */
+	int	rows;
+} EGI_PYRAMID_LEVEL;
+
+typedef struct egi_imgpyramid {
+	char			fpath[EGI_PATH_MAX];
+	int			width;		/* Full resolution image size */
+	int			height;
+	int			tsize;		/* Tile size */
+	int			nlevels;
+	EGI_PYRAMID_LEVEL	levels[EGI_PYRAMID_LEVELS_MAX];
+
+	/* Tile cache */
+	EGI_PYRAMID_TILE	**htable;
+	unsigned int		hsize;		/* Power of 2 */
+	EGI_PYRAMID_TILE	*lru_head;
+	EGI_PYRAMID_TILE	*lru_tail;
+	int			ntiles;
+	int			max_tiles;
+
+	EGI_IMGBUF		*view;		/* Viewport buffer, reused by egi_imgpyramid_renderView() */
+	EGI_16BIT_COLOR		bkcolor;	/* Color of the view area out of the picture */
+	pthread_mutex_t		lock;
+
+	/* Statistics */
+	unsigned int		hits;
+	unsigned int		misses;
+	unsigned int		decodes;	/* Number of JPG band decodings */
+} EGI_IMGPYRAMID;
+
+
+EGI_IMGPYRAMID*	egi_imgpyramid_open(const char *fpath, int tsize, int max_tiles);
+void		egi_imgpyramid_close(EGI_IMGPYRAMID **pyr);
+int		egi_imgpyramid_pickLevel(const EGI_IMGPYRAMID *pyr, float zoom);
+int		egi_imgpyramid_prefetch(EGI_IMGPYRAMID *pyr, float zoom, int xp, int yp,	/* mutex_lock */
+							int winw, int winh, int margin);
+int		egi_imgpyramid_renderView(EGI_IMGPYRAMID *pyr, FBDEV *fb_dev, float zoom,	/* mutex_lock */
+							int xp, int yp, int xw, int yw, int winw, int winh);
+
+#endif
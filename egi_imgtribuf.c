@@ -0,0 +1,213 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Lock-free triple buffer of EGI_IMGBUFs, see egi_imgtribuf.h
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "egi_imgtribuf.h"
+#include "egi_image.h"
+#include "egi_log.h"
+
+
+/*-----------------------------------------------------
+Create a triple buffer with three images of the same
+size, all pixels are initialized as 0.
+
+@height,width:	Size of the images.
+@alpha_on:	If true, images have alpha data.
+
+Return:
+	Pointer to an EGI_IMGTRIBUF	OK
+	NULL				Fails
+------------------------------------------------------*/
+EGI_IMGTRIBUF* egi_imgtribuf_create(int height, int width, bool alpha_on)
+{
+	EGI_IMGTRIBUF *tribuf;
+	int i;
+
+	if(height<=0 || width<=0)
+		return NULL;
+
+	tribuf=calloc(1, sizeof(EGI_IMGTRIBUF));
+	if(tribuf==NULL) {
+		printf("%s: Fail to calloc tribuf.\n", __func__);
+		return NULL;
+	}
+
+	for(i=0; i<3; i++) {
+		if(alpha_on)
+			tribuf->imgs[i]=egi_imgbuf_create(height, width, 0, 0);
+		else
+			tribuf->imgs[i]=egi_imgbuf_createWithoutAlpha(height, width, 0);
+		if(tribuf->imgs[i]==NULL) {
+			printf("%s: Fail to create imgs[%d].\n", __func__, i);
+			egi_imgtribuf_free(&tribuf);
+			return NULL;
+		}
+	}
+
+	tribuf->back=0;
+	tribuf->mid=1;
+	tribuf->front=2;
+	tribuf->last=-1;
+
+	return tribuf;
+}
+
+
+/*------------------------------------------
+Free a triple buffer, the writer and the
+reader shall both have quit.
+-------------------------------------------*/
+void egi_imgtribuf_free(EGI_IMGTRIBUF **tribuf)
+{
+	int i;
+
+	if(tribuf==NULL || *tribuf==NULL)
+		return;
+
+	for(i=0; i<3; i++)
+		egi_imgbuf_free((*tribuf)->imgs[i]);
+
+	free(*tribuf);
+	*tribuf=NULL;
+}
+
+
+/*-------------------------------------------------------------
+Get the back image to write a new frame. Writer side ONLY.
+
+@tribuf:	An EGI_IMGTRIBUF.
+@keep:		If true, the frame published last is copied to the
+		back image first, for producers which only update
+		part of the frame(such as GIF canvas). If false,
+		content of the back image is undefined.
+
+Return:
+	Pointer to the back image	OK
+	NULL				Fails
+--------------------------------------------------------------*/
+EGI_IMGBUF* egi_imgtribuf_writeBuffer(EGI_IMGTRIBUF *tribuf, bool keep)
+{
+	EGI_IMGBUF *bimg;
+	EGI_IMGBUF *limg;
+
+	if(tribuf==NULL)
+		return NULL;
+
+	bimg=tribuf->imgs[tribuf->back];
+
+	/* The last published image is read only, for both the writer and the reader */
+	if(keep && tribuf->last>=0) {
+		limg=tribuf->imgs[tribuf->last];
+		memcpy(bimg->imgbuf, limg->imgbuf, bimg->height*bimg->width*sizeof(EGI_16BIT_COLOR));
+		if(bimg->alpha)
+			memcpy(bimg->alpha, limg->alpha, bimg->height*bimg->width);
+	}
+
+	/* alpha data will be changed */
+	egi_imgbuf_freeAlphaRLE(bimg);
+
+	return bimg;
+}
+
+
+/*-------------------------------------------------------------
+Publish the back image as the latest frame. Writer side ONLY.
+The old middle image becomes the new back image.
+--------------------------------------------------------------*/
+void egi_imgtribuf_publish(EGI_IMGTRIBUF *tribuf)
+{
+	unsigned int old;
+
+	if(tribuf==NULL)
+		return;
+
+	old=__atomic_exchange_n(&tribuf->mid, tribuf->back|EGI_TRIBUF_FRESH, __ATOMIC_ACQ_REL);
+	if(old & EGI_TRIBUF_FRESH)
+		__atomic_add_fetch(&tribuf->drops, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&tribuf->frames, 1, __ATOMIC_RELAXED);
+
+	tribuf->last=tribuf->back;
+	tribuf->back=old & ~EGI_TRIBUF_FRESH;
+}
+
+
+/*-------------------------------------------------------------
+Copy an image to the back image and publish it. Writer side ONLY.
+The caller shall keep eimg unchanged during the call, img_mutex
+of eimg is NOT locked here.
+
+@tribuf:	An EGI_IMGTRIBUF.
+@eimg:		An image of the same size as the triple buffer.
+
+Return:
+	0	OK
+	<0	Fails
+--------------------------------------------------------------*/
+int egi_imgtribuf_publishCopy(EGI_IMGTRIBUF *tribuf, const EGI_IMGBUF *eimg)
+{
+	EGI_IMGBUF *bimg;
+
+	if(tribuf==NULL || eimg==NULL || eimg->imgbuf==NULL)
+		return -1;
+
+	bimg=egi_imgtribuf_writeBuffer(tribuf, false);
+	if( bimg->width!=eimg->width || bimg->height!=eimg->height ) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Image size %dx%d mismatches with tribuf %dx%d.",
+				__func__, eimg->width, eimg->height, bimg->width, bimg->height);
+		return -2;
+	}
+
+	memcpy(bimg->imgbuf, eimg->imgbuf, bimg->height*bimg->width*sizeof(EGI_16BIT_COLOR));
+	if(bimg->alpha) {
+		if(eimg->alpha)
+			memcpy(bimg->alpha, eimg->alpha, bimg->height*bimg->width);
+		else
+			memset(bimg->alpha, 255, bimg->height*bimg->width);
+	}
+
+	egi_imgtribuf_publish(tribuf);
+
+	return 0;
+}
+
+
+/*-------------------------------------------------------------
+Get the latest published frame. Reader side ONLY.
+The returned image is valid until next call, and it shall NOT
+be modified by the reader.
+
+@tribuf:	An EGI_IMGTRIBUF.
+@fresh:		To pass out whether a new frame is published since
+		last call, or NULL.
+
+Return:
+	Pointer to the front image	OK
+	NULL				Fails
+--------------------------------------------------------------*/
+EGI_IMGBUF* egi_imgtribuf_readLatest(EGI_IMGTRIBUF *tribuf, bool *fresh)
+{
+	unsigned int old;
+	bool is_fresh=false;
+
+	if(tribuf==NULL)
+		return NULL;
+
+	if( __atomic_load_n(&tribuf->mid, __ATOMIC_ACQUIRE) & EGI_TRIBUF_FRESH ) {
+		old=__atomic_exchange_n(&tribuf->mid, tribuf->front, __ATOMIC_ACQ_REL);
+		tribuf->front=old & ~EGI_TRIBUF_FRESH;
+		is_fresh=true;
+	}
+
+	if(fresh)
+		*fresh=is_fresh;
+
+	return tribuf->imgs[tribuf->front];
+}
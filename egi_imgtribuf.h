@@ -0,0 +1,64 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Lock-free triple buffer of EGI_IMGBUFs, to hand frames from one
+producer thread(GIF decoder, video decoder, camera...) to one display
+thread without mutex and tearing.
+
+1. Three images of the same size are held: the back image belongs to
+   the writer, the front image belongs to the reader, and the middle
+   one is shared by exchanging its index atomically.
+2. The writer fills the back image and publishes it, then the old middle
+   image becomes the new back image. The writer never waits.
+3. The reader gets the latest published image, it never sees a half
+   updated frame and never waits. Frames published between two reads
+   are dropped, and counted in 'drops'.
+4. img_mutex of the three images is NOT used.
+
+Example:
+	// Writer thread
+	eimg=egi_imgtribuf_writeBuffer(tribuf, true);
+	... update eimg ...
+	egi_imgtribuf_publish(tribuf);
+
+	// Reader thread
+	eimg=egi_imgtribuf_readLatest(tribuf, &fresh);
+	if(fresh)
+		egi_imgbuf_windisplay(eimg, ...);
+
+Note:
+1. For ONE writer and ONE reader only.
+2. GCC __atomic builtins are applied(gcc 4.7+).
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#ifndef __EGI_IMGTRIBUF_H__
+#define __EGI_IMGTRIBUF_H__
+
+#include <stdbool.h>
+#include "egi_imgbuf.h"
+
+#define EGI_TRIBUF_FRESH	0x4	/* Flag in mid: the middle image is published and NOT read yet */
+
+typedef struct egi_imgtribuf {
+	EGI_IMGBUF	*imgs[3];
+	int		back;		/* Index of the writer's image */
+	int		front;		/* Index of the reader's image */
+	int		last;		/* Index of the image published last, <0 if none */
+	unsigned int	mid;		/* Index of the middle image | EGI_TRIBUF_FRESH, accessed atomically */
+
+	/* Statistics, accessed atomically */
+	unsigned int	frames;		/* Number of published frames */
+	unsigned int	drops;		/* Number of frames overwritten before being read */
+} EGI_IMGTRIBUF;
+
+EGI_IMGTRIBUF*	egi_imgtribuf_create(int height, int width, bool alpha_on);
+void		egi_imgtribuf_free(EGI_IMGTRIBUF **tribuf);
+EGI_IMGBUF*	egi_imgtribuf_writeBuffer(EGI_IMGTRIBUF *tribuf, bool keep);
+void		egi_imgtribuf_publish(EGI_IMGTRIBUF *tribuf);
+int		egi_imgtribuf_publishCopy(EGI_IMGTRIBUF *tribuf, const EGI_IMGBUF *eimg);
+EGI_IMGBUF*	egi_imgtribuf_readLatest(EGI_IMGTRIBUF *tribuf, bool *fresh);
+
+#endif
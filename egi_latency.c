@@ -0,0 +1,401 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Touch-to-photon latency instrumentation, see egi_latency.h
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "egi_latency.h"
+#include "egi_shmem.h"
+#include "egi_log.h"
+
+static const char *str_lat_stage[]=
+{
+	"dispatch", "reaction", "render", "total",
+};
+
+static bool		lat_enabled;		/* Accessed atomically */
+static EGI_LATENCY	lat_local;		/* If not in shared memory */
+static EGI_LATENCY	*lat=&lat_local;
+static EGI_SHMEM	lat_shm;		/* Shared memory by egi_lat_enable() */
+static EGI_SHMEM	lat_shm_attached;	/* Shared memory by egi_lat_attach() */
+static pthread_mutex_t	lat_mutex=PTHREAD_MUTEX_INITIALIZER;
+
+/* The touch being traced */
+static bool		lat_pending;		/* A touch is dispatched */
+static bool		lat_armed;		/* Its reaction returned, waiting for a frame */
+static bool		lat_reacting;		/* In reaction() */
+static long long	lat_touch_us;		/* When the touch is read */
+static long long	lat_react_us;		/* When reaction() begins */
+static long long	lat_react_end_us;	/* When reaction() of the traced touch returns */
+
+static long long lat_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000000LL+ts.tv_nsec/1000;
+}
+
+/* Map shared memory of name, EGI_LATENCY is put after EGI_SHMEM.msg_data */
+static EGI_LATENCY *lat_shm_map(EGI_SHMEM *shm, const char *shm_name)
+{
+	memset(shm, 0, sizeof(EGI_SHMEM));
+	shm->shm_name=shm_name;
+	shm->offset=(sizeof(*shm->msg_data)+7)&~7;
+	shm->shm_size=shm->offset+sizeof(EGI_LATENCY);
+	if( egi_shmem_open(shm)!=0 ) {
+		printf("%s: Fail to open shared memory '%s'.\n",__func__, shm_name);
+		return NULL;
+	}
+
+	return (EGI_LATENCY *)(shm->shm_map+shm->offset);
+}
+
+
+/*---------------------------------------------------------------
+Enable latency tracing, histograms are reset.
+
+@shm_name:	Name of a POSIX shared memory to keep histograms,
+		as "/egi_latency". If NULL, they are kept in the
+		process.
+Return:
+	0	OK
+	<0	Fails
+----------------------------------------------------------------*/
+int egi_lat_enable(const char *shm_name)
+{
+	EGI_LATENCY *shmlat;
+
+	egi_lat_disable();
+
+	if(shm_name!=NULL) {
+		shmlat=lat_shm_map(&lat_shm, shm_name);
+		if(shmlat==NULL)
+			return -1;
+		lat=shmlat;
+	}
+
+	egi_lat_reset();
+	__atomic_store_n(&lat_enabled, true, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+
+/*--------------------------------------------------------
+Disable latency tracing, and unmap the shared memory, the
+shared memory is NOT removed, see egi_shmem_remove().
+--------------------------------------------------------*/
+void egi_lat_disable(void)
+{
+	__atomic_store_n(&lat_enabled, false, __ATOMIC_RELEASE);
+
+	pthread_mutex_lock(&lat_mutex);
+	if(lat!=&lat_local) {
+		egi_shmem_close(&lat_shm);
+		lat=&lat_local;
+	}
+	lat_pending=false;
+	lat_armed=false;
+	lat_reacting=false;
+	pthread_mutex_unlock(&lat_mutex);
+}
+
+
+/*---------------------------------------------
+Return histograms of this process.
+---------------------------------------------*/
+EGI_LATENCY* egi_lat_data(void)
+{
+	return lat;
+}
+
+
+/*--------------------------------------------------------------
+Attach to histograms in shared memory, written by the process
+which calls egi_lat_enable(shm_name). One attachment only for a
+process, a new call unmaps the last one.
+
+Return:
+	Pointer to EGI_LATENCY	OK
+	NULL			Fails, or the writer hasn't started.
+---------------------------------------------------------------*/
+EGI_LATENCY* egi_lat_attach(const char *shm_name)
+{
+	EGI_LATENCY *shmlat;
+
+	if(shm_name==NULL)
+		return NULL;
+
+	if(lat_shm_attached.shm_map!=NULL)
+		egi_shmem_close(&lat_shm_attached);
+
+	shmlat=lat_shm_map(&lat_shm_attached, shm_name);
+	if(shmlat==NULL)
+		return NULL;
+	if( memcmp(shmlat->magic, EGI_LAT_MAGIC, sizeof(shmlat->magic))!=0 ) {
+		printf("%s: No latency data in '%s'.\n",__func__, shm_name);
+		egi_shmem_close(&lat_shm_attached);
+		return NULL;
+	}
+
+	return shmlat;
+}
+
+
+/*----------------------------
+Clear all histograms.
+----------------------------*/
+void egi_lat_reset(void)
+{
+	pthread_mutex_lock(&lat_mutex);
+	memset(lat, 0, sizeof(EGI_LATENCY));
+	memcpy(lat->magic, EGI_LAT_MAGIC, sizeof(lat->magic));
+	lat_pending=false;
+	lat_armed=false;
+	pthread_mutex_unlock(&lat_mutex);
+}
+
+
+/*--------------------------------------------------------------
+The page routine dispatches a touch data.
+
+@ts:	When the touch data is read, EGI_TOUCH_DATA.ts. If it's
+	zero, the dispatch time is applied.
+--------------------------------------------------------------*/
+void egi_lat_touch(const struct timespec *ts)
+{
+	long long now, us;
+
+	if( !__atomic_load_n(&lat_enabled, __ATOMIC_ACQUIRE) )
+		return;
+
+	now=lat_now_us();
+	us= (ts==NULL || (ts->tv_sec==0 && ts->tv_nsec==0)) ? now : ts->tv_sec*1000000LL+ts->tv_nsec/1000;
+
+	pthread_mutex_lock(&lat_mutex);
+	egi_lat_record(&lat->hists[lat_dispatch], now-us);
+
+	/* Keep the oldest touch waiting for a frame */
+	if(lat_pending && lat_armed) {
+		lat->superseded++;
+	}
+	else {
+		lat_pending=true;
+		lat_armed=false;
+		lat_touch_us=us;
+	}
+	pthread_mutex_unlock(&lat_mutex);
+}
+
+
+/*-----------------------------------------
+Reaction of the dispatched touch begins.
+-----------------------------------------*/
+void egi_lat_react_begin(void)
+{
+	if( !__atomic_load_n(&lat_enabled, __ATOMIC_ACQUIRE) )
+		return;
+
+	pthread_mutex_lock(&lat_mutex);
+	if(lat_pending) {
+		lat_reacting=true;
+		lat_react_us=lat_now_us();
+	}
+	pthread_mutex_unlock(&lat_mutex);
+}
+
+
+/*------------------------------------------------------
+Reaction of the dispatched touch returns, then the next
+frame completes the trace.
+------------------------------------------------------*/
+void egi_lat_react_end(void)
+{
+	long long now;
+
+	if( !__atomic_load_n(&lat_enabled, __ATOMIC_ACQUIRE) )
+		return;
+
+	pthread_mutex_lock(&lat_mutex);
+	if(lat_reacting) {
+		now=lat_now_us();
+		egi_lat_record(&lat->hists[lat_reaction], now-lat_react_us);
+		lat_reacting=false;
+		if(lat_pending && !lat_armed) {
+			lat_armed=true;
+			lat_react_end_us=now;
+		}
+	}
+	pthread_mutex_unlock(&lat_mutex);
+}
+
+
+/*-------------------------------------------------------
+A frame reaches FB, called by fb_page_refresh() etc.
+-------------------------------------------------------*/
+void egi_lat_frame(void)
+{
+	long long now;
+
+	if( !__atomic_load_n(&lat_enabled, __ATOMIC_ACQUIRE) )
+		return;
+
+	pthread_mutex_lock(&lat_mutex);
+	if(lat_pending && lat_armed) {
+		now=lat_now_us();
+		egi_lat_record(&lat->hists[lat_render], now-lat_react_end_us);
+		egi_lat_record(&lat->hists[lat_total], now-lat_touch_us);
+		lat_pending=false;
+		lat_armed=false;
+	}
+	pthread_mutex_unlock(&lat_mutex);
+}
+
+
+/* Bucket index of a value in us */
+static int lat_bucket(unsigned long long us)
+{
+	int msb;
+	int idx;
+
+	if( us < (1<<EGI_LAT_SUBBITS) )
+		return us;
+
+	msb=63-__builtin_clzll(us);
+	idx=((msb-EGI_LAT_SUBBITS+1)<<EGI_LAT_SUBBITS) + ((us>>(msb-EGI_LAT_SUBBITS))&((1<<EGI_LAT_SUBBITS)-1));
+
+	return idx<EGI_LAT_BUCKETS ? idx : EGI_LAT_BUCKETS-1;
+}
+
+/* Lower bound of a bucket in us */
+static unsigned long long lat_bucket_low(int idx)
+{
+	int msb;
+
+	if( idx < (1<<EGI_LAT_SUBBITS) )
+		return idx;
+
+	msb=(idx>>EGI_LAT_SUBBITS)+EGI_LAT_SUBBITS-1;
+	return (unsigned long long)((1<<EGI_LAT_SUBBITS)+(idx&((1<<EGI_LAT_SUBBITS)-1))) << (msb-EGI_LAT_SUBBITS);
+}
+
+
+/*-------------------------------------------
+Record a latency value in a histogram.
+Negative values are recorded as 0.
+-------------------------------------------*/
+void egi_lat_record(EGI_LAT_HIST *hist, long long us)
+{
+	if(hist==NULL)
+		return;
+	if(us<0)
+		us=0;
+
+	hist->count++;
+	hist->sum_us += us;
+	if(us > hist->max_us)
+		hist->max_us = us>0xFFFFFFFFLL ? 0xFFFFFFFF : us;
+	hist->buckets[lat_bucket(us)]++;
+}
+
+
+/*-------------------------------------------------------------
+Get a percentile of a histogram, as the upper bound of the
+bucket it falls in, but not more than the max. value.
+
+@pct:	Percentage, 0-100.
+
+Return:
+	Latency in us.
+-------------------------------------------------------------*/
+unsigned int egi_lat_percentile(const EGI_LAT_HIST *hist, float pct)
+{
+	unsigned long long high;
+	unsigned int n=0;
+	unsigned int rank;
+	int i;
+
+	if(hist==NULL || hist->count==0)
+		return 0;
+
+	rank=hist->count*pct/100.0+0.5;
+	if(rank<1)
+		rank=1;
+	for(i=0; i<EGI_LAT_BUCKETS-1; i++) {
+		n+=hist->buckets[i];
+		if(n>=rank)
+			break;
+	}
+
+	high=lat_bucket_low(i+1)-1;
+
+	return high < hist->max_us ? high : hist->max_us;
+}
+
+
+/*---------------------------------------------------------------
+Print a summary of latency histograms, and log percentiles of
+the total in EGI log.
+---------------------------------------------------------------*/
+void egi_lat_summary(const EGI_LATENCY *data)
+{
+	const EGI_LAT_HIST *hist;
+	char bar[41];
+	unsigned int peak;
+	int i,k;
+
+	if(data==NULL)
+		return;
+
+	printf("------ Touch-to-photon latency in ms, %u touches superseded ------\n", data->superseded);
+	printf("%-8s %7s %8s %8s %8s %8s %8s\n", "stage", "n", "avg", "p50", "p90", "p99", "max");
+	for(k=0; k<EGI_LAT_STAGES; k++) {
+		hist=&data->hists[k];
+		printf("%-8s %7u %8.2f %8.2f %8.2f %8.2f %8.2f\n", str_lat_stage[k], hist->count,
+			hist->count ? hist->sum_us/1000.0/hist->count : 0.0,
+			egi_lat_percentile(hist, 50)/1000.0, egi_lat_percentile(hist, 90)/1000.0,
+			egi_lat_percentile(hist, 99)/1000.0, hist->max_us/1000.0);
+	}
+	hist=&data->hists[lat_total];
+	EGI_PLOG(LOGLV_INFO, "touch-to-photon latency: n=%u p50=%uus p90=%uus p99=%uus max=%uus",
+			hist->count, egi_lat_percentile(hist, 50), egi_lat_percentile(hist, 90),
+			egi_lat_percentile(hist, 99), hist->max_us);
+
+	/* Histogram of the total */
+	for(peak=0, i=0; i<EGI_LAT_BUCKETS; i++) {
+		if(hist->buckets[i]>peak)
+			peak=hist->buckets[i];
+	}
+	if(peak==0)
+		return;
+	printf("total:\n");
+	for(i=0; i<EGI_LAT_BUCKETS; i++) {
+		if(hist->buckets[i]==0)
+			continue;
+		k=(hist->buckets[i]*40+peak-1)/peak;
+		memset(bar, '#', k);
+		bar[k]='\0';
+		printf("  >=%8.2f %6u %s\n", lat_bucket_low(i)/1000.0, hist->buckets[i], bar);
+	}
+}
+
+
+/*------------------------------
+Return name of a stage.
+------------------------------*/
+const char* egi_str_lat_stage(enum egi_lat_stage stage)
+{
+	if( stage<lat_dispatch || stage>=EGI_LAT_STAGES )
+		return "unknown";
+
+	return str_lat_stage[stage];
+}
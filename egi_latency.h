@@ -0,0 +1,89 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Touch-to-photon latency instrumentation.
+
+1. A touch data is stamped with CLOCK_MONOTONIC when it's read, see
+   EGI_TOUCH_DATA.ts. egi_page_routine() calls egi_lat_touch() when it
+   dispatches the touch data, and egi_lat_react_begin()/end() around
+   the ebox reaction() or the gesture handler. fb_page_refresh() and
+   fb_render() call egi_lat_frame() when pixels reach the FB, so does
+   egi_page_refresh() in direct FB mode.
+2. Stages recorded for a touch:
+	lat_dispatch	Touch read -> dispatched by the page routine.
+	lat_reaction	reaction() runs.
+	lat_render	reaction() returns -> next frame in FB.
+	lat_total	Touch read -> next frame in FB.
+   Only touches which trigger a reaction are traced to a frame. If more
+   touches react before a frame, the oldest one is traced, and others
+   are counted in 'superseded'.
+3. Histograms are log-linear, 4 buckets per power of 2 in us, so
+   percentiles are within 25%. They are kept in a POSIX shared memory
+   if a name is given to egi_lat_enable(), and another process may read
+   it with egi_lat_attach(), or printed and logged by egi_lat_summary().
+4. All egi_lat_*() calls are cheap no-ops until egi_lat_enable().
+
+Example:
+	egi_lat_enable("/egi_latency");
+	... run pages ...
+	egi_lat_summary(egi_lat_data());
+
+	// In another process
+	lat=egi_lat_attach("/egi_latency");
+	egi_lat_summary(lat);
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#ifndef __EGI_LATENCY_H__
+#define __EGI_LATENCY_H__
+
+#include <stdbool.h>
+#include <time.h>
+
+#define EGI_LAT_MAGIC		"EGILATNC"
+#define EGI_LAT_SUBBITS		2				/* 2^SUBBITS buckets per power of 2 */
+#define EGI_LAT_BUCKETS		(24<<EGI_LAT_SUBBITS)		/* Up to 2^24us, 16s */
+
+enum egi_lat_stage
+{
+	lat_dispatch=0,
+	lat_reaction,
+	lat_render,
+	lat_total,
+	EGI_LAT_STAGES,
+};
+
+typedef struct egi_lat_hist {
+	unsigned int		count;
+	unsigned int		max_us;
+	unsigned long long	sum_us;
+	unsigned int		buckets[EGI_LAT_BUCKETS];
+} EGI_LAT_HIST;
+
+typedef struct egi_latency	EGI_LATENCY;
+struct egi_latency
+{
+	char		magic[8];		/* EGI_LAT_MAGIC, set after init */
+	unsigned int	superseded;		/* Touches not traced, see 2. above */
+	EGI_LAT_HIST	hists[EGI_LAT_STAGES];
+};
+
+int		egi_lat_enable(const char *shm_name);
+void		egi_lat_disable(void);
+EGI_LATENCY*	egi_lat_data(void);
+EGI_LATENCY*	egi_lat_attach(const char *shm_name);
+void		egi_lat_reset(void);
+
+void		egi_lat_touch(const struct timespec *ts);
+void		egi_lat_react_begin(void);
+void		egi_lat_react_end(void);
+void		egi_lat_frame(void);
+
+void		egi_lat_record(EGI_LAT_HIST *hist, long long us);
+unsigned int	egi_lat_percentile(const EGI_LAT_HIST *hist, float pct);
+void		egi_lat_summary(const EGI_LATENCY *data);
+const char*	egi_str_lat_stage(enum egi_lat_stage stage);
+
+#endif
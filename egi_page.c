@@ -9,6 +9,9 @@ Midas Zhou
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
 #include "sys_list.h"
 #include "xpt2046.h"
 #include "egi.h"
@@ -19,6 +22,10 @@ Midas Zhou
 #include "egi_symbol.h"
 #include "egi_bjp.h"
 #include "egi_touch.h"
+#include "egi_gesture.h"
+#include "egi_latency.h"
+#include "egi_evloop.h"
+#include "egi_scene.h"
 #include "egi_log.h"
 
 
@@ -84,6 +91,17 @@ EGI_PAGE * egi_page_new(char *tag)
 		return NULL;
 	}
 
+	/* 10. event loop for the page routine */
+	page->evloop=egi_evloop_new();
+	if(page->evloop==NULL) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to create page.evloop!", __func__ );
+		pthread_mutex_destroy(&page->pgmutex);
+		egi_ebox_free(page->ebox);
+		free(page);
+		return NULL;
+	}
+	page->idle_ms=EGI_PAGE_IDLEMS;
+
 
 	return page;
 }
@@ -146,6 +164,9 @@ int egi_page_free(EGI_PAGE *page)
 		EGI_PLOG(LOGLV_ERROR, "%s: Fail to destroy PAGE.pgmutex!", __func__ );
 	}
 
+	/* free event loop, after runners are joined */
+	egi_evloop_free(&page->evloop);
+
 	/*  free every child in list */
 	if(!list_empty(&page->list_head))
 	{
@@ -156,6 +177,7 @@ int egi_page_free(EGI_PAGE *page)
 			EGI_PDEBUG(DBG_PAGE,"ebox '%s' is unlisted from page '%s' and freed.\n"
 									,ebox->tag,page->ebox->tag);
                 	list_del(tnode);
+			egi_scene_free_children(ebox);
                 	ebox->free(ebox);
         	}
 	}
@@ -385,8 +407,8 @@ int egi_page_addlist(EGI_PAGE *page, EGI_EBOX *ebox)
 	/* set ebox->container */
 	ebox->container=page;
 
-	/* add to list tail */
-	list_add_tail(&ebox->node, &page->list_head);
+	/* add to list tail, behind eboxes of a bigger z */
+	egi_scene_insert(&page->list_head, ebox);
 	EGI_PDEBUG(DBG_PAGE,"ebox '%s' is added to page '%s' \n",
 								ebox->tag, page->ebox->tag);
 
@@ -563,6 +585,9 @@ int egi_page_activate(EGI_PAGE *page)
    3.3.3 To call egi_ebox_forcerefresh() is seemed as dangerous,
          for it refreshs itself and ingnores its PAGE image coordination.
 
+4. For a PAGE in retained mode, only the damage is redrawn by
+   egi_scene_render(), see egi_scene.h.
+
 Return:
 	1	need_refresh=false
 	0	If any ebox has been refreshed.
@@ -590,6 +615,12 @@ int egi_page_refresh(EGI_PAGE *page)
                 return -1;
         }
 
+	/* A retained scene redraws its damage only, see egi_scene.h */
+	if(page->retained) {
+		ret=egi_scene_render(page);
+		goto END_FUNC;
+	}
+
 	/* --------------- ***** 1. FOR 'PAGE' REFRESH, wallpaper etc. ***** ------------ */
 	/* only if need_refresh */
 	if(page->ebox->need_refresh)
@@ -677,7 +708,8 @@ int egi_page_refresh(EGI_PAGE *page)
 	if(list_empty(&page->list_head))
 	{
 		printf("egi_page_refresh(): page '%s' has an empty list_head .\n",page->ebox->tag);
-		return -1*ret;
+		ret=-1*ret;
+		goto END_FUNC;
 	}
 
 	/* traverse the list and activate list eboxes, not safe */
@@ -716,12 +748,17 @@ int egi_page_refresh(EGI_PAGE *page)
 	/* reset need_refresh at last */
 //	page->ebox->need_refresh=false;
 
+END_FUNC:
 	/* reset page_update, synchronized with page->ebox->need_refresh currently. */
 	page->page_update=false;
 
 	/* put PAGE.pgmutex */
         pthread_mutex_unlock(&page->pgmutex);
 
+	/* In direct FB mode, pixels are already in FB */
+	if( ret==0 && (gv_fb_dev.map_bk==NULL || gv_fb_dev.map_bk==gv_fb_dev.map_fb) )
+		egi_lat_frame();
+
 	return ret; /* if any ebox refreshed, return 0 */
 }
 
@@ -759,6 +796,8 @@ int egi_page_flag_needrefresh(EGI_PAGE *page)
 	/* put PAGE.pgmutex */
         pthread_mutex_unlock(&page->pgmutex);
 
+	egi_page_wakeup(page);
+
 	return 0;
 }
 
@@ -810,11 +849,32 @@ int egi_page_needrefresh(EGI_PAGE *page)
 	/* 6.put PAGE.pgmutex */
         pthread_mutex_unlock(&page->pgmutex);
 
+	egi_page_wakeup(page);
 
 	return 0;
 }
 
 
+/*-------------------------------------------------------------
+Wake up egi_page_routine() to refresh the page at next frame.
+Call it in runners after setting need_refresh of eboxes, it's
+safe in any thread.
+
+return:
+	0	OK
+	<0	fails
+--------------------------------------------------------------*/
+int egi_page_wakeup(EGI_PAGE *page)
+{
+	if(page==NULL || page->evloop==NULL)
+		return -1;
+
+	__atomic_store_n(&page->dirty, true, __ATOMIC_RELEASE);
+
+	return egi_evloop_wakeup(page->evloop);
+}
+
+
 /*--------------------------------------------------------
 pick a btn or slider pointer by its type and id number
 
@@ -972,165 +1032,167 @@ int egi_page_start_runners(EGI_PAGE *page)
 }
 
 
-/*-------------------------------------------
-Default page routine job ,No sliding handling
-
-return:
-	loop or >=0  	OK
-	<0		fails
--------------------------------------------*/
-int egi_page_routine(EGI_PAGE *page)
+/* State of egi_page_routine() */
+typedef struct egi_page_loop {
+	EGI_PAGE		*page;
+	EGI_GESTURE_TRACKER	gtracker;
+	EGI_EBOX		*last_holdbtn;	/* remember last hold btn */
+	bool			wait_press;	/* Discard touch data till a new 'pressing' */
+	int			touch_fd;	/* Touch eventfd, or a timer to poll touch data */
+	int			poll_ms;	/* Interval of polling touch data, if touch_fd is a timer */
+	enum egi_touch_status	last_status;	/* Status of the last touch data read, for the polling rate */
+	int			idle_tfd;	/* Timer to check need_refresh, see EGI_PAGE.idle_ms */
+	int			frame_tfd;	/* One-shot timer for the next frame */
+	bool			frame_pending;	/* frame_tfd is armed */
+	struct timespec		frame_ts;	/* Time of the last frame */
+} EGI_PAGE_LOOP;
+
+/*---------------------------------------------------
+Refresh the page for a frame, by egi_page_routine().
+---------------------------------------------------*/
+static void page_loop_frame(EGI_PAGE_LOOP *pl)
 {
-//	int i;
-	int ret;
-	uint16_t sx,sy;
-	enum egi_touch_status last_status=released_hold;
-	EGI_TOUCH_DATA touch_data;
-
-	/* delay a while, to avoid touch-jittering ???? necessary ??????? */
-	tm_delayms(200);
-
-	/* for time struct */
-//	struct timeval t_start,t_end; /* record two pressing_down time */
-//	long tus;
+	pl->frame_pending=false;
+	clock_gettime(CLOCK_MONOTONIC, &pl->frame_ts);
+	egi_page_refresh(pl->page);
+}
 
-	EGI_EBOX  *hitbtn; /* hit button_ebox */
-	EGI_EBOX  *last_holdbtn=NULL; /* remember last hold btn */
+/*---------------------------------------------------------------
+Request a frame, by egi_page_routine(). The page is refreshed at
+once if the last frame is EGI_PAGE_FRAMEMS ago, or when the frame
+timer expires, so requests in a frame are coalesced into one.
+----------------------------------------------------------------*/
+static void page_loop_request_frame(EGI_PAGE_LOOP *pl)
+{
+	struct timespec ts;
+	long ms;
+
+	if(pl->frame_pending)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ms=(ts.tv_sec-pl->frame_ts.tv_sec)*1000+(ts.tv_nsec-pl->frame_ts.tv_nsec)/1000000;
+	if( ms>=EGI_PAGE_FRAMEMS || egi_evloop_set_timer(pl->page->evloop, pl->frame_tfd, EGI_PAGE_FRAMEMS-ms, false)!=0 )
+		page_loop_frame(pl);
+	else
+		pl->frame_pending=true;
+}
 
-	/* 1. check data */
-	EGI_PDEBUG(DBG_PAGE,"start to check data for page.\n");
-	if(page==NULL || page->ebox==NULL)
-	{
-		printf("egi_page_routine(): input page OR page->ebox  is NULL!\n");
-		return -1;
-	}
+/* Timer handlers of egi_page_routine() */
+static int page_loop_frame_handler(EGI_EVLOOP *evloop, int fd, void *arg)
+{
+	page_loop_frame(arg);
+	return 0;
+}
 
-	/* 2. check list */
-	EGI_PDEBUG(DBG_PAGE,"start to check ebox list for page.\n");
-	if(list_empty(&page->list_head))
-	{
-		printf("egi_page_routine(): WARNING!!! page '%s' has an empty ebox list_head .\n",page->ebox->tag);
-	}
+static int page_loop_idle_handler(EGI_EVLOOP *evloop, int fd, void *arg)
+{
+	page_loop_request_frame(arg);
+	return 0;
+}
 
-	EGI_PDEBUG(DBG_PAGE,"--------------- get into [PAGE %s]'s loop routine -------------\n",page->ebox->tag);
+/*---------------------------------------------------------------
+Dispatch touch data to the gesture handler and buttons of a page,
+by egi_page_routine().
 
-	/* 3. Start page runners */
-	if( egi_page_start_runners(page) !=0 ) {
-		EGI_PLOG(LOGLV_ERROR, "%s: Fail to launch page runners!",__func__ );
-		return -2;
-	}
+Return:
+	btnret_REQUEST_EXIT_PAGE	To exit the page
+	0				OK
+----------------------------------------------------------------*/
+static int page_loop_dispatch(EGI_PAGE_LOOP *pl, EGI_TOUCH_DATA *touch_data)
+{
+	EGI_PAGE *page=pl->page;
+	enum egi_touch_status last_status=touch_data->status;
+	uint16_t sx=touch_data->coord.x;
+	uint16_t sy=touch_data->coord.y;
+	EGI_GESTURE gestures[EGI_GESTURE_MAXOUT];
+	bool gesture_drag;
+	EGI_EBOX  *hitbtn; /* hit button_ebox */
+	int ret;
+	int i,n;
 
-#if 0  //////////////////    Replaced by egi_page_start_runners()    ///////////////////
-	/* 3. load page runner threads */
-	EGI_PDEBUG(DBG_PAGE,"start to load PAGE [%s]'s runner...\n",page->ebox->tag);
-	for(i=0;i<EGI_PAGE_MAXTHREADS;i++)
+	/* 1. recognize gestures and pass them to the gesture handler.
+	 * Buttons are NOT triggered during a drag, as PAGE sliding in egi_homepage_routine().
+	 */
+	gesture_drag=false;
+	if(page->gesture_handler != NULL)
 	{
-		if( page->runner[i] !=0 )
-		{
-			/* launch Runners in order */
-			EGI_PDEBUG(DBG_PAGE,"Start creating runner: pthreadID[%d]=%u ...\n",
-								i,(unsigned int)page->threadID[i] );
-			if( pthread_create( &page->threadID[i],NULL,(void *)page->runner[i],(void *)page)==0)
-			{
-				page->thread_running[i]=true;
-				printf("%s: Create runner pthreadID[%d]=%u successfully. \n", __func__,
-								i, (unsigned int)page->threadID[i] );
-			}
-			else {
-			      EGI_PLOG(LOGLV_ERROR,"%s: Fail to create pthread for runner[%d] of page[%s].", __func__,
-					i, page->ebox->tag );
-			      /* carry on anyway..... */
+		n=egi_gesture_feed(&pl->gtracker, touch_data, gestures, EGI_GESTURE_MAXOUT);
+		for(i=0; i<n; i++) {
+			if(gestures[i].type==gesture_drag_end)
+				gesture_drag=true;
+			egi_lat_react_begin();
+			ret=page->gesture_handler(page, &gestures[i]);
+			egi_lat_react_end();
+			if( ret==btnret_REQUEST_EXIT_PAGE ) {
+				printf("[page '%s'] gesture '%s' ret: request to exit the page.\n",
+							page->ebox->tag, egi_str_gesture(gestures[i].type));
+				return btnret_REQUEST_EXIT_PAGE;
 			}
 		}
+		if(pl->gtracker.dragging || gesture_drag)
+			return 0;
 	}
-	/* Initiate thread mutex locks, NOTE: also for egi_pagehome_routine() */
-	EGI_PDEBUG(DBG_PAGE,"Start to initiate thread mutex lock for page runners.\n");
-	if(pthread_mutex_init(&page->runner_mutex,NULL) !=0 ) {
-		EGI_PLOG(LOGLV_ERROR, "%s: Fail to call pthread_mutex_init()!", __func__ );
-		return -1;
-	}
-	if(pthread_cond_init(&page->runner_cond,NULL) !=0 ) {
-		EGI_PLOG(LOGLV_ERROR, "%s: Fail to call pthread_cond_init()!", __func__ );
-		return -1;
-	}
-#endif ////////////////////////////////////////////////////////////////////////////////////
 
- 	/* ----------------    Touch Event Handling   ----------------  */
-	EGI_PDEBUG(DBG_PAGE,"Now trap into touch event handling loop...\n");
-
-	/* Try to discard first obsolete data, just to inform egi_touch_loopread() to start loop_read */
-	egi_touch_getdata(&touch_data);
+	/* 2. trigger touch handling process then */
+	if(last_status==released_hold)
+		return 0;
+
+	EGI_PDEBUG(DBG_PAGE,"last_status=%d \n",last_status);
+	/* check if any ebox was hit */
+        hitbtn=egi_hit_pagebox(sx, sy, page, type_btn|type_slider);
+
+	EGI_PDEBUG(DBG_PAGE,"hitbtn is '%s' \n", (hitbtn==NULL) ? "NULL" : hitbtn->tag);
+
+	/* check if last hold btn losing foucs
+	 * Note:
+	 *	1. If it re_enters from SIGSTOP, this will trigger the very hitbtn
+	 *	   which rasied SIGSTOP signal, to refresh and reset its need_refresh
+	 *	   flag. So, when elements of the page are refreshed as SIGCONT
+	 *	   handler expected, this hitbtn will disappear!!!
+	 *	   We need to confirm 'last_holdbtn->need_refresh==false' here to rule
+	 *	   out the situation, and make sure when egi_page_refresh(page) is called
+	 *	   all elements are to refreshed in order.
+	 *	2. Re_drawing an unmovable btn will change brightness of the icon, if
+	 *	   the icon has opaque value.
+	 */
 
-	while(1)
+	if( pl->last_holdbtn != NULL && pl->last_holdbtn != hitbtn
+				 && pl->last_holdbtn->need_refresh==false )
 	{
-		/* 1. read touch data */
-		if(!egi_touch_getdata(&touch_data) )
+		EGI_PDEBUG(DBG_PAGE,"last_holdbtn '%s' losed focus, refresh it...\n",
+								pl->last_holdbtn->tag);
+		if( ((EGI_DATA_BTN *)(pl->last_holdbtn->egi_data))->opaque <= 0 )
+			/* To avoid refresh btn with opaque value, which shall be refreshed
+			  with whole PAGE instead of just one btn!!! */
 		{
-//			EGI_PDEBUG(DBG_PAGE,"egi_page_routine(): egi_touch_getdata() no updated touch data found, retry...\n");
-			continue;
+	           printf("'%s' is %s \n",pl->last_holdbtn->tag, pl->last_holdbtn->movable ? "movable":"unmovable");
+		   egi_ebox_forcerefresh(pl->last_holdbtn); /* refreshi it then */
 		}
-		sx=touch_data.coord.x;
-		sy=touch_data.coord.y;
-		last_status=touch_data.status;
 
-		/* 2. trigger touch handling process then */
-		if(last_status !=released_hold )
-		{
-			EGI_PDEBUG(DBG_PAGE,"last_status=%d \n",last_status);
-			/* check if any ebox was hit */
-		        hitbtn=egi_hit_pagebox(sx, sy, page, type_btn|type_slider);
-
-			EGI_PDEBUG(DBG_PAGE,"hitbtn is '%s' \n", (hitbtn==NULL) ? "NULL" : hitbtn->tag);
-
-			/* check if last hold btn losing foucs
-			 * Note:
-			 *	1. If it re_enters from SIGSTOP, this will trigger the very hitbtn
-			 *	   which rasied SIGSTOP signal, to refresh and reset its need_refresh
-			 *	   flag. So, when elements of the page are refreshed as SIGCONT
-			 *	   handler expected, this hitbtn will disappear!!!
-			 *	   We need to confirm 'last_holdbtn->need_refresh==false' here to rule
-			 *	   out the situation, and make sure when egi_page_refresh(page) is called
-			 *	   all elements are to refreshed in order.
-			 *	2. Re_drawing an unmovable btn will change brightness of the icon, if
-			 *	   the icon has opaque value.
-			 */
-
-			if( last_holdbtn != NULL && last_holdbtn != hitbtn
-						 && last_holdbtn->need_refresh==false )
-			{
-				EGI_PDEBUG(DBG_PAGE,"last_holdbtn '%s' losed focus, refresh it...\n",
-										last_holdbtn->tag);
-				if( ((EGI_DATA_BTN *)(last_holdbtn->egi_data))->opaque <= 0 )
-					/* To avoid refresh btn with opaque value, which shall be refreshed
-					  with whole PAGE instead of just one btn!!! */
-				{
-			           printf("'%s' is %s \n",last_holdbtn->tag, last_holdbtn->movable ? "movable":"unmovable");
-				   egi_ebox_forcerefresh(last_holdbtn); /* refreshi it then */
-				}
-
-				last_holdbtn=NULL;
-			}
+		pl->last_holdbtn=NULL;
+	}
 
-			/* trap into button reaction functions */
-	       	 	if(hitbtn != NULL)
-			{
+	/* trap into button reaction functions */
+       	 	if(hitbtn != NULL)
+	{
 
 //	EGI_PDEBUG(DBG_PAGE,"[page '%s'] [button '%s'] is touched! touch status is '%s'\n",
 //						page->ebox->tag,hitbtn->tag,egi_str_touch_status(last_status));
 
-		       /*  then trigger button-hit action:
-		  	   1. 'pressing' and 'db_pressing' reaction events never coincide,
-				'pressing' will prevail  ---
-			*  2. !!!!WARNING: check touch_data in buttion reaction funciton at very begin,
-			*  Status 'pressed_hold' will last for a while, so it will have chance to trigger
-			*  button of previous page after triggered current page routine to quit.
-			*  3. only 'pressed_hold','pressing','db_pressing' can trigger button reaction. ???
-			*/
-				/* display touch effect for button */
-				if(hitbtn->type==type_btn) {
+       /*  then trigger button-hit action:
+  	   1. 'pressing' and 'db_pressing' reaction events never coincide,
+		'pressing' will prevail  ---
+	*  2. !!!!WARNING: check touch_data in buttion reaction funciton at very begin,
+	*  Status 'pressed_hold' will last for a while, so it will have chance to trigger
+	*  button of previous page after triggered current page routine to quit.
+	*  3. only 'pressed_hold','pressing','db_pressing' can trigger button reaction. ???
+	*/
+		/* display touch effect for button */
+		if(hitbtn->type==type_btn) {
 
-				    /* remember last hold btn */
-				    if(last_status==pressed_hold) last_holdbtn=hitbtn;
+		    /* remember last hold btn */
+		    if(last_status==pressed_hold) pl->last_holdbtn=hitbtn;
 
 
  /* 1. When the page returns from SIGSTOP by signal SIGCONT, status 'pressed_hold' and 'releasing'
@@ -1143,122 +1205,243 @@ int egi_page_routine(EGI_PAGE *page)
    *    Example: when status transfers from 'pressed_hold' to PEN_UP etc
    * 3. So, we need to bypass 'releasing' here by checking hitbtn->need_refresh!
    */
-			 /* ---- call touch_effect() ----- */
-			 /* 1. 'pressing', 'releaseing' 'pressed_hold' all will trigger touch_effec(),
-			  *     with differenct reactions defined.
-			  * 2. Signals that trigger the touch_effec() may be by_passed by the reaction()
-			  *    , so you should not expect that touch_effect() and reaction() will exectued
-			  *    one after the other. in most case,when you slide on the btn, touch_effect()
-			  *    will be triggered serval times, most possiblely by 'pressed_hold'.
-			  * 3. When the btn icon is unmovale and has opaque(alpha) value, refreshing
-			  *    it without refreshing the PAGE bk image will just addup/deepen color
-			  *	value to FB.
-			  */
-		                    if( hitbtn->need_refresh==false   /* In case SIGCONT triggered */
+	 /* ---- call touch_effect() ----- */
+	 /* 1. 'pressing', 'releaseing' 'pressed_hold' all will trigger touch_effec(),
+	  *     with differenct reactions defined.
+	  * 2. Signals that trigger the touch_effec() may be by_passed by the reaction()
+	  *    , so you should not expect that touch_effect() and reaction() will exectued
+	  *    one after the other. in most case,when you slide on the btn, touch_effect()
+	  *    will be triggered serval times, most possiblely by 'pressed_hold'.
+	  * 3. When the btn icon is unmovale and has opaque(alpha) value, refreshing
+	  *    it without refreshing the PAGE bk image will just addup/deepen color
+	  *	value to FB.
+	  */
+                    if( hitbtn->need_refresh==false   /* In case SIGCONT triggered */
                                        // && last_status==pressing      /* trigger once only after pressing */
-					&&( ((EGI_DATA_BTN *)hitbtn->egi_data)->touch_effect != NULL ) ) {
-					  EGI_PDEBUG(DBG_PAGE,"call '%s' touch_effect() \n", hitbtn->tag);
-					((EGI_DATA_BTN *)hitbtn->egi_data)->touch_effect(hitbtn,&touch_data);//last_status);
-				    }
+			&&( ((EGI_DATA_BTN *)hitbtn->egi_data)->touch_effect != NULL ) ) {
+			  EGI_PDEBUG(DBG_PAGE,"call '%s' touch_effect() \n", hitbtn->tag);
+			((EGI_DATA_BTN *)hitbtn->egi_data)->touch_effect(hitbtn,touch_data);//last_status);
+		    }
 
-				}
+		}
 
 
-				/* trigger reaction func */
+		/* trigger reaction func */
  				if( hitbtn->reaction != NULL && (  last_status==pressed_hold ||
-								   last_status==pressing ||
-								   last_status==releasing ||
-								   last_status==db_pressing  )  )
-				{
+						   last_status==pressing ||
+						   last_status==releasing ||
+						   last_status==db_pressing  )  )
+		{
 
-					/*if ret<0, button pressed to exit current page
-					   usually fall back to its page's routine caller to release page...
-					*/
-					ret=hitbtn->reaction(hitbtn, &touch_data);//last_status);
+			/*if ret<0, button pressed to exit current page
+			   usually fall back to its page's routine caller to release page...
+			*/
+			egi_lat_react_begin();
+			ret=hitbtn->reaction(hitbtn, touch_data);//last_status);
+			egi_lat_react_end();
 
-					/* IF: a button request to exit current page routine */
-					if( ret==btnret_REQUEST_EXIT_PAGE )
-					{
-				       printf("[page '%s'] [button '%s'] ret: request to exit host page.\n",
-										page->ebox->tag, hitbtn->tag);
-						return pgret_OK; // or break;
-					}
+			/* IF: a button request to exit current page routine */
+			if( ret==btnret_REQUEST_EXIT_PAGE )
+			{
+		       printf("[page '%s'] [button '%s'] ret: request to exit host page.\n",
+								page->ebox->tag, hitbtn->tag);
+				return btnret_REQUEST_EXIT_PAGE;
+			}
 
-					/* ELSE IF: a button activated page returns. */
-					else if ( ret==pgret_OK || ret==pgret_ERR )
-					{
-	  printf("[page '%s'] [button '%s'] ret: return from a button activated page, set needrefresh flag.\n",
-										page->ebox->tag,hitbtn->tag);
-						egi_page_needrefresh(page); /* refresh whole page */
-						egi_page_refresh(page);
-						/* wait for 'release_hold' as begin of a new touch session
-					         * the purpuse is to let last page's touching status pass away,
-						 * especially 'pressed_hold' and 'releasing', which may trigger
-						 * refreshed page again!!!
-						 */
-						do {
-							tm_delayms(200);
-						 	egi_touch_getdata(&touch_data);
+			/* ELSE IF: a button activated page returns. */
+			else if ( ret==pgret_OK || ret==pgret_ERR )
+			{
+  printf("[page '%s'] [button '%s'] ret: return from a button activated page, set needrefresh flag.\n",
+								page->ebox->tag,hitbtn->tag);
+				egi_page_needrefresh(page); /* refresh whole page */
+				egi_page_refresh(page);
+				/* wait for a new touch session, the purpuse is to let last page's
+				 * touching status pass away, especially 'pressed_hold' and 'releasing',
+				 * which may trigger refreshed page again!!!
+				 */
+				pl->wait_press=true;
 
-						}while(touch_data.status != released_hold);
+			}
+			else
+			/* ELSE: for other cases, btnret_OK, btnret_ERR  */
+			{
+			/* needfresh flags for page or eboxes to be set by btn react. func. */
+			    //let btn do it:	egi_page_needrefresh(page);
+			}
+		}
 
-					}
-					else
-					/* ELSE: for other cases, btnret_OK, btnret_ERR  */
-					{
-					/* needfresh flags for page or eboxes to be set by btn react. func. */
-					    //let btn do it:	egi_page_needrefresh(page);
-					}
-				}
+	 } /* end of hitbtn reaction */
+
+	return 0;
+}
 
-			 } /* end of hitbtn reaction */
+/*---------------------------------------------------------------------
+Read out touch data and dispatch them, when the touch eventfd is ready
+or the polling timer expires. A frame is requested after them.
+For XPT2046, which has no eventfd, touch data is polled at its active
+sampling rate while the pen is down, and at the idle rate otherwise.
+----------------------------------------------------------------------*/
+static int page_loop_touch_handler(EGI_EVLOOP *evloop, int fd, void *arg)
+{
+	EGI_PAGE_LOOP *pl=arg;
+	EGI_TOUCH_DATA touch_data;
+	enum egi_touch_status status;
+	uint64_t count;
+	bool touched=false;
+	int ms;
+
+	if( fd==egi_touch_eventfd() && read(fd, &count, sizeof(count))<0 && errno!=EAGAIN )
+		printf("%s: Fail to read touch eventfd: %s\n", __func__, strerror(errno));
+
+	while( egi_touch_getdata(&touch_data) ) {
+		status=touch_data.status;
+		pl->last_status=status;
+
+		/* Touch data of the last touch session passes away */
+		if(pl->wait_press) {
+			if(status!=pressing && status!=db_pressing)
+				continue;
+			pl->wait_press=false;
 		}
-		else /* last_status == released_hold */
-		{
-			/* else, do other routine jobs */
-                        //eig_pdebug(DBG_PAGE,"egi_page_routine(): --- XPT_READ_STATUS_PENUP ---\n");
-
-		       /* 	              -----   NOTE  -----
-			* If a react function is triggered by a pressing touch, then after running
-			* the function, a press_hold AND/OR a releasing touch status will likely be
-		        * captured immediately and it triggers its reaction function just before following
-			* egi_page_refresh().
-			* If above mentioned press_hold/releasing reaction function also include refreshing
-			* the ebox, that will cause following egi_page_refresh() useless. Because after refresh
-			* the need_refresh flag will be reset afterall.
-			* So, it must run just after egi_page_needrefresh(page);
-			* OR OR OR --- All react functions to be triggered by a 'releasing' status. ??
-			* However...a 'releasing' status always happens after a 'pressing' status, and if the
-			* preceding 'pressing' triggers a PAGE, which unfortunatly has an ebox just at the same
-			* location waiting for a 'releasing' to activate it. WOW.... It is activated at once!!!
-			* Conclusion: activating touch_status(signal) for all eboxes shall be the same type!
-	               */
 
-			/* refresh page, OR sleep a while */
-			if(egi_page_refresh(page)!=0) {
-				/* hold on for a while, otherwise the screen will be  ...heheheheheh... */
-#if 1
-				tm_delayms(75); //55
-#endif
-#if 0 /* conflict with timer */
-				egi_sleep(0,0,900);
-#endif
+		if(status != released_hold) {
+			touched=true;
+			/* Trace touch-to-photon latency, see egi_latency.h */
+			egi_lat_touch(&touch_data.ts);
+		}
 
-			}
+		if( page_loop_dispatch(pl, &touch_data)==btnret_REQUEST_EXIT_PAGE )
+			return btnret_REQUEST_EXIT_PAGE;
+	}
+	if(touched)
+		page_loop_request_frame(pl);
 
+	/* Adjust the polling rate, by the last touch status seen. A poll without new data
+	 * during a drag keeps the active rate.
+	 */
+	if(pl->poll_ms>0) {
+		status=pl->last_status;
+		ms = ( status==released_hold || status==releasing || status==db_releasing )
+			? xpt_period_ms(false) : xpt_period_ms(true);
+		if( ms!=pl->poll_ms && egi_evloop_set_timer(evloop, fd, ms, true)==0 )
+			pl->poll_ms=ms;
+	}
 
-#if 0 /* conflict with timer */
-	                printf("--------egi_page: egi_sleep 900ms ------------\n");
-			egi_sleep(4,0,900);
-	                printf("--------egi_page:  end egi_sleep 900ms------------\n");
-#endif
-			/* loop in refreshing listed eboxes */
+	return 0;
+}
+
+/*----------------------------------------------------------------------
+Default page routine job ,No sliding handling
+
+It runs an event loop on page->evloop, see egi_evloop.h, and sleeps till
+there is work:
+1. Touch data from the touch eventfd, or a polling timer for XPT2046.
+2. Timers and signals added to page->evloop by the caller or runners,
+   their handlers may return btnret_REQUEST_EXIT_PAGE to exit the page.
+3. egi_page_wakeup() by runners, as egi_ebox_needrefresh() does.
+4. Every page->idle_ms, to check need_refresh set directly by runners.
+The page is refreshed at most once every EGI_PAGE_FRAMEMS, after any
+of above happens.
+
+return:
+	loop or >=0  	OK
+	<0		fails
+----------------------------------------------------------------------*/
+int egi_page_routine(EGI_PAGE *page)
+{
+	EGI_PAGE_LOOP pl;
+	EGI_TOUCH_DATA touch_data;
+	int ret;
+
+	/* 1. check data */
+	EGI_PDEBUG(DBG_PAGE,"start to check data for page.\n");
+	if(page==NULL || page->ebox==NULL || page->evloop==NULL)
+	{
+		printf("egi_page_routine(): input page OR page->ebox OR page->evloop is NULL!\n");
+		return -1;
+	}
+
+	/* 2. check list */
+	EGI_PDEBUG(DBG_PAGE,"start to check ebox list for page.\n");
+	if(list_empty(&page->list_head))
+	{
+		printf("egi_page_routine(): WARNING!!! page '%s' has an empty ebox list_head .\n",page->ebox->tag);
+	}
+
+	EGI_PDEBUG(DBG_PAGE,"--------------- get into [PAGE %s]'s loop routine -------------\n",page->ebox->tag);
+
+	/* 3. Start page runners */
+	if( egi_page_start_runners(page) !=0 ) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to launch page runners!",__func__ );
+		return -2;
+	}
+
+	/* 4. Add touch data and timers to the event loop */
+	memset(&pl, 0, sizeof(pl));
+	pl.page=page;
+	pl.touch_fd=pl.idle_tfd=pl.frame_tfd=-1;
+	pl.last_status=released_hold;
+	egi_gesture_reset(&pl.gtracker);
+
+	/* Touch status of the last page, as 'pressed_hold' and 'releasing' of the touch which
+	 * brings up this page, shall NOT trigger buttons here.
+	 */
+	pl.wait_press=true;
+
+	if( egi_touch_eventfd()>=0 ) {
+		if( egi_evloop_add_fd(page->evloop, egi_touch_eventfd(), page_loop_touch_handler, &pl)==0 )
+			pl.touch_fd=egi_touch_eventfd();
+	}
+	else {
+		pl.poll_ms=xpt_period_ms(false);
+		pl.touch_fd=egi_evloop_add_timer(page->evloop, pl.poll_ms, true, page_loop_touch_handler, &pl);
+	}
+	pl.frame_tfd=egi_evloop_add_timer(page->evloop, 0, false, page_loop_frame_handler, &pl);
+	if(page->idle_ms>0)
+		pl.idle_tfd=egi_evloop_add_timer(page->evloop, page->idle_ms, true, page_loop_idle_handler, &pl);
+	if(pl.touch_fd<0 || pl.frame_tfd<0 || (page->idle_ms>0 && pl.idle_tfd<0) ) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to set up the event loop of page '%s'!",__func__, page->ebox->tag);
+		ret=pgret_ERR;
+		goto END_FUNC;
+	}
+
+ 	/* ----------------    Event Handling   ----------------  */
+	EGI_PDEBUG(DBG_PAGE,"Now trap into the event loop...\n");
+
+	/* Try to discard first obsolete data, just to inform egi_touch_loopread() to start loop_read.
+	 * Ring backends keep every touch data in order, nothing to discard.
+	 */
+	if(egi_touch_eventfd()<0)
+		egi_touch_getdata(&touch_data);
+	page_loop_frame(&pl);
+
+	while(1)
+	{
+		ret=egi_evloop_wait(page->evloop, -1);
+		if(ret==btnret_REQUEST_EXIT_PAGE) {
+			ret=pgret_OK;
+			break;
+		}
+		else if(ret<0) {
+			EGI_PLOG(LOGLV_ERROR, "%s: Event loop of page '%s' fails!",__func__, page->ebox->tag);
+			ret=pgret_ERR;
+			break;
 		}
 
-	}/* end while() */
+		/* Woken up by runners */
+		if( __atomic_exchange_n(&page->dirty, false, __ATOMIC_ACQ_REL) )
+			page_loop_request_frame(&pl);
+	}
 
-	return pgret_OK;
-	//return 0;
+END_FUNC:
+	if(pl.touch_fd>=0)
+		egi_evloop_del_fd(page->evloop, pl.touch_fd);
+	if(pl.frame_tfd>=0)
+		egi_evloop_del_fd(page->evloop, pl.frame_tfd);
+	if(pl.idle_tfd>=0)
+		egi_evloop_del_fd(page->evloop, pl.idle_tfd);
+
+	return ret;
 }
 
 
@@ -1406,6 +1589,10 @@ int egi_homepage_routine(EGI_PAGE *page)
 		sy=touch_data.coord.y;
 		last_status=touch_data.status;
 
+		/* Trace touch-to-photon latency, see egi_latency.h */
+		if(last_status != released_hold)
+			egi_lat_touch(&touch_data.ts);
+
 		/* print read_in touch status */
 		if(last_status != released_hold)
 			printf("routine: --- %s ---\n",egi_str_touch_status(last_status));
@@ -1514,7 +1701,9 @@ int egi_homepage_routine(EGI_PAGE *page)
 					printf(" --- sliding press start! --- \n");
 				#endif
 				if(page->slide_handler != NULL) {
+					egi_lat_react_begin();
 					page->slide_handler(page, &touch_data);
+					egi_lat_react_end();
 					/* Refresh page for other eboxes! since it will loop back(continue),
 					 * and no chance to refresh the page elsewhere.
 					 */
@@ -1585,7 +1774,9 @@ int egi_homepage_routine(EGI_PAGE *page)
 					/*if ret<0, button pressed to exit current page
 					   usually fall back to its page's routine caller to release page...
 					*/
+					egi_lat_react_begin();
 					ret=hitbtn->reaction(hitbtn, &touch_data);//last_status);
+					egi_lat_react_end();
 
 					/* IF: a button request to exit current page routine */
 					if( ret==btnret_REQUEST_EXIT_PAGE )
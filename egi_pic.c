@@ -17,6 +17,8 @@ Midas Zhou
 #include "egi.h"
 #include "egi_pic.h"
 #include "egi_debug.h"
+#include "egi_page.h"
+#include "egi_scene.h"
 #include "egi_symbol.h"
 #include "egi_bjp.h"
 
@@ -449,7 +451,7 @@ int egi_picbox_refresh(EGI_EBOX *ebox)
 		return 1;
 	}
 
-   if(ebox->movable) /* only if ebox is movale */
+   if(ebox->movable && !egi_scene_retained(ebox)) /* only if ebox is movale */
    {
 	/* 2. restore bk image use old bkbox data, before refresh */
 	#if 0 /* DEBUG */
@@ -514,7 +516,7 @@ int egi_picbox_refresh(EGI_EBOX *ebox)
 	EGI_PDEBUG(DBG_PIC,"Resize ebox as per data_pic: ebox.height=%d, ebox.width=%d\n",
 						ebox->height, ebox->width);
 
-   if(ebox->movable) /* only if ebox is movale */
+   if(ebox->movable && !egi_scene_retained(ebox)) /* only if ebox is movale */
    {
        /* ---- 4. redefine bkimg box range, in case it changes... */
 	/* check ebox height and font lines in case it changes, then adjust the height */
@@ -650,7 +652,7 @@ int egi_picbox_sleep(EGI_EBOX *ebox)
 		return -1;
 	}
 
-        if(ebox->movable) /* only for movable ebox */
+        if(ebox->movable && !egi_scene_retained(ebox)) /* only for movable ebox */
         {
                 /* restore bkimg */
                 if(fb_cpyfrom_buf(&gv_fb_dev, ebox->bkbox.startxy.x, ebox->bkbox.startxy.y,
@@ -664,6 +666,10 @@ int egi_picbox_sleep(EGI_EBOX *ebox)
         /* reset status */
         ebox->status=status_sleep;
 
+        /* In a retained scene, the next frame erases it */
+        if(egi_scene_retained(ebox))
+                egi_page_wakeup(egi_scene_page(ebox));
+
         EGI_PDEBUG(DBG_PIC,"egi_picbox_sleep(): a '%s' ebox is put to sleep.\n",ebox->tag);
         return 0;
 }
@@ -0,0 +1,740 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+A retained scene of eboxes in a PAGE, see egi_scene.h
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "sys_list.h"
+#include "egi.h"
+#include "egi_page.h"
+#include "egi_scene.h"
+#include "egi_fbdev.h"
+#include "egi_fbgeom.h"
+#include "egi_image.h"
+#include "egi_bjp.h"
+#include "egi_color.h"
+#include "egi_debug.h"
+
+/* A box is empty if its end point is before its start point, see egi_scene_bounds() */
+static inline bool scene_box_empty(const EGI_BOX *box)
+{
+	return box->endxy.x < box->startxy.x || box->endxy.y < box->startxy.y;
+}
+
+static inline bool scene_box_overlap(const EGI_BOX *a, const EGI_BOX *b)
+{
+	return !( a->endxy.x < b->startxy.x || b->endxy.x < a->startxy.x
+		  || a->endxy.y < b->startxy.y || b->endxy.y < a->startxy.y );
+}
+
+/* Whether box a is inside box b */
+static inline bool scene_box_inside(const EGI_BOX *a, const EGI_BOX *b)
+{
+	return a->startxy.x >= b->startxy.x && a->endxy.x <= b->endxy.x
+		&& a->startxy.y >= b->startxy.y && a->endxy.y <= b->endxy.y;
+}
+
+/* Add box to damage, valid indicates whether damage is not empty */
+static void scene_box_union(EGI_BOX *damage, bool *valid, const EGI_BOX *box)
+{
+	if(scene_box_empty(box))
+		return;
+
+	if(!*valid) {
+		*damage=*box;
+		*valid=true;
+		return;
+	}
+
+	if(box->startxy.x < damage->startxy.x) damage->startxy.x=box->startxy.x;
+	if(box->startxy.y < damage->startxy.y) damage->startxy.y=box->startxy.y;
+	if(box->endxy.x > damage->endxy.x) damage->endxy.x=box->endxy.x;
+	if(box->endxy.y > damage->endxy.y) damage->endxy.y=box->endxy.y;
+}
+
+/* Lock/unlock the PAGE of an ebox, if it's in a PAGE */
+static int scene_lock(EGI_PAGE *page)
+{
+	if( page!=NULL && pthread_mutex_lock(&page->pgmutex)!=0 ) {
+		printf("%s: Fail to get PAGE.pgmutex!\n",__func__);
+		return -1;
+	}
+	return 0;
+}
+
+static void scene_unlock(EGI_PAGE *page)
+{
+	if(page!=NULL) {
+		pthread_mutex_unlock(&page->pgmutex);
+		/* Let the page routine render it */
+		egi_page_wakeup(page);
+	}
+}
+
+/* Count eboxes in a list and their descendants */
+static int scene_count(struct list_head *head)
+{
+	struct list_head *tnode;
+	int n=0;
+
+	list_for_each(tnode, head)
+		n += 1+scene_count(&list_entry(tnode, EGI_EBOX, node)->children);
+
+	return n;
+}
+
+/* Put eboxes in a list and their descendants to eboxes[], in z-order from bottom to top */
+static void scene_flatten(struct list_head *head, EGI_EBOX **eboxes, int *n)
+{
+	struct list_head *tnode;
+	EGI_EBOX *ebox;
+
+	list_for_each(tnode, head) {
+		ebox=list_entry(tnode, EGI_EBOX, node);
+		eboxes[(*n)++]=ebox;
+		scene_flatten(&ebox->children, eboxes, n);
+	}
+}
+
+/* Set container of all descendants of an ebox */
+static void scene_set_container(EGI_EBOX *ebox, EGI_PAGE *page)
+{
+	struct list_head *tnode;
+	EGI_EBOX *child;
+
+	list_for_each(tnode, &ebox->children) {
+		child=list_entry(tnode, EGI_EBOX, node);
+		child->container=page;
+		scene_set_container(child, page);
+	}
+}
+
+/* Move an ebox and its descendants, and set need_refresh for all of them */
+static void scene_move(EGI_EBOX *ebox, int dx, int dy)
+{
+	struct list_head *tnode;
+
+	ebox->x0 += dx;
+	ebox->y0 += dy;
+	/* Move touchbox only if it's defined, see egi_hit_pagebox() */
+	if( ebox->touchbox.startxy.x!=0 || ebox->touchbox.endxy.x!=0 ) {
+		ebox->touchbox.startxy.x += dx;
+		ebox->touchbox.startxy.y += dy;
+		ebox->touchbox.endxy.x += dx;
+		ebox->touchbox.endxy.y += dy;
+	}
+	ebox->need_refresh=true;
+
+	list_for_each(tnode, &ebox->children)
+		scene_move(list_entry(tnode, EGI_EBOX, node), dx, dy);
+}
+
+/* Load page->fpath as page->ebox->frame_img, so the wallpaper is loaded only once */
+static void scene_load_wallpaper(EGI_PAGE *page)
+{
+	EGI_IMGBUF *imgbuf;
+
+	imgbuf=egi_imgbuf_alloc();
+	if(imgbuf==NULL)
+		return;
+
+	if( egi_imgbuf_loadpng(page->fpath, imgbuf)!=0 && egi_imgbuf_loadjpg(page->fpath, imgbuf)!=0 ) {
+		printf("%s: Fail to load '%s' as wallpaper of page '%s'.\n", __func__, page->fpath, page->ebox->tag);
+		egi_imgbuf_free(imgbuf);
+		return;
+	}
+
+	page->ebox->frame_img=imgbuf;
+}
+
+/* Redraw wallpaper of a PAGE within the box */
+static void scene_paint_wallpaper(EGI_PAGE *page, const EGI_BOX *box)
+{
+	EGI_IMGBUF *imgbuf=page->ebox->frame_img;
+
+	if( imgbuf!=NULL && imgbuf->imgbuf!=NULL ) {
+		/* no subcolor, no FB filo */
+		egi_imgbuf_windisplay2(imgbuf, &gv_fb_dev, box->startxy.x, box->startxy.y,
+					box->startxy.x, box->startxy.y,
+					box->endxy.x-box->startxy.x+1, box->endxy.y-box->startxy.y+1);
+	}
+	else {
+		fbset_color( page->ebox->prmcolor>=0 ? page->ebox->prmcolor : WEGI_COLOR_BLACK );
+		draw_filled_rect(&gv_fb_dev, box->startxy.x, box->startxy.y, box->endxy.x, box->endxy.y);
+	}
+}
+
+
+/*----------------------------------------------------------------
+Turn on/off retained mode of a PAGE, the whole page is refreshed
+in the next frame.
+
+Return:
+	0	OK
+	<0	Fails
+-----------------------------------------------------------------*/
+int egi_scene_enable(EGI_PAGE *page, bool enable)
+{
+	if( page==NULL || page->ebox==NULL ) {
+		printf("%s: Input page is invalid!\n",__func__);
+		return -1;
+	}
+
+	if(scene_lock(page)!=0)
+		return -2;
+
+	page->retained=enable;
+	page->damaged=false;
+	page->ebox->need_refresh=true;
+
+	scene_unlock(page);
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------
+Get the PAGE of an ebox, which is the container of its root
+ebox in the scene.
+
+Return:
+	Pointer to the PAGE	OK
+	NULL			Not in a PAGE
+-----------------------------------------------------------*/
+EGI_PAGE* egi_scene_page(const EGI_EBOX *ebox)
+{
+	if(ebox==NULL)
+		return NULL;
+
+	while(ebox->father!=NULL)
+		ebox=ebox->father;
+
+	return ebox->container;
+}
+
+
+/*-----------------------------------------------------------
+Whether an ebox is in a PAGE of retained mode. If so, it needs
+not to restore or save its bkimg when it's refreshed or erased,
+egi_scene_render() redraws the wallpaper and eboxes beneath it.
+------------------------------------------------------------*/
+bool egi_scene_retained(const EGI_EBOX *ebox)
+{
+	EGI_PAGE *page=egi_scene_page(ebox);
+
+	return page!=NULL && page->retained;
+}
+
+
+/*-----------------------------------------------------------
+Insert an ebox to a list of the scene, as PAGE.list_head or
+ebox->children, behind all eboxes of the same or smaller z.
+Descendants of the ebox take the same container of it.
+
+Note: The caller shall hold PAGE.pgmutex if the list is in a
+      PAGE being refreshed.
+------------------------------------------------------------*/
+void egi_scene_insert(struct list_head *head, EGI_EBOX *ebox)
+{
+	struct list_head *tnode;
+
+	if(head==NULL || ebox==NULL)
+		return;
+
+	/* An ebox not created by egi_ebox_new() */
+	if(ebox->children.next==NULL)
+		INIT_LIST_HEAD(&ebox->children);
+
+	list_for_each(tnode, head) {
+		if( list_entry(tnode, EGI_EBOX, node)->z > ebox->z )
+			break;
+	}
+	list_add_tail(&ebox->node, tnode);	/* Before tnode, or at tail of the list */
+
+	scene_set_container(ebox, ebox->container);
+}
+
+
+/*-----------------------------------------------------------
+Add a child ebox to a parent ebox, the child is drawn above
+the parent and siblings of smaller z. The child shall not be
+in any list.
+
+Return:
+	0	OK
+	<0	Fails
+------------------------------------------------------------*/
+int egi_scene_add_child(EGI_EBOX *parent, EGI_EBOX *child)
+{
+	EGI_PAGE *page;
+
+	if( parent==NULL || child==NULL || parent==child ) {
+		printf("%s: Input parent or child is invalid!\n",__func__);
+		return -1;
+	}
+
+	page=egi_scene_page(parent);
+	if(scene_lock(page)!=0)
+		return -2;
+
+	/* An ebox not created by egi_ebox_new() */
+	if(parent->children.next==NULL)
+		INIT_LIST_HEAD(&parent->children);
+
+	child->father=parent;
+	child->container=page;
+	child->drawn=false;
+	child->need_refresh=true;
+	egi_scene_insert(&parent->children, child);
+
+	scene_unlock(page);
+
+	return 0;
+}
+
+
+/*-----------------------------------------------------------
+Remove an ebox, with its descendants, from the scene. Its PAGE
+will redraw where it was drawn. The ebox is not freed.
+
+Return:
+	0	OK
+	<0	Fails
+------------------------------------------------------------*/
+int egi_scene_remove(EGI_EBOX *ebox)
+{
+	EGI_PAGE *page;
+	EGI_EBOX **eboxes;
+	int i, n=0;
+
+	if(ebox==NULL || ebox->node.next==NULL) {
+		printf("%s: Input ebox is invalid or not in a list!\n",__func__);
+		return -1;
+	}
+
+	page=egi_scene_page(ebox);
+	if(scene_lock(page)!=0)
+		return -2;
+
+	/* Damage where they're drawn */
+	n=1+scene_count(&ebox->children);
+	eboxes=malloc(n*sizeof(EGI_EBOX *));
+	if(eboxes!=NULL) {
+		eboxes[0]=ebox;
+		n=1;
+		scene_flatten(&ebox->children, eboxes, &n);
+		for(i=0; i<n; i++) {
+			if( page!=NULL && eboxes[i]->drawn )
+				scene_box_union(&page->damage, &page->damaged, &eboxes[i]->drawbox);
+			eboxes[i]->drawn=false;
+		}
+		free(eboxes);
+	}
+	else if(page!=NULL) {
+		page->ebox->need_refresh=true;		/* Refresh the whole page then */
+	}
+
+	list_del(&ebox->node);
+	ebox->node.next=NULL;
+	ebox->node.prev=NULL;
+	ebox->father=NULL;
+	ebox->container=NULL;
+	scene_set_container(ebox, NULL);
+
+	scene_unlock(page);
+
+	return 0;
+}
+
+
+/*-----------------------------------------------------------
+Set z-order of an ebox, and move it in its list accordingly.
+
+Return:
+	0	OK
+	<0	Fails
+------------------------------------------------------------*/
+int egi_scene_set_z(EGI_EBOX *ebox, int z)
+{
+	EGI_PAGE *page;
+	struct list_head *head=NULL;
+
+	if(ebox==NULL) {
+		printf("%s: Input ebox is NULL!\n",__func__);
+		return -1;
+	}
+
+	page=egi_scene_page(ebox);
+	if(scene_lock(page)!=0)
+		return -2;
+
+	if(ebox->father!=NULL)
+		head=&ebox->father->children;
+	else if(ebox->container!=NULL)
+		head=&ebox->container->list_head;
+
+	ebox->z=z;
+	if( head!=NULL && ebox->node.next!=NULL ) {
+		list_del(&ebox->node);
+		egi_scene_insert(head, ebox);
+	}
+	ebox->need_refresh=true;
+
+	scene_unlock(page);
+
+	return 0;
+}
+
+
+/*-----------------------------------------------------------
+Get bounds of an ebox, where it draws. A box with end point
+before start point is empty.
+------------------------------------------------------------*/
+void egi_scene_bounds(const EGI_EBOX *ebox, EGI_BOX *box)
+{
+	EGI_DATA_SLIDER *data_slider;
+	EGI_BOX slot;
+	bool valid=true;
+
+	if(ebox==NULL || box==NULL)
+		return;
+
+	box->startxy.x=ebox->x0;
+	box->startxy.y=ebox->y0;
+	box->endxy.x=ebox->x0+ebox->width-1;
+	box->endxy.y=ebox->y0+ebox->height-1;
+
+	/* A slider also draws its slot, see egi_slider_refresh() */
+	if( ebox->type==type_slider && ebox->egi_data!=NULL ) {
+		data_slider=(EGI_DATA_SLIDER *)((EGI_DATA_BTN *)ebox->egi_data)->prvdata;
+		if(data_slider!=NULL) {
+			/* bkbox of a vertical slot is from bottom to top */
+			slot=data_slider->bkbox;
+			if(slot.startxy.x > slot.endxy.x) {
+				slot.startxy.x=data_slider->bkbox.endxy.x;
+				slot.endxy.x=data_slider->bkbox.startxy.x;
+			}
+			if(slot.startxy.y > slot.endxy.y) {
+				slot.startxy.y=data_slider->bkbox.endxy.y;
+				slot.endxy.y=data_slider->bkbox.startxy.y;
+			}
+			if(scene_box_empty(box))
+				*box=slot;
+			else
+				scene_box_union(box, &valid, &slot);
+		}
+	}
+}
+
+
+/*-----------------------------------------------------------
+Add a damage to a PAGE in retained mode, it will be redrawn in
+the next frame.
+
+Return:
+	0	OK
+	<0	Fails
+------------------------------------------------------------*/
+int egi_scene_damage(EGI_PAGE *page, const EGI_BOX *box)
+{
+	if(page==NULL || box==NULL) {
+		printf("%s: Input page or box is NULL!\n",__func__);
+		return -1;
+	}
+
+	if(scene_lock(page)!=0)
+		return -2;
+
+	scene_box_union(&page->damage, &page->damaged, box);
+
+	scene_unlock(page);
+
+	return 0;
+}
+
+
+/*-----------------------------------------------------------
+Mark an ebox dirty, its damage is propagated to its PAGE: the
+bounds where it was drawn and where it's to be drawn. Eboxes
+overlapped with the damage will be redrawn in the next frame.
+
+Return:
+	0	OK
+	<0	Fails
+------------------------------------------------------------*/
+int egi_scene_mark_dirty(EGI_EBOX *ebox)
+{
+	EGI_PAGE *page;
+	EGI_BOX box;
+
+	if(ebox==NULL) {
+		printf("%s: Input ebox is NULL!\n",__func__);
+		return -1;
+	}
+
+	page=egi_scene_page(ebox);
+	if(scene_lock(page)!=0)
+		return -2;
+
+	ebox->need_refresh=true;
+	if(page!=NULL) {
+		if(ebox->drawn)
+			scene_box_union(&page->damage, &page->damaged, &ebox->drawbox);
+		egi_scene_bounds(ebox, &box);
+		scene_box_union(&page->damage, &page->damaged, &box);
+	}
+
+	scene_unlock(page);
+
+	return 0;
+}
+
+
+/*-----------------------------------------------------------
+Move an ebox with its descendants by (dx,dy).
+
+Return:
+	0	OK
+	<0	Fails
+------------------------------------------------------------*/
+int egi_scene_move(EGI_EBOX *ebox, int dx, int dy)
+{
+	EGI_PAGE *page;
+
+	if(ebox==NULL) {
+		printf("%s: Input ebox is NULL!\n",__func__);
+		return -1;
+	}
+
+	page=egi_scene_page(ebox);
+	if(scene_lock(page)!=0)
+		return -2;
+
+	scene_move(ebox, dx, dy);
+
+	scene_unlock(page);
+
+	return 0;
+}
+
+
+/*--------------------------------------------------------------------
+Render a frame of a PAGE in retained mode, called by egi_page_refresh()
+with PAGE.pgmutex held.
+
+1. The damage is the PAGE damage, and bounds of eboxes with need_refresh
+   set, both where they were drawn and are to be drawn. A drawn ebox not
+   active any more damages where it was drawn. The whole screen is the
+   damage if page->ebox->need_refresh is set.
+2. The damage is enlarged to cover every active ebox overlapped with it,
+   till no more, so an ebox refreshed as a whole never overdraws others
+   above it that are not refreshed.
+3. The wallpaper in the damage is redrawn, then eboxes in the damage in
+   z-order, into the FB working buffer.
+4. If an ebox grows out of the damage when it's refreshed, as a txt ebox
+   with more lines, it's refreshed again in the next frame.
+
+Return:
+	1	No damage
+	0	OK
+	<0	Fails
+---------------------------------------------------------------------*/
+int egi_scene_render(EGI_PAGE *page)
+{
+	EGI_EBOX **eboxes;
+	bool *drawing;
+	EGI_EBOX *ebox;
+	EGI_BOX damage, screen, box;
+	bool damaged, whole, changed;
+	int i, n=0;
+
+	if( page==NULL || page->ebox==NULL )
+		return -1;
+
+	/* 1. The damage */
+	damage=page->damage;
+	damaged=page->damaged;
+	page->damaged=false;
+
+	screen.startxy.x=0;
+	screen.startxy.y=0;
+	screen.endxy.x=gv_fb_dev.pos_xres-1;
+	screen.endxy.y=gv_fb_dev.pos_yres-1;
+
+	whole=page->ebox->need_refresh;
+	if(whole) {
+		scene_box_union(&damage, &damaged, &screen);
+		if( page->ebox->frame_img==NULL && page->fpath!=NULL )
+			scene_load_wallpaper(page);
+	}
+
+	n=scene_count(&page->list_head);
+	eboxes=malloc(n*(sizeof(EGI_EBOX *)+sizeof(bool))+1);
+	if(eboxes==NULL) {
+		printf("%s: Fail to malloc eboxes!\n",__func__);
+		page->damaged=damaged;
+		page->damage=damage;
+		return -2;
+	}
+	drawing=(bool *)(eboxes+n);
+	memset(drawing, 0, n*sizeof(bool));
+	n=0;
+	scene_flatten(&page->list_head, eboxes, &n);
+
+	for(i=0; i<n; i++) {
+		ebox=eboxes[i];
+		if(ebox->status!=status_active) {
+			if(ebox->drawn)
+				scene_box_union(&damage, &damaged, &ebox->drawbox);
+			ebox->drawn=false;
+		}
+		else if(ebox->need_refresh) {
+			if(ebox->drawn)
+				scene_box_union(&damage, &damaged, &ebox->drawbox);
+			egi_scene_bounds(ebox, &box);
+			scene_box_union(&damage, &damaged, &box);
+		}
+	}
+	if(!damaged) {
+		free(eboxes);
+		return 1;
+	}
+
+	/* 2. Enlarge the damage */
+	do {
+		changed=false;
+		for(i=0; i<n; i++) {
+			if( drawing[i] || eboxes[i]->status!=status_active )
+				continue;
+			egi_scene_bounds(eboxes[i], &box);
+			if( !scene_box_empty(&box) && scene_box_overlap(&box, &damage) ) {
+				drawing[i]=true;
+				scene_box_union(&damage, &damaged, &box);
+				changed=true;
+			}
+		}
+	} while(changed);
+
+	/* 3. Wallpaper within the screen */
+	box=damage;
+	if(box.startxy.x < 0) box.startxy.x=0;
+	if(box.startxy.y < 0) box.startxy.y=0;
+	if(box.endxy.x > screen.endxy.x) box.endxy.x=screen.endxy.x;
+	if(box.endxy.y > screen.endxy.y) box.endxy.y=screen.endxy.y;
+	if(!scene_box_empty(&box))
+		scene_paint_wallpaper(page, &box);
+
+	if(whole) {
+		egi_ebox_decorate(page->ebox);
+		if( page->page_refresh_misc != NULL )
+			page->page_refresh_misc(page);
+		page->ebox->need_refresh=false;
+	}
+
+	/* 4. Eboxes in z-order */
+	for(i=0; i<n; i++) {
+		if(!drawing[i])
+			continue;
+		ebox=eboxes[i];
+		ebox->need_refresh=true;
+		ebox->refresh(ebox);
+
+		egi_scene_bounds(ebox, &ebox->drawbox);
+		ebox->drawn=true;
+		if( !scene_box_empty(&ebox->drawbox) && !scene_box_inside(&ebox->drawbox, &damage) ) {
+			EGI_PDEBUG(DBG_PAGE,"ebox '%s' grows out of the damage, refresh it again.\n", ebox->tag);
+			ebox->need_refresh=true;
+			egi_page_wakeup(page);
+		}
+	}
+
+	free(eboxes);
+
+	return 0;
+}
+
+
+/*-----------------------------------------------------------
+Get the topmost active ebox of the type at (x,y) in a PAGE of
+retained mode, by its touchbox if defined, or its ebox box.
+Called by egi_hit_pagebox().
+
+Return:
+	Pointer to the ebox	OK
+	NULL			No ebox hit, or fails.
+------------------------------------------------------------*/
+EGI_EBOX* egi_scene_hit(EGI_PAGE *page, int x, int y, enum egi_ebox_type type)
+{
+	EGI_EBOX **eboxes;
+	EGI_EBOX *ebox, *hit=NULL;
+	EGI_POINT *sxy, *exy;
+	int i, n=0;
+
+	if(page==NULL)
+		return NULL;
+
+	n=scene_count(&page->list_head);
+	if(n==0)
+		return NULL;
+	eboxes=malloc(n*sizeof(EGI_EBOX *));
+	if(eboxes==NULL) {
+		printf("%s: Fail to malloc eboxes!\n",__func__);
+		return NULL;
+	}
+	n=0;
+	scene_flatten(&page->list_head, eboxes, &n);
+
+	/* From top to bottom */
+	for(i=n-1; i>=0; i--) {
+		ebox=eboxes[i];
+		if( !(ebox->type & type) || ebox->status!=status_active )
+			continue;
+
+		sxy=&(ebox->touchbox.startxy);
+		exy=&(ebox->touchbox.endxy);
+		if( sxy->x==0 && exy->x==0 ) {		/* 1. If touch box NOT defined */
+			if( x > ebox->x0 && x < ebox->x0+ebox->width
+					&& y > ebox->y0 && y < ebox->y0+ebox->height ) {
+				hit=ebox;
+				break;
+			}
+		}
+		else {					/* 2. If touch box defined */
+			if( x > sxy->x && x < exy->x && y > sxy->y && y < exy->y ) {
+				hit=ebox;
+				break;
+			}
+		}
+	}
+
+	free(eboxes);
+	return hit;
+}
+
+
+/*-----------------------------------------------------------
+Free all descendants of an ebox, called by egi_page_free()
+before the ebox is freed.
+------------------------------------------------------------*/
+void egi_scene_free_children(EGI_EBOX *ebox)
+{
+	struct list_head *tnode, *tmpnode;
+	EGI_EBOX *child;
+
+	if( ebox==NULL || ebox->children.next==NULL )
+		return;
+
+	list_for_each_safe(tnode, tmpnode, &ebox->children) {
+		child=list_entry(tnode, EGI_EBOX, node);
+		list_del(tnode);
+		egi_scene_free_children(child);
+		child->free(child);
+	}
+}
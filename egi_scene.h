@@ -0,0 +1,63 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+A retained scene of eboxes in a PAGE, redrawn by damage rectangles.
+
+1. Tree and z-order:
+   Eboxes in PAGE.list_head are the top level of the scene, an ebox
+   may have child eboxes in its ebox->children, with ebox->father as
+   its parent. Each list is kept in order of ebox->z, from bottom to
+   top, and a child is always drawn above its parent. Coordinates of
+   a child are still absolute FB coordinates.
+2. Damage:
+   An ebox with need_refresh set damages its bounds, and the bounds
+   where it was drawn last time (ebox->drawbox), so a moved, resized,
+   hidden or sleeping ebox is erased. egi_scene_damage() adds any
+   other area to be redrawn, as where an ebox is removed.
+3. Frame:
+   egi_page_refresh() calls egi_scene_render() for a PAGE in retained
+   mode. The damage is enlarged to cover all eboxes overlapped with
+   it, then the wallpaper within the damage is redrawn, then eboxes
+   in the damage are refreshed in z-order. Other eboxes are untouched.
+   Ebox bkimg is neither restored nor saved in retained mode, see
+   egi_scene_retained().
+4. Limits:
+   - Page decorate() and page_refresh_misc() are called only when the
+     whole page is refreshed, drawings of them in the damage are lost.
+   - Eboxes shall not draw out of their bounds, see egi_scene_bounds().
+
+Example:
+	page=egi_page_new("scene");
+	egi_scene_enable(page, true);
+	egi_page_addlist(page, panel);
+	egi_scene_add_child(panel, btn);	// Drawn above the panel
+	egi_scene_set_z(popup, 10);		// Drawn above all z<10
+	...
+	egi_scene_move(panel, 0, 20);		// Moves btn too, a frame redraws the damage
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#ifndef __EGI_SCENE_H__
+#define __EGI_SCENE_H__
+
+#include <stdbool.h>
+#include "egi.h"
+
+int		egi_scene_enable(EGI_PAGE *page, bool enable);
+bool		egi_scene_retained(const EGI_EBOX *ebox);
+EGI_PAGE*	egi_scene_page(const EGI_EBOX *ebox);
+void		egi_scene_insert(struct list_head *head, EGI_EBOX *ebox);
+int		egi_scene_add_child(EGI_EBOX *parent, EGI_EBOX *child);
+int		egi_scene_remove(EGI_EBOX *ebox);
+int		egi_scene_set_z(EGI_EBOX *ebox, int z);
+void		egi_scene_bounds(const EGI_EBOX *ebox, EGI_BOX *box);
+int		egi_scene_damage(EGI_PAGE *page, const EGI_BOX *box);
+int		egi_scene_mark_dirty(EGI_EBOX *ebox);
+int		egi_scene_move(EGI_EBOX *ebox, int dx, int dy);
+int		egi_scene_render(EGI_PAGE *page);
+EGI_EBOX*	egi_scene_hit(EGI_PAGE *page, int x, int y, enum egi_ebox_type type);
+void		egi_scene_free_children(EGI_EBOX *ebox);
+
+#endif
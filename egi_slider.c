@@ -19,6 +19,7 @@ Midas Zhou
 #include "egi_btn.h"
 #include "egi_slider.h"
 #include "egi_debug.h"
+#include "egi_scene.h"
 #include "egi_symbol.h"
 
 /*-------------------------------------
@@ -440,7 +441,7 @@ int egi_slider_refresh(EGI_EBOX *ebox)
 	twidth=ebox->touchbox.endxy.x - ebox->touchbox.startxy.x;
 	theight=ebox->touchbox.endxy.y - ebox->touchbox.startxy.y;
 
-   if(ebox->movable) /* only if ebox is movale */
+   if(ebox->movable && !egi_scene_retained(ebox)) /* only if ebox is movale */
    {
 	/* 3. restore bk image use old bkbox data, before refresh */
 	#if 0 /* DEBUG */
@@ -532,6 +533,8 @@ int egi_slider_refresh(EGI_EBOX *ebox)
 	#endif
         /* ---- 5. store bk image which will be restored when you refresh it later,
 		this ebox position/size changes */
+	/* Bkboxes are still updated above, as bounds of a slider in a retained scene */
+     if(!egi_scene_retained(ebox)) {
 	/* 5.1 slot_bkimg */
 	if( fb_cpyto_buf(&gv_fb_dev, data_slider->bkbox.startxy.x, data_slider->bkbox.startxy.y,
 	     data_slider->bkbox.endxy.x, data_slider->bkbox.endxy.y, data_slider->slot_bkimg) <0) {
@@ -545,6 +548,7 @@ int egi_slider_refresh(EGI_EBOX *ebox)
 		printf("%s: fb_cpyto_buf() for Ebox '%s' fails.\n",__func__, ebox->tag);
 		return -4;
 	}
+     }
 
 
    } /* end of movable codes */
@@ -43,6 +43,7 @@ midaszhou@yahoo.com
 #include <unistd.h> /*close*/
 #include <stdint.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <string.h>
 #include <errno.h>
 #include "egi_fbgeom.h"
@@ -561,6 +562,18 @@ void symbol_release_page(EGI_SYMPAGE *sym_page)
 	if(sym_page==NULL)
 		return;
 
+	/* A page mmapped from a cache file */
+	if(sym_page->mmap_base != NULL) {
+		munmap(sym_page->mmap_base, sym_page->mmap_size);
+		sym_page->mmap_base=NULL;
+		sym_page->mmap_size=0;
+		sym_page->data=NULL;
+		sym_page->alpha=NULL;
+		sym_page->symoffset=NULL;
+		sym_page->symwidth=NULL;
+		return;
+	}
+
 	if(sym_page->data != NULL) {
 		//printf("%s: free(sym_page->data) ...\n",__func__);
 		free(sym_page->data);
@@ -599,6 +612,7 @@ void symbol_release_page(EGI_SYMPAGE *sym_page)
 
 /*-----------------------------------------------------------------------
 check integrity of a ((loaded)) page structure
+A page with alpha data only(data==NULL) is OK.
 
 sym_page: a loaded page
 func:	  function name of the caller
@@ -622,10 +636,10 @@ int symbol_check_page(const EGI_SYMPAGE *sym_page, char *func)
                 printf("%s(): symbol number less than 1! fail to load page.\n",func);
                 return -2;
         }
-        /* check for data */
-        if(sym_page->data == NULL)
+        /* check for data, a FT sympage may have alpha only, as loaded from a cache file */
+        if(sym_page->data == NULL && sym_page->alpha == NULL)
         {
-                printf("%s(): sym_page->data is NULL! the symbol page has not been loaded?!\n",func);
+                printf("%s(): sym_page->data and alpha are NULL! the symbol page has not been loaded?!\n",func);
 	                return -3;
         }
         /* check for symb_index */
@@ -726,6 +740,214 @@ int symbol_string_pixlen(char *str, const EGI_SYMPAGE *font)
 }
 
 
+#if !defined(FB_SYMOUT_ROLLBACK) && !defined(LETS_NOTE)
+/*-----------------------------------------------------------------------------------
+Write a symbol to a 16bits FB or a virtual FB row by row, with the same result as
+the pixel by pixel loop in symbol_writeFB(). FB FILO is NOT applied.
+
+1. The symbol box is clipped to the screen once, then each symbol row is a
+   span in FB mem, which steps +1, +xres, -1 or -xres as per pos_rotate.
+2. Without alpha data, runs of transparent pixels are skipped in bulk, and
+   runs of opaque pixels are copied by memcpy()(pos_rotate 0), or filled
+   with fontcolor.
+3. With alpha data, the alpha row is taken as runs as in egi_imgbuf_buildAlphaRLE():
+   runs of alpha 0 are skipped in bulk, runs of alpha 255 are copied or filled
+   as spans, and pixels with alpha big enough take the front color without blending.
+4. With luminance decrement(lumdev<0), transparent pixels are darkened too,
+   so pixels of a real FB are processed one by one.
+
+@offset,width,pitch:	Symbol pixels in the page, as in symbol_writeFB().
+@opaque:		[0 255]
+@lumdev:		Luminance decrement, <=0.
+-----------------------------------------------------------------------------------*/
+static void symbol_writeFB_rows(FBDEV *fb_dev, const EGI_SYMPAGE *sym_page, int fontcolor,
+				int transpcolor, int x0, int y0, int offset, int width, int pitch,
+				int opaque, int lumdev)
+{
+	EGI_IMGBUF *virt_fb=fb_dev->virt_fb;
+	const uint16_t *data=sym_page->data;
+	const unsigned char *alpha=sym_page->alpha;
+	const uint16_t *prow=NULL;	/* Symbol row in page data */
+	const unsigned char *parow;	/* Symbol row in page alpha */
+	uint16_t *fbuf;			/* 16bits FB mem, or imgbuf of the virt FB */
+	unsigned char *valpha=NULL;	/* Alpha of the virt FB */
+	int xres,yres;
+	int lw,lh;			/* Screen width and height as seen by the symbol */
+	int i0,i1,j0,j1;		/* Clipped symbol box */
+	int i,j,k,n;
+	long base,step;			/* FB mem position of row pixel j: base+j*step */
+	long pos;
+	uint16_t pcolor;
+	int palpha;
+	int sumalpha;
+
+	if(virt_fb) {
+		xres=virt_fb->width;
+		yres=virt_fb->height;
+		fbuf=virt_fb->imgbuf;
+		valpha=virt_fb->alpha;
+		lumdev=0;		/* Luma decrement NOT applied to virt FB */
+	}
+	else {
+		xres=fb_dev->vinfo.xres;
+		yres=fb_dev->vinfo.yres;
+		#ifdef ENABLE_BACK_BUFFER
+		fbuf=(uint16_t *)fb_dev->map_bk;
+		#else
+		fbuf=(uint16_t *)fb_dev->map_fb;
+		#endif
+	}
+	if(fbuf==NULL)
+		return;
+
+	if(fb_dev->pos_rotate & 0x1) {	/* 90 or 270 Deg */
+		lw=yres;
+		lh=xres;
+	}
+	else {
+		lw=xres;
+		lh=yres;
+	}
+
+	/* Clip the symbol box */
+	i0 = y0<0 ? -y0 : 0;
+	i1 = y0+sym_page->symheight>lh ? lh-y0 : sym_page->symheight;
+	j0 = x0<0 ? -x0 : 0;
+	j1 = x0+width>lw ? lw-x0 : width;
+	if(i0>=i1 || j0>=j1)
+		return;
+
+	for(i=i0; i<i1; i++) {
+		/* FB mem position of the row, as mapped in symbol_writeFB() */
+	        switch(fb_dev->pos_rotate) {
+			case 1:		/* Clockwise 90 deg */
+				base=(long)x0*xres+(xres-1)-(y0+i);
+				step=xres;
+				break;
+			case 2:		/* Clockwise 180 deg */
+				base=(long)((yres-1)-(y0+i))*xres+(xres-1)-x0;
+				step=-1;
+				break;
+			case 3:		/* Clockwise 270 deg */
+				base=(long)((yres-1)-x0)*xres+y0+i;
+				step=-xres;
+				break;
+			default:	/* FB defaul position */
+				base=(long)(y0+i)*xres+x0;
+				step=1;
+				break;
+		}
+
+		if(data)
+			prow=data+offset+pitch*i;
+
+		/* ----- Symbol with alpha data ----- */
+		if(alpha) {
+			parow=alpha+offset+pitch*i;
+			for(j=j0; j<j1; ) {
+				palpha=parow[j];
+				if( palpha==0 && lumdev==0 ) {	/* Nothing changes, skip the run */
+					for(j++; j<j1 && parow[j]==0; j++);
+					continue;
+				}
+
+				/* Copy/fill a run of opaque pixels */
+				if( palpha==255 && opaque==255 && lumdev==0 ) {
+					for(k=j+1; k<j1 && parow[k]==255; k++);
+					if(step==1 && fontcolor<0 && prow) {
+						memcpy(fbuf+base+j, prow+j, (k-j)*sizeof(uint16_t));
+					}
+					else {
+						for(n=j, pos=base+j*step; n<k; n++, pos+=step)
+							fbuf[pos]= fontcolor>=0 ? fontcolor : (prow ? prow[n] : WEGI_COLOR_BLACK);
+					}
+					if(valpha) {	/* sumalpha=valpha+255 */
+						for(pos=base+j*step; j<k; j++, pos+=step)
+							valpha[pos]=255;
+					}
+					j=k;
+					continue;
+				}
+
+				pos=base+j*step;
+				if(fontcolor>=0)
+					pcolor=fontcolor;
+				else
+					pcolor= prow ? prow[j] : WEGI_COLOR_BLACK;
+
+				k= opaque==255 ? palpha : palpha*opaque/255;
+				if(k<170)	/* egi_16bitColor_blend() takes front color for alpha>=170 */
+					pcolor=egi_16bitColor_blend(pcolor, fbuf[pos], k);
+				if(lumdev<0)
+					pcolor=egi_colorLuma_adjust(pcolor,lumdev);
+				fbuf[pos]=pcolor;
+
+				if(valpha) {
+					sumalpha=valpha[pos]+palpha;
+					valpha[pos]= sumalpha>255 ? 255 : sumalpha;
+				}
+				j++;
+			}
+			continue;
+		}
+
+		/* ----- Symbol without alpha data, data is NOT NULL then ----- */
+		for(j=j0; j<j1; ) {
+			pcolor=prow[j];
+
+			/* Transparent pixels */
+			if( transpcolor>=0 && pcolor==transpcolor ) {
+				if(lumdev<0) {		/* To darken transparent pixel */
+					pos=base+j*step;
+					fbuf[pos]=egi_colorLuma_adjust(fbuf[pos],lumdev);
+					j++;
+				}
+				else {			/* Skip the run */
+					for(j++; j<j1 && prow[j]==transpcolor; j++);
+				}
+				continue;
+			}
+
+			/* Copy/fill a run of opaque pixels */
+			if( opaque==255 && lumdev==0 && !TESTFONT_COLOR_FLIP ) {
+				for(k=j+1; k<j1 && (transpcolor<0 || prow[k]!=transpcolor); k++);
+				if(step==1 && fontcolor<0) {
+					memcpy(fbuf+base+j, prow+j, (k-j)*sizeof(uint16_t));
+				}
+				else {
+					for(n=j, pos=base+j*step; n<k; n++, pos+=step)
+						fbuf[pos]= fontcolor>=0 ? fontcolor : prow[n];
+				}
+				if(valpha) {	/* sumalpha=valpha+255 */
+					for(pos=base+j*step; j<k; j++, pos+=step)
+						valpha[pos]=255;
+				}
+				j=k;
+				continue;
+			}
+
+			pos=base+j*step;
+			if(TESTFONT_COLOR_FLIP)
+				pcolor = ~pcolor;
+			if(fontcolor>=0)
+				pcolor=fontcolor;
+			if(opaque!=255)
+				pcolor=egi_16bitColor_blend(pcolor, fbuf[pos], opaque);
+			if(lumdev<0)
+				pcolor=egi_colorLuma_adjust(pcolor,lumdev);
+			fbuf[pos]=pcolor;
+
+			if(valpha) {
+				sumalpha=valpha[pos]+opaque;
+				valpha[pos]= sumalpha>255 ? 255 : sumalpha;
+			}
+			j++;
+		}
+	}
+}
+#endif
+
+
 /*------------------------------------------------------------------------------------------
 		write a symbol/font pixel data to FB device
 
@@ -734,6 +956,8 @@ int symbol_string_pixlen(char *str, const EGI_SYMPAGE *font)
    color.
 4. Note: put page check in symbol_string_writeFB()!!!
 5. Points out of fb_map page(one screen buffer) will be ruled out.
+6. Written row by row with symbol_writeFB_rows(), pixel by pixel only if FB FILO
+   is on.
 
 @fbdev: 	FB device
 		or Virt FB
@@ -789,6 +1013,7 @@ void symbol_writeFB(FBDEV *fb_dev, const EGI_SYMPAGE *sym_page, 	\
 	long poff;
 	int height=sym_page->symheight;
 	int width;
+	int pitch;	/* row pitch of symbol data */
 	EGI_IMGBUF *virt_fb;
 	int sumalpha;
 	int lumdev=0;	/* luminance decrement value */
@@ -819,6 +1044,9 @@ void symbol_writeFB(FBDEV *fb_dev, const EGI_SYMPAGE *sym_page, 	\
         if(virt_fb) {                   /* for virtual FB */
                 xres=virt_fb->width;
                 yres=virt_fb->height;
+		/* alpha data of the virt FB will be changed */
+		if(virt_fb->alpha_rle)
+			egi_imgbuf_freeAlphaRLE(virt_fb);
         }
         else {                          /* for FB */
                 xres=fb_dev->vinfo.xres;
@@ -828,10 +1056,12 @@ void symbol_writeFB(FBDEV *fb_dev, const EGI_SYMPAGE *sym_page, 	\
 	/* get symbol/font width, only 1 character in FT2 symbol page NOW!!! */
 	if(sym_page->symtype==symtype_FT2) {
 		width=sym_page->ftwidth;
+		pitch=sym_page->ftpitch>0 ? sym_page->ftpitch : width;
 		offset=0;
 	}
 	else {
 		width=sym_page->symwidth[sym_code];
+		pitch=width;
 		offset=sym_page->symoffset[sym_code];
 	}
 
@@ -851,6 +1081,15 @@ void symbol_writeFB(FBDEV *fb_dev, const EGI_SYMPAGE *sym_page, 	\
 		pargb=255<<24; /* For LETS_NOTE */
 	}
 
+#if !defined(FB_SYMOUT_ROLLBACK) && !defined(LETS_NOTE)
+	/* Row by row, unless FILO is on */
+	if(!fb_dev->filo_on) {
+		symbol_writeFB_rows(fb_dev, sym_page, fontcolor, transpcolor, x0, y0,
+					offset, width, pitch, opaque, lumdev);
+		return;
+	}
+#endif
+
 	/* get symbol pixel and copy it to FB mem */
 	for(i=0;i<height;i++)
 	{
@@ -927,7 +1166,7 @@ void symbol_writeFB(FBDEV *fb_dev, const EGI_SYMPAGE *sym_page, 	\
 			/*x(i,j),y(i,j) mapped to LCD(xy),
 				however, pos may also be out of FB screensize  */
 			pos=mapy*xres+mapx; 	/* in pixel, LCD fb mem position */
-			poff=offset+width*i+j; 	/* offset to pixel data */
+			poff=offset+pitch*i+j; 	/* offset to pixel data */
 
 			if(sym_page->alpha)
 				palpha=*(sym_page->alpha+poff);  	/*  get alpha */
@@ -1443,6 +1682,10 @@ void symbol_rotate(const EGI_SYMPAGE *sym_page,
         /* check page data */
         if(symbol_check_page(sym_page, "symbol_rotate") != 0)
                 return;
+	if(sym_page->data==NULL) {
+		printf("%s: Symbol page has no color data to rotate.\n",__func__);
+		return;
+	}
 
 	int i,j;
         uint16_t *data=sym_page->data; /* symbol pixel data in a mem page */
@@ -99,6 +99,9 @@ struct symbol_page
 	int ftwidth;	/* For FT page only, which holds only one character
 			 * taken as slot->advance.x;
 			 */
+	int ftpitch;	/* For FT page only, bytes per row of alpha, 0 as ftwidth.
+			 * Bitmap in a glyph atlas has the pitch of the atlas surface.
+			 */
 
 	/* !!!!! following not used, if symbol encoded from 0, you can use array index number as code number.
 	 Each row has same number of symbols, so you can use code number to locate a row in a img page
@@ -107,6 +110,12 @@ struct symbol_page
 	int *symb_code; /* default NULL, if not applicable
 			 * MAYBE: applicable for FT page
 			 */
+
+	/* For a page mmapped from a cache file, data is read only, and symbol_release_page()
+	 * munmaps it instead of free().
+	 */
+	void	*mmap_base;
+	size_t	mmap_size;
 };
 
 
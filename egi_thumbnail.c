@@ -0,0 +1,785 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Thumbnail service for photo browsing pages, see egi_thumbnail.h
+
+Note:
+1. Cache files are written to a temporary file first and then renamed,
+   so processes sharing the same cache directory never see a half
+   written thumbnail.
+2. libjpeg error_exit() is redirected with setjmp/longjmp, a broken
+   JPG file only fails its own job instead of exiting the process.
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <setjmp.h>
+#include <sys/mman.h>
+#include <jpeglib.h>
+#include <jerror.h>
+#include "egi_thumbnail.h"
+#include "egi_image.h"
+#include "egi_bjp.h"
+#include "egi_utils.h"
+#include "egi_log.h"
+
+/* libjpeg error manager with a return point */
+struct thumb_jpeg_error {
+	struct jpeg_error_mgr	pub;
+	jmp_buf			setjmp_buffer;
+};
+
+static void thumb_jpeg_error_exit(j_common_ptr cinfo);
+static uint32_t thumb_hash_string(const char *str);
+static void *egi_thumbsrv_worker(void *arg);
+
+
+/*--------------------------------------------
+libjpeg error_exit: print the message and
+jump back to the decoding function.
+--------------------------------------------*/
+static void thumb_jpeg_error_exit(j_common_ptr cinfo)
+{
+	struct thumb_jpeg_error *jerr=(struct thumb_jpeg_error *)cinfo->err;
+
+	(*cinfo->err->output_message)(cinfo);
+	longjmp(jerr->setjmp_buffer, 1);
+}
+
+/*--------------------------------------------
+FNV-1a hash of a string.
+--------------------------------------------*/
+static uint32_t thumb_hash_string(const char *str)
+{
+	uint32_t hash=2166136261U;
+
+	while(*str) {
+		hash ^= (unsigned char)(*str++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+
+/*---------------------------------------------------------------------
+Get path of the cache file for a source image file.
+Different thumbnail sizes of the same file get different cache files.
+
+@cache_dir:	Cache directory.
+@fpath:		Full path of the source image file.
+@tw,th:		Max. thumbnail size.
+@buff:		Buffer to hold the result.
+@size:		Size of buff.
+
+Return:
+	0	OK
+	<0	Fails
+---------------------------------------------------------------------*/
+int egi_thumb_cachePath(const char *cache_dir, const char *fpath, int tw, int th, char *buff, int size)
+{
+	int ret;
+
+	if(cache_dir==NULL || fpath==NULL || buff==NULL || size<=0)
+		return -1;
+
+	ret=snprintf(buff, size, "%s/%08x_%dx%d.%s", cache_dir, thumb_hash_string(fpath),
+									tw, th, EGI_THUMB_FEXTNAME);
+	if(ret >= size)
+		return -2;
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------------------
+Mmap a thumbnail cache file.
+If fpath is given, the entry is valid only if the recorded path hash
+matches with it. If sb is given, the entry is valid only if the
+recorded source file size and mtime match with sb.
+
+@cpath:		Path of the cache file.
+@fpath:		Path of the source file, or NULL to ignore.
+@sb:		stat of the source file, or NULL to ignore.
+
+Return:
+	Pointer to an EGI_THUMB		OK
+	NULL				Fails, or cache entry is stale.
+---------------------------------------------------------------------*/
+EGI_THUMB* egi_thumb_mmapFile(const char *cpath, const char *fpath, const struct stat *sb)
+{
+	int fd;
+	struct stat csb;
+	EGI_THUMB *thumb=NULL;
+	const EGI_THUMB_HEADER *header;
+	void *map;
+
+	if(cpath==NULL)
+		return NULL;
+
+	fd=open(cpath, O_RDONLY|O_CLOEXEC);
+	if(fd<0)
+		return NULL;
+
+	if( fstat(fd, &csb)<0 || csb.st_size < sizeof(EGI_THUMB_HEADER) ) {
+		close(fd);
+		return NULL;
+	}
+
+	map=mmap(NULL, csb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);  /* The mapping keeps its own reference */
+	if(map==MAP_FAILED) {
+		printf("%s: Fail to mmap '%s', %s.\n", __func__, cpath, strerror(errno));
+		return NULL;
+	}
+
+	/* Check header */
+	header=(const EGI_THUMB_HEADER *)map;
+	if( header->magic != EGI_THUMB_MAGIC || header->version != EGI_THUMB_VERSION
+	    || header->hdsize != sizeof(EGI_THUMB_HEADER)
+	    || csb.st_size < header->hdsize + 2*header->width*header->height )
+	{
+		printf("%s: '%s' is NOT a valid thumbnail file.\n", __func__, cpath);
+		goto END_FAIL;
+	}
+
+	/* Check whether it's of the source file, and whether the source file is changed */
+	if( fpath!=NULL && header->pathhash != thumb_hash_string(fpath) )
+		goto END_FAIL;
+	if( sb!=NULL && ( header->fsize != (int64_t)sb->st_size || header->fmtime != (int64_t)sb->st_mtime ) )
+		goto END_FAIL;
+
+	thumb=calloc(1, sizeof(EGI_THUMB));
+	if(thumb==NULL) {
+		printf("%s: Fail to calloc thumb.\n", __func__);
+		goto END_FAIL;
+	}
+	thumb->width=header->width;
+	thumb->height=header->height;
+	thumb->color=(const EGI_16BIT_COLOR *)((const char *)map+header->hdsize);
+	thumb->map=map;
+	thumb->mapsize=csb.st_size;
+
+	return thumb;
+
+END_FAIL:
+	munmap(map, csb.st_size);
+	return NULL;
+}
+
+/*-----------------------------------------
+Unmap and free an EGI_THUMB, and reset
+it to NULL.
+-----------------------------------------*/
+void egi_thumb_unmap(EGI_THUMB **thumb)
+{
+	if(thumb==NULL || *thumb==NULL)
+		return;
+
+	munmap((*thumb)->map, (*thumb)->mapsize);
+	free(*thumb);
+	*thumb=NULL;
+}
+
+/*-----------------------------------------------
+Copy a mapped thumbnail to a new EGI_IMGBUF,
+without alpha data.
+
+Return:
+	Pointer to an EGI_IMGBUF	OK
+	NULL				Fails
+------------------------------------------------*/
+EGI_IMGBUF* egi_thumb_toImgbuf(const EGI_THUMB *thumb)
+{
+	EGI_IMGBUF *eimg;
+
+	if(thumb==NULL || thumb->color==NULL)
+		return NULL;
+
+	eimg=egi_imgbuf_alloc();
+	if(eimg==NULL)
+		return NULL;
+
+	if( egi_imgbuf_init(eimg, thumb->height, thumb->width, false)!=0 ) {
+		egi_imgbuf_free(eimg);
+		return NULL;
+	}
+	memcpy(eimg->imgbuf, thumb->color, thumb->width*thumb->height*sizeof(EGI_16BIT_COLOR));
+
+	return eimg;
+}
+
+
+/*---------------------------------------------------------------------
+Save an EGI_IMGBUF as a thumbnail cache file. Alpha data is ignored.
+
+@cpath:		Path of the cache file.
+@eimg:		Thumbnail image.
+@fpath:		Full path of the source image file.
+@sb:		stat of the source file.
+
+Return:
+	0	OK
+	<0	Fails
+---------------------------------------------------------------------*/
+int egi_thumb_saveFile(const char *cpath, const EGI_IMGBUF *eimg, const char *fpath, const struct stat *sb)
+{
+	int fd;
+	int ret=0;
+	size_t datsize;
+	EGI_THUMB_HEADER header;
+	char tmpath[EGI_PATH_MAX+EGI_NAME_MAX+32];
+
+	if(cpath==NULL || fpath==NULL || sb==NULL || eimg==NULL || eimg->imgbuf==NULL)
+		return -1;
+
+	memset(&header, 0, sizeof(header));
+	header.magic=EGI_THUMB_MAGIC;
+	header.version=EGI_THUMB_VERSION;
+	header.hdsize=sizeof(EGI_THUMB_HEADER);
+	header.width=eimg->width;
+	header.height=eimg->height;
+	header.pathhash=thumb_hash_string(fpath);
+	header.fsize=sb->st_size;
+	header.fmtime=sb->st_mtime;
+
+	/* Write to a temporary file first */
+	snprintf(tmpath, sizeof(tmpath), "%s.%d_%lx", cpath, getpid(), (unsigned long)pthread_self());
+	fd=open(tmpath, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+	if(fd<0) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to open '%s', %s.\n", __func__, tmpath, strerror(errno));
+		return -2;
+	}
+
+	datsize=eimg->width*eimg->height*sizeof(EGI_16BIT_COLOR);
+	if( write(fd, &header, sizeof(header)) != sizeof(header)
+	    || write(fd, eimg->imgbuf, datsize) != datsize )
+	{
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to write '%s', %s.\n", __func__, tmpath, strerror(errno));
+		ret=-3;
+	}
+	close(fd);
+
+	if( ret==0 && rename(tmpath, cpath)<0 ) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to rename '%s', %s.\n", __func__, tmpath, strerror(errno));
+		ret=-4;
+	}
+	if(ret!=0)
+		unlink(tmpath);
+
+	return ret;
+}
+
+
+/*---------------------------------------------------------------------
+Decode a JPG file to a thumbnail with max. size tw x th, aspect ratio
+of the picture is kept.
+The biggest libjpeg DCT scaling(1/8,1/4,1/2) that still keeps the
+output not smaller than the thumbnail is applied, then the result
+is resized by egi_imgbuf_resize().
+
+@fpath:		Full path of the JPG file.
+@tw,th:		Max. thumbnail size.
+
+Return:
+	Pointer to an EGI_IMGBUF	OK
+	NULL				Fails
+---------------------------------------------------------------------*/
+EGI_IMGBUF* egi_thumb_loadjpg(const char *fpath, int tw, int th)
+{
+	struct jpeg_decompress_struct cinfo;
+	struct thumb_jpeg_error jerr;
+	FILE *fil;
+	EGI_IMGBUF * volatile eimg=NULL;
+	EGI_IMGBUF *outimg=NULL;
+	unsigned char * volatile rowbuf=NULL;
+	JSAMPROW row;
+	unsigned char *pt;
+	unsigned int denom;
+	int ow, oh;
+	int i,j;
+
+	if(fpath==NULL || tw<2 || th<2)
+		return NULL;
+
+	fil=fopen(fpath, "rbe");
+	if(fil==NULL) {
+		printf("%s: Fail to open '%s', %s.\n", __func__, fpath, strerror(errno));
+		return NULL;
+	}
+
+	cinfo.err=jpeg_std_error(&jerr.pub);
+	jerr.pub.error_exit=thumb_jpeg_error_exit;
+	if(setjmp(jerr.setjmp_buffer)) {
+		printf("%s: Fail to decode '%s'.\n", __func__, fpath);
+		jpeg_destroy_decompress(&cinfo);
+		fclose(fil);
+		free(rowbuf);
+		egi_imgbuf_free(eimg);
+		return NULL;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_stdio_src(&cinfo, fil);
+	jpeg_read_header(&cinfo, TRUE);
+
+	/* Select DCT scaling */
+	for(denom=8; denom>1; denom>>=1) {
+		if( cinfo.image_width/denom >= tw || cinfo.image_height/denom >= th )
+			break;
+	}
+	cinfo.scale_num=1;
+	cinfo.scale_denom=denom;
+	cinfo.out_color_space=JCS_RGB;		/* Also for grayscale */
+	cinfo.dct_method=JDCT_IFAST;
+	cinfo.do_fancy_upsampling=FALSE;
+
+	jpeg_start_decompress(&cinfo);
+
+	eimg=egi_imgbuf_alloc();
+	if( eimg==NULL || egi_imgbuf_init(eimg, cinfo.output_height, cinfo.output_width, false)!=0 )
+		ERREXIT(&cinfo, JERR_OUT_OF_MEMORY);
+	rowbuf=malloc(cinfo.output_width*cinfo.output_components);
+	if(rowbuf==NULL)
+		ERREXIT(&cinfo, JERR_OUT_OF_MEMORY);
+
+	for(i=0; cinfo.output_scanline < cinfo.output_height; i++) {
+		row=rowbuf;
+		jpeg_read_scanlines(&cinfo, &row, 1);
+		pt=row;
+		for(j=0; j<cinfo.output_width; j++, pt+=3)
+			eimg->imgbuf[i*cinfo.output_width+j]=COLOR_RGB_TO16BITS(pt[0], pt[1], pt[2]);
+	}
+
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+	fclose(fil);
+	free(rowbuf);
+
+	/* Fit into tw x th */
+	if( eimg->width*th > eimg->height*tw ) {
+		ow=tw;
+		oh=eimg->height*tw/eimg->width;
+	}
+	else {
+		oh=th;
+		ow=eimg->width*th/eimg->height;
+	}
+	if( ow==eimg->width && oh==eimg->height )
+		return eimg;
+
+	outimg=egi_imgbuf_resize(eimg, ow, oh);
+	egi_imgbuf_free(eimg);
+
+	return outimg;
+}
+
+
+/*---------------------------------------------------------------------
+Get thumbnail of an image file, from the cache if the entry is valid,
+or decode the file and save it to the cache.
+
+@cache_dir:	Cache directory. If NULL, no cache is applied.
+@fpath:		Full path of the source image file, JPG or PNG.
+@tw,th:		Max. thumbnail size.
+@cache_hit:	To pass out whether it's loaded from the cache, or NULL.
+
+Return:
+	Pointer to an EGI_IMGBUF	OK
+	NULL				Fails
+---------------------------------------------------------------------*/
+EGI_IMGBUF* egi_thumb_create(const char *cache_dir, const char *fpath, int tw, int th, bool *cache_hit)
+{
+	struct stat sb;
+	char cpath[EGI_PATH_MAX+EGI_NAME_MAX];
+	EGI_THUMB *thumb;
+	EGI_IMGBUF *eimg=NULL;
+	EGI_IMGBUF *tmpimg=NULL;
+
+	if(cache_hit)
+		*cache_hit=false;
+
+	if(fpath==NULL || stat(fpath, &sb)<0)
+		return NULL;
+
+	/* 1. Try the cache */
+	if( cache_dir!=NULL && egi_thumb_cachePath(cache_dir, fpath, tw, th, cpath, sizeof(cpath))==0 ) {
+		thumb=egi_thumb_mmapFile(cpath, fpath, &sb);
+		if(thumb!=NULL) {
+			eimg=egi_thumb_toImgbuf(thumb);
+			egi_thumb_unmap(&thumb);
+			if(eimg!=NULL) {
+				if(cache_hit)
+					*cache_hit=true;
+				return eimg;
+			}
+		}
+	}
+	else
+		cache_dir=NULL;
+
+	/* 2. Decode the source file */
+	eimg=egi_thumb_loadjpg(fpath, tw, th);
+	if(eimg==NULL) {
+		/* Try PNG, NO DCT scaling then */
+		tmpimg=egi_imgbuf_alloc();
+		if(tmpimg==NULL)
+			return NULL;
+		if( egi_imgbuf_loadpng(fpath, tmpimg)!=0 ) {
+			egi_imgbuf_free(tmpimg);
+			return NULL;
+		}
+		if( tmpimg->width*th > tmpimg->height*tw )
+			eimg=egi_imgbuf_resize(tmpimg, tw, 0);
+		else
+			eimg=egi_imgbuf_resize(tmpimg, 0, th);
+		egi_imgbuf_free(tmpimg);
+		if(eimg==NULL)
+			return NULL;
+	}
+
+	/* 3. Save to the cache */
+	if(cache_dir!=NULL)
+		egi_thumb_saveFile(cpath, eimg, fpath, &sb);
+
+	return eimg;
+}
+
+
+/*-------------------------------------------------------------
+Create a thumbnail service.
+
+@cache_dir:	Cache directory, it will be created if not exists.
+		If NULL, no cache is applied.
+@tw,th:		Max. thumbnail size.
+
+Return:
+	Pointer to an EGI_THUMB_SERVICE		OK
+	NULL					Fails
+-------------------------------------------------------------*/
+EGI_THUMB_SERVICE* egi_thumbsrv_create(const char *cache_dir, int tw, int th)
+{
+	EGI_THUMB_SERVICE *srv;
+
+	if(tw<2 || th<2)
+		return NULL;
+
+	srv=calloc(1, sizeof(EGI_THUMB_SERVICE));
+	if(srv==NULL) {
+		printf("%s: Fail to calloc srv.\n", __func__);
+		return NULL;
+	}
+
+	if(cache_dir!=NULL) {
+		snprintf(srv->cache_dir, sizeof(srv->cache_dir), "%s", cache_dir);
+		if( egi_util_mkdir(srv->cache_dir, 0755)!=0 ) {
+			EGI_PLOG(LOGLV_WARN, "%s: Fail to make cache dir '%s', cache disabled.\n",
+										__func__, cache_dir);
+			srv->cache_dir[0]='\0';
+		}
+	}
+	srv->tw=tw;
+	srv->th=th;
+
+	if( pthread_mutex_init(&srv->lock, NULL)!=0 ) {
+		free(srv);
+		return NULL;
+	}
+	pthread_cond_init(&srv->cond_ready, NULL);
+
+	return srv;
+}
+
+/*-------------------------------------------------------------
+Set a callback to deliver finished thumbnails, instead of the
+ready queue. Call it before egi_thumbsrv_scanDir().
+-------------------------------------------------------------*/
+void egi_thumbsrv_setCallback(EGI_THUMB_SERVICE *srv, EGI_THUMB_CALLBACK callback, void *arg)
+{
+	if(srv==NULL)
+		return;
+
+	pthread_mutex_lock(&srv->lock);
+	srv->callback=callback;
+	srv->cb_arg=arg;
+	pthread_mutex_unlock(&srv->lock);
+}
+
+
+/*-------------------------------------------------------------
+Search image files in a directory and start worker threads to
+make thumbnails for them.
+Index of a thumbnail is the same as its source file index
+in srv->fpaths[].
+
+@srv:		An EGI_THUMB_SERVICE.
+@path:		Directory to scan.
+@fext:		File extension names, see egi_alloc_search_files().
+@nworkers:	Number of worker threads, 1-EGI_THUMB_WORKERS_MAX.
+
+Return:
+	>=0	Number of image files found.
+	<0	Fails
+-------------------------------------------------------------*/
+int egi_thumbsrv_scanDir(EGI_THUMB_SERVICE *srv, const char *path, const char *fext, int nworkers)
+{
+	int i;
+	int count=0;
+
+	if(srv==NULL || path==NULL || fext==NULL)
+		return -1;
+
+	if(srv->fpaths!=NULL) {
+		printf("%s: A directory is already scanned.\n", __func__);
+		return -2;
+	}
+
+	srv->fpaths=egi_alloc_search_files(path, fext, &count);
+	if(srv->fpaths==NULL)
+		return count<0 ? -3 : 0;
+
+	srv->status=calloc(count, sizeof(unsigned char));
+	srv->ready=calloc(count, sizeof(int));
+	srv->thumbs=calloc(count, sizeof(EGI_IMGBUF *));
+	if(srv->status==NULL || srv->ready==NULL || srv->thumbs==NULL) {
+		printf("%s: Fail to calloc job buffers.\n", __func__);
+		free(srv->status);
+		free(srv->ready);
+		free(srv->thumbs);
+		srv->status=NULL;
+		srv->ready=NULL;
+		srv->thumbs=NULL;
+		egi_free_buff2D((unsigned char **)srv->fpaths, count);
+		srv->fpaths=NULL;
+		return -4;
+	}
+	srv->total=count;
+
+	/* Start workers */
+	if(nworkers<1)
+		nworkers=1;
+	if(nworkers>EGI_THUMB_WORKERS_MAX)
+		nworkers=EGI_THUMB_WORKERS_MAX;
+	for(i=0; i<nworkers; i++) {
+		if( pthread_create(&srv->workers[i], NULL, egi_thumbsrv_worker, (void *)srv)!=0 ) {
+			EGI_PLOG(LOGLV_ERROR, "%s: Fail to create worker %d.\n", __func__, i);
+			break;
+		}
+		srv->nworkers++;
+	}
+	if(srv->nworkers==0)
+		return -5;
+
+	return count;
+}
+
+/*-------------------------------------------------------------
+Let workers serve jobs from index 'first' at first, usually
+the first thumbnail on current screen.
+-------------------------------------------------------------*/
+void egi_thumbsrv_setVisible(EGI_THUMB_SERVICE *srv, int first)
+{
+	if(srv==NULL)
+		return;
+
+	pthread_mutex_lock(&srv->lock);
+	if( first>=0 && first<srv->total )
+		srv->first_visible=first;
+	pthread_mutex_unlock(&srv->lock);
+}
+
+
+/*-------------------------------------------------------------
+Fetch a finished thumbnail from the ready queue.
+The caller takes the ownership of the thumbnail.
+
+@srv:		An EGI_THUMB_SERVICE.
+@index:		To pass out index of the thumbnail.
+@thumb:		To pass out the thumbnail, NULL if its source
+		file fails to be decoded.
+@timeout_ms:	0	Return immediately.
+		>0	Wait at most timeout_ms.
+		<0	Wait until a thumbnail is ready or all jobs finish.
+
+Return:
+	0	OK
+	1	No thumbnail ready (yet).
+	<0	Fails
+-------------------------------------------------------------*/
+int egi_thumbsrv_getReady(EGI_THUMB_SERVICE *srv, int *index, EGI_IMGBUF **thumb, int timeout_ms)
+{
+	struct timespec ts;
+	int k;
+
+	if(srv==NULL || index==NULL || thumb==NULL)
+		return -1;
+
+	pthread_mutex_lock(&srv->lock);
+
+	if(timeout_ms>0) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += timeout_ms/1000;
+		ts.tv_nsec += (timeout_ms%1000)*1000000;
+		if(ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+	}
+
+	while( srv->ready_count==0 && timeout_ms!=0 && srv->ndone < srv->total && !srv->request_quit ) {
+		if(timeout_ms>0) {
+			if( pthread_cond_timedwait(&srv->cond_ready, &srv->lock, &ts)==ETIMEDOUT )
+				break;
+		}
+		else
+			pthread_cond_wait(&srv->cond_ready, &srv->lock);
+	}
+
+	if(srv->ready_count==0) {
+		pthread_mutex_unlock(&srv->lock);
+		return 1;
+	}
+
+	k=srv->ready[srv->ready_head];
+	srv->ready_head=(srv->ready_head+1)%srv->total;
+	srv->ready_count--;
+
+	*index=k;
+	*thumb=srv->thumbs[k];
+	srv->thumbs[k]=NULL;
+
+	pthread_mutex_unlock(&srv->lock);
+
+	return 0;
+}
+
+/*-------------------------------------------
+Return true if all jobs are finished.
+-------------------------------------------*/
+bool egi_thumbsrv_finished(EGI_THUMB_SERVICE *srv)
+{
+	bool ret;
+
+	if(srv==NULL)
+		return true;
+
+	pthread_mutex_lock(&srv->lock);
+	ret=( srv->ndone >= srv->total );
+	pthread_mutex_unlock(&srv->lock);
+
+	return ret;
+}
+
+
+/*-------------------------------------------------------------
+Stop all workers and free the service, thumbnails not fetched
+yet are freed also.
+-------------------------------------------------------------*/
+void egi_thumbsrv_free(EGI_THUMB_SERVICE **srv)
+{
+	int i;
+	EGI_THUMB_SERVICE *psrv;
+
+	if(srv==NULL || *srv==NULL)
+		return;
+
+	psrv=*srv;
+
+	pthread_mutex_lock(&psrv->lock);
+	psrv->request_quit=true;
+	pthread_cond_broadcast(&psrv->cond_ready);
+	pthread_mutex_unlock(&psrv->lock);
+
+	for(i=0; i<psrv->nworkers; i++) {
+		if( pthread_join(psrv->workers[i], NULL)!=0 )
+			EGI_PLOG(LOGLV_ERROR, "%s: Fail to join worker %d.\n", __func__, i);
+	}
+
+	EGI_PLOG(LOGLV_INFO, "%s: %d files, cache hits %d, misses %d, fails %d.\n", __func__,
+			psrv->total, psrv->cache_hits, psrv->cache_misses, psrv->fails);
+
+	if(psrv->thumbs) {
+		for(i=0; i<psrv->total; i++)
+			egi_imgbuf_free(psrv->thumbs[i]);
+		free(psrv->thumbs);
+	}
+	free(psrv->ready);
+	free(psrv->status);
+	if(psrv->fpaths)
+		egi_free_buff2D((unsigned char **)psrv->fpaths, psrv->total);
+
+	pthread_cond_destroy(&psrv->cond_ready);
+	pthread_mutex_destroy(&psrv->lock);
+
+	free(psrv);
+	*srv=NULL;
+}
+
+
+/*-------------------------------------------------------------
+Worker thread function.
+Take the first pending job from srv->first_visible, make its
+thumbnail and deliver it.
+-------------------------------------------------------------*/
+static void *egi_thumbsrv_worker(void *arg)
+{
+	EGI_THUMB_SERVICE *srv=(EGI_THUMB_SERVICE *)arg;
+	EGI_IMGBUF *eimg;
+	bool cache_hit;
+	int i,k;
+
+	while(1) {
+		/* Take a job */
+		pthread_mutex_lock(&srv->lock);
+		k=-1;
+		for(i=0; i<srv->total; i++) {
+			if( srv->status[(srv->first_visible+i)%srv->total]==thumb_pending ) {
+				k=(srv->first_visible+i)%srv->total;
+				break;
+			}
+		}
+		if(k<0 || srv->request_quit) {
+			pthread_mutex_unlock(&srv->lock);
+			break;
+		}
+		srv->status[k]=thumb_working;
+		pthread_mutex_unlock(&srv->lock);
+
+		/* Make the thumbnail */
+		eimg=egi_thumb_create(srv->cache_dir[0] ? srv->cache_dir : NULL, srv->fpaths[k],
+									srv->tw, srv->th, &cache_hit);
+
+		/* Deliver */
+		pthread_mutex_lock(&srv->lock);
+		srv->status[k]=thumb_done;
+		srv->ndone++;
+		if(eimg==NULL)
+			srv->fails++;
+		else if(cache_hit)
+			srv->cache_hits++;
+		else
+			srv->cache_misses++;
+
+		if(srv->callback==NULL) {
+			srv->thumbs[k]=eimg;
+			srv->ready[(srv->ready_head+srv->ready_count)%srv->total]=k;
+			srv->ready_count++;
+			pthread_cond_broadcast(&srv->cond_ready);
+			pthread_mutex_unlock(&srv->lock);
+		}
+		else {
+			pthread_cond_broadcast(&srv->cond_ready);
+			pthread_mutex_unlock(&srv->lock);
+			srv->callback(k, srv->fpaths[k], eimg, srv->cb_arg);
+		}
+	}
+
+	return (void *)0;
+}
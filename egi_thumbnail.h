@@ -0,0 +1,120 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Thumbnail service for photo browsing pages.
+
+1. Image files in a directory are decoded by a pool of worker threads,
+   JPG files are decoded with libjpeg DCT scaling(1/2,1/4,1/8), so a
+   big picture never needs to be fully decompressed.
+2. Each thumbnail is saved in a cache directory as a raw RGB565 file
+   with a small header, so it can be mmap()ed directly next time.
+3. A cache entry is keyed by source file path, file size and mtime.
+   If the source file changes, the entry is regenerated.
+4. Finished thumbnails are delivered asynchronously, either by a
+   callback in the worker thread context, or by a ready queue which
+   the page routine polls with egi_thumbsrv_getReady().
+
+Midas Zhou
+-------------------------------------------------------------------*/
+#ifndef __EGI_THUMBNAIL_H__
+#define __EGI_THUMBNAIL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "egi_imgbuf.h"
+#include "egi_utils.h"
+
+#define EGI_THUMB_MAGIC		0x42485445	/* "ETHB" in little endian */
+#define EGI_THUMB_VERSION	1
+#define EGI_THUMB_FEXTNAME	"t565"		/* Extension name of cache files */
+#define EGI_THUMB_WORKERS_MAX	4		/* Max. number of worker threads */
+
+/* Cache file header, followed by width*height RGB565 pixels */
+typedef struct egi_thumb_header {
+	uint32_t	magic;		/* EGI_THUMB_MAGIC */
+	uint16_t	version;	/* EGI_THUMB_VERSION */
+	uint16_t	hdsize;		/* sizeof(EGI_THUMB_HEADER), offset of pixel data */
+	uint16_t	width;		/* Thumbnail size */
+	uint16_t	height;
+	uint32_t	pathhash;	/* Hash value of the source file path */
+	int64_t		fsize;		/* Source file size */
+	int64_t		fmtime;		/* Source file mtime */
+} EGI_THUMB_HEADER;
+
+/* A thumbnail mapped from a cache file */
+typedef struct egi_thumb {
+	int			width;
+	int			height;
+	const EGI_16BIT_COLOR	*color;		/* Pointer to pixel data in the mmap */
+	void			*map;		/* mmap of the cache file */
+	size_t			mapsize;
+} EGI_THUMB;
+
+/* Callback for a finished thumbnail.
+ * Called in a worker thread context, ownership of thumb is taken by the callee.
+ * thumb is NULL if the source file fails to be decoded.
+ */
+typedef void (*EGI_THUMB_CALLBACK)(int index, const char *fpath, EGI_IMGBUF *thumb, void *arg);
+
+enum egi_thumb_status {
+	thumb_pending	=0,
+	thumb_working	=1,
+	thumb_done	=2,
+};
+
+typedef struct egi_thumb_service {
+	char		cache_dir[EGI_PATH_MAX];
+	int		tw;			/* Max. thumbnail size, aspect ratio is kept */
+	int		th;
+
+	char		**fpaths;		/* Source file paths, by egi_alloc_search_files() */
+	int		total;			/* Total number of source files */
+	unsigned char	*status;		/* status[total], enum egi_thumb_status */
+	int		first_visible;		/* Jobs from this index are served first */
+	int		ndone;			/* Number of finished jobs */
+
+	int		*ready;			/* Ring buffer of finished job indexes */
+	EGI_IMGBUF	**thumbs;		/* thumbs[index], finished thumbnails waiting to be fetched */
+	int		ready_head;
+	int		ready_count;
+
+	EGI_THUMB_CALLBACK callback;		/* If set, thumbnails are delivered by callback, NOT by ready queue */
+	void		*cb_arg;
+
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond_ready;		/* Signaled when a thumbnail is ready */
+	pthread_t	workers[EGI_THUMB_WORKERS_MAX];
+	int		nworkers;		/* Number of running workers */
+	bool		request_quit;
+
+	/* Statistics */
+	int		cache_hits;
+	int		cache_misses;
+	int		fails;
+} EGI_THUMB_SERVICE;
+
+
+/* Cache file functions */
+int 		egi_thumb_cachePath(const char *cache_dir, const char *fpath, int tw, int th, char *buff, int size);
+EGI_THUMB*	egi_thumb_mmapFile(const char *cpath, const char *fpath, const struct stat *sb);
+void		egi_thumb_unmap(EGI_THUMB **thumb);
+EGI_IMGBUF*	egi_thumb_toImgbuf(const EGI_THUMB *thumb);
+int		egi_thumb_saveFile(const char *cpath, const EGI_IMGBUF *eimg, const char *fpath, const struct stat *sb);
+EGI_IMGBUF*	egi_thumb_loadjpg(const char *fpath, int tw, int th);
+EGI_IMGBUF*	egi_thumb_create(const char *cache_dir, const char *fpath, int tw, int th, bool *cache_hit);
+
+/* Thumbnail service */
+EGI_THUMB_SERVICE* egi_thumbsrv_create(const char *cache_dir, int tw, int th);
+void	egi_thumbsrv_setCallback(EGI_THUMB_SERVICE *srv, EGI_THUMB_CALLBACK callback, void *arg);
+int 	egi_thumbsrv_scanDir(EGI_THUMB_SERVICE *srv, const char *path, const char *fext, int nworkers);
+void 	egi_thumbsrv_setVisible(EGI_THUMB_SERVICE *srv, int first);
+int 	egi_thumbsrv_getReady(EGI_THUMB_SERVICE *srv, int *index, EGI_IMGBUF **thumb, int timeout_ms);
+bool	egi_thumbsrv_finished(EGI_THUMB_SERVICE *srv);
+void	egi_thumbsrv_free(EGI_THUMB_SERVICE **srv);
+
+#endif
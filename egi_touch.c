@@ -14,6 +14,18 @@ TODO:
    however, other threads may not be able to keep up with it.
    try adjusting tm_delayms()...
 
+2. egi_start_touchread_evdev() starts the other backend, which reads Linux
+   input events(EV_ABS/BTN_TOUCH) of a touch screen through epoll. Touch data
+   goes to a lock-free SPSC ring with monotonic timestamps, and an eventfd is
+   signaled, see egi_touch_eventfd() and egi_touch_waitdata(). The thread
+   sleeps while the pen is up, and egi_touch_getdata() reads out every touch
+   data in order, so no 'pressing' or 'releasing' is missed.
+
+3. egi_touch_record_start() records touch data read out by egi_touch_getdata()
+   to a text file, and egi_start_touchread_replay() starts the third backend,
+   which replays a record through the same ring at the original or a scaled
+   speed, so a page may be benchmarked with the same input again and again.
+
 
 Midas Zhou
 -----------------------------------------------------------------------*/
@@ -26,6 +38,17 @@ Midas Zhou
 #include "egi_touch.h"
 #include <errno.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <linux/input.h>
 
 /* typedef struct egi_touch_data EGI_TOUCH_DATA in "egi.h" */
 static EGI_TOUCH_DATA live_touch_data;  /* !!! TODO & Warning --- Not mutex locked */
@@ -50,6 +73,46 @@ static bool tok_loopread_nowait;	/* If ture, touch_loopread will run nonstop,
 					 * after last data is read out.
 					 */
 
+/* Linux input event backend, see egi_start_touchread_evdev() */
+#define TOUCH_RING_SIZE		256	/* Slots in the touch ring, power of 2 */
+#define TOUCH_EVDEV_HOLDMS	50	/* Interval of repeating 'pressed_hold' while the pen stays still */
+
+static bool 		tok_ring;		/* If true, touch data is read out of the ring, from evdev or a record */
+static int		evdev_fd=-1;		/* Touch screen input device */
+static int		evdev_efd=-1;		/* eventfd, signaled when touch data is pushed to the ring */
+static int		evdev_quitfd=-1;	/* eventfd, to end the evdev or replay thread */
+static bool		evdev_monots;		/* If event times are CLOCK_MONOTONIC */
+static struct input_absinfo evdev_absx;		/* Ranges of ABS_X and ABS_Y */
+static struct input_absinfo evdev_absy;
+
+/* Lock-free ring of touch data, with a single producer(the evdev thread) and a single consumer.
+ * When the ring is full, the producer drops the oldest data by moving tail with CAS, so the
+ * consumer also moves tail with CAS, and discards what it has read if tail was moved under it.
+ */
+static struct {
+	EGI_TOUCH_DATA	data[TOUCH_RING_SIZE];
+	unsigned int	head;			/* Written by the producer only */
+	unsigned int	tail;			/* By the consumer, or by the producer when full */
+	EGI_TOUCH_DATA	last;			/* The last published data, see touch_ring_getlast() */
+	unsigned int	lastseq;		/* Odd while the producer is writing last */
+} touch_ring;
+static enum egi_touch_status ring_last;		/* Status of the last data read out of the ring */
+static struct timespec	ring_idlets;		/* Time of the last 'released_hold' made up, see egi_touch_getdata() */
+
+/* Record and replay, see egi_touch_record_start() and egi_start_touchread_replay() */
+#define TOUCH_RECORD_HEADER	"# EGI touch record v1"
+
+static FILE		*record_fp;		/* Touch data read out by egi_touch_getdata() goes to it */
+static long long	record_t0us;		/* Time of the first recorded data, in us */
+static bool		tok_replay;		/* If true, touch data is replayed from a record */
+static bool		replay_done;		/* All touch data of the record is pushed to the ring */
+static float		replay_speed;		/* Times of the original speed, 0 as fast as possible */
+static EGI_TOUCH_DATA	*replay_data;		/* Touch data of the record, ts as offset to the first one */
+static int		replay_num;
+
+static void *egi_touch_evdev_loopread(void *arg);
+static void *egi_touch_replay_loopread(void *arg);
+
 /*--------------------------------------------------------------
 To check whether it touchs/moves on an EGI_RECTBTN
 
@@ -137,7 +200,8 @@ int egi_touch_timeWait_press( int s, unsigned int ms, EGI_TOUCH_DATA *touch_data
 		tok_loopread_nowait=false;
 
 		/* Reset updated token, as we read out pxy */
-		live_touch_data.updated=false;
+		if(!tok_ring)
+			live_touch_data.updated=false;
 
 		pthread_mutex_unlock(&mutex_lockCond);
 /*  --- <<<   Critical Zone  */
@@ -237,7 +301,8 @@ int egi_touch_timeWait_release(int s, unsigned int ms, EGI_TOUCH_DATA *touch_dat
 		tok_loopread_nowait=false;
 
 		/* Reset updated token, as we read out pxy */
-		live_touch_data.updated=false;
+		if(!tok_ring)
+			live_touch_data.updated=false;
 
 		pthread_mutex_unlock(&mutex_lockCond);
 /*  --- <<<   Critical Zone  */
@@ -285,6 +350,240 @@ void egi_touchread_nowait(bool nowait)
 	tok_loopread_nowait=nowait;
 }
 
+/*-----------------------------------------------------
+Push touch data to the ring, by the evdev thread.
+If the ring is full, the oldest data is dropped, so the
+newest touch status always gets to the consumer.
+
+Return:
+	true	OK
+	false	The ring is full, the oldest data is dropped.
+------------------------------------------------------*/
+static bool touch_ring_push(const EGI_TOUCH_DATA *data)
+{
+	unsigned int head=touch_ring.head;
+	unsigned int tail=__atomic_load_n(&touch_ring.tail, __ATOMIC_ACQUIRE);
+	bool dropped=false;
+
+	/* If CAS fails, the consumer has just read out one, and there is room now */
+	if( head-tail==TOUCH_RING_SIZE )
+		dropped=__atomic_compare_exchange_n(&touch_ring.tail, &tail, tail+1, false,
+							__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+
+	touch_ring.data[head&(TOUCH_RING_SIZE-1)]=*data;
+	__atomic_store_n(&touch_ring.head, head+1, __ATOMIC_RELEASE);
+
+	return !dropped;
+}
+
+/*-----------------------------------------------------
+Keep the last published data, by the ring producer.
+Readers take it with touch_ring_getlast(), and retry
+if lastseq is odd or changed.
+------------------------------------------------------*/
+static void touch_ring_setlast(const EGI_TOUCH_DATA *data)
+{
+	unsigned int seq=touch_ring.lastseq;
+
+	__atomic_store_n(&touch_ring.lastseq, seq+1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	touch_ring.last=*data;
+	__atomic_store_n(&touch_ring.lastseq, seq+2, __ATOMIC_RELEASE);
+}
+
+/*-----------------------------------------------------
+Get a consistent copy of the last published data.
+------------------------------------------------------*/
+static void touch_ring_getlast(EGI_TOUCH_DATA *data)
+{
+	unsigned int seq;
+
+	do {
+		seq=__atomic_load_n(&touch_ring.lastseq, __ATOMIC_ACQUIRE);
+		*data=touch_ring.last;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while( (seq&1) || __atomic_load_n(&touch_ring.lastseq, __ATOMIC_RELAXED)!=seq );
+}
+
+/*-----------------------------------------------------
+Make up 'released_hold' at the last published point,
+for when the pen is up and the ring is empty.
+------------------------------------------------------*/
+static void touch_ring_released(EGI_TOUCH_DATA *data, const struct timespec *ts)
+{
+	touch_ring_getlast(data);
+	data->status=released_hold;
+	data->dx=0;
+	data->dy=0;
+	data->ts=*ts;
+	data->updated=true;
+}
+
+/*-------------------------------------------------
+Read out touch data from the ring, or just peek it.
+Return:
+	true	OK
+	false	The ring is empty.
+--------------------------------------------------*/
+static bool touch_ring_pop(EGI_TOUCH_DATA *data, bool peek)
+{
+	EGI_TOUCH_DATA rdata;
+	unsigned int tail=__atomic_load_n(&touch_ring.tail, __ATOMIC_ACQUIRE);
+	unsigned int head;
+
+	/* If the producer drops the slot while it's being read, tail moves, read again. */
+	for(;;) {
+		head=__atomic_load_n(&touch_ring.head, __ATOMIC_ACQUIRE);
+		if(head==tail)
+			return false;
+
+		rdata=touch_ring.data[tail&(TOUCH_RING_SIZE-1)];
+		if(peek) {
+			if( __atomic_load_n(&touch_ring.tail, __ATOMIC_ACQUIRE)==tail )
+				break;
+			tail=__atomic_load_n(&touch_ring.tail, __ATOMIC_ACQUIRE);
+		}
+		else if( __atomic_compare_exchange_n(&touch_ring.tail, &tail, tail+1, false,
+							__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ) {
+			break;
+		}
+	}
+
+	if(data!=NULL)
+		*data=rdata;
+
+	return true;
+}
+
+/*-----------------------------------------------------------
+Wait until the ring has data. The eventfd is cleared before
+checking the ring, so a push after the check always wakes
+up poll().
+
+@ms:	Timeout in ms, <0 persistent wait.
+Return:
+	0	OK
+	>0	Time out
+	<0	Fails
+------------------------------------------------------------*/
+static int touch_ring_wait(int ms)
+{
+	struct pollfd pfd;
+	uint64_t count;
+	int ret;
+
+	pfd.fd=evdev_efd;
+	pfd.events=POLLIN;
+	while( __atomic_load_n(&touch_ring.head, __ATOMIC_ACQUIRE)==__atomic_load_n(&touch_ring.tail, __ATOMIC_ACQUIRE) ) {
+		ret=poll(&pfd, 1, ms);
+		if(ret==0)
+			return 1;
+		else if(ret<0 && errno!=EINTR)
+			return -1;
+		if( read(evdev_efd, &count, sizeof(count))<0 && errno!=EAGAIN )
+			return -2;
+	}
+
+	return 0;
+}
+
+/*-----------------------------------------------------------------
+Publish touch data of a ring backend: push it to the ring, signal
+the eventfd, and wake up egi_touch_timeWait_press()/_release().
+
+Return:
+	true	OK
+	false	The ring is full, the oldest data is dropped.
+------------------------------------------------------------------*/
+static bool touch_ring_publish(const EGI_TOUCH_DATA *data)
+{
+	uint64_t one=1;
+	bool down;
+	bool ret;
+
+	down = ( data->status==pressing || data->status==db_pressing || data->status==pressed_hold );
+
+	touch_ring_setlast(data);
+	ret=touch_ring_push(data);
+	if( write(evdev_efd, &one, sizeof(one))<0 )
+		EGI_PDEBUG(DBG_TOUCH,"Fail to write evdev_efd.\n");
+
+	/* set/reset flag_cond AND send cond signal simultaneously */
+	if( (data->status!=pressed_hold && flag_cond==(down?0:1)) ) {
+		if( pthread_mutex_lock(&mutex_lockCond) ==0 ) {
+			flag_cond = down ? 1 : 0;
+			wtouch_data=*data;
+			pthread_cond_signal(&cond_touch);
+			pthread_mutex_unlock(&mutex_lockCond);
+		}
+	}
+
+	return ret;
+}
+
+/*-----------------------------------------------------------
+Prepare eventfds, mutex/cond and the ring for a ring backend,
+before its thread is created.
+
+Return:
+	0	OK
+	<0	Fails
+------------------------------------------------------------*/
+static int touch_ring_open(void)
+{
+	evdev_efd=eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+	evdev_quitfd=eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+	if(evdev_efd<0 || evdev_quitfd<0) {
+		printf("%s: Fail to create eventfd: %s\n", __func__, strerror(errno));
+		goto END_FAIL;
+	}
+
+	/* initiliaze pthread mutex cond */
+	if( pthread_mutex_init(&mutex_lockCond,NULL) != 0 ) {
+                printf("%s: Fail to initialize mutex_lockCond!\n", __func__);
+		goto END_FAIL;
+	}
+	if( pthread_cond_init(&cond_touch, NULL) !=0 ) {
+                printf("%s: Fail to initialize cond_touch!\n", __func__);
+		pthread_mutex_destroy(&mutex_lockCond);
+		goto END_FAIL;
+	}
+	/* reset cond flag */
+	flag_cond=0;
+
+	touch_ring.head=0;
+	touch_ring.tail=0;
+	ring_last=released_hold;
+	memset(&touch_ring.last, 0, sizeof(touch_ring.last));
+	touch_ring.last.status=released_hold;
+	touch_ring.lastseq=0;
+	cmd_end_loopread=false;
+	tok_ring=true;
+
+	return 0;
+
+END_FAIL:
+	if(evdev_efd>=0)
+		close(evdev_efd);
+	if(evdev_quitfd>=0)
+		close(evdev_quitfd);
+	evdev_efd=evdev_quitfd=-1;
+	return -1;
+}
+
+/*-------------------------------------------------
+Close eventfds of a ring backend, after the thread
+is joined and mutex/cond are destroyed.
+--------------------------------------------------*/
+static void touch_ring_close(void)
+{
+	close(evdev_efd);
+	close(evdev_quitfd);
+	evdev_efd=evdev_quitfd=-1;
+	tok_ring=false;
+}
+
+
 /*-----------------------------------
 Start touch_loopread thread.
 
@@ -328,6 +627,358 @@ int egi_start_touchread(void)
 }
 
 
+/*------------------------------------------------------------------
+Find a touch screen input device, which reports BTN_TOUCH and ABS_X
+or ABS_MT_POSITION_X.
+
+@path:	To pass out the device path.
+Return:
+	0	OK
+	<0	Fails
+-------------------------------------------------------------------*/
+static int egi_touch_find_evdev(char *path, size_t size)
+{
+	unsigned long keybits[KEY_MAX/(8*sizeof(long))+1];
+	unsigned long absbits[ABS_MAX/(8*sizeof(long))+1];
+	int fd;
+	int i;
+
+	#define TEST_BIT(bits, n)  ( (bits[(n)/(8*sizeof(long))]>>((n)%(8*sizeof(long))))&1 )
+	for(i=0; i<32; i++) {
+		snprintf(path, size, "/dev/input/event%d", i);
+		fd=open(path, O_RDONLY|O_CLOEXEC);
+		if(fd<0)
+			continue;
+		memset(keybits, 0, sizeof(keybits));
+		memset(absbits, 0, sizeof(absbits));
+		ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keybits)), keybits);
+		ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absbits)), absbits);
+		close(fd);
+		if( TEST_BIT(keybits, BTN_TOUCH) && ( TEST_BIT(absbits, ABS_X) || TEST_BIT(absbits, ABS_MT_POSITION_X) ) )
+			return 0;
+	}
+	#undef TEST_BIT
+
+	return -1;
+}
+
+/*--------------------------------------------------------------------
+Start the evdev touch backend, instead of egi_start_touchread().
+A thread reads input events of the touch screen through epoll, and
+maps ABS_X/ABS_Y to tft-LCD coordinates in the same way as XPT2046.
+egi_touch_getdata() then reads out touch data from a ring in order.
+
+@devpath:	Path of the input device, as "/dev/input/event0".
+		If NULL, the first touch screen found is taken.
+Return:
+	0	Ok
+	<0	Fails
+---------------------------------------------------------------------*/
+int egi_start_touchread_evdev(const char *devpath)
+{
+	char path[64];
+	int clkid=CLOCK_MONOTONIC;
+
+	if(tok_loopread_running) {
+		printf("%s: Touch read thread is running already!\n", __func__);
+		return -1;
+	}
+
+	if(devpath==NULL) {
+		if( egi_touch_find_evdev(path, sizeof(path))!=0 ) {
+			printf("%s: No touch screen input device found!\n", __func__);
+			return -1;
+		}
+		devpath=path;
+	}
+
+	evdev_fd=open(devpath, O_RDONLY|O_NONBLOCK|O_CLOEXEC);
+	if(evdev_fd<0) {
+		printf("%s: Fail to open '%s': %s\n", __func__, devpath, strerror(errno));
+		return -1;
+	}
+
+	/* Ranges of X and Y, or take them as tft-LCD coordinates already */
+	if( ioctl(evdev_fd, EVIOCGABS(ABS_X), &evdev_absx)<0 || evdev_absx.maximum<=evdev_absx.minimum ) {
+		if( ioctl(evdev_fd, EVIOCGABS(ABS_MT_POSITION_X), &evdev_absx)<0 || evdev_absx.maximum<=evdev_absx.minimum ) {
+			evdev_absx.minimum=0;
+			evdev_absx.maximum=LCD_SIZE_X-1;
+		}
+	}
+	if( ioctl(evdev_fd, EVIOCGABS(ABS_Y), &evdev_absy)<0 || evdev_absy.maximum<=evdev_absy.minimum ) {
+		if( ioctl(evdev_fd, EVIOCGABS(ABS_MT_POSITION_Y), &evdev_absy)<0 || evdev_absy.maximum<=evdev_absy.minimum ) {
+			evdev_absy.minimum=0;
+			evdev_absy.maximum=LCD_SIZE_Y-1;
+		}
+	}
+
+	/* Let event times be CLOCK_MONOTONIC, or stamp them when they are read */
+	evdev_monots=false;
+	#ifdef EVIOCSCLOCKID
+	if( ioctl(evdev_fd, EVIOCSCLOCKID, &clkid)==0 )
+		evdev_monots=true;
+	#endif
+	(void)clkid;
+
+	if( touch_ring_open()!=0 ) {
+		close(evdev_fd);
+		evdev_fd=-1;
+		return -2;
+	}
+
+	/* start touch_read thread */
+        if( pthread_create(&thread_loopread, NULL, egi_touch_evdev_loopread, NULL) !=0 ) {
+                printf("%s: Fail to create touch_read thread!\n", __func__);
+		pthread_cond_destroy(&cond_touch);
+		pthread_mutex_destroy(&mutex_lockCond);
+		touch_ring_close();
+		close(evdev_fd);
+		evdev_fd=-1;
+		return -3;
+        }
+
+	/* reset token */
+	tok_loopread_running=true;
+
+	printf("%s: Read touch events from '%s'.\n", __func__, devpath);
+	return 0;
+}
+
+/*---------------------------------------------------------
+Parse a touch status name, as egi_str_touch_status() gives.
+Return:
+	The status, or undefined if unknown.
+----------------------------------------------------------*/
+static enum egi_touch_status touch_parse_status(const char *name)
+{
+	int i;
+
+	for(i=unkown; i<undefined; i++) {
+		if( strcmp(name, egi_str_touch_status(i))==0 )
+			return i;
+	}
+
+	return undefined;
+}
+
+/*----------------------------------------------------------------
+Load a touch record to replay_data[], see egi_touch_record_start().
+
+Return:
+	0	OK
+	<0	Fails
+-----------------------------------------------------------------*/
+static int touch_replay_load(const char *fpath)
+{
+	FILE *fp;
+	char line[128];
+	char name[32];
+	EGI_TOUCH_DATA *more;
+	EGI_TOUCH_DATA data;
+	long long us;
+	int capacity=0;
+	int nline=0;
+
+	fp=fopen(fpath, "r");
+	if(fp==NULL) {
+		printf("%s: Fail to open '%s': %s\n", __func__, fpath, strerror(errno));
+		return -1;
+	}
+
+	replay_num=0;
+	while( fgets(line, sizeof(line), fp)!=NULL ) {
+		nline++;
+		if(line[0]=='#' || line[0]=='\n')
+			continue;
+
+		memset(&data, 0, sizeof(data));
+		if( sscanf(line, "%lld %31s %d %d %d %d", &us, name, &data.coord.x, &data.coord.y, &data.dx, &data.dy)!=6
+		    || us<0 || (data.status=touch_parse_status(name))==undefined ) {
+			printf("%s: Invalid touch data at line %d of '%s'.\n", __func__, nline, fpath);
+			goto END_FAIL;
+		}
+		data.updated=true;
+		data.ts.tv_sec=us/1000000;
+		data.ts.tv_nsec=us%1000000*1000;
+
+		if(replay_num==capacity) {
+			capacity = capacity>0 ? capacity*2 : 256;
+			more=realloc(replay_data, capacity*sizeof(EGI_TOUCH_DATA));
+			if(more==NULL) {
+				printf("%s: Fail to realloc replay_data!\n", __func__);
+				goto END_FAIL;
+			}
+			replay_data=more;
+		}
+		replay_data[replay_num++]=data;
+	}
+
+	fclose(fp);
+	return 0;
+
+END_FAIL:
+	fclose(fp);
+	free(replay_data);
+	replay_data=NULL;
+	replay_num=0;
+	return -2;
+}
+
+/*--------------------------------------------------------------------
+Start the replay touch backend, instead of egi_start_touchread().
+A thread pushes touch data of a record to the ring at their recorded
+times, and egi_touch_getdata() reads them out in order, as the evdev
+backend does. Touch data is stamped with the time it's pushed, and
+all data of the record is read out when egi_touch_replay_done().
+
+Note: Gestures depend on the time between touch data, so replay at
+the original speed if a page takes gestures.
+
+@fpath:		Path of the record, see egi_touch_record_start().
+@speed:		Times of the original speed, as 4.0 for 4 times faster.
+		If 0, replay as fast as the ring is read out.
+Return:
+	0	Ok
+	<0	Fails
+---------------------------------------------------------------------*/
+int egi_start_touchread_replay(const char *fpath, float speed)
+{
+	if(fpath==NULL || speed<0)
+		return -1;
+
+	if(tok_loopread_running) {
+		printf("%s: Touch read thread is running already!\n", __func__);
+		return -1;
+	}
+
+	if( touch_replay_load(fpath)!=0 )
+		return -2;
+
+	if( touch_ring_open()!=0 ) {
+		free(replay_data);
+		replay_data=NULL;
+		return -3;
+	}
+	replay_speed=speed;
+	replay_done=false;
+	tok_replay=true;
+
+	/* start touch_read thread */
+        if( pthread_create(&thread_loopread, NULL, egi_touch_replay_loopread, NULL) !=0 ) {
+                printf("%s: Fail to create touch_read thread!\n", __func__);
+		pthread_cond_destroy(&cond_touch);
+		pthread_mutex_destroy(&mutex_lockCond);
+		touch_ring_close();
+		free(replay_data);
+		replay_data=NULL;
+		tok_replay=false;
+		return -4;
+        }
+
+	/* reset token */
+	tok_loopread_running=true;
+
+	printf("%s: Replay %d touch data from '%s'.\n", __func__, replay_num, fpath);
+	return 0;
+}
+
+/*----------------------------------------------------------
+Check if all touch data of the record has been read out,
+for the replay backend.
+-----------------------------------------------------------*/
+bool egi_touch_replay_done(void)
+{
+	if(!tok_replay)
+		return false;
+
+	return __atomic_load_n(&replay_done, __ATOMIC_ACQUIRE)
+		&& __atomic_load_n(&touch_ring.head, __ATOMIC_ACQUIRE)==__atomic_load_n(&touch_ring.tail, __ATOMIC_ACQUIRE);
+}
+
+/*--------------------------------------------------------------------
+Start to record touch data read out by egi_touch_getdata(), of any
+backend, to a text file. Each line has time in us since the first
+data, status, coord x,y and dx,dy, as:
+	# EGI touch record v1
+	0 pressing 120 80 0 0
+	16833 pressed_hold 122 86 2 6
+'released_hold' is not recorded, for the backends make it up while
+the pen is up.
+
+Note: Call it in the thread which calls egi_touch_getdata().
+
+@fpath:		Path of the record, it will be truncated.
+Return:
+	0	Ok
+	<0	Fails
+---------------------------------------------------------------------*/
+int egi_touch_record_start(const char *fpath)
+{
+	if(fpath==NULL)
+		return -1;
+
+	if(record_fp!=NULL) {
+		printf("%s: Touch data is being recorded already!\n", __func__);
+		return -1;
+	}
+
+	record_fp=fopen(fpath, "w");
+	if(record_fp==NULL) {
+		printf("%s: Fail to open '%s': %s\n", __func__, fpath, strerror(errno));
+		return -2;
+	}
+	fprintf(record_fp, "%s\n", TOUCH_RECORD_HEADER);
+	record_t0us=-1;
+
+	return 0;
+}
+
+/*------------------------------------------
+Stop recording touch data, and close the
+record file.
+Return:
+	0	Ok
+	<0	Fails
+	>0	Not recording.
+------------------------------------------*/
+int egi_touch_record_stop(void)
+{
+	int ret;
+
+	if(record_fp==NULL)
+		return 1;
+
+	ret=fclose(record_fp);
+	record_fp=NULL;
+	if(ret!=0) {
+		printf("%s: Fail to close the record: %s\n", __func__, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Write touch data to the record */
+static void touch_record(const EGI_TOUCH_DATA *data)
+{
+	struct timespec ts;
+	long long us;
+
+	if(data->status==released_hold)
+		return;
+
+	ts=data->ts;
+	if(ts.tv_sec==0 && ts.tv_nsec==0)
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+	us=ts.tv_sec*1000000LL+ts.tv_nsec/1000;
+	if(record_t0us<0)
+		record_t0us=us;
+
+	fprintf(record_fp, "%lld %s %d %d %d %d\n", us-record_t0us, egi_str_touch_status(data->status),
+			data->coord.x, data->coord.y, data->dx, data->dy);
+}
+
+
 /*-----------------------------------
 Stop touch read thread.
 Return:
@@ -344,6 +995,11 @@ int egi_end_touchread(void)
 
 	/* Set indicator to end loopread */
 	cmd_end_loopread=true;
+	if(tok_ring) {
+		uint64_t one=1;
+		if( write(evdev_quitfd, &one, sizeof(one))<0 )
+			printf("%s: Fail to write evdev_quitfd: %s\n", __func__, strerror(errno));
+	}
 
 	/* Wait to join touch_loopread thread */
 	if( pthread_join(thread_loopread, NULL) !=0 ) {
@@ -363,8 +1019,23 @@ int egi_end_touchread(void)
 		ret-=4;
 	}
 
-	/* close SPI dev */
-	SPI_Close();
+	/* close input dev or the record, or SPI dev */
+	if(tok_ring) {
+		touch_ring_close();
+		if(evdev_fd>=0)
+			close(evdev_fd);
+		evdev_fd=-1;
+		free(replay_data);
+		replay_data=NULL;
+		tok_replay=false;
+	}
+	else {
+		SPI_Close();
+		xpt_close_penirq();
+	}
+
+	cmd_end_loopread=false;
+	tok_loopread_running=false;
 
 	return ret;
 }
@@ -387,6 +1058,35 @@ return:
 ------------------------------------------*/
 bool egi_touch_getdata(EGI_TOUCH_DATA *data)
 {
+	EGI_TOUCH_DATA rdata;
+	struct timespec ts;
+
+	/* Read out the ring in order, for the evdev and replay backends */
+	if(tok_ring) {
+		if( touch_ring_pop(&rdata, false) ) {
+			ring_last=rdata.status;
+		}
+		else {
+			/* Make up 'released_hold' every TOUCH_EVDEV_HOLDMS while the pen is up, as
+			 * egi_touch_loopread() does, so page routines still run their idle jobs.
+			 */
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			if( ring_last==pressing || ring_last==db_pressing || ring_last==pressed_hold
+			    || (ts.tv_sec-ring_idlets.tv_sec)*1000+(ts.tv_nsec-ring_idlets.tv_nsec)/1000000 < TOUCH_EVDEV_HOLDMS ) {
+				if(data != NULL)
+					data->updated=false;
+				return false;
+			}
+			ring_idlets=ts;
+			touch_ring_released(&rdata, &ts);
+		}
+		if(data!=NULL)
+			*data=rdata;
+		if(record_fp!=NULL)
+			touch_record(&rdata);
+		return true;
+	}
+
 	if(!live_touch_data.updated) {
 		if(data != NULL)
 			data->updated=false;
@@ -396,6 +1096,8 @@ bool egi_touch_getdata(EGI_TOUCH_DATA *data)
 	/* pass data, directly assign */
 	if(data!=NULL)
 		*data=live_touch_data;
+	if(record_fp!=NULL)
+		touch_record(&live_touch_data);
 
 	/* reset update flag */
 	live_touch_data.updated=false;
@@ -406,6 +1108,60 @@ bool egi_touch_getdata(EGI_TOUCH_DATA *data)
 }
 
 
+/*---------------------------------------------------------------
+Get the eventfd of the evdev backend. It's readable when touch
+data comes, so a page loop may poll/epoll it with other fds.
+Read it out before egi_touch_getdata() till it returns false.
+
+Return:
+	>=0	The eventfd
+	<0	Not the evdev backend.
+----------------------------------------------------------------*/
+int egi_touch_eventfd(void)
+{
+	return tok_ring ? evdev_efd : -1;
+}
+
+/*---------------------------------------------------------------
+Wait for touch data and read it out.
+For the evdev and replay backends, it sleeps on the eventfd, and for XPT2046
+it checks the data every 2ms.
+
+@data:	To pass out touch data.
+@ms:	Timeout in ms, <0 persistent wait.
+
+Return:
+	0	OK
+	>0	Time out
+	<0	Fails
+----------------------------------------------------------------*/
+int egi_touch_waitdata(EGI_TOUCH_DATA *data, int ms)
+{
+	int ret;
+
+	if(!tok_loopread_running)
+		return -1;
+
+	if(tok_ring) {
+		ret=touch_ring_wait(ms);
+		if(ret!=0)
+			return ret;
+		egi_touch_getdata(data);
+		return 0;
+	}
+
+	while(!egi_touch_getdata(data)) {
+		if(ms==0)
+			return 1;
+        	tm_delayms(2);
+		if(ms>0)
+			ms = ms>2 ? ms-2 : 0;
+	}
+
+	return 0;
+}
+
+
 /*---------------------------------------------------------------
 Map touch data(coord,dx,dy) to the same coord sys as current
 FBDEV's pos_rotate set.
@@ -484,6 +1240,24 @@ Check the touch data, but do NOT read out.
 ------------------------------------------*/
 EGI_TOUCH_DATA egi_touch_peekdata(void)
 {
+	EGI_TOUCH_DATA data={0};
+	struct timespec ts;
+
+	/* The ring is empty while the pen is up, so wait no longer than a hold interval,
+	 * then take the last published data, as 'released_hold' if the pen is up.
+	 */
+	if(tok_ring) {
+		if( touch_ring_wait(TOUCH_EVDEV_HOLDMS)==0 && touch_ring_pop(&data, true) )
+			return data;
+
+		touch_ring_getlast(&data);
+		if( data.status!=pressing && data.status!=db_pressing && data.status!=pressed_hold ) {
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			touch_ring_released(&data, &ts);
+		}
+		return data;
+	}
+
 	while(!live_touch_data.updated) {
         	tm_delayms(2);
 	}
@@ -497,6 +1271,9 @@ Usually use it to check touch_slide condition.
 ---------------------------------------------*/
 inline int egi_touch_peekdx(void)
 {
+	if(tok_ring)
+		return egi_touch_peekdata().dx;
+
 	while(!live_touch_data.updated) {
         	tm_delayms(2);
 	}
@@ -510,6 +1287,9 @@ Usually use it to check touch_slide condition.
 ---------------------------------------------*/
 inline int egi_touch_peekdy(void)
 {
+	if(tok_ring)
+		return egi_touch_peekdata().dy;
+
 	while(!live_touch_data.updated) {
         	tm_delayms(2);
 	}
@@ -524,6 +1304,17 @@ Usually use it to check touch_slide condition.
 -----------------------------------------------*/
 inline void egi_touch_peekdxdy(int *dx, int *dy)
 {
+	EGI_TOUCH_DATA data;
+
+	if(tok_ring) {
+		data=egi_touch_peekdata();
+		if(dx != NULL)
+			*dx=data.dx;
+		if(dy != NULL)
+			*dy=data.dy;
+		return;
+	}
+
 	while(!live_touch_data.updated) {
         	tm_delayms(2);
 	}
@@ -540,6 +1331,9 @@ Check the touch status, but do NOT read out.
 ------------------------------------------*/
 enum egi_touch_status egi_touch_peekstatus(void)
 {
+	if(tok_ring)
+		return egi_touch_peekdata().status;
+
 	while(!live_touch_data.updated) {
         	tm_delayms(2);
 	}
@@ -576,8 +1370,9 @@ void *egi_touch_loopread(void)
 	live_touch_data.dy=0;
 	live_touch_data.status=released_hold;
 
-	/* Init. calibrated factors */
+	/* Init. calibrated factors and the sampler */
 	xpt_init_factors();
+	xpt_init_sampler();
 
 	/* Loop touch reading... */
 	while(1)
@@ -599,16 +1394,26 @@ enum egi_touch_status 	 !!! --- TO see lateset in egi.h --- !!!
 			break;
 		}
 
-	        /* 1. Necessary wait,just for XPT to prepare data */
-        	tm_delayms(2);
-
 		/* Wait .... until read out,  AND NOT nowait mode */
-		if( live_touch_data.updated==true && !tok_loopread_nowait )
+		if( live_touch_data.updated==true && !tok_loopread_nowait ) {
+			tm_delayms(xpt_period_ms(true));
 			continue;
+		}
+
+	        /* 1. Wait for the next sample: at the idle rate, or until PENIRQ if it's available,
+		 *    when untouched, and at the active rate when touched.
+		 */
+		if(last_status==released_hold) {
+			if( xpt_wait_penirq(1000)<0 )
+				tm_delayms(xpt_period_ms(false));
+		}
+		else {
+			tm_delayms(xpt_period_ms(true));
+		}
 
 		/* 2. Read XPT to get avg tft-LCD coordinate */
         	//printf("start xpt_getavt_xy() \n");
-        	ret=xpt_getavg_xy(&sx,&sy); /* if fail to get touched tft-LCD xy */
+        	ret=xpt_getfilt_xy(&sx,&sy); /* if fail to get touched tft-LCD xy */
 		sxy.x=sx; sxy.y=sy;
 
         	/* 3. touch reading is going on... */
@@ -624,6 +1429,7 @@ enum egi_touch_status 	 !!! --- TO see lateset in egi.h --- !!!
                	/* 4. put PEN-UP status events here */
                 else if(ret == XPT_READ_STATUS_PENUP )
                 {
+			clock_gettime(CLOCK_MONOTONIC, &live_touch_data.ts);
                         if(last_status==pressing || last_status==db_pressing || last_status==pressed_hold)
                         {
                                 last_status=releasing; /* or db_releasing */
@@ -671,12 +1477,13 @@ enum egi_touch_status 	 !!! --- TO see lateset in egi.h --- !!!
 				last_y=0;
 			}
 
-                        tm_delayms(40); //100);/* hold on for a while to relive CPU load, or the screen will be ...heheheheheh... */
+                        /* Sampling rate drops to the idle rate after 'releasing', see 1. */
                 }
 
 		/* 5. get touch coordinates and trigger actions for the hit button if any */
 		else if(ret == XPT_READ_STATUS_COMPLETE) /* touch action detected */
 		{
+			clock_gettime(CLOCK_MONOTONIC, &live_touch_data.ts);
                         /* CASE HOLD_ON: check if hold on */
                         if( last_status==pressing || last_status==db_pressing || last_status==pressed_hold )
                         {
@@ -750,3 +1557,219 @@ enum egi_touch_status 	 !!! --- TO see lateset in egi.h --- !!!
 }
 
 
+
+
+/*-----------------------------------------------------------------
+Update touch data for a frame of input events(till SYN_REPORT), push
+it to the ring and signal the eventfd, by the evdev thread.
+
+@down:	  If the pen is down.
+@rx,ry:	  ABS_X and ABS_Y of the frame.
+@ts:	  CLOCK_MONOTONIC time of the frame.
+------------------------------------------------------------------*/
+static void egi_touch_evdev_report(bool down, int rx, int ry, const struct timespec *ts)
+{
+	static bool last_down;
+	static EGI_POINT start;			/* Where the pen presses down */
+	static struct timespec ts_press;	/* Last pressing time */
+	EGI_TOUCH_DATA data;
+	long tus;
+
+	if(!down && !last_down)
+		return;
+
+	/* Map to tft-LCD coordinates */
+	data.coord.x=(long)(rx-evdev_absx.minimum)*(LCD_SIZE_X-1)/(evdev_absx.maximum-evdev_absx.minimum);
+	data.coord.y=(long)(ry-evdev_absy.minimum)*(LCD_SIZE_Y-1)/(evdev_absy.maximum-evdev_absy.minimum);
+	data.ts=*ts;
+	data.updated=true;
+
+	if(down && !last_down) {
+		/* pressing, or double click */
+		if( ts->tv_sec-ts_press.tv_sec > 1 )
+			tus=TM_DBCLICK_INTERVAL;
+		else
+			tus=(ts->tv_sec-ts_press.tv_sec)*1000000+(ts->tv_nsec-ts_press.tv_nsec)/1000;
+		data.status = ( tus < TM_DBCLICK_INTERVAL ) ? db_pressing : pressing;
+		ts_press=*ts;
+		start=data.coord;
+		data.dx=0;
+		data.dy=0;
+	}
+	else {
+		/* pressed_hold or releasing, with sliding deviation */
+		data.status = down ? pressed_hold : releasing;
+		data.dx=data.coord.x-start.x;
+		data.dy=data.coord.y-start.y;
+	}
+	last_down=down;
+
+	if( !touch_ring_publish(&data) )
+		EGI_PDEBUG(DBG_TOUCH,"Touch ring is full, drop the oldest touch data.\n");
+}
+
+/* ------------------     A Thread Function    ----------------------
+Read input events of the touch screen through epoll, and report touch
+data for each frame. It sleeps while the pen is up, and repeats
+'pressed_hold' every TOUCH_EVDEV_HOLDMS while the pen stays still.
+--------------------------------------------------------------------*/
+static void *egi_touch_evdev_loopread(void *arg)
+{
+	struct input_event ies[64];
+	struct epoll_event ev, evs[2];
+	struct timespec ts;
+	int epfd;
+	int rx=0, ry=0;
+	bool down=false;
+	bool dropped=false;	/* Events are dropped by the kernel, till next SYN_REPORT */
+	unsigned long keybits[KEY_MAX/(8*sizeof(long))+1];
+	struct input_absinfo abs;
+	int nev, nread;
+	int i, k;
+
+	epfd=epoll_create(2);
+	if(epfd<0) {
+		printf("%s: Fail to create epoll: %s\n", __func__, strerror(errno));
+		return (void *)-1;
+	}
+	memset(&ev, 0, sizeof(ev));
+	ev.events=EPOLLIN;
+	ev.data.fd=evdev_fd;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, evdev_fd, &ev);
+	ev.data.fd=evdev_quitfd;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, evdev_quitfd, &ev);
+
+	while(!cmd_end_loopread) {
+		nev=epoll_wait(epfd, evs, 2, down ? TOUCH_EVDEV_HOLDMS : -1);
+		if(nev<0) {
+			if(errno==EINTR)
+				continue;
+			printf("%s: epoll_wait fails: %s\n", __func__, strerror(errno));
+			break;
+		}
+
+		/* The pen stays still */
+		if(nev==0) {
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			egi_touch_evdev_report(down, rx, ry, &ts);
+			continue;
+		}
+
+		for(k=0; k<nev; k++) {
+			if(evs[k].data.fd==evdev_quitfd)
+				goto END_FUNC;
+
+			while( (nread=read(evdev_fd, ies, sizeof(ies))) > 0 ) {
+				if(!evdev_monots)
+					clock_gettime(CLOCK_MONOTONIC, &ts);
+
+				for(i=0; i<nread/(int)sizeof(struct input_event); i++) {
+					if(ies[i].type==EV_SYN && ies[i].code==SYN_DROPPED) {
+						dropped=true;
+						continue;
+					}
+					if(dropped) {
+						if(ies[i].type!=EV_SYN || ies[i].code!=SYN_REPORT)
+							continue;
+						/* Get current state after the drop */
+						dropped=false;
+						memset(keybits, 0, sizeof(keybits));
+						if( ioctl(evdev_fd, EVIOCGKEY(sizeof(keybits)), keybits)>=0 )
+							down=(keybits[BTN_TOUCH/(8*sizeof(long))]>>(BTN_TOUCH%(8*sizeof(long))))&1;
+						if( ioctl(evdev_fd, EVIOCGABS(ABS_X), &abs)>=0 )
+							rx=abs.value;
+						if( ioctl(evdev_fd, EVIOCGABS(ABS_Y), &abs)>=0 )
+							ry=abs.value;
+					}
+
+					switch(ies[i].type) {
+					case EV_ABS:
+						if(ies[i].code==ABS_X || ies[i].code==ABS_MT_POSITION_X)
+							rx=ies[i].value;
+						else if(ies[i].code==ABS_Y || ies[i].code==ABS_MT_POSITION_Y)
+							ry=ies[i].value;
+						break;
+					case EV_KEY:
+						if(ies[i].code==BTN_TOUCH)
+							down = ies[i].value!=0;
+						break;
+					case EV_SYN:
+						if(ies[i].code==SYN_REPORT) {
+							if(evdev_monots) {
+								ts.tv_sec=ies[i].time.tv_sec;
+								ts.tv_nsec=ies[i].time.tv_usec*1000;
+							}
+							egi_touch_evdev_report(down, rx, ry, &ts);
+						}
+						break;
+					}
+				}
+			}
+
+			/* The device is gone */
+			if( nread==0 || (nread<0 && errno!=EAGAIN && errno!=EINTR) ) {
+				printf("%s: Touch device is closed: %s\n", __func__, nread==0 ? "EOF" : strerror(errno));
+				goto END_FUNC;
+			}
+		}
+	}
+
+END_FUNC:
+	close(epfd);
+	return (void *)0;
+}
+
+
+/* ------------------     A Thread Function    ----------------------
+Push touch data of the record to the ring at their recorded times,
+scaled by replay_speed. If the ring is full, wait till it's read out,
+so no data is dropped. It idles after the record is done, till
+egi_end_touchread().
+--------------------------------------------------------------------*/
+static void *egi_touch_replay_loopread(void *arg)
+{
+	struct pollfd pfd;
+	struct timespec t0, ts;
+	EGI_TOUCH_DATA data;
+	long long us, dus;
+	int i;
+
+	pfd.fd=evdev_quitfd;
+	pfd.events=POLLIN;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for(i=0; i<replay_num && !cmd_end_loopread; ) {
+		data=replay_data[i];
+
+		/* Wait till its time, or as fast as possible */
+		if(replay_speed>0) {
+			us=(data.ts.tv_sec*1000000LL+data.ts.tv_nsec/1000)/replay_speed;
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			dus=us-((ts.tv_sec-t0.tv_sec)*1000000LL+(ts.tv_nsec-t0.tv_nsec)/1000);
+			if(dus>0) {
+				if( poll(&pfd, 1, (dus+999)/1000)>0 )
+					break;
+				continue;
+			}
+		}
+
+		/* Wait till the ring is read out */
+		if( touch_ring.head-__atomic_load_n(&touch_ring.tail, __ATOMIC_ACQUIRE)==TOUCH_RING_SIZE ) {
+			if( poll(&pfd, 1, 1)>0 )
+				break;
+			continue;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &data.ts);
+		touch_ring_publish(&data);
+		i++;
+	}
+	__atomic_store_n(&replay_done, true, __ATOMIC_RELEASE);
+
+	while(!cmd_end_loopread) {
+		if( poll(&pfd, 1, -1)>0 )
+			break;
+	}
+
+	return (void *)0;
+}
@@ -19,9 +19,16 @@ int 		egi_touch_timeWait_press( int s, unsigned int ms, EGI_TOUCH_DATA *touch_da
 int 		egi_touch_timeWait_release( int s, unsigned int ms, EGI_TOUCH_DATA *touch_data);
 void 		egi_touchread_nowait(bool nowait);
 int 		egi_start_touchread(void);
+int 		egi_start_touchread_evdev(const char *devpath);
+int 		egi_start_touchread_replay(const char *fpath, float speed);
+bool 		egi_touch_replay_done(void);
+int 		egi_touch_record_start(const char *fpath);
+int 		egi_touch_record_stop(void);
 int 		egi_end_touchread(void);
 bool 		egi_touchread_is_running(void);
 bool 		egi_touch_getdata(EGI_TOUCH_DATA *data);
+int 		egi_touch_eventfd(void);
+int 		egi_touch_waitdata(EGI_TOUCH_DATA *data, int ms);
 int 		egi_touch_fbpos_data(FBDEV *fbdev, EGI_TOUCH_DATA *touch_data);
 EGI_TOUCH_DATA 	egi_touch_peekdata(void);
 int 		egi_touch_peekdx(void);
@@ -12,15 +12,21 @@ Midas Zhou
 #include <stdlib.h>
 //#include <signal.h>
 #include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <sys/stat.h>
 #include "egi_color.h"
 #include "egi.h"
 #include "egi_txt.h"
 #include "egi_debug.h"
+#include "egi_page.h"
+#include "egi_scene.h"
 //#include "egi_timer.h"
 #include "egi_symbol.h"
 #include "egi_FTsymbol.h"
 #include "egi_bjp.h"
 #include "egi_filo.h"
+#include "egi_txtsrc.h"
 
 
 //static int egi_txtbox_decorate(EGI_EBOX *ebox);
@@ -503,6 +509,165 @@ TXT_ACTIVATE_END:
 }
 
 
+/*-------------------------------------
+	Cached txt surfaces
+--------------------------------------*/
+#define EGI_TXTCACHE_MAXMEM	(512*1024)	/* Default cap of memory for all txt caches */
+
+static pthread_mutex_t txtcache_lock=PTHREAD_MUTEX_INITIALIZER;
+static size_t txtcache_maxmem=EGI_TXTCACHE_MAXMEM;
+static size_t txtcache_mem;		/* Memory taken by all txt caches */
+
+/*-----------------------------------------------------
+Hash txt content, font, color and size of a txt ebox,
+as key of its txt cache.
+------------------------------------------------------*/
+static unsigned int egi_txtbox_cachekey(const EGI_DATA_TXT *data_txt, int w, int h)
+{
+	unsigned int hash=2166136261U;	/* FNV-1a */
+	const unsigned char *p;
+	int i;
+	int param[]={ data_txt->color, data_txt->nl, data_txt->llen, data_txt->pixpl,
+		      data_txt->fw, data_txt->fh, data_txt->gap, w, h };
+
+	/* txt content */
+	if(data_txt->font && data_txt->txt) {
+		for(i=0; i<data_txt->nl; i++) {
+			for(p=(unsigned char *)data_txt->txt[i]; p && *p; p++)
+				hash=(hash^*p)*16777619U;
+			hash=(hash^'\n')*16777619U;
+		}
+	}
+	else if(data_txt->font_face && data_txt->utxt) {
+		for(p=data_txt->utxt; *p; p++)
+			hash=(hash^*p)*16777619U;
+	}
+
+	/* font and other params */
+	for(p=(unsigned char *)&data_txt->font; p<(unsigned char *)(&data_txt->font+1); p++)
+		hash=(hash^*p)*16777619U;
+	for(p=(unsigned char *)&data_txt->font_face; p<(unsigned char *)(&data_txt->font_face+1); p++)
+		hash=(hash^*p)*16777619U;
+	for(p=(unsigned char *)param; p<(unsigned char *)(param+sizeof(param)/sizeof(param[0])); p++)
+		hash=(hash^*p)*16777619U;
+
+	return hash;
+}
+
+/*----------------------------------------------
+Free txt cache of a txt data, and count its
+memory out.
+-----------------------------------------------*/
+static void egi_txtbox_freecache(EGI_DATA_TXT *data_txt)
+{
+	EGI_IMGBUF *cache=data_txt->cache;
+
+	if(cache==NULL)
+		return;
+
+	pthread_mutex_lock(&txtcache_lock);
+	txtcache_mem -= (size_t)cache->width*cache->height*3;
+	pthread_mutex_unlock(&txtcache_lock);
+
+	egi_imgbuf_free(cache);
+	data_txt->cache=NULL;
+	data_txt->cache_key=0;
+}
+
+/*-----------------------------------------------------------------
+Render txt of a txt ebox to its txt cache, if txt, font, color or
+size changes. A cache is an RGB565+A8 EGI_IMGBUF of w*h, txt starts
+from its left top.
+
+@w,h:	Size of the cache.
+
+Return:
+	0	OK, data_txt->cache is up to date.
+	<0	Fails, or total cache memory would exceed the cap.
+------------------------------------------------------------------*/
+static int egi_txtbox_rendercache(EGI_DATA_TXT *data_txt, int w, int h)
+{
+	EGI_IMGBUF *cache=data_txt->cache;
+	FBDEV vfb={0};
+	unsigned int key;
+	size_t size=(size_t)w*h*3;	/* RGB565+A8 */
+	int i,k;
+	bool glyph_alpha=false;		/* Cache alpha is from glyph blending */
+
+	if(w<=0 || h<=0)
+		return -1;
+
+	key=egi_txtbox_cachekey(data_txt, w, h);
+	if(cache && data_txt->cache_key==key)
+		return 0;
+
+	/* Reuse the surface if size is the same */
+	if( cache && (cache->width!=w || cache->height!=h) ) {
+		egi_txtbox_freecache(data_txt);
+		cache=NULL;
+	}
+	if(cache==NULL) {
+		pthread_mutex_lock(&txtcache_lock);
+		if(txtcache_mem+size > txtcache_maxmem) {
+			pthread_mutex_unlock(&txtcache_lock);
+			EGI_PDEBUG(DBG_TXT,"Txt cache memory cap reached, %zu+%zu bytes.\n", txtcache_mem, size);
+			return -2;
+		}
+		txtcache_mem += size;
+		pthread_mutex_unlock(&txtcache_lock);
+
+		cache=egi_imgbuf_create(h, w, 0, data_txt->color);
+		if(cache==NULL) {
+			pthread_mutex_lock(&txtcache_lock);
+			txtcache_mem -= size;
+			pthread_mutex_unlock(&txtcache_lock);
+			return -3;
+		}
+		data_txt->cache=cache;
+	}
+	else {
+		/* Clear it: txt color with alpha 0 */
+		for(i=0; i<w*h; i++)
+			cache->imgbuf[i]=data_txt->color;
+		memset(cache->alpha, 0, w*h);
+	}
+
+	/* Render txt to the cache through a virtual FB */
+	if( init_virt_fbdev(&vfb, cache) !=0 ) {
+		egi_txtbox_freecache(data_txt);
+		return -4;
+	}
+	if(data_txt->font && data_txt->txt) {
+		for(i=0; i<data_txt->nl; i++)
+			symbol_string_writeFB(&vfb, data_txt->font, data_txt->color, 1,
+						0, data_txt->font->symheight*i, data_txt->txt[i], -1);
+		glyph_alpha= data_txt->font->alpha!=NULL;	/* Such as sympg_ascii */
+	}
+	else if(data_txt->font_face && data_txt->utxt) {
+		FTsymbol_uft8strings_writeFB( &vfb, data_txt->font_face, data_txt->fw, data_txt->fh,
+					      data_txt->utxt, data_txt->pixpl, data_txt->nl, data_txt->gap,
+					      0, 0, data_txt->color, -1, 255, NULL, NULL, NULL, NULL);
+		glyph_alpha=true;
+	}
+	release_virt_fbdev(&vfb);
+
+	/* Glyphs with alpha are blended with egi_16bitColor_blend(), which takes alpha*3/2,
+	 * so do the same to get the same look when the cache is blended with FB.
+	 */
+	if(glyph_alpha) {
+		for(i=0; i<w*h; i++) {
+			k=cache->alpha[i]*3/2;
+			cache->alpha[i]= k>255 ? 255 : k;
+		}
+	}
+
+	egi_imgbuf_enableAlphaRLE(cache, true);
+	egi_imgbuf_freeAlphaRLE(cache);	/* Rebuild on next blit */
+	data_txt->cache_key=key;
+
+	return 0;
+}
+
 /*-------------------------------------------------------------------------------
 refresh a txt ebox.   (For both nonFTsymbols and FTsymbols)
 A hidden txtbox only refresh data, and NO displaying.
@@ -519,6 +684,8 @@ Note:
 	4.refresh ebox color if ebox->prmcolor >0, and draw frame.
  	5.update txt, or read txt file to it.
 	6.write txt to FB and display it.
+	  If data_txt->cache_on, txt is rendered to the txt cache only when txt, font,
+	  color or size changes, and the cache is blitted to FB.
 
 Return
 	2	fail to read txt file.
@@ -625,7 +792,7 @@ int egi_txtbox_refresh(EGI_EBOX *ebox)
 //   if ( ( ebox->movable && ( (ebox->bkbox.startxy.x!=x0) || (ebox->bkbox.startxy.y!=y0)
 //			|| ( ebox->bkbox.endxy.x!=x0+width-1) || (ebox->bkbox.endxy.y!=y0+height-1) ) )
 //           || (ebox->prmcolor<0)  )
-   if( ebox->movable || ebox->prmcolor<0 )
+   if( (ebox->movable || ebox->prmcolor<0) && !egi_scene_retained(ebox) )
    {
 
 #if 0 /* DEBUG */
@@ -727,7 +894,17 @@ int egi_txtbox_refresh(EGI_EBOX *ebox)
 		ebox->decorate(ebox);
 
 	/* ---- 11. refresh TXT, write txt line to FB */
-        if(data_txt->font)  /*  --11.1--  For non_FTsymbols */
+
+	/* --11.0-- Blit txt cache, txt is rendered to it only if changed */
+	if( data_txt->cache_on && font_height>0
+	    && egi_txtbox_rendercache(data_txt,
+			data_txt->font_face && data_txt->pixpl>width-offx ? data_txt->pixpl : width-offx,
+			height-offy) ==0 )
+	{
+		egi_imgbuf_windisplay( data_txt->cache, &gv_fb_dev, -1, 0, 0, x0+offx, y0+offy,
+					data_txt->cache->width, data_txt->cache->height );
+	}
+        else if(data_txt->font)  /*  --11.1--  For non_FTsymbols */
 	{
 		EGI_PDEBUG(DBG_TXT,"Start symbol_string_writeFB(), font color=%d ...\n", data_txt->color);
 		for(i=0;i<nl;i++)
@@ -783,7 +960,7 @@ int egi_txtbox_sleep(EGI_EBOX *ebox)
                 return -1;
         }
 
-   	if(ebox->movable) { /* only for movable ebox, it holds bkimg. */
+   	if( ebox->movable && !egi_scene_retained(ebox) ) { /* only for movable ebox, it holds bkimg. */
 		/* restore bkimg */
        		if(fb_cpyfrom_buf(&gv_fb_dev, ebox->bkbox.startxy.x, ebox->bkbox.startxy.y,
                                ebox->bkbox.endxy.x, ebox->bkbox.endxy.y, ebox->bkimg) <0 )
@@ -796,6 +973,10 @@ int egi_txtbox_sleep(EGI_EBOX *ebox)
 	/* reset status */
 	ebox->status=status_sleep;
 
+	/* In a retained scene, the next frame erases it */
+	if(egi_scene_retained(ebox))
+		egi_page_wakeup(egi_scene_page(ebox));
+
 	EGI_PDEBUG(DBG_TXT,"A '%s' ebox is put to sleep.\n",ebox->tag);
 	return 0;
 }
@@ -817,7 +998,7 @@ int egi_txtbox_hide(EGI_EBOX *ebox)
                 return -1;
         }
 
-   	if( ebox->movable && ebox->bkimg != NULL ) { /* only for movable ebox, it holds bkimg. */
+   	if( ebox->movable && ebox->bkimg != NULL && !egi_scene_retained(ebox) ) { /* only for movable ebox, it holds bkimg. */
 		/* restore bkimg */
        		if(fb_cpyfrom_buf(&gv_fb_dev, ebox->bkbox.startxy.x, ebox->bkbox.startxy.y,
                                ebox->bkbox.endxy.x, ebox->bkbox.endxy.y, ebox->bkimg) <0 )
@@ -830,6 +1011,10 @@ int egi_txtbox_hide(EGI_EBOX *ebox)
 	/* reset status */
 	ebox->status=status_hidden;
 
+	/* In a retained scene, the next frame erases it */
+	if(egi_scene_retained(ebox))
+		egi_page_wakeup(egi_scene_page(ebox));
+
 	EGI_PDEBUG(DBG_TXT,"A '%s' ebox is put to hide.\n",ebox->tag);
 	return 0;
 }
@@ -903,10 +1088,10 @@ int egi_txtbox_readfile(EGI_EBOX *ebox, char *path)
 		return -2;
 	}
 
-	FILE *fil;
+	struct stat sb;
 	int i;
-	char buf[32]={0};
-	int nread=0;
+	const char *buf;	/* txt in the mmaped file, from foff */
+	long nread=0;
 	int ret=0;
 	EGI_DATA_TXT *data_txt=(EGI_DATA_TXT *)(ebox->egi_data);
 	int bxwidth=ebox->width; /* in pixel, ebox width for txt  */
@@ -952,24 +1137,31 @@ int egi_txtbox_readfile(EGI_EBOX *ebox, char *path)
 	for(i=0;i<nl;i++)
 		memset(txt[i],0,data_txt->llen); /* dont use llen, here llen=data_txt->llen-1 */
 
-	fil=fopen(path,"rbe");
-	if(fil==NULL) {
-		perror("egi_txtbox_readfile()");
+	/* Open the file as a txt source, or reopen it if it's changed */
+	if( stat(path, &sb)!=0 ) {
+		printf("%s: Fail to stat '%s': %s\n",__func__, path, strerror(errno));
 		return -2;
 	}
-	printf("egi_txtbox_readfile(): succeed to open %s, current offset=%ld \n",path,foff);
+	if( data_txt->src==NULL || strcmp(data_txt->src->fpath, path)!=0
+	    || data_txt->src->size!=(size_t)sb.st_size || data_txt->src->mtime!=sb.st_mtime ) {
+		egi_txtsrc_close(&data_txt->src);
+		data_txt->src=egi_txtsrc_open(path, 0);
+		if(data_txt->src==NULL) {
+			printf("%s: Fail to open '%s' as a txt source!\n",__func__, path);
+			return -2;
+		}
+		printf("%s: succeed to open %s, current offset=%ld \n",__func__, path, foff);
+	}
 
-	/* restore file position */
-	fseek(fil,foff,SEEK_SET);
+	/* Txt from foff to the end of file, no copying */
+	if( foff>=0 && (size_t)foff<data_txt->src->size ) {
+		buf=(const char *)data_txt->src->addr+foff;
+		nread=data_txt->src->size-foff;
+		egi_txtsrc_advise(data_txt->src, foff);
+	}
 
-	while( !feof(fil) )
+	if(nread>0)
 	{
-		memset(buf,0,sizeof(buf));/* clear buf */
-
-		nread=fread(buf,1,sizeof(buf),fil);
-		if(nread <= 0) /* error or end of file */
-			break;
-
 		 /*TODO: for() session to be replaced by egi_push_datatxt() if possible  */
 		/* here put char to egi_data_txt->txt */
 		for(i=0;i<nread;i++)
@@ -1047,14 +1239,13 @@ int egi_txtbox_readfile(EGI_EBOX *ebox, char *path)
 		/* check if txt line is used up, end this file-read session */
 		if(nlw>nl-1) {
 			ret+=i+1;
-			break; /* end while() of fread */
 		}
-		/* or if just finish pushing nread (may not be sizeof(buf)) to txt */
+		/* or if just finish pushing all the rest of the file to txt */
 		else {
 			ret+=nread;
 		}
 
-	} /* END while() of fread */
+	} /* END if(nread>0) */
 
 	/* DEBUG, print out all txt in txt data buf */
 #if 0
@@ -1066,7 +1257,7 @@ int egi_txtbox_readfile(EGI_EBOX *ebox, char *path)
 	data_txt->count=ret;
 
 	/* If reach end of file, renew foff to end position, we'll verify it at begin of this func */
-	if(feof(fil)) {
+	if( foff+ret >= (long)data_txt->src->size ) {
 		//printf("---------------end: END OF FILE ----------------\n");
 		/* push foff and set count<0, to avoid endless pushing.  */
 		egi_filo_push(data_txt->filo_off, &foff);
@@ -1086,8 +1277,6 @@ int egi_txtbox_readfile(EGI_EBOX *ebox, char *path)
 		((EGI_DATA_TXT *)(ebox->egi_data))->foff +=ret;
 	}
 
-	fclose(fil);
-
 	/* set need_refresh */
 	ebox->need_refresh=true;
 
@@ -1111,6 +1300,8 @@ void egi_free_data_txt(EGI_DATA_TXT *data_txt)
 		data_txt->filo_off=NULL;
 	}
 
+	egi_txtsrc_close(&data_txt->src);
+
 	if( data_txt->txt != NULL)
 	{
 		for(i=0;i<nl;i++)
@@ -1128,6 +1319,8 @@ void egi_free_data_txt(EGI_DATA_TXT *data_txt)
 	/* data_txt->utxt is referred from elsewhere. Do not free it here! */
 	data_txt->utxt=NULL;
 
+	egi_txtbox_freecache(data_txt);
+
 	free(data_txt);
 	data_txt=NULL;
 }
@@ -1341,3 +1534,60 @@ int egi_txtbox_set_direct(EGI_EBOX *ebox, int direct)
 
 	return 0;
 }
+
+
+/*-----------------------------------------------------------------------
+Turn on/off txt cache of a txt ebox.  (For both nonFTsymbols and FTsymbols)
+
+With txt cache on, txt is rendered to an RGB565+A8 EGI_IMGBUF, only when
+txt, font, color or size changes, and refresh() blits it to FB instead of
+rendering txt again. Memory of all txt caches is capped, see
+egi_txtbox_set_cachemem(), the txtbox renders txt directly if the cap
+is reached.
+
+Note: Txt out of the ebox(offx,offy to its right bottom) is cut off.
+
+@ebox:	A txt ebox
+@on:	True to turn on, false to turn off and free the cache.
+
+Return:
+	0	OK
+	<0	Fails
+------------------------------------------------------------------------*/
+int egi_txtbox_set_cache(EGI_EBOX *ebox, bool on)
+{
+	EGI_DATA_TXT *data_txt;
+
+	if( ebox==NULL || ebox->type!=type_txt || ebox->egi_data==NULL ) {
+		printf("%s: Input ebox is invalid!\n",__func__);
+		return -1;
+	}
+	data_txt=(EGI_DATA_TXT *)ebox->egi_data;
+
+	data_txt->cache_on=on;
+	if(!on)
+		egi_txtbox_freecache(data_txt);
+
+	return 0;
+}
+
+/*------------------------------------------------------------
+Set cap of memory for all txt caches, default 512KBytes.
+Caches already allocated are NOT affected.
+
+@maxmem:	Max. memory in bytes.
+
+Return:
+	Memory taken by all txt caches now, in bytes.
+-------------------------------------------------------------*/
+size_t egi_txtbox_set_cachemem(size_t maxmem)
+{
+	size_t mem;
+
+	pthread_mutex_lock(&txtcache_lock);
+	txtcache_maxmem=maxmem;
+	mem=txtcache_mem;
+	pthread_mutex_unlock(&txtcache_lock);
+
+	return mem;
+}
@@ -53,6 +53,8 @@ int 	egi_txtbox_hide(EGI_EBOX *ebox);
 int 	egi_txtbox_unhide(EGI_EBOX *ebox);
 EGI_DATA_TXT *egi_txtbox_getdata(EGI_EBOX *ebox);
 void 	egi_free_data_txt(EGI_DATA_TXT *data_txt);
+int 	egi_txtbox_set_cache(EGI_EBOX *ebox, bool on);
+size_t 	egi_txtbox_set_cachemem(size_t maxmem);
 
 /* For non_FTsymbols only */
 int 	egi_txtbox_readfile(EGI_EBOX *ebox, char *path);
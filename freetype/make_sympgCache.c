@@ -0,0 +1,67 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Render ASCII symbol pages of a font file at given sizes, and save
+them to a cache file for FTsymbol_load_asciis_from_cache().
+
+Usage:	make_sympgCache font_path cache_path WxH [WxH ...]
+Example:
+	make_sympgCache /mmc/fonts/liber/LiberationSans-Regular.ttf \
+			/mmc/fonts/sympg_ascii.cache 18x18 16x16
+
+Note: Set 'ascii_cache' in egi.conf to load sympg_ascii from it.
+
+Midas Zhou
+------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "egi_common.h"
+#include "egi_FTsymbol.h"
+
+int main(int argc, char **argv)
+{
+	EGI_SYMPAGE page={0};
+	int *sizes;
+	int nsizes;
+	int i;
+
+	if(argc < 4) {
+		printf("Usage: %s font_path cache_path WxH [WxH ...]\n", argv[0]);
+		return 1;
+	}
+
+	nsizes=argc-3;
+	sizes=calloc(nsizes*2, sizeof(int));
+	if(sizes==NULL)
+		return -1;
+	for(i=0; i<nsizes; i++) {
+		if( sscanf(argv[3+i], "%dx%d", &sizes[2*i], &sizes[2*i+1])!=2 || sizes[2*i]<=0 || sizes[2*i+1]<=0 ) {
+			printf("Invalid size '%s', it shall be as WxH.\n", argv[3+i]);
+			free(sizes);
+			return 1;
+		}
+	}
+
+	if( FTsymbol_save_asciis_cache(argv[2], argv[1], nsizes, sizes)!=0 ) {
+		printf("Fail to save cache file '%s'.\n", argv[2]);
+		free(sizes);
+		return -2;
+	}
+
+	/* Check it */
+	for(i=0; i<nsizes; i++) {
+		if( FTsymbol_load_asciis_from_cache(&page, argv[2], argv[1], sizes[2*i], sizes[2*i+1])!=0 ) {
+			printf("Fail to load page %dx%d from cache file.\n", sizes[2*i], sizes[2*i+1]);
+			free(sizes);
+			return -3;
+		}
+		printf("Page %dx%d: symheight=%d, %d bytes of alpha.\n", sizes[2*i], sizes[2*i+1],
+					page.symheight, page.symoffset[page.maxnum]+page.symwidth[page.maxnum]*page.symheight);
+		symbol_release_page(&page);
+	}
+
+	free(sizes);
+	return 0;
+}
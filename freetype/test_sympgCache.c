@@ -0,0 +1,101 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Test ASCII symbol pages loaded from a cache file:
+1. Save a cache file of the font, then load the page from it.
+2. Write a string with the cached page and with the page rendered
+   from the font file, each on a virtual FB.
+3. The string shall be drawn, and the two FBs shall be the same.
+
+Usage:	test_sympgCache font_path cache_path
+Example:
+	test_sympgCache /mmc/fonts/liber/LiberationSans-Regular.ttf /tmp/test.cache
+
+Midas Zhou
+------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "egi_common.h"
+#include "egi_fbdev.h"
+#include "egi_image.h"
+#include "egi_symbol.h"
+#include "egi_FTsymbol.h"
+
+#define TEST_STRING	"Hello EGI, 0123!"
+#define FONT_SIZE	18
+
+/* Write TEST_STRING with the page on a virtual FB of vimg, return number of pixels drawn */
+static int draw_string(EGI_SYMPAGE *page, EGI_IMGBUF *vimg)
+{
+	FBDEV vfb={0};
+	int i, n;
+
+	if(init_virt_fbdev(&vfb, vimg)!=0)
+		return -1;
+
+	egi_imgbuf_resetColorAlpha(vimg, WEGI_COLOR_WHITE, 255);
+	symbol_string_writeFB(&vfb, page, WEGI_COLOR_BLUE, -1, 5, 5, TEST_STRING, 255);
+	release_virt_fbdev(&vfb);
+
+	for(n=0, i=0; i<vimg->width*vimg->height; i++) {
+		if(vimg->imgbuf[i]!=WEGI_COLOR_WHITE)
+			n++;
+	}
+
+	return n;
+}
+
+int main(int argc, char **argv)
+{
+	EGI_SYMPAGE cpage={0};		/* Loaded from the cache file */
+	EGI_SYMPAGE fpage={0};		/* Rendered from the font file */
+	EGI_IMGBUF *cimg, *fimg;
+	int sizes[2]={FONT_SIZE, FONT_SIZE};
+	int cn, fn;
+	int ret=1;
+
+	if(argc < 3) {
+		printf("Usage: %s font_path cache_path\n", argv[0]);
+		return 1;
+	}
+
+	if( FTsymbol_save_asciis_cache(argv[2], argv[1], 1, sizes)!=0
+	    || FTsymbol_load_asciis_from_cache(&cpage, argv[2], argv[1], FONT_SIZE, FONT_SIZE)!=0 ) {
+		printf("Fail to save or load cache file '%s'.\n", argv[2]);
+		return -1;
+	}
+	if( FTsymbol_load_asciis_from_fontfile(&fpage, argv[1], FONT_SIZE, FONT_SIZE)!=0 ) {
+		printf("Fail to load font file '%s'.\n", argv[1]);
+		symbol_release_page(&cpage);
+		return -1;
+	}
+	printf("Cached page: data %s, alpha %s.\n", cpage.data ? "yes" : "NULL", cpage.alpha ? "yes" : "NULL");
+
+	cimg=egi_imgbuf_create(40, 240, 255, WEGI_COLOR_WHITE);
+	fimg=egi_imgbuf_create(40, 240, 255, WEGI_COLOR_WHITE);
+	if(cimg==NULL || fimg==NULL)
+		goto END_TEST;
+
+	cn=draw_string(&cpage, cimg);
+	fn=draw_string(&fpage, fimg);
+	printf("Pixels drawn: %d by the cached page, %d by the font file page.\n", cn, fn);
+
+	if(cn<=0)
+		printf("FAIL: Nothing is drawn by the cached page.\n");
+	else if( cn!=fn || memcmp(cimg->imgbuf, fimg->imgbuf, cimg->width*cimg->height*sizeof(EGI_16BIT_COLOR))!=0 )
+		printf("FAIL: The cached page draws differently.\n");
+	else
+		ret=0;
+
+END_TEST:
+	printf("Sympg cache check: %s\n", ret==0 ? "OK" : "FAIL");
+	egi_imgbuf_free(cimg);
+	egi_imgbuf_free(fimg);
+	symbol_release_page(&cpage);
+	symbol_release_page(&fpage);
+
+	return ret;
+}
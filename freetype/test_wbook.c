@@ -106,6 +106,7 @@ midaszhou@yahoo.com
 #include "egi_image.h"
 #include "egi_utils.h"
 #include "egi_FTsymbol.h"
+#include "egi_FTbook.h"
 
 #include FT_FREETYPE_H
 
@@ -116,19 +117,12 @@ int main( int  argc,   char**  argv )
   int 		i,j,k;
   int		ret;
 
-  int fd;
-  int fsize;
-  struct stat sb;
-  unsigned char *fp;
-
-  wchar_t *wbook=L"人心生一念，天地尽皆知。善恶若无报，乾坤必有私。\
-　　那菩萨闻得此言，满心欢喜，对大圣道：“圣经云：‘出其言善。\
-　　则千里之外应之；出其言不善，则千里之外适之。’你既有此心，待我到了东土大唐国寻一个取经的人来，教他救你。你可跟他做个徒弟，秉教伽持，入我佛门。再修正果，如何？”大圣声声道：“愿去！愿去！”菩萨道：“既有善果，我与你起个法名。”大圣道：“我已有名了，叫做孙悟空。”菩萨又喜道：“我前面也有二人归降，正是‘悟’字排行。你今也是‘悟’字，却与他相合，甚好，甚好。这等也不消叮嘱，我去也。”那大圣见性明心归佛教，这菩萨留情在意访神谱。\
-　　他与木吒离了此处，一直东来，不一日就到了长安大唐国。敛雾收云，师徒们变作两个疥癫游憎，入长安城里，竟不觉天晚。行至大市街旁，见一座土地庙祠，二人径进，唬得那土地心慌，鬼兵胆战。知是菩萨，叩头接入。那土地又急跑报与城隍社令及满长安城各庙神抵，都来参见，告道：“菩萨，恕众神接迟之罪。”菩萨道：“汝等不可走漏消息。我奉佛旨，特来此处寻访取经人。借你庙宇，权住几日，待访着真僧即回。”众神各归本处，把个土地赶到城隍庙里暂住，他师徒们隐遁真形。\
-　　毕竟不知寻出那个取经来，且听下回分解。";
+  const char *fpath="/mmc/xyj_uft8.txt";
+  EGI_FTBOOK *book_pt, *book_ls;	/* Paginated for portrait and landscape text boxes */
+  EGI_FTBOOK *book;
+  int pgnum;
 
   int fh,fw; /* font Height,Width */
-  int lines;
   int pixpl;
   int gap;   /* line gap */
   int offp;
@@ -143,9 +137,14 @@ int main( int  argc,   char**  argv )
 
 
 
-#if 1	/////////////// 	char_unicode_to_uft8( ) 	/////////////
+#if 0	/////////////// 	char_unicode_to_uft8( ) 	/////////////
+	wchar_t *wbook=L"人心生一念，天地尽皆知。善恶若无报，乾坤必有私。\
+　　那菩萨闻得此言，满心欢喜，对大圣道：“圣经云：‘出其言善。\
+　　则千里之外应之；出其言不善，则千里之外适之。’你既有此心，待我到了东土大唐国寻一个取经的人来，教他救你。你可跟他做个徒弟，秉教伽持，入我佛门。再修正果，如何？”大圣声声道：“愿去！愿去！”菩萨道：“既有善果，我与你起个法名。”大圣道：“我已有名了，叫做孙悟空。”菩萨又喜道：“我前面也有二人归降，正是‘悟’字排行。你今也是‘悟’字，却与他相合，甚好，甚好。这等也不消叮嘱，我去也。”那大圣见性明心归佛教，这菩萨留情在意访神谱。\
+　　他与木吒离了此处，一直东来，不一日就到了长安大唐国。敛雾收云，师徒们变作两个疥癫游憎，入长安城里，竟不觉天晚。行至大市街旁，见一座土地庙祠，二人径进，唬得那土地心慌，鬼兵胆战。知是菩萨，叩头接入。那土地又急跑报与城隍社令及满长安城各庙神抵，都来参见，告道：“菩萨，恕众神接迟之罪。”菩萨道：“汝等不可走漏消息。我奉佛旨，特来此处寻访取经人。借你庙宇，权住几日，待访着真僧即回。”众神各归本处，把个土地赶到城隍庙里暂住，他师徒们隐遁真形。\
+　　毕竟不知寻出那个取经来，且听下回分解。";
 	char char_uft8[4+1];
-	whart_t *wp=wbook;
+	wchar_t *wp=wbook;
 
 	while(*wp) {
 		memset(char_uft8,0,sizeof(char_uft8));
@@ -196,40 +195,30 @@ while(1) { ///////////////////////  LOOP TEST  ////////////////////////
 		return -1;
 
 
-	/* open wchar book file */
-	fd=open("/mmc/xyj_uft8.txt",O_RDONLY);
-//	fd=open("/home/memo.txt",O_RDONLY);
-	if(fd<0) {
-		perror("open file");
+   fw=18; fh=20;
+   gap=5;
+   x0=5;y0=60;
+
+	/* open the book for portrait and landscape text boxes, pages are indexed in background,
+	 * and the index is saved to a sidecar file.
+	 */
+	book_pt=FTbook_open(fpath, egi_appfonts.regular, fw, fh, 240-x0, 10, gap);
+	book_ls=FTbook_open(fpath, egi_appfonts.regular, fw, fh, 320-x0, 7, gap);
+	if(book_pt==NULL || book_ls==NULL) {
+		printf("Fail to open book %s.\n", fpath);
 		return -1;
 	}
-	/* obtain file stat */
-	if( fstat(fd,&sb)<0 ) {
-		perror("fstat");
-		return -2;
-	}
-	fsize=sb.st_size;
-	/* mmap txt file */
-	fp=mmap(NULL, fsize, PROT_READ, MAP_PRIVATE, fd, 0);
-	if(fp==MAP_FAILED) {
-		perror("mmap");
-		return -3;
-	}
 
         /* --- TITLE --- */
         wchar_t* title =L"大 唐 西 游 记";
 
 	/* get total wchars in the book */
- 	wtotal=cstr_strcount_uft8(fp);
+ 	wtotal=egi_txtsrc_count(book_pt->faddr, book_pt->fsize);
 	printf(" Total %d characters in the book.\n",wtotal);
 
    EGI_PLOG(LOGLV_CRITICAL,"---------- ebook START --------\n");
 
-   fw=18; fh=20;
    offp=0;
-   lines=10;
-   gap=5;
-   x0=5;y0=60;
    do {
 	/* clear screen */
 	clear_screen(&gv_fb_dev, 0xfff9); //0x0679); //COLOR_COMPLEMENT_16BITS(font_color));
@@ -241,7 +230,6 @@ while(1) { ///////////////////////  LOOP TEST  ////////////////////////
                 draw_filled_rect2(&gv_fb_dev, 0x0679, 0, 0, 319, 50 ); /* pos_rotate= 1,3 */
 	        /* Draw dividing lines */
                 draw_wline_nc(&gv_fb_dev , 0, 50, 319, 50, 1); /* 1 width */
-		lines=7;
 		pixpl=320;
 		tx0=85;
 	}
@@ -250,7 +238,6 @@ while(1) { ///////////////////////  LOOP TEST  ////////////////////////
                 draw_filled_rect2(&gv_fb_dev, 0x0679, 0,0, 239, 50 );  /* pos_rotate= 0,2 */
 	        /* Draw dividing lines */
                 draw_wline_nc(&gv_fb_dev , 0, 50, 239, 50, 1); /* 1 width */
-		lines=10;
 		pixpl=240;
 		tx0=45;
 	}
@@ -262,15 +249,14 @@ while(1) { ///////////////////////  LOOP TEST  ////////////////////////
                                		   tx0, 8,			/* x0,y0, */
                                		   WEGI_COLOR_BLACK, -1, -1); 	/* fontcolor, stranscolor,opaque */
 
-	/* write book content: UFT-8 string to FB */
-//	nwrite=FTsymbol_uft8strings_writeFB(&gv_fb_dev, egi_appfonts.regular,  /* FBdev, fontface */
-	nwrite=FTsymbol_unicstrings_writeFB(&gv_fb_dev, egi_appfonts.regular,  /* FBdev, fontface */
-					   fw, fh, wbook+offp, //fp+offp,	/* fw,fh, pstr */
-                               		   pixpl-x0, lines,  gap,		/* pixpl, lines, gap */
-                               		   x0, y0,			/* x0,y0, */
-                               		   WEGI_COLOR_BLACK, -1, -1); 	/* fontcolor, stranscolor,opaque */
-	printf("nwrite=%d bytes\n",nwrite);
-	offp+=nwrite;
+	/* write book content: the page holding reading position offp, in current text box */
+	book= gv_fb_dev.pos_rotate%2 ? book_ls : book_pt;
+	pgnum=FTbook_pageOfOffset(book, offp, true);
+	if(pgnum<0)
+		break;
+	nwrite=FTbook_writePage(&gv_fb_dev, book, pgnum, x0, y0, WEGI_COLOR_BLACK);
+	printf("page %d/%d, nwrite=%d bytes\n", pgnum, FTbook_totalPages(book, NULL), nwrite);
+	offp=FTbook_pageOffset(book, pgnum, false)+nwrite;
 
 	/* Dispay EGI_IMGBUF */
 	egi_imgbuf_windisplay(penguin_img, &gv_fb_dev, -1, 0, 0, 0, 0, penguin_img->width, penguin_img->height);
@@ -295,9 +281,9 @@ while(1) { ///////////////////////  LOOP TEST  ////////////////////////
 	egi_imgbuf_free(logo_img);
 	egi_imgbuf_free(penguin_img);
 
-	/* unmap and close fd */
-	munmap(fp, fsize);
-	close(fd);
+	/* close books */
+	FTbook_close(&book_pt);
+	FTbook_close(&book_ls);
 
 FONT_FAILS:
 	/* Release EGI fonts */
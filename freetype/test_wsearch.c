@@ -0,0 +1,113 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Benchmark of full-text search in a txt book:
+1. Query latency before the index is built(mostly scanning).
+2. Index build rate.
+3. Query latency with the index, and pages of the first hits.
+
+Usage:	test_wsearch book.txt [-r] word1 [word2 ...]
+	-r	Remove the saved index and rebuild it.
+
+Midas Zhou
+------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "egi_common.h"
+#include "egi_FTsymbol.h"
+#include "egi_FTbook.h"
+#include "egi_txtidx.h"
+
+#define MAX_HITS	1000
+#define QUERY_LOOPS	20
+
+static unsigned int offs[MAX_HITS];
+
+/* Average cost of a query in us, and pass out number of hits */
+static unsigned int query_cost(EGI_TXTIDX *idx, const char *word, int *nhits)
+{
+	struct timeval tm_start, tm_end;
+	int i;
+
+	gettimeofday(&tm_start,NULL);
+	for(i=0; i<QUERY_LOOPS; i++)
+		*nhits=egi_txtidx_search(idx, word, 0, offs, MAX_HITS);
+	gettimeofday(&tm_end,NULL);
+
+	return tm_diffus(tm_start, tm_end)/QUERY_LOOPS;
+}
+
+int main(int argc, char **argv)
+{
+	EGI_TXTIDX *idx;
+	EGI_FTBOOK *book;
+	struct timeval tm_start, tm_end;
+	struct stat sb;
+	char idxpath[256];
+	bool done=false;
+	size_t indexed;
+	unsigned int us;
+	int first=2;
+	int nhits;
+	int i,k;
+
+	if(argc < 3) {
+		printf("Usage: %s book.txt [-r] word1 [word2 ...]\n", argv[0]);
+		return 2;
+	}
+	snprintf(idxpath, sizeof(idxpath), "%s.txtidx", argv[1]);
+	if(strcmp(argv[2],"-r")==0) {
+		remove(idxpath);
+		first=3;
+	}
+
+	/* <<<<<  EGI general init  >>>>>> */
+	if(FTsymbol_load_appfonts() !=0 ) {     /* load FT fonts LIBS */
+		printf("Fail to load FT appfonts, quit.\n");
+		return -2;
+	}
+	/* <<<<------------------  End EGI Init  ----------------->>>> */
+
+	/* 1. Query before the index is built */
+	gettimeofday(&tm_start,NULL);
+	idx=egi_txtidx_open(argv[1]);
+	if(idx==NULL)
+		goto END_TEST;
+	for(k=first; k<argc; k++) {
+		us=query_cost(idx, argv[k], &nhits);
+		printf("Query '%s' before indexed: %d hits, %uus.\n", argv[k], nhits, us);
+	}
+
+	/* 2. Wait for the index */
+	while( indexed=egi_txtidx_progress(idx, &done), !done )
+		usleep(10000);
+	gettimeofday(&tm_end,NULL);
+	us=tm_diffus(tm_start, tm_end);
+	stat(idxpath, &sb);
+	printf("Index %zu bytes in %uus, %.2fMB/s, index file %lld bytes.\n", indexed, us,
+			us>0 ? (double)indexed/us : 0.0, (long long)sb.st_size);
+
+	/* 3. Query with the index, and get pages of hits */
+	book=FTbook_open(argv[1], egi_appfonts.regular, 18, 20, 240-5, 10, 5);
+	for(k=first; k<argc; k++) {
+		us=query_cost(idx, argv[k], &nhits);
+		printf("Query '%s' indexed: %d hits, %uus.\n", argv[k], nhits, us);
+		for(i=0; i<nhits && i<10; i++) {
+			printf("   offset %u on page %d\n", offs[i],
+				book ? FTbook_pageOfOffset(book, offs[i], true) : -1);
+		}
+	}
+	FTbook_close(&book);
+	egi_txtidx_close(&idx);
+
+END_TEST:
+        /* <<<<<-----------------  EGI general release  ----------------->>>>> */
+        printf("FTsymbol_release_allfonts()...\n");
+        FTsymbol_release_allfonts();
+
+	return 0;
+}
@@ -0,0 +1,44 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Check counters for self-checking test programs, as:
+
+	TEST_CHECK( n==3, "%s: n=%d, expect 3\n", tag, n );
+	...
+	test_report("Gesture");		// Gesture check: OK, 38 passed.
+	return test_result();		// 1 if any check fails.
+
+A failed check prints "FAIL " followed by its message.
+
+Midas Zhou
+------------------------------------------------------------------*/
+#ifndef __EGI_TEST_H__
+#define __EGI_TEST_H__
+
+#include <stdio.h>
+
+static int test_npass;
+static int test_nfail;
+
+#define TEST_PASS()		do { test_npass++; } while(0)
+#define TEST_FAIL(...)		do { printf("FAIL " __VA_ARGS__); test_nfail++; } while(0)
+#define TEST_CHECK(cond, ...)	do { if(cond) TEST_PASS(); else TEST_FAIL(__VA_ARGS__); } while(0)
+
+/* Print results of checks so far */
+static inline void test_report(const char *name)
+{
+	if(test_nfail)
+		printf("%s check: FAIL, %d passed, %d failed.\n", name, test_npass, test_nfail);
+	else
+		printf("%s check: OK, %d passed.\n", name, test_npass);
+}
+
+/* Exit code of a test program */
+static inline int test_result(void)
+{
+	return test_nfail>0 ? 1 : 0;
+}
+
+#endif
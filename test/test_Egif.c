@@ -3,7 +3,7 @@ This program is free software; you can redistribute it and/or modify
 it under the terms of the GNU General Public License version 2 as
 published by the Free Software Foundation.
 
-		Usage:  %s [-h] [-t] [-d] [-p] fpath
+		Usage:  %s [-h] [-t] [-d] [-p] [-s] [-c] [-r width] fpath
 
 Test gif file:
 1. muyu.gif
@@ -19,6 +19,11 @@ Test gif file:
 3. egi_gif_cread() to create an EGI_GIF with the given EGI_GIF_DATA.
 4. egi_gif_displayFrame() to display the EGI_GIF.
 5. egi_gif_runDisplayThread() to display EGI_GIF by a thread.
+6. egi_gif_openStream() to open a GIF as a streaming EGI_GIF, frames are
+   decoded one by one when displaying.
+7. egi_gif_enableCompiled() to record frames as patches in the first loop,
+   and replay them after then.
+8. egi_gif_setResize() to play the GIF resized to a given width.
 
 
 Midas Zhou
@@ -46,22 +51,29 @@ int main(int argc, char **argv)
 	int User_DispMode=-1;   /* <0, disable */
 	int User_TransColor=-1; /* <0, disable, if>=0, auto set User_DispMode to 2. */
 	int User_BkgColor=-1;   /* <0, disable */
+	bool Stream_ON=false;	/* Open GIF by egi_gif_openStream() */
+	bool Compiled_ON=false;	/* Replay frames as patches after the first loop */
+	int RWidth=0;		/* >0, play GIF resized to the width */
+	int gw, gh;		/* Size of the displayed GIF */
 
 	int xp,yp;
 	int xw,yw;
 
 
 	/* parse input option */
-	while( (opt=getopt(argc,argv,"htdp"))!=-1)
+	while( (opt=getopt(argc,argv,"htdpscr:"))!=-1)
 	{
     		switch(opt)
     		{
 		       case 'h':
-		           printf("usage:  %s [-h] [-t] [-d] [-p] fpath \n", argv[0]);
+		           printf("usage:  %s [-h] [-t] [-d] [-p] [-s] [-c] [-r width] fpath \n", argv[0]);
 		           printf("         -h   help \n");
 		           printf("         -t   Image_transparency ON. ( default is OFF ) \n");
 		           printf("         -d   Wirte to FB mem directly, without buffer. ( default use FB working buffer ) \n");
 		           printf("         -p   Portrait mode. ( default is Landscape mode ) \n");
+		           printf("         -s   Streaming mode, decode frames one by one. ( default slurp all frames ) \n");
+		           printf("         -c   Compiled mode, replay frames as patches after the first loop. \n");
+		           printf("         -r   Resize the GIF to the width, keep aspect ratio. \n");
 			   printf("fpath   Gif file path \n");
 		           return 0;
 		       case 't':
@@ -76,6 +88,18 @@ int main(int argc, char **argv)
 			   printf(" Set PortraitMode=true.\n");
 			   PortraitMode=true;
 			   break;
+		       case 's':
+			   printf(" Set Stream_ON=true.\n");
+			   Stream_ON=true;
+			   break;
+		       case 'c':
+			   printf(" Set Compiled_ON=true.\n");
+			   Compiled_ON=true;
+			   break;
+		       case 'r':
+			   RWidth=atoi(optarg);
+			   printf(" Set RWidth=%d.\n", RWidth);
+			   break;
 		       default:
 		           break;
 	    	}
@@ -84,7 +108,7 @@ int main(int argc, char **argv)
 	printf(" optind=%d, argv[%d]=%s\n", optind, optind, argv[optind] );
 	fpath=argv[optind];
 	if(fpath==NULL) {
-	           printf("usage:  %s [-h] [-t] [-d] [-p] fpath\n", argv[0]);
+	           printf("usage:  %s [-h] [-t] [-d] [-p] [-s] [-c] [-r width] fpath\n", argv[0]);
 	           exit(-1);
 	}
 
@@ -161,6 +185,17 @@ int main(int argc, char **argv)
 
 while(1) {  ////////////////////////////////  ---  LOOP TEST  ---  /////////////////////////////////////
 
+   if(Stream_ON) {	/* ------------------  TEST:  Open by egi_gif_openStream()  ------------------ */
+
+	egif=egi_gif_openStream( fpath, ImgTransp_ON, true); /* fpath, bool ImgTransp_ON, bool InMemory */
+	if(egif==NULL) {
+		printf("Fail to open gif stream!\n");
+		exit(-1);
+	}
+        printf("Finish opening GIF file as a streaming EGI_GIF by egi_gif_openStream().\n");
+   }
+   else {
+
    #if 1  /* OPTION 1:  ------------------  TEST:  Read into by egi_gif_slurpFile()  ------------------ */
 
 	/* read GIF data into an EGI_GIF */
@@ -187,12 +222,21 @@ while(1) {  ////////////////////////////////  ---  LOOP TEST  ---  /////////////
         printf("Finish reading GIF file into egi_data and creating egif by egi_gif_create().\n");
 
    #endif
+   }
+
+	if( Compiled_ON && egi_gif_enableCompiled(egif, 0)!=0 )
+		printf("Fail to enable compiled frames!\n");
+
+	if( RWidth>0 && egi_gif_setResize(egif, RWidth, 0)!=0 )
+		printf("Fail to set resizing!\n");
+	gw=egif->RSimgbuf ? egif->RWidth : egif->SWidth;
+	gh=egif->RSimgbuf ? egif->RHeight : egif->SHeight;
 
 	/* Cal xp,yp xw,yw, to position it to the center of LCD  */
-	xp=egif->SWidth>xres ? (egif->SWidth-xres)/2:0;
-	yp=egif->SHeight>yres ? (egif->SHeight-yres)/2:0;
-	xw=egif->SWidth>xres ? 0:(xres-egif->SWidth)/2;
-	yw=egif->SHeight>yres ? 0:(yres-egif->SHeight)/2;
+	xp=gw>xres ? (gw-xres)/2:0;
+	yp=gh>yres ? (gh-yres)/2:0;
+	xw=gw>xres ? 0:(xres-gw)/2;
+	yw=gh>yres ? 0:(yres-gh)/2;
 
         /* Lump context data */
         gif_ctxt.fbdev=&gv_fb_dev;
@@ -206,8 +250,8 @@ while(1) {  ////////////////////////////////  ---  LOOP TEST  ---  /////////////
         gif_ctxt.yp=yp;
         gif_ctxt.xw=xw;
         gif_ctxt.yw=yw;
-        gif_ctxt.winw=egif->SWidth>xres ? xres:egif->SWidth; /* put window at center of LCD */
-        gif_ctxt.winh=egif->SHeight>yres ? yres:egif->SHeight;
+        gif_ctxt.winw=gw>xres ? xres:gw; /* put window at center of LCD */
+        gif_ctxt.winh=gh>yres ? yres:gh;
 
 
 #if 0  /* ----------------------  TEST:  egi_gif_runDisplayThread( )  ----------------------- */
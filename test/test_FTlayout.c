@@ -0,0 +1,97 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Test FTlayout: lay out a UTF-8 string once, then redraw it.
+
+Usage:	test_FTlayout "string" [-w] [-k]
+	-w	Word wrap(CJK aware)
+	-k	Kerning
+
+Midas Zhou
+------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "egi_common.h"
+#include "egi_FTsymbol.h"
+#include "egi_FTlayout.h"
+
+int main(int argc, char **argv)
+{
+	EGI_FTLAYOUT *layout;
+	struct timeval tm_start, tm_end;
+	int flags=0;
+	int i;
+
+	if(argc < 2) {
+		printf("Usage: %s \"string\" [-w] [-k]\n", argv[0]);
+		return 2;
+	}
+	for(i=2; i<argc; i++) {
+		if(strcmp(argv[i],"-w")==0)
+			flags |= FTLAYOUT_WORDWRAP;
+		else if(strcmp(argv[i],"-k")==0)
+			flags |= FTLAYOUT_KERNING;
+	}
+
+        /* <<<<<  EGI general init  >>>>>> */
+        printf("symbol_load_allpages()...\n");
+        if(symbol_load_allpages() !=0 ) {       /* load sys fonts */
+                printf("Fail to load sym pages,quit.\n");
+                return -2;
+        }
+        if(FTsymbol_load_appfonts() !=0 ) {     /* load FT fonts LIBS */
+                printf("Fail to load FT appfonts, quit.\n");
+                return -2;
+        }
+        printf("init_fbdev()...\n");
+        if( init_fbdev(&gv_fb_dev) )            /* init sys FB */
+                return -1;
+        /* <<<<------------------  End EGI Init  ----------------->>>> */
+
+	fb_set_directFB(&gv_fb_dev, true);
+	fb_page_saveToBuff(&gv_fb_dev, 0);
+
+	/* Layout once */
+	gettimeofday(&tm_start,NULL);
+	layout=FTlayout_get(egi_appfonts.regular, 18, 18, (const unsigned char *)argv[1],
+				320-20, 8, 4, flags);
+	gettimeofday(&tm_end,NULL);
+	if(layout==NULL)
+		goto END_TEST;
+	printf("Layout: %d glyphs in %d lines, %dx%d pixels, %d bytes in box, cost %uus.\n",
+			layout->nglyphs, layout->nlines, layout->width, layout->height, layout->bytes,
+			tm_diffus(tm_start, tm_end));
+
+	/* Draw it with a frame */
+	fbset_color(WEGI_COLOR_GRAY);
+	draw_rect(&gv_fb_dev, 10-1, 10-1, 10+layout->width, 10+layout->height);
+	gettimeofday(&tm_start,NULL);
+	FTlayout_writeFB(&gv_fb_dev, layout, 10, 10, WEGI_COLOR_BLACK, -1, -1);
+	gettimeofday(&tm_end,NULL);
+	printf("FTlayout_writeFB() cost %uus.\n", tm_diffus(tm_start, tm_end));
+	FTlayout_free(&layout);
+
+	/* Get it again from the layout cache */
+	gettimeofday(&tm_start,NULL);
+	layout=FTlayout_get(egi_appfonts.regular, 18, 18, (const unsigned char *)argv[1],
+				320-20, 8, 4, flags);
+	gettimeofday(&tm_end,NULL);
+	printf("Layout from cache cost %uus.\n", tm_diffus(tm_start, tm_end));
+	FTlayout_free(&layout);
+
+	sleep(3);
+	fb_page_restoreFromBuff(&gv_fb_dev, 0);
+
+END_TEST:
+        /* <<<<<-----------------  EGI general release  ----------------->>>>> */
+        printf("FTsymbol_release_allfonts()...\n");
+        FTsymbol_release_allfonts();
+        printf("symbol_release_allpages()...\n");
+        symbol_release_allpages();
+        printf("release_fbdev()...\n");
+        release_fbdev(&gv_fb_dev);
+
+	return 0;
+}
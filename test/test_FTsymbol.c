@@ -10,6 +10,7 @@ Midas Zhou
 #include <getopt.h>
 #include "egi_common.h"
 #include "egi_FTsymbol.h"
+#include "egi_FTatlas.h"
 #include "egi_gif.h"
 
 int main(int argc, char **argv)
@@ -90,6 +91,9 @@ int main(int argc, char **argv)
                                           COLOR_RGB_TO16BITS(0,151,169), -1, 255 );   /* fontcolor, transcolor,opaque */
 	#endif
 
+	/* Pack glyphs of the face/size in an atlas, for CJK text give it more memory */
+	EGI_FTATLAS *atlas=FTatlas_create(egi_appfonts.bold, 30, 30, 0, FTATLAS_SHELF_BESTFIT);
+
 	//printf("%s\n", argv[1]);
 	FTsymbol_uft8strings_writeFB( 	&gv_fb_dev, egi_appfonts.bold,         	/* FBdev, fontface */
 				      	//60, 60,(const unsigned char *)argv[1], 	/* fw,fh, pstr */
@@ -100,6 +104,11 @@ int main(int argc, char **argv)
 					10, 10,                           	/* x0,y0, */
                                      	WEGI_COLOR_RED, -1, -1,      /* fontcolor, transcolor,opaque */
                                      	NULL, NULL, NULL, NULL);      /* int *cnt, int *lnleft, int* penx, int* peny */
+
+	if(atlas)
+		printf("Atlas: hits %u, misses %u, evictions %u, %d glyphs in %d shelves.\n",
+			atlas->hits, atlas->misses, atlas->evictions, atlas->nglyphs, atlas->nshelves);
+	FTatlas_free(&atlas);
 #endif
 
 
@@ -0,0 +1,167 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Test the event loop.
+1. A periodic timer, a one-shot timer re-armed in its handler, and a
+   timer disarmed before it expires.
+2. Wakeup latency from another thread, as a page runner does by
+   egi_page_wakeup().
+3. A signal read by signalfd, and a handler ends the loop.
+4. CPU time when idle, against polling every 5ms as egi_page_routine()
+   did with tm_delayms().
+
+Usage:	make test TEST_NAME=test_evloop
+
+Midas Zhou
+------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "egi_evloop.h"
+#include "egi_test.h"
+
+#define WAKEUP_TIMES	200
+#define EXIT_LOOP	99
+
+static EGI_EVLOOP *evloop;
+static int nticks;
+static int nshots;
+static int ndisarmed;
+static volatile int wakeup_seq;
+static struct timespec wakeup_ts;
+
+static long long ts_us(const struct timespec *ts)
+{
+	return ts->tv_sec*1000000LL+ts->tv_nsec/1000;
+}
+
+static long long cpu_us(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return (ru.ru_utime.tv_sec+ru.ru_stime.tv_sec)*1000000LL+ru.ru_utime.tv_usec+ru.ru_stime.tv_usec;
+}
+
+static int tick(EGI_EVLOOP *evloop, int fd, void *arg)
+{
+	nticks++;
+	return 0;
+}
+
+/* Re-arm itself 3 times */
+static int shot(EGI_EVLOOP *evloop, int fd, void *arg)
+{
+	if(++nshots<3)
+		egi_evloop_set_timer(evloop, fd, 20, false);
+	return 0;
+}
+
+static int disarmed(EGI_EVLOOP *evloop, int fd, void *arg)
+{
+	ndisarmed++;
+	return 0;
+}
+
+static int sigusr(EGI_EVLOOP *evloop, int fd, void *arg)
+{
+	return EXIT_LOOP;
+}
+
+/* Wake up the loop WAKEUP_TIMES, as a runner thread */
+static void *runner(void *arg)
+{
+	int i;
+
+	for(i=0; i<WAKEUP_TIMES; i++) {
+		usleep(2000);
+		clock_gettime(CLOCK_MONOTONIC, &wakeup_ts);
+		__atomic_store_n(&wakeup_seq, i+1, __ATOMIC_RELEASE);
+		egi_evloop_wakeup(evloop);
+		while( __atomic_load_n(&wakeup_seq, __ATOMIC_ACQUIRE)>0 )
+			usleep(100);
+	}
+
+	return (void *)0;
+}
+
+int main(void)
+{
+	struct timespec t0, t1;
+	pthread_t thread;
+	long long us, sum=0, max=0;
+	long long cpu0;
+	int tfd, ret, n;
+
+	evloop=egi_evloop_new();
+	if(evloop==NULL)
+		return -1;
+
+	/* 1. Timers in 500ms */
+	tfd=egi_evloop_add_timer(evloop, 50, true, tick, NULL);
+	egi_evloop_add_timer(evloop, 20, false, shot, NULL);
+	ret=egi_evloop_add_timer(evloop, 100, false, disarmed, NULL);
+	egi_evloop_set_timer(evloop, ret, 0, false);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	do {
+		egi_evloop_wait(evloop, 10);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+	} while( ts_us(&t1)-ts_us(&t0) < 500000 );
+	egi_evloop_del_fd(evloop, tfd);
+	TEST_CHECK( nticks>=9 && nticks<=10 && nshots==3 && ndisarmed==0,
+		    "timers: %d ticks, %d shots, %d disarmed, expect 10, 3, 0\n", nticks, nshots, ndisarmed );
+
+	/* 2. Wakeups from a thread */
+	if( pthread_create(&thread, NULL, runner, NULL)!=0 )
+		return -2;
+	for(n=0; n<WAKEUP_TIMES; ) {
+		egi_evloop_wait(evloop, 1000);
+		if( __atomic_load_n(&wakeup_seq, __ATOMIC_ACQUIRE)==0 ) {
+			TEST_FAIL("wakeup: no wakeup in 1s.\n");
+			break;
+		}
+		else {
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			us=ts_us(&t1)-ts_us(&wakeup_ts);
+			sum+=us;
+			if(us>max)
+				max=us;
+			n++;
+			__atomic_store_n(&wakeup_seq, 0, __ATOMIC_RELEASE);
+		}
+	}
+	pthread_join(thread, NULL);
+	if(n==WAKEUP_TIMES)
+		TEST_PASS();
+	printf("Wakeup from a thread: avg %lldus, max %lldus, in %d wakeups.\n", sum/(n>0?n:1), max, n);
+
+	/* 3. Signal */
+	egi_evloop_add_signal(evloop, SIGUSR1, sigusr, NULL);
+	raise(SIGUSR1);
+	ret=egi_evloop_wait(evloop, 1000);
+	TEST_CHECK( ret==EXIT_LOOP, "signal: egi_evloop_wait() returns %d, expect %d\n", ret, EXIT_LOOP );
+
+	/* 4. CPU time when idle in 2s */
+	cpu0=cpu_us();
+	egi_evloop_wait(evloop, 2000);
+	us=cpu_us()-cpu0;
+	cpu0=cpu_us();
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	do {
+		usleep(5000);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+	} while( ts_us(&t1)-ts_us(&t0) < 2000000 );
+	printf("CPU time in 2s idle: %lldus by the event loop, %lldus by polling every 5ms.\n", us, cpu_us()-cpu0);
+
+	egi_evloop_free(&evloop);
+	test_report("Event loop");
+
+	return test_result();
+}
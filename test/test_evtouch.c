@@ -0,0 +1,215 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Test the evdev touch backend with a virtual touch screen by uinput.
+1. Tap, drag, hold still and double tap are injected, and touch data
+   read out by egi_touch_waitdata() are checked.
+2. Latency from injecting a tap to reading out its 'pressing'.
+3. CPU time of the backend when idle.
+
+Usage:	make test TEST_NAME=test_evtouch
+	test_evtouch	(needs /dev/uinput, modprobe uinput)
+
+Midas Zhou
+------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include "egi_common.h"
+#include "egi_touch.h"
+#include "xpt2046.h"
+#include "egi_test.h"
+
+#define UINPUT_NAME	"EGI uinput touch"
+#define LATENCY_TAPS	200
+
+static int ufd=-1;
+
+static void emit(int type, int code, int value)
+{
+	struct input_event ie;
+
+	memset(&ie, 0, sizeof(ie));
+	ie.type=type;
+	ie.code=code;
+	ie.value=value;
+	if( write(ufd, &ie, sizeof(ie))!=sizeof(ie) )
+		printf("Fail to write uinput: %s\n", strerror(errno));
+}
+
+/* A frame of touch events */
+static void inject(bool down, int x, int y)
+{
+	emit(EV_ABS, ABS_X, x);
+	emit(EV_ABS, ABS_Y, y);
+	emit(EV_KEY, BTN_TOUCH, down);
+	emit(EV_SYN, SYN_REPORT, 0);
+}
+
+/* Read out touch data, and check it */
+static void expect(const char *tag, enum egi_touch_status status, int x, int y, int dx, int dy)
+{
+	EGI_TOUCH_DATA data;
+
+	if( egi_touch_waitdata(&data, 500)!=0 ) {
+		TEST_FAIL("%s: no touch data.\n", tag);
+		return;
+	}
+	TEST_CHECK( data.status==status && data.coord.x==x && data.coord.y==y && data.dx==dx && data.dy==dy,
+		    "%s: status %d (%d,%d) dx=%d dy=%d, expect %d (%d,%d) dx=%d dy=%d\n", tag,
+		    data.status, data.coord.x, data.coord.y, data.dx, data.dy, status, x, y, dx, dy );
+}
+
+static long long ts_us(const struct timespec *ts)
+{
+	return ts->tv_sec*1000000LL+ts->tv_nsec/1000;
+}
+
+/* Create the virtual touch screen, and find its event device */
+static int create_uinput(char *path, size_t size)
+{
+	struct uinput_user_dev udev;
+	char name[64];
+	int fd;
+	int i;
+
+	ufd=open("/dev/uinput", O_WRONLY|O_NONBLOCK);
+	if(ufd<0) {
+		printf("Fail to open /dev/uinput: %s\n", strerror(errno));
+		return -1;
+	}
+	ioctl(ufd, UI_SET_EVBIT, EV_KEY);
+	ioctl(ufd, UI_SET_KEYBIT, BTN_TOUCH);
+	ioctl(ufd, UI_SET_EVBIT, EV_ABS);
+	ioctl(ufd, UI_SET_ABSBIT, ABS_X);
+	ioctl(ufd, UI_SET_ABSBIT, ABS_Y);
+	ioctl(ufd, UI_SET_EVBIT, EV_SYN);
+
+	memset(&udev, 0, sizeof(udev));
+	snprintf(udev.name, UINPUT_MAX_NAME_SIZE, UINPUT_NAME);
+	udev.id.bustype=BUS_VIRTUAL;
+	udev.absmin[ABS_X]=0;
+	udev.absmax[ABS_X]=LCD_SIZE_X-1;
+	udev.absmin[ABS_Y]=0;
+	udev.absmax[ABS_Y]=LCD_SIZE_Y-1;
+	if( write(ufd, &udev, sizeof(udev))!=sizeof(udev) || ioctl(ufd, UI_DEV_CREATE)<0 ) {
+		printf("Fail to create uinput device: %s\n", strerror(errno));
+		return -2;
+	}
+	usleep(200000);	/* For udev/mdev to make the node */
+
+	for(i=0; i<32; i++) {
+		snprintf(path, size, "/dev/input/event%d", i);
+		fd=open(path, O_RDONLY);
+		if(fd<0)
+			continue;
+		memset(name, 0, sizeof(name));
+		ioctl(fd, EVIOCGNAME(sizeof(name)-1), name);
+		close(fd);
+		if(strcmp(name, UINPUT_NAME)==0)
+			return 0;
+	}
+
+	printf("Fail to find event device of '%s'.\n", UINPUT_NAME);
+	return -3;
+}
+
+int main(void)
+{
+	EGI_TOUCH_DATA data;
+	struct timespec t0, t1;
+	struct rusage ru0, ru1;
+	char path[64];
+	long long us, sum=0, max=0;
+	int i, n;
+
+        /* <<<<<  EGI general init  >>>>>> */
+	if( create_uinput(path, sizeof(path))!=0 )
+		goto END_TEST;
+	if( egi_start_touchread_evdev(path)!=0 )
+		goto END_TEST;
+        /* <<<<<  End EGI Init  >>>>> */
+
+	/* 1. Tap */
+	inject(true, 100, 200);
+	expect("tap press", pressing, 100, 200, 0, 0);
+	inject(false, 100, 200);
+	expect("tap release", releasing, 100, 200, 0, 0);
+
+	/* 2. Drag, after the double click interval */
+	usleep(TM_DBCLICK_INTERVAL+100000);
+	inject(true, 10, 10);
+	expect("drag press", pressing, 10, 10, 0, 0);
+	for(i=1; i<=5; i++) {
+		inject(true, 10+i*8, 10+i*10);
+		expect("drag move", pressed_hold, 10+i*8, 10+i*10, i*8, i*10);
+	}
+
+	/* 3. Hold still, pressed_hold is repeated */
+	usleep(300000);
+	for(n=0; egi_touch_getdata(&data); n++) {
+		if(data.status!=pressed_hold || data.dx!=40 || data.dy!=50)
+			break;
+	}
+	TEST_CHECK( n>=4 && !data.updated, "hold: %d pressed_hold repeated in 300ms.\n", n );
+	inject(false, 50, 60);
+	expect("drag release", releasing, 50, 60, 40, 50);
+
+	/* 4. Double tap */
+	usleep(TM_DBCLICK_INTERVAL+100000);
+	inject(true, 30, 40);
+	expect("dbtap press1", pressing, 30, 40, 0, 0);
+	inject(false, 30, 40);
+	expect("dbtap release1", releasing, 30, 40, 0, 0);
+	inject(true, 31, 41);
+	expect("dbtap press2", db_pressing, 31, 41, 0, 0);
+	inject(false, 31, 41);
+	expect("dbtap release2", releasing, 31, 41, 0, 0);
+
+	test_report("Touch data");
+
+	/* 5. Latency of taps */
+	for(i=0; i<LATENCY_TAPS; i++) {
+		usleep(TM_DBCLICK_INTERVAL/20);
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		inject(true, i%LCD_SIZE_X, i%LCD_SIZE_Y);
+		egi_touch_waitdata(&data, 500);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		us=ts_us(&t1)-ts_us(&t0);
+		sum+=us;
+		if(us>max)
+			max=us;
+		inject(false, i%LCD_SIZE_X, i%LCD_SIZE_Y);
+		egi_touch_waitdata(&data, 500);
+	}
+	printf("Inject to read out: avg %lldus, max %lldus, in %d taps.\n", sum/LATENCY_TAPS, max, LATENCY_TAPS);
+	printf("Kernel to read out: %lldus for the last release.\n", ts_us(&t1)-ts_us(&data.ts));
+
+	/* 6. CPU time when idle */
+	getrusage(RUSAGE_SELF, &ru0);
+	sleep(2);
+	getrusage(RUSAGE_SELF, &ru1);
+	us=(ru1.ru_utime.tv_sec-ru0.ru_utime.tv_sec+ru1.ru_stime.tv_sec-ru0.ru_stime.tv_sec)*1000000LL
+		+ru1.ru_utime.tv_usec-ru0.ru_utime.tv_usec+ru1.ru_stime.tv_usec-ru0.ru_stime.tv_usec;
+	printf("CPU time in 2s idle: %lldus.\n", us);
+
+END_TEST:
+        /* <<<<<  EGI general release >>>>> */
+        printf("egi_end_touchread()...\n");
+        egi_end_touchread();
+	if(ufd>=0) {
+		ioctl(ufd, UI_DEV_DESTROY);
+		close(ufd);
+	}
+
+	return test_result();
+}
@@ -0,0 +1,179 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Test the gesture recognizer.
+1. Synthetic touch data of tap, double tap, long press, slow drag and
+   swipes are fed, and the gestures recognized are checked.
+2. Velocity of a jittering drag at a constant speed is estimated by
+   least-squares fitting, and compared with the velocity of the last
+   two samples.
+3. With '-l', print gestures of the touch screen.
+
+Usage:	make test TEST_NAME=test_gesture
+	test_gesture [-l]
+
+Midas Zhou
+------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "egi_common.h"
+#include "egi_touch.h"
+#include "egi_gesture.h"
+#include "egi_test.h"
+
+static EGI_GESTURE_TRACKER gt;
+static EGI_GESTURE gs[EGI_GESTURE_MAXOUT];
+static long long now_us=1000000;	/* Time of synthetic touch data */
+
+/* Feed a synthetic touch data, ms after the last one */
+static int feed(enum egi_touch_status status, int x, int y, int ms)
+{
+	EGI_TOUCH_DATA data;
+
+	now_us += ms*1000LL;
+	memset(&data, 0, sizeof(data));
+	data.updated=true;
+	data.status=status;
+	data.coord.x=x;
+	data.coord.y=y;
+	data.ts.tv_sec=now_us/1000000;
+	data.ts.tv_nsec=now_us%1000000*1000;
+
+	return egi_gesture_feed(&gt, &data, gs, EGI_GESTURE_MAXOUT);
+}
+
+/* Check gestures of the last feed */
+static void expect(const char *tag, int n, enum egi_gesture_type type, enum egi_gesture_dir dir)
+{
+	TEST_CHECK( n>=1 && gs[n-1].type==type && gs[n-1].dir==dir,
+		    "%s: %d gestures, last '%s' dir %d, expect '%s' dir %d\n", tag, n,
+		    n>0 ? egi_str_gesture(gs[n-1].type) : "-", n>0 ? gs[n-1].dir : 0,
+		    egi_str_gesture(type), dir );
+}
+
+static void expect_none(const char *tag, int n)
+{
+	TEST_CHECK( n==0, "%s: unexpected '%s'\n", tag, egi_str_gesture(gs[0].type) );
+}
+
+/* Print gestures of the touch screen */
+static void live_gestures(void)
+{
+	EGI_TOUCH_DATA touch_data;
+	int i,n;
+
+	if( egi_start_touchread()!=0 )
+		return;
+	egi_gesture_reset(&gt);
+	while(1) {
+		if(!egi_touch_getdata(&touch_data)) {
+			tm_delayms(5);
+			continue;
+		}
+		n=egi_gesture_feed(&gt, &touch_data, gs, EGI_GESTURE_MAXOUT);
+		for(i=0; i<n; i++) {
+			printf("%s (%d,%d) dx=%d dy=%d v=(%.0f,%.0f)px/s dir=%d\n", egi_str_gesture(gs[i].type),
+				gs[i].coord.x, gs[i].coord.y, gs[i].dx, gs[i].dy, gs[i].vx, gs[i].vy, gs[i].dir);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	double err_fit=0, err_diff=0;
+	float vx,vy;
+	int x,lastx=0;
+	int i,n;
+
+	if(argc>1 && strcmp(argv[1],"-l")==0) {
+		live_gestures();
+		return 0;
+	}
+
+	egi_gesture_reset(&gt);
+
+	/* 1. Tap, with a little jitter */
+	feed(pressing, 100, 100, 0);
+	expect_none("tap hold", feed(pressed_hold, 103, 98, 30));
+	expect("tap", feed(releasing, 103, 98, 30), gesture_tap, gesture_dir_none);
+
+	/* 2. Double tap */
+	feed(pressing, 104, 101, 150);
+	expect("dbtap", feed(releasing, 104, 101, 60), gesture_dbtap, gesture_dir_none);
+
+	/* 3. A tap too late to pair with the last one */
+	feed(pressing, 100, 100, 1000);
+	expect("tap1", feed(releasing, 100, 100, 50), gesture_tap, gesture_dir_none);
+	feed(pressing, 100, 100, GESTURE_DBTAP_MS+50);
+	expect("tap2", feed(releasing, 100, 100, 50), gesture_tap, gesture_dir_none);
+
+	/* 4. Long press, no tap after it */
+	feed(pressing, 50, 200, 1000);
+	for(i=0; i<GESTURE_LONGPRESS_MS/50-1; i++)
+		expect_none("long hold", feed(pressed_hold, 50, 201, 50));
+	expect("longpress", feed(pressed_hold, 51, 200, 50), gesture_longpress, gesture_dir_none);
+	expect_none("long hold more", feed(pressed_hold, 51, 200, 50));
+	expect_none("long release", feed(releasing, 51, 200, 50));
+
+	/* 5. Slow drag, then pause and release: no swipe */
+	feed(pressing, 20, 20, 1000);
+	expect("drag start", feed(pressed_hold, 20, 35, 20), gesture_drag_start, gesture_dir_none);
+	for(i=1; i<=10; i++)
+		expect("drag", feed(pressed_hold, 20, 35+i*2, 20), gesture_drag, gesture_dir_none);
+	TEST_CHECK( gs[0].vy>=50 && gs[0].vy<=150 && gs[0].dy==35,
+		    "drag velocity: vy=%.1f dy=%d, expect 100px/s dy=35\n", gs[0].vy, gs[0].dy );
+	for(i=0; i<4; i++)
+		feed(pressed_hold, 20, 55, 50);	/* Held still */
+	n=feed(releasing, 20, 55, 10);
+	expect("drag end", n, gesture_drag_end, gesture_dir_none);
+	TEST_CHECK( n==1 && fabs(gs[0].vy)<=1.0, "drag end: %d gestures, vy=%.1f after a pause\n", n, gs[0].vy );
+
+	/* 6. Swipes in four directions, 1000px/s */
+	feed(pressing, 200, 100, 1000);
+	for(i=1; i<=6; i++)
+		feed(pressed_hold, 200-i*10, 100, 10);
+	expect("swipe left", feed(releasing, 140, 100, 10), gesture_swipe, gesture_dir_left);
+	feed(pressing, 20, 100, 1000);
+	for(i=1; i<=6; i++)
+		feed(pressed_hold, 20+i*10, 102, 10);
+	expect("swipe right", feed(releasing, 80, 102, 10), gesture_swipe, gesture_dir_right);
+	feed(pressing, 100, 300, 1000);
+	for(i=1; i<=6; i++)
+		feed(pressed_hold, 98, 300-i*10, 10);
+	expect("swipe up", feed(releasing, 98, 240, 10), gesture_swipe, gesture_dir_up);
+	feed(pressing, 100, 20, 1000);
+	for(i=1; i<=6; i++)
+		feed(pressed_hold, 100, 20+i*10, 10);
+	expect("swipe down", feed(releasing, 100, 80, 10), gesture_swipe, gesture_dir_down);
+
+	/* 7. Missed 'pressing' and 'releasing' while not pressed are tolerated */
+	expect_none("missed pressing", feed(pressed_hold, 10, 10, 1000));
+	expect("missed pressing tap", feed(releasing, 10, 10, 50), gesture_tap, gesture_dir_none);
+	expect_none("extra releasing", feed(releasing, 10, 10, 50));
+
+	test_report("Gesture");
+
+	/* 8. Velocity of a jittering drag at 500px/s, samples every 8ms */
+	srand(1);
+	feed(pressing, 0, 100, 1000);
+	for(i=1; i<=200; i++) {
+		x=i*4+rand()%5-2;
+		feed(pressed_hold, x, 100, 8);
+		if(i>EGI_GESTURE_SAMPLES) {
+			egi_gesture_velocity(&gt, &vx, &vy);
+			err_fit += fabs(vx-500.0);
+			err_diff += fabs((x-lastx)/0.008-500.0);
+		}
+		lastx=x;
+	}
+	feed(releasing, x, 100, 8);
+	printf("Velocity of a drag at 500px/s with 2px jitter: mean error %.1fpx/s fitted, %.1fpx/s by last 2 samples.\n",
+			err_fit/(200-EGI_GESTURE_SAMPLES), err_diff/(200-EGI_GESTURE_SAMPLES));
+
+	return test_result();
+}
@@ -0,0 +1,96 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Touch-to-photon latency histograms.
+1. Without options, trace synthetic touches with known delays of each
+   stage, and check percentiles in the summary.
+2. With '-r', attach to histograms in shared memory, written by an EGI
+   app which calls egi_lat_enable("/egi_latency"), and print a summary
+   every few seconds.
+
+Usage:	make test TEST_NAME=test_latency
+	test_latency [-r [seconds]]
+
+Midas Zhou
+------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "egi_latency.h"
+#include "egi_shmem.h"
+#include "egi_test.h"
+
+#define LAT_SHM_NAME	"/egi_latency"
+#define LAT_TOUCHES	200
+
+/* Check a percentile is within a bucket(25%) and scheduling slack of expected */
+static void expect(enum egi_lat_stage stage, const EGI_LATENCY *lat, unsigned int us)
+{
+	unsigned int p50=egi_lat_percentile(&lat->hists[stage], 50);
+
+	TEST_CHECK( lat->hists[stage].count==LAT_TOUCHES && p50>=us && p50<=us*5/4+500,
+		    "%s: n=%u p50=%uus, expect n=%d p50=%uus\n", egi_str_lat_stage(stage),
+		    lat->hists[stage].count, p50, LAT_TOUCHES, us );
+}
+
+int main(int argc, char **argv)
+{
+	EGI_LATENCY *lat;
+	struct timespec ts;
+	int secs;
+	int i;
+
+	/* Read histograms of another process */
+	if(argc>1 && strcmp(argv[1],"-r")==0) {
+		secs= argc>2 ? atoi(argv[2]) : 5;
+		while(1) {
+			lat=egi_lat_attach(LAT_SHM_NAME);
+			if(lat!=NULL)
+				egi_lat_summary(lat);
+			sleep(secs);
+		}
+	}
+
+	/* Synthetic touches: read 2ms before dispatched, react in 3ms, and 5ms to render */
+	if( egi_lat_enable(LAT_SHM_NAME)!=0 )
+		return -1;
+	for(i=0; i<LAT_TOUCHES; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		usleep(2000);
+		egi_lat_touch(&ts);
+		egi_lat_react_begin();
+		usleep(3000);
+		egi_lat_react_end();
+
+		/* A touch superseded by the first one */
+		if(i%10==0) {
+			egi_lat_touch(NULL);
+			egi_lat_react_begin();
+			egi_lat_react_end();
+		}
+
+		usleep(5000);
+		egi_lat_frame();
+		egi_lat_frame();	/* No touch pending */
+	}
+	lat=egi_lat_data();
+	egi_lat_summary(lat);
+
+	expect(lat_render, lat, 5000);
+	expect(lat_total, lat, 10000);
+	TEST_CHECK( lat->superseded==LAT_TOUCHES/10, "superseded: %u, expect %d\n", lat->superseded, LAT_TOUCHES/10 );
+
+	/* Same data seen from shared memory */
+	lat=egi_lat_attach(LAT_SHM_NAME);
+	TEST_CHECK( lat!=NULL && lat->hists[lat_total].count==LAT_TOUCHES, "attach: no data in shared memory.\n" );
+
+	egi_lat_disable();
+	egi_shmem_remove(LAT_SHM_NAME);
+	test_report("Latency");
+
+	return test_result();
+}
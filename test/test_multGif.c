@@ -3,11 +3,13 @@ This program is free software; you can redistribute it and/or modify
 it under the terms of the GNU General Public License version 2 as
 published by the Free Software Foundation.
 
-An example to operate and display EGI_GIF with mutli_threads.
+An example to operate and display EGI_GIFs with an EGI_GIFSCHED, all
+GIFs are updated by ONE scheduler thread.
 
 Note:
 1. The base layer GIF for displaying shall be nontransparent type or
    set ImgTransp_ON to false.
+2. Frame lateness statistics are printed every 1000 page refreshes.
 
 Midas Zhou
 ------------------------------------------------------------------*/
@@ -16,6 +18,7 @@ Midas Zhou
 #include "egi_common.h"
 #include "egi_FTsymbol.h"
 #include "egi_gif.h"
+#include "egi_gifsched.h"
 
 
 const wchar_t *wslogan=L"EGI: A mini UI Powered by Openwrt";
@@ -29,6 +32,7 @@ typedef struct gif_thread_params
 	bool ImgTransp_ON;
 	int  x0,y0;	   /* gif->Simgbuf origin coordinates relating to LCD */
 	int  xp,yp;
+	EGI_GIF_CONTEXT gif_ctxt;
 
 } GIF_PARAM;
 
@@ -44,8 +48,7 @@ static GIF_PARAM gif_param[4] =
 	{ .fname="/mmc/muyu.gif", .DirectFB_ON=false, .ImgTransp_ON=true, .x0=90, .y0=80 }, //.x0=10, .y0=20  }, /* 140x123 */
 };
 //static EGI_GIF *egif[4];
-static pthread_t thread_gif[4];
-static void *thread_GifImgbuf_update(void *arg);
+static EGI_GIFSCHED *gif_sched;
 
 int main(int argc, char **argv)
 {
@@ -85,6 +88,8 @@ int main(int argc, char **argv)
 
 	int i;
 	int k;
+	int n;
+	EGI_GIFSCHED_STATS stats;
     	int xres;
     	int yres;
 	bool DirectFB_ON=false; /* For transparency_off GIF,to speed up,tear line possible. */
@@ -110,19 +115,40 @@ int main(int argc, char **argv)
             //memcpy(gv_fb_dev.map_bk, gv_fb_dev.map_fb, gv_fb_dev.screensize);
     	}
 
-	/* Start GIF updating threads */
-	printf("Creating gif threads...\n");
+	/* Start the GIF scheduler */
+	printf("Creating gif scheduler...\n");
+	gif_sched=egi_gifsched_create();
+	if(gif_sched==NULL)
+		exit(-1);
+
 	for(i=0; i<4; i++) {
-		if( pthread_create(&thread_gif[i],NULL, thread_GifImgbuf_update, (void *)&gif_param[i]) != 0 )
-		{
-			printf("Fail to start thread_gif[%d]!\n",i);
-			exit(-1);
+		if(gif_param[i].fname==NULL)
+			continue;
+
+		/* Slurp GIF data to EGI_GIF */
+		gif_param[i].egif= egi_gif_slurpFile( gif_param[i].fname, gif_param[i].ImgTransp_ON);
+		if(gif_param[i].egif==NULL) {
+			printf("Fail to read in gif file '%s'! \n", gif_param[i].fname);
+			continue;
 		}
+
+		/* FBDEV is NULL, update egif->Simgbuf ONLY */
+		memset(&gif_param[i].gif_ctxt, 0, sizeof(EGI_GIF_CONTEXT));
+		gif_param[i].gif_ctxt.egif=gif_param[i].egif;
+		gif_param[i].gif_ctxt.nloop=-1;
+		gif_param[i].gif_ctxt.DirectFB_ON=gif_param[i].DirectFB_ON;
+		gif_param[i].gif_ctxt.User_DisposalMode=-1;
+		gif_param[i].gif_ctxt.User_TransColor=-1;
+		gif_param[i].gif_ctxt.User_BkgColor=-1;
+
+		if( egi_gifsched_add(gif_sched, &gif_param[i].gif_ctxt)!=0 )
+			printf("Fail to add '%s' to the scheduler!\n", gif_param[i].fname);
 	}
 
 	/* Loop displaying */
 	printf("loop displaying...\n");
 	k=320;
+	n=0;
         while(1) {
 
 	   /* refresh working buffer */
@@ -159,12 +185,23 @@ int main(int argc, char **argv)
                                           k, 10,                           /* x0,y0, */
                               COLOR_RGB_TO16BITS(224,60,49), -1, 255 );   /* fontcolor, transcolor, opaque */
 
-	    printf(" page refresh \n");
-	    fb_page_refresh(&gv_fb_dev);
+	    fb_page_refresh(&gv_fb_dev, 0);
 	    usleep(10000);
+
+	    /* Print frame lateness */
+	    if( ++n%1000==0 ) {
+		for(i=0; i<4; i++) {
+		    if( egi_gifsched_getStats(gif_sched, &gif_param[i].gif_ctxt, &stats)!=0 )
+			continue;
+		    printf("'%s': %u frames, %u late, lateness avg. %lluus max. %uus, rendering %uus\n",
+				gif_param[i].fname, stats.frames, stats.late_frames,
+				stats.frames ? stats.sum_late_us/stats.frames : 0, stats.max_late_us, stats.rend_us);
+		}
+	    }
 	}
 
-	/* Free EGI_GIF */
+	/* Stop the scheduler and free EGI_GIF */
+	egi_gifsched_free(&gif_sched);
         for(i=0; i<4; i++)
 	    	egi_gif_free(&(gif_param[i].egif));
 
@@ -188,40 +225,3 @@ int main(int argc, char **argv)
 	return 0;
 }
 
-
-/*--------------------------------------
-A thread function: updating GIF Simgbuf
----------------------------------------*/
-static void *thread_GifImgbuf_update(void *arg)
-{
-	EGI_GIF *egif;
-	GIF_PARAM *param=(GIF_PARAM *)arg;
-
-	/* Slurp GIF data to EGI_GIF */
-	egif= egi_gif_slurpFile( param->fname, param->ImgTransp_ON); /* fpath, bool ImgTransp_ON */
-	if(egif==NULL) {
-		printf("%s: Fail to read in gif file '%s'! \n",__func__, param->fname);
-		return (void *)-1;
-	}
-	printf("%s: Finish slurping '%s' to EGI_GIF.\n", __func__, param->fname);
-
-	/* assign EGI_GIF */
-	param->egif=egif;
-
-	/* Loop updating Simgbuf of egif */
-        while(1) {
-	    /* FBDEV is NULL, update egif->Simgbuf ONLY */
-            egi_gif_displayFrame( NULL, egif, 		/* *fbdev, EGI_GIF *egif */
-				  100, false,		/*  nloop, bool DirectFB_ON */
-		  -1,-1, -1,		/*  int User_DisposalMode, int User_TransColor, int User_BkgColor, */
-				  0,0,  		/* xp, yp */
-				  0,0, 			/* xw, yw */
-				  0,0			/* winw, winh */
-			);
-	}
-
-    	egi_gif_free(&egif);
-
-
-	return (void *)0;
-}
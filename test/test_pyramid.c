@@ -0,0 +1,97 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+An example to pan and zoom a big JPG picture by EGI_IMGPYRAMID.
+
+Usage:	./test_pyramid  /mmc/big.jpg
+
+1. Zoom in from the whole picture to full resolution at the center,
+   then pan around and zoom out again.
+2. Tiles of the next view are prefetched while the frame is shown.
+
+Midas Zhou
+------------------------------------------------------------------*/
+#include <stdio.h>
+#include "egi_common.h"
+#include "egi_imgpyramid.h"
+
+#define TILE_SIZE	128
+#define MAX_TILES	64	/* 64*128*128*2 = 2MBytes */
+
+int main(int argc, char **argv)
+{
+	EGI_IMGPYRAMID *pyr=NULL;
+	long long unsigned int tm_start;
+	float zoom, zoom_min;
+	int xres, yres;
+	int cx, cy;		/* View center, in full resolution image coordinates */
+	int nframes=0;
+	int i;
+
+	if(argc<2) {
+		printf("Usage: %s file.jpg\n", argv[0]);
+		exit(-1);
+	}
+
+        /* <<<<<  EGI general init  >>>>>> */
+        printf("init_fbdev()...\n");
+        if( init_fbdev(&gv_fb_dev) )		/* init sys FB */
+                return -1;
+        /* <<<<<  END EGI general init  >>>>>> */
+
+	xres=gv_fb_dev.pos_xres;
+	yres=gv_fb_dev.pos_yres;
+
+	pyr=egi_imgpyramid_open(argv[1], TILE_SIZE, MAX_TILES);
+	if(pyr==NULL)
+		exit(-1);
+	printf("%dx%d picture, %d levels.\n", pyr->width, pyr->height, pyr->nlevels);
+
+	/* Whole picture in the screen */
+	zoom_min = (float)xres/pyr->width < (float)yres/pyr->height ?
+			(float)xres/pyr->width : (float)yres/pyr->height;
+	cx=pyr->width/2;
+	cy=pyr->height/2;
+
+	tm_start=tm_get_tmstampms();
+
+	/* Zoom in */
+	for(zoom=zoom_min; zoom<1.0; zoom*=1.1, nframes++) {
+		egi_imgpyramid_renderView(pyr, &gv_fb_dev, zoom, cx-xres/2/zoom, cy-yres/2/zoom,
+									0, 0, xres, yres);
+		fb_page_refresh(&gv_fb_dev, 0);
+		egi_imgpyramid_prefetch(pyr, zoom*1.1, cx-xres/2/zoom/1.1, cy-yres/2/zoom/1.1,
+									xres, yres, 0);
+	}
+
+	/* Pan around at full resolution */
+	zoom=1.0;
+	for(i=0; i<400; i++, nframes++) {
+		cx += (i/100)%2 ? 0 : ( i<200 ? 8 : -8 );
+		cy += (i/100)%2 ? ( i<200 ? 8 : -8 ) : 0;
+		egi_imgpyramid_renderView(pyr, &gv_fb_dev, zoom, cx-xres/2, cy-yres/2, 0, 0, xres, yres);
+		fb_page_refresh(&gv_fb_dev, 0);
+		egi_imgpyramid_prefetch(pyr, zoom, cx-xres/2, cy-yres/2, xres, yres, TILE_SIZE/2);
+	}
+
+	/* Zoom out */
+	for(zoom=1.0; zoom>zoom_min; zoom/=1.1, nframes++) {
+		egi_imgpyramid_renderView(pyr, &gv_fb_dev, zoom, cx-xres/2/zoom, cy-yres/2/zoom,
+									0, 0, xres, yres);
+		fb_page_refresh(&gv_fb_dev, 0);
+	}
+
+	printf("%d frames in %llums, tile cache hits %u, misses %u, JPG band decodings %u.\n",
+		nframes, tm_get_tmstampms()-tm_start, pyr->hits, pyr->misses, pyr->decodes);
+
+	egi_imgpyramid_close(&pyr);
+
+        /* <<<<<  EGI general release >>>>> */
+	printf("release_fbdev()...\n");
+        release_fbdev(&gv_fb_dev);
+        printf("<-------  END  ------>\n");
+
+	return 0;
+}
@@ -0,0 +1,248 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Test the retained scene of a PAGE, on a virtual FB.
+1. Eboxes are drawn in z-order, a child above its parent.
+2. Only eboxes in the damage are redrawn, after one of them is marked
+   dirty, moved, raised, hidden or removed.
+3. The topmost ebox is hit.
+4. Eboxes redrawn for a moving ebox, in a grid of eboxes, against a
+   whole page refresh.
+
+Usage:	make test TEST_NAME=test_scene
+
+Midas Zhou
+------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "egi_common.h"
+#include "egi.h"
+#include "egi_page.h"
+#include "egi_scene.h"
+#include "egi_fbdev.h"
+#include "egi_fbgeom.h"
+#include "egi_image.h"
+#include "egi_test.h"
+
+#define GRID_COLS	6
+#define GRID_ROWS	8
+#define GRID_SIZE	36
+#define MOVE_STEPS	100
+
+static EGI_IMGBUF *vimg;
+static int nrefresh[64];
+
+/* Fill its box with prmcolor, and count refreshes by ebox->id */
+static int rect_refresh(EGI_EBOX *ebox)
+{
+	if(!ebox->need_refresh)
+		return 1;
+
+	nrefresh[ebox->id]++;
+	fbset_color(ebox->prmcolor);
+	draw_filled_rect(&gv_fb_dev, ebox->x0, ebox->y0, ebox->x0+ebox->width-1, ebox->y0+ebox->height-1);
+	ebox->need_refresh=false;
+
+	return 0;
+}
+
+static EGI_EBOX *rect_new(int id, int x0, int y0, int w, int h, int color)
+{
+	EGI_EBOX *ebox;
+
+	ebox=egi_ebox_new(type_btn);
+	if(ebox==NULL)
+		exit(-1);
+	ebox->id=id;
+	ebox->x0=x0;
+	ebox->y0=y0;
+	ebox->width=w;
+	ebox->height=h;
+	ebox->prmcolor=color;
+	ebox->status=status_active;
+	ebox->need_refresh=true;
+	ebox->refresh=rect_refresh;
+	sprintf(ebox->tag, "rect%d", id);
+
+	return ebox;
+}
+
+static EGI_16BIT_COLOR pixel(int x, int y)
+{
+	return vimg->imgbuf[y*vimg->width+x];
+}
+
+static void check_pixel(const char *step, int x, int y, EGI_16BIT_COLOR color)
+{
+	TEST_CHECK( pixel(x,y)==color, "%s: pixel (%d,%d) is 0x%04X, expect 0x%04X\n", step, x, y, pixel(x,y), color );
+}
+
+/* Check refresh counts since last check, as a string of digits by ebox id */
+static void check_refresh(const char *step, int n, const char *expect)
+{
+	char counts[64];
+	int i;
+
+	for(i=0; i<n; i++)
+		counts[i]='0'+nrefresh[i];
+	counts[n]=0;
+	TEST_CHECK( strcmp(counts, expect)==0, "%s: refreshed %s, expect %s\n", step, counts, expect );
+	memset(nrefresh, 0, sizeof(nrefresh));
+}
+
+static void check_hit(EGI_PAGE *page, int x, int y, EGI_EBOX *expect)
+{
+	EGI_EBOX *ebox=egi_hit_pagebox(x, y, page, type_btn);
+
+	TEST_CHECK( ebox==expect, "hit (%d,%d): '%s', expect '%s'\n", x, y, ebox ? ebox->tag : "NULL",
+								expect ? expect->tag : "NULL" );
+}
+
+/* 1-3. Scene of 4 rects:  A with a child B, C above A, D away */
+static void check_scene(void)
+{
+	EGI_PAGE *page;
+	EGI_EBOX *A, *B, *C, *D;
+
+	page=egi_page_new("scene");
+	page->ebox->prmcolor=WEGI_COLOR_BLACK;
+	egi_scene_enable(page, true);
+
+	A=rect_new(0, 20, 20, 100, 100, WEGI_COLOR_RED);
+	B=rect_new(1, 40, 40, 40, 40, WEGI_COLOR_GREEN);
+	C=rect_new(2, 100, 100, 80, 80, WEGI_COLOR_BLUE);
+	D=rect_new(3, 10, 250, 50, 50, WEGI_COLOR_YELLOW);
+	egi_page_addlist(page, A);
+	egi_scene_add_child(A, B);
+	C->z=5;
+	egi_page_addlist(page, C);
+	egi_page_addlist(page, D);
+
+	egi_page_refresh(page);
+	check_refresh("first frame", 4, "1111");
+	check_pixel("first frame", 60, 60, WEGI_COLOR_GREEN);
+	check_pixel("first frame", 110, 110, WEGI_COLOR_BLUE);
+	check_pixel("first frame", 15, 15, WEGI_COLOR_BLACK);
+	check_hit(page, 60, 60, B);
+	check_hit(page, 110, 110, C);
+
+	TEST_CHECK( egi_page_refresh(page)==1, "no damage: a frame is rendered.\n" );
+	check_refresh("no damage", 4, "0000");
+
+	egi_scene_mark_dirty(D);
+	egi_page_refresh(page);
+	check_refresh("dirty D", 4, "0001");
+
+	/* B in A, A overlaps C, C is redrawn above A */
+	egi_scene_move(B, 20, 0);
+	egi_page_refresh(page);
+	check_refresh("move B", 4, "1110");
+	check_pixel("move B", 45, 60, WEGI_COLOR_RED);
+	check_pixel("move B", 90, 60, WEGI_COLOR_GREEN);
+	check_pixel("move B", 110, 110, WEGI_COLOR_BLUE);
+
+	/* A and its child B above C */
+	egi_scene_set_z(A, 10);
+	egi_page_refresh(page);
+	check_refresh("raise A", 4, "1110");
+	check_pixel("raise A", 110, 110, WEGI_COLOR_RED);
+	check_pixel("raise A", 90, 60, WEGI_COLOR_GREEN);
+	check_pixel("raise A", 150, 150, WEGI_COLOR_BLUE);
+	check_hit(page, 110, 110, A);
+	check_hit(page, 90, 60, B);
+
+	/* Parent moves with its child, C beneath is exposed */
+	egi_scene_move(A, 0, -10);
+	egi_page_refresh(page);
+	check_refresh("move A", 4, "1110");
+	check_pixel("move A", 110, 112, WEGI_COLOR_BLUE);
+	check_pixel("move A", 90, 35, WEGI_COLOR_GREEN);
+
+	C->status=status_hidden;
+	egi_page_refresh(page);
+	check_refresh("hide C", 4, "1100");
+	check_pixel("hide C", 150, 150, WEGI_COLOR_BLACK);
+	check_hit(page, 150, 150, NULL);
+
+	egi_scene_remove(D);
+	egi_page_refresh(page);
+	check_refresh("remove D", 4, "0000");
+	check_pixel("remove D", 30, 270, WEGI_COLOR_BLACK);
+	egi_ebox_free(D);
+
+	egi_page_free(page);
+}
+
+/* 4. Move an ebox over a grid of eboxes */
+static void check_grid(void)
+{
+	EGI_PAGE *page;
+	EGI_EBOX *mover;
+	struct timespec t0, t1;
+	long long us[2];
+	int nref[2];
+	int i, k, retained;
+
+	for(retained=0; retained<2; retained++) {
+		page=egi_page_new("grid");
+		/* No wallpaper for whole page refresh, clear_screen() is not for a virtual FB */
+		page->ebox->prmcolor= retained ? WEGI_COLOR_BLACK : -1;
+		egi_scene_enable(page, retained);
+		for(i=0; i<GRID_COLS*GRID_ROWS; i++) {
+			egi_page_addlist(page, rect_new(i, (i%GRID_COLS)*(GRID_SIZE+4), (i/GRID_COLS)*(GRID_SIZE+4),
+						GRID_SIZE, GRID_SIZE, WEGI_COLOR_GRAY));
+		}
+		mover=rect_new(GRID_COLS*GRID_ROWS, 0, 0, 20, 20, WEGI_COLOR_RED);
+		mover->z=1;
+		egi_page_addlist(page, mover);
+		egi_page_refresh(page);
+		memset(nrefresh, 0, sizeof(nrefresh));
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for(k=0; k<MOVE_STEPS; k++) {
+			if(retained) {
+				egi_scene_move(mover, 2, 3);
+			}
+			else {
+				/* Without bkimg, the whole page is refreshed as the mover moves */
+				mover->x0+=2;
+				mover->y0+=3;
+				egi_page_needrefresh(page);
+			}
+			egi_page_refresh(page);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+
+		us[retained]=(t1.tv_sec-t0.tv_sec)*1000000LL+(t1.tv_nsec-t0.tv_nsec)/1000;
+		for(nref[retained]=0, i=0; i<=GRID_COLS*GRID_ROWS; i++)
+			nref[retained]+=nrefresh[i];
+		if(retained)
+			check_pixel("grid", mover->x0+10, mover->y0+10, WEGI_COLOR_RED);
+
+		egi_page_free(page);
+	}
+
+	printf("Move an ebox %d steps over %d eboxes: %d refreshes in %lldus by the scene, %d in %lldus by whole page.\n",
+			MOVE_STEPS, GRID_COLS*GRID_ROWS, nref[1], us[1], nref[0], us[0]);
+	TEST_CHECK( nref[1]*4 <= nref[0], "grid: too many refreshes by the scene.\n" );
+}
+
+int main(void)
+{
+	vimg=egi_imgbuf_create(320, 240, 255, WEGI_COLOR_BLACK);
+	if( vimg==NULL || init_virt_fbdev(&gv_fb_dev, vimg)!=0 )
+		return -1;
+
+	check_scene();
+	check_grid();
+
+	release_virt_fbdev(&gv_fb_dev);
+	egi_imgbuf_free(vimg);
+	test_report("Scene");
+
+	return test_result();
+}
@@ -0,0 +1,99 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+An example to show a grid of photo thumbnails by EGI_THUMB_SERVICE.
+
+Usage:	./test_thumbnail /mmc/photos
+
+1. Thumbnails are made by worker threads and fetched in the loop with
+   a frame budget, the screen is refreshed once per frame.
+2. Run it twice, thumbnails will be loaded from the cache directory
+   the second time.
+
+Midas Zhou
+------------------------------------------------------------------*/
+#include <stdio.h>
+#include "egi_common.h"
+#include "egi_thumbnail.h"
+
+#define THUMB_W		76
+#define THUMB_H		76
+#define GRID_COLS	3
+#define GRID_ROWS	4
+#define FRAME_BUDGET	40	/* ms */
+
+int main(int argc, char **argv)
+{
+	EGI_THUMB_SERVICE *srv=NULL;
+	EGI_IMGBUF *thumb=NULL;
+	long long unsigned int tm_start, tm_frame;
+	int total;
+	int index;
+	int nshown=0;
+	int x0,y0;
+	bool refresh;
+
+	if(argc<2) {
+		printf("Usage: %s dir\n", argv[0]);
+		exit(-1);
+	}
+
+        /* <<<<<  EGI general init  >>>>>> */
+        printf("init_fbdev()...\n");
+        if( init_fbdev(&gv_fb_dev) )		/* init sys FB */
+                return -1;
+        /* <<<<<  END EGI general init  >>>>>> */
+
+	clear_screen(&gv_fb_dev, WEGI_COLOR_GRAY);
+	fb_page_refresh(&gv_fb_dev, 0);
+
+	tm_start=tm_get_tmstampms();
+
+	srv=egi_thumbsrv_create("/tmp/.thumbnails", THUMB_W, THUMB_H);
+	if(srv==NULL)
+		exit(-1);
+
+	total=egi_thumbsrv_scanDir(srv, argv[1], "jpg, png", 2);
+	printf("%d image files found in %s.\n", total, argv[1]);
+
+	while( !egi_thumbsrv_finished(srv) || srv->ready_count>0 ) {
+
+		/* Fetch thumbnails within a frame budget */
+		refresh=false;
+		tm_frame=tm_get_tmstampms();
+		while( tm_get_tmstampms()-tm_frame < FRAME_BUDGET ) {
+			if( egi_thumbsrv_getReady(srv, &index, &thumb, FRAME_BUDGET/2) != 0 )
+				break;
+
+			/* Only the first screen is displayed */
+			if( thumb!=NULL && index < GRID_COLS*GRID_ROWS ) {
+				x0=(index%GRID_COLS)*(240/GRID_COLS)+(240/GRID_COLS-thumb->width)/2;
+				y0=(index/GRID_COLS)*(320/GRID_ROWS)+(320/GRID_ROWS-thumb->height)/2;
+				egi_imgbuf_windisplay(thumb, &gv_fb_dev, -1, 0, 0, x0, y0,
+								thumb->width, thumb->height);
+				refresh=true;
+				if(++nshown==GRID_COLS*GRID_ROWS || nshown==total)
+					printf("First screen of thumbnails shown in %llums.\n",
+									tm_get_tmstampms()-tm_start);
+			}
+			egi_imgbuf_free(thumb);
+		}
+
+		if(refresh)
+			fb_page_refresh(&gv_fb_dev, 0);
+	}
+
+	printf("All %d thumbnails finished in %llums, cache hits %d, misses %d, fails %d.\n",
+		 total, tm_get_tmstampms()-tm_start, srv->cache_hits, srv->cache_misses, srv->fails);
+
+	egi_thumbsrv_free(&srv);
+
+        /* <<<<<  EGI general release >>>>> */
+	printf("release_fbdev()...\n");
+        release_fbdev(&gv_fb_dev);
+        printf("<-------  END  ------>\n");
+
+	return 0;
+}
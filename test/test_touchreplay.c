@@ -0,0 +1,265 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Record and replay touch data.
+1. Without options, a synthetic record of a tap and a drag is replayed
+   at 4 times the speed and as fast as possible, touch data read out
+   are recorded again and checked against the original.
+2. With '-r', record touch data of the touch screen for some seconds.
+3. With '-p', replay a record and paint the touched points, then print
+   the time, frames and touch-to-photon latency. With '-v' it paints
+   on a virtual FB, so the same record always takes the same job, and
+   runs with no screen.
+
+Usage:	make test TEST_NAME=test_touchreplay
+	test_touchreplay
+	test_touchreplay -r file [seconds]
+	test_touchreplay -p file [speed] [-v]
+
+Midas Zhou
+------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "egi_common.h"
+#include "egi_touch.h"
+#include "xpt2046.h"
+#include "egi_latency.h"
+#include "egi_fbdev.h"
+#include "egi_fbgeom.h"
+#include "egi_image.h"
+#include "egi_test.h"
+
+#define REPLAY_SRC	"/tmp/egi_touch_src.rec"
+#define REPLAY_OUT	"/tmp/egi_touch_out.rec"
+#define REPLAY_SPEED	4.0
+
+static long long ts_us(const struct timespec *ts)
+{
+	return ts->tv_sec*1000000LL+ts->tv_nsec/1000;
+}
+
+/* Write a synthetic record: a tap, then a drag of 40 points every 10ms */
+static int write_record(const char *fpath)
+{
+	FILE *fp;
+	int i;
+
+	fp=fopen(fpath, "w");
+	if(fp==NULL)
+		return -1;
+	fprintf(fp, "# EGI touch record v1\n");
+	fprintf(fp, "0 pressing 100 100 0 0\n");
+	fprintf(fp, "50000 releasing 100 100 0 0\n");
+	fprintf(fp, "800000 pressing 20 20 0 0\n");
+	for(i=1; i<=40; i++)
+		fprintf(fp, "%d pressed_hold %d %d %d %d\n", 800000+i*10000, 20+i*4, 20+i*2, i*4, i*2);
+	fprintf(fp, "1210000 releasing 180 100 160 80\n");
+	fclose(fp);
+
+	return 0;
+}
+
+/* Compare two records, skip time of each line. */
+static int diff_records(const char *fsrc, const char *fout)
+{
+	FILE *fs, *fo;
+	char ls[128], lo[128];
+	int n=0, ret=0;
+
+	fs=fopen(fsrc, "r");
+	fo=fopen(fout, "r");
+	if(fs==NULL || fo==NULL) {
+		ret=-1;
+		goto END_FUNC;
+	}
+	while( fgets(ls, sizeof(ls), fs)!=NULL ) {
+		if( fgets(lo, sizeof(lo), fo)==NULL ) {
+			printf("Replay ends at line %d\n", n+1);
+			ret=-2;
+			break;
+		}
+		n++;
+		if( strcmp(strchr(ls,' ') ? strchr(ls,' ') : ls, strchr(lo,' ') ? strchr(lo,' ') : lo)!=0 ) {
+			printf("Line %d differs: '%s' replayed as '%s'\n", n, strtok(ls,"\n"), strtok(lo,"\n"));
+			ret=-3;
+			break;
+		}
+	}
+	if( ret==0 && fgets(lo, sizeof(lo), fo)!=NULL ) {
+		printf("Extra data replayed: %s", lo);
+		ret=-4;
+	}
+
+END_FUNC:
+	if(fs) fclose(fs);
+	if(fo) fclose(fo);
+	return ret;
+}
+
+/* Replay the synthetic record at speed, and check it */
+static void check_replay(float speed)
+{
+	EGI_TOUCH_DATA data;
+	struct timespec t0, t1;
+	long long us, expect;
+
+	if( egi_start_touchread_replay(REPLAY_SRC, speed)!=0 || egi_touch_record_start(REPLAY_OUT)!=0 ) {
+		TEST_FAIL("replay at speed %.1f: fail to start.\n", speed);
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	while(!egi_touch_replay_done()) {
+		if( egi_touch_waitdata(&data, 100)<0 )
+			break;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	egi_touch_record_stop();
+	egi_end_touchread();
+
+	us=ts_us(&t1)-ts_us(&t0);
+	expect = speed>0 ? 1210000/speed : 0;
+	if( diff_records(REPLAY_SRC, REPLAY_OUT)!=0 || us<expect || us>expect+20000 ) {
+		TEST_FAIL("replay at speed %.1f: in %lldus, expect %lldus\n", speed, us, expect);
+	}
+	else {
+		printf("Replay at speed %.1f: in %lldus, same touch data.\n", speed, us);
+		TEST_PASS();
+	}
+}
+
+/* Record touch data of the touch screen */
+static int record(const char *fpath, int secs)
+{
+	EGI_TOUCH_DATA data;
+	struct timespec t0, ts;
+	int n=0;
+
+	if( egi_start_touchread_evdev(NULL)!=0 && egi_start_touchread()!=0 )
+		return -1;
+	if( egi_touch_record_start(fpath)!=0 ) {
+		egi_end_touchread();
+		return -2;
+	}
+
+	printf("Record touch data in %ds...\n", secs);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	do {
+		if( egi_touch_waitdata(&data, 100)==0 && data.status!=released_hold ) {
+			n++;
+			printf("%s (%d,%d)\n", egi_str_touch_status(data.status), data.coord.x, data.coord.y);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+	} while( ts_us(&ts)-ts_us(&t0) < secs*1000000LL );
+
+	egi_touch_record_stop();
+	egi_end_touchread();
+	printf("%d touch data recorded to '%s'.\n", n, fpath);
+
+	return 0;
+}
+
+/* Replay a record, and paint touched points */
+static int replay(const char *fpath, float speed, bool virt)
+{
+	EGI_IMGBUF *vimg=NULL;
+	EGI_TOUCH_DATA data;
+	struct timespec t0, t1;
+	int ntouch=0, nframe=0;
+	int n;
+
+	if(virt) {
+		vimg=egi_imgbuf_create(LCD_SIZE_Y, LCD_SIZE_X, 255, WEGI_COLOR_BLACK);
+		if( vimg==NULL || init_virt_fbdev(&gv_fb_dev, vimg)!=0 )
+			return -1;
+	}
+	else {
+		if( init_fbdev(&gv_fb_dev)!=0 )
+			return -1;
+		fb_clear_backBuff(&gv_fb_dev, WEGI_COLOR_BLACK);
+	}
+
+	egi_lat_enable(NULL);
+	if( egi_start_touchread_replay(fpath, speed)!=0 )
+		goto END_FUNC;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	while(!egi_touch_replay_done()) {
+		if( egi_touch_waitdata(&data, 100)!=0 )
+			continue;
+
+		/* Paint all touch data read out, then refresh once, as a page does */
+		n=0;
+		do {
+			if(data.status==released_hold)
+				continue;
+			n++;
+			egi_lat_touch(&data.ts);
+			egi_lat_react_begin();
+			fbset_color( data.status==pressing || data.status==db_pressing ? WEGI_COLOR_RED : WEGI_COLOR_GREEN );
+			draw_filled_circle(&gv_fb_dev, data.coord.x, data.coord.y, 5);
+			egi_lat_react_end();
+		} while( egi_touch_getdata(&data) );
+		if(n==0)
+			continue;
+
+		ntouch+=n;
+		nframe++;
+		if(virt)
+			egi_lat_frame();	/* Pixels are in the virtual FB */
+		else
+			fb_page_refresh(&gv_fb_dev, 0);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	egi_end_touchread();
+
+	printf("Replay '%s' at speed %.1f: %d touch data, %d frames in %.3fs.\n", fpath, speed,
+				ntouch, nframe, (ts_us(&t1)-ts_us(&t0))/1.0e6);
+	egi_lat_summary(egi_lat_data());
+
+END_FUNC:
+	egi_lat_disable();
+	if(virt) {
+		release_virt_fbdev(&gv_fb_dev);
+		egi_imgbuf_free(vimg);
+	}
+	else {
+		release_fbdev(&gv_fb_dev);
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	float speed=1.0;
+	bool virt=false;
+
+	/* Record */
+	if(argc>2 && strcmp(argv[1],"-r")==0)
+		return record(argv[2], argc>3 ? atoi(argv[3]) : 10);
+
+	/* Replay and paint */
+	if(argc>2 && strcmp(argv[1],"-p")==0) {
+		if(argc>3 && strcmp(argv[3],"-v")!=0)
+			speed=atof(argv[3]);
+		virt = strcmp(argv[argc-1],"-v")==0;
+		return replay(argv[2], speed, virt);
+	}
+
+	/* Self check */
+	tm_start_egitick();
+	if( write_record(REPLAY_SRC)!=0 )
+		return -1;
+	check_replay(REPLAY_SPEED);
+	check_replay(0);
+	remove(REPLAY_SRC);
+	remove(REPLAY_OUT);
+	test_report("Touch replay");
+
+	return test_result();
+}
@@ -0,0 +1,139 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Benchmark of XPT2046 sampling, averaging by xpt_getavg_xy() against
+the adaptive sampler xpt_getfilt_xy():
+1. SPI transfers per second when untouched.
+2. Hold the stylus still: points per second, SPI transfers per point
+   and per second, and jitter of points.
+
+Usage:	make test TEST_NAME=test_xptsample
+	test_xptsample [-a] [idle_hz active_hz]
+	-a	Average by xpt_getavg_xy(), as egi_touch_loopread() did.
+
+Midas Zhou
+------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "egi_common.h"
+#include "spi.h"
+#include "xpt2046.h"
+
+#define BENCH_SECONDS	5
+
+static bool avg_mode;
+
+/* Sample once at the pace of egi_touch_loopread() */
+static int sample(bool touched, uint16_t *sx, uint16_t *sy)
+{
+	int ret;
+
+	if(avg_mode) {
+		tm_delayms(2);
+		ret=xpt_getavg_xy(sx, sy);
+		if(ret==XPT_READ_STATUS_PENUP)
+			tm_delayms(40);
+		return ret;
+	}
+	else {
+		if(!touched) {
+			if( xpt_wait_penirq(1000)<0 )
+				tm_delayms(xpt_period_ms(false));
+		}
+		else {
+			tm_delayms(xpt_period_ms(true));
+		}
+		return xpt_getfilt_xy(sx, sy);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct timeval tm_start, tm_end;
+	unsigned long xfers;
+	uint16_t sx,sy;
+	double sumx=0, sumy=0, sumxx=0, sumyy=0;
+	int minx=9999, maxx=0, miny=9999, maxy=0;
+	double mx,my,secs;
+	int npts=0;
+	bool touched=false;
+	int ret;
+
+	if(argc>1 && strcmp(argv[1],"-a")==0) {
+		avg_mode=true;
+		argc--; argv++;
+	}
+
+        /* <<<<<  EGI general init  >>>>>> */
+	tm_start_egitick();	/* For tm_delayms() */
+        if( SPI_Open()<0 ) {
+		printf("Fail to open SPI device '%s'.\n", spi_fdev);
+		return -1;
+	}
+	xpt_init_factors();
+	xpt_init_sampler();
+	if(argc>2)
+		xpt_set_rates(atoi(argv[1]), atoi(argv[2]));
+        /* <<<<<  End EGI Init  >>>>> */
+
+	printf("Sampling by %s.\n", avg_mode ? "xpt_getavg_xy()" : "xpt_getfilt_xy()");
+
+	/* 1. Untouched */
+	printf("Do NOT touch the pad in %ds...\n", BENCH_SECONDS);
+	xfers=xpt_spi_transfers();
+	gettimeofday(&tm_start,NULL);
+	do {
+		sample(false, &sx, &sy);
+		gettimeofday(&tm_end,NULL);
+	} while( tm_diffus(tm_start, tm_end) < BENCH_SECONDS*1000000 );
+	secs=tm_diffus(tm_start, tm_end)/1.0e6;
+	printf("Untouched: %.1f SPI transfers/s.\n", (xpt_spi_transfers()-xfers)/secs);
+
+	/* 2. Hold still */
+	printf("Press and hold the stylus still...\n");
+	while( sample(touched, &sx, &sy)!=XPT_READ_STATUS_COMPLETE );
+	touched=true;
+	tm_delayms(500);	/* Let it settle */
+	xfers=xpt_spi_transfers();
+	gettimeofday(&tm_start,NULL);
+	do {
+		ret=sample(touched, &sx, &sy);
+		if(ret==XPT_READ_STATUS_PENUP) {
+			printf("Released too early!\n");
+			break;
+		}
+		if(ret==XPT_READ_STATUS_COMPLETE) {
+			npts++;
+			sumx+=sx;
+			sumy+=sy;
+			sumxx+=sx*sx;
+			sumyy+=sy*sy;
+			if(sx<minx) minx=sx;
+			if(sx>maxx) maxx=sx;
+			if(sy<miny) miny=sy;
+			if(sy>maxy) maxy=sy;
+		}
+		gettimeofday(&tm_end,NULL);
+	} while( tm_diffus(tm_start, tm_end) < BENCH_SECONDS*1000000 );
+	secs=tm_diffus(tm_start, tm_end)/1.0e6;
+	xfers=xpt_spi_transfers()-xfers;
+
+	if(npts>0) {
+		mx=sumx/npts;
+		my=sumy/npts;
+		printf("Touched: %.1f points/s, %.1f SPI transfers/s, %.1f transfers/point.\n",
+				npts/secs, xfers/secs, (double)xfers/npts);
+		printf("Jitter at (%.0f,%.0f): stddev x %.2f y %.2f, peak-to-peak x %d y %d pixels.\n", mx, my,
+				sqrt(fabs(sumxx/npts-mx*mx)), sqrt(fabs(sumyy/npts-my*my)), maxx-minx, maxy-miny);
+	}
+
+        /* <<<<<  EGI general release >>>>> */
+	xpt_close_penirq();
+	SPI_Close();
+
+	return 0;
+}
@@ -7,6 +7,8 @@ Example:
 1. Call egi_gif_slurpFile() to load a GIF file to an EGI_GIF struct
 2. Call egi_gif_displayFrame() to display the EGI_GIF.
 3. Call egi_gif_runDisplayThread() to display EGI_GIF by a thread.
+4. Frames are updated by threads and published to EGI_GIF.Stribuf,
+   the game loop gets them by egi_gif_readFrame() without mutex lock.
 
 Midas Zhou
 ------------------------------------------------------------------*/
@@ -223,6 +225,7 @@ int main(int argc, char **argv)
 
 	/* --- Start thread: frame refresh thread for zombies --- */
 	for(i=0; i<ZOMBIE_MAX; i++) {
+		egi_gif_enableTribuf(ctxt_zombie[i].egif);
 		if( egi_gif_runDisplayThread(&ctxt_zombie[i]) !=0 ) {
 			printf("Fail to run thread for ctxt_zombie[%d]!\n",i);
 			exit(1);
@@ -234,6 +237,7 @@ int main(int argc, char **argv)
 
 	/* --- Start thread: frame refresh thread for plants --- */
 	for(i=0; i<FLOWER_MAX; i++) {	  					/* ----- Sun flowers ----- */
+		egi_gif_enableTribuf(ctxt_flower[i].egif);
 		if( egi_gif_runDisplayThread(&ctxt_flower[i]) !=0 ) {
 			printf("Fail to run thread for ctxt_flower[%d]!\n",i);
 			exit(1);
@@ -243,6 +247,7 @@ int main(int argc, char **argv)
 		//tm_delayms(150); /* for some random factors */
 	}
 	for(i=0; i<SHOOTER_MAX; i++) {						/* ----- peashooters ----- */
+		egi_gif_enableTribuf(ctxt_peashooter[i].egif);
 		if( egi_gif_runDisplayThread(&ctxt_peashooter[i]) !=0 ) {
 			printf("Fail to run thread for ctxt_peashooter[%d]\n",i);
 			exit(1);
@@ -345,8 +350,14 @@ while(1) {
 -------------------------------------------------*/
 static void display_gifCharacter( EGI_GIF_CONTEXT *gif_ctxt)
 {
+	EGI_IMGBUF *frame;
 
-        egi_imgbuf_windisplay( gif_ctxt->egif->Simgbuf, &gv_fb_dev, -1,    /* img, fb, subcolor */
+	/* Latest complete frame, or Simgbuf if Stribuf is not enabled */
+	frame=egi_gif_readFrame(gif_ctxt->egif, NULL);
+	if(frame==NULL)
+		frame=gif_ctxt->egif->Simgbuf;
+
+        egi_imgbuf_windisplay( frame, &gv_fb_dev, -1,    /* img, fb, subcolor */
                                gif_ctxt->xp, gif_ctxt->yp,            /* xp, yp */
                                gif_ctxt->xw, gif_ctxt->yw,            /* xw, yw */
                                gif_ctxt->winw, gif_ctxt->winh /* winw, winh */
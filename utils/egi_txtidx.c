@@ -0,0 +1,717 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Full-text search in an UTF-8 txt book, see egi_txtidx.h
+
+Midas Zhou
+-----------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "egi_txtidx.h"
+#include "egi_log.h"
+
+#define TXTIDX_MAGIC	"EGITXIDX"
+#define TXTIDX_VERSION	1
+
+/* Header of the sidecar index file, followed by nsegs segments */
+typedef struct egi_txtidx_head {
+	char		magic[8];
+	int		version;
+	int		nsegs;
+	long long	fsize;
+	long long	mtime;
+	unsigned int	indexed;
+	int		done;
+} EGI_TXTIDX_HEAD;
+
+/* Header of a segment, followed by nkeys EGI_TXTIDX_KEYs and datasize bytes of posting lists */
+typedef struct egi_txtidx_seghead {
+	unsigned int	start;
+	unsigned int	end;
+	unsigned int	nkeys;
+	unsigned int	datasize;
+} EGI_TXTIDX_SEGHEAD;
+
+/* A bigram key and its posting list, which ends at the next one's */
+typedef struct egi_txtidx_key {
+	unsigned int	key;
+	unsigned int	dataoff;	/* Offset of its list in the posting lists */
+} EGI_TXTIDX_KEY;
+
+
+/* Fold ASCII letters to lower case */
+static inline unsigned int txtidx_fold(unsigned int c)
+{
+	return (c>='A' && c<='Z') ? c+('a'-'A') : c;
+}
+
+/* Key of a bigram, collisions are filtered out by verifying with the text */
+static inline unsigned int txtidx_key(unsigned int c1, unsigned int c2)
+{
+	return (txtidx_fold(c1)*2654435761U) ^ txtidx_fold(c2);
+}
+
+/* Length of a UNICODE in UTF-8 */
+static inline int txtidx_uft8len(unsigned int c)
+{
+	return c<0x80 ? 1 : c<0x800 ? 2 : c<0x10000 ? 3 : 4;
+}
+
+/* If the text matches the folded query */
+static inline bool txtidx_match(const unsigned char *p, const unsigned char *q, size_t qlen)
+{
+	size_t i;
+
+	for(i=0; i<qlen; i++) {
+		if( txtidx_fold(p[i])!=q[i] )
+			return false;
+	}
+	return true;
+}
+
+static int txtidx_cmpu64(const void *a, const void *b)
+{
+	uint64_t x=*(const uint64_t *)a;
+	uint64_t y=*(const uint64_t *)b;
+
+	return x<y ? -1 : x>y;
+}
+
+/*-------------------------------------------------
+Append a segment to the index.
+Call with idx->lock locked.
+Return:
+	0	OK
+	<0	Fails
+--------------------------------------------------*/
+static int txtidx_addSeg(EGI_TXTIDX *idx, const EGI_TXTIDX_SEG *seg)
+{
+	EGI_TXTIDX_SEG *segs;
+	int capacity;
+
+	if(idx->nsegs==idx->capacity) {
+		capacity = idx->capacity>0 ? idx->capacity*2 : 64;
+		segs=realloc(idx->segs, capacity*sizeof(EGI_TXTIDX_SEG));
+		if(segs==NULL)
+			return -1;
+		idx->segs=segs;
+		idx->capacity=capacity;
+	}
+	idx->segs[idx->nsegs++]=*seg;
+
+	return 0;
+}
+
+/*----------------------------------------------
+Write the header of the sidecar index file.
+Return:
+	0	OK
+	<0	Fails
+-----------------------------------------------*/
+static int txtidx_writeHead(EGI_TXTIDX *idx, int nsegs, unsigned int indexed, bool done)
+{
+	EGI_TXTIDX_HEAD head;
+
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, TXTIDX_MAGIC, 8);
+	head.version=TXTIDX_VERSION;
+	head.nsegs=nsegs;
+	head.fsize=idx->src->size;
+	head.mtime=idx->src->mtime;
+	head.indexed=indexed;
+	head.done=done;
+
+	if( pwrite(idx->fd, &head, sizeof(head), 0)!=sizeof(head) )
+		return -1;
+
+	return 0;
+}
+
+/*--------------------------------------------------------------
+Open the sidecar index file and load its segments, if it matches
+the book. A segment left incomplete is truncated, so building
+resumes after the last complete one. If the sidecar file can't be
+created, the index is built in a temporary file.
+
+Return:
+	0	OK
+	<0	Fails
+---------------------------------------------------------------*/
+static int txtidx_loadIndex(EGI_TXTIDX *idx)
+{
+	EGI_TXTIDX_HEAD head;
+	EGI_TXTIDX_SEGHEAD sh;
+	EGI_TXTIDX_SEG seg;
+	struct stat sb;
+	FILE *fil;
+	long off;
+	unsigned int end=0;
+	int i=0;
+
+	idx->fd=open(idx->idxpath, O_RDWR|O_CREAT|O_CLOEXEC, 0644);
+	if(idx->fd<0) {
+		EGI_PLOG(LOGLV_WARN, "%s: Fail to open '%s': %s, build index in a temporary file.",
+							__func__, idx->idxpath, strerror(errno));
+		fil=tmpfile();
+		if(fil!=NULL) {
+			idx->fd=dup(fileno(fil));
+			fclose(fil);
+		}
+		if(idx->fd<0)
+			return -1;
+	}
+	if( fstat(idx->fd, &sb)<0 )
+		return -2;
+
+	off=sizeof(head);
+	if( pread(idx->fd, &head, sizeof(head), 0)==sizeof(head) && memcmp(head.magic, TXTIDX_MAGIC, 8)==0
+	    && head.version==TXTIDX_VERSION && head.fsize==(long long)idx->src->size
+	    && head.mtime==idx->src->mtime ) {
+		for(i=0; i<head.nsegs; i++) {
+			if( pread(idx->fd, &sh, sizeof(sh), off)!=sizeof(sh)
+			    || sh.start!=end || sh.end<=sh.start || sh.end>idx->src->size )
+				break;
+			seg.start=sh.start;
+			seg.end=sh.end;
+			seg.nkeys=sh.nkeys;
+			seg.datasize=sh.datasize;
+			seg.tableoff=off+sizeof(sh);
+			seg.dataoff=seg.tableoff+(long)sh.nkeys*sizeof(EGI_TXTIDX_KEY);
+			if( seg.dataoff+sh.datasize > sb.st_size )
+				break;
+			if( txtidx_addSeg(idx, &seg)!=0 )
+				break;
+			off=seg.dataoff+sh.datasize;
+			end=sh.end;
+		}
+		idx->done = head.done && i==head.nsegs;
+	}
+
+	idx->fend=off;
+	idx->indexed=end;
+	if(idx->src->size==0)
+		idx->done=true;
+
+	/* Drop anything after the last complete segment */
+	if( ftruncate(idx->fd, off)!=0 || txtidx_writeHead(idx, idx->nsegs, idx->indexed, idx->done)!=0 )
+		return -3;
+
+	return 0;
+}
+
+/*-----------------------------------------------------------------
+Collect bigrams whose first characters start in [start, end) of the
+text, as (key<<32 | offset of the first character).
+
+@p:	The text, '\0' terminated.
+@size:	Size of the text.
+@pairs:	To pass out bigrams, space for (end-start) of them.
+
+Return:
+	Number of bigrams.
+------------------------------------------------------------------*/
+static int txtidx_collect(const unsigned char *p, size_t size, size_t start, size_t end, uint64_t *pairs)
+{
+	wchar_t wcs[512];
+	size_t i=start;
+	size_t used, sum;
+	size_t off, prevoff=0;
+	unsigned int prev=0;
+	bool hasprev=false;
+	int np=0;
+	int n, k;
+
+	while(i<size) {
+		n=egi_txtsrc_decode(p+i, size-i, wcs, 512, &used);
+		if(n<=0)
+			break;
+
+		/* With no illegal byte skipped, offsets are sums of lengths,
+		 * or decode a character at a time till the illegal ones.
+		 */
+		for(sum=0, k=0; k<n; k++)
+			sum+=txtidx_uft8len(wcs[k]);
+		if(sum==used) {
+			off=i;
+		}
+		else {
+			n=egi_txtsrc_decode(p+i, size-i, wcs, 1, &used);
+			if(n<=0)
+				break;
+			off=i+used-txtidx_uft8len(wcs[0]);
+		}
+		for(k=0; k<n; k++) {
+			if(hasprev)
+				pairs[np++]=((uint64_t)txtidx_key(prev, wcs[k])<<32) | prevoff;
+			if(off>=end)
+				return np;
+			prev=wcs[k];
+			prevoff=off;
+			hasprev=true;
+			off+=txtidx_uft8len(wcs[k]);
+		}
+		i+=used;
+	}
+
+	return np;
+}
+
+/* Put a varint, return its length */
+static inline int txtidx_putVarint(unsigned char *p, unsigned int v)
+{
+	int n=0;
+
+	while(v>=0x80) {
+		p[n++]=(v&0x7F)|0x80;
+		v>>=7;
+	}
+	p[n++]=v;
+
+	return n;
+}
+
+/* Get a varint, return its length */
+static inline int txtidx_getVarint(const unsigned char *p, unsigned int *v)
+{
+	unsigned int x=0;
+	int n=0;
+
+	do {
+		x|=(unsigned int)(p[n]&0x7F)<<(7*n);
+	} while( (p[n++]&0x80) && n<5 );
+	*v=x;
+
+	return n;
+}
+
+/*------------------------------------------------------------
+The thread to build the index, a segment at a time. Each one
+is appended to the sidecar file before the header is updated,
+so a segment is either complete or truncated next time.
+-------------------------------------------------------------*/
+static void* txtidx_thread(void *arg)
+{
+	EGI_TXTIDX *idx=(EGI_TXTIDX *)arg;
+	EGI_TXTSRC *src=idx->src;
+	EGI_TXTIDX_SEGHEAD sh;
+	EGI_TXTIDX_SEG seg;
+	EGI_TXTIDX_KEY *table=NULL;
+	EGI_TXTSPAN span;
+	uint64_t *pairs;
+	unsigned char *data;
+	unsigned int key, pos, last=0;
+	size_t start;
+	size_t dlen;
+	int np, nkeys;
+	int i, k;
+	bool done;
+
+	pairs=malloc(EGI_TXTIDX_SEGSIZE*sizeof(uint64_t));
+	data=malloc(EGI_TXTIDX_SEGSIZE*5);
+	if(pairs==NULL || data==NULL) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to malloc buffers.", __func__);
+		goto END_FUNC;
+	}
+
+	while(!idx->quit && !idx->done) {
+		start=idx->indexed;
+		if( egi_txtsrc_span(src, start, EGI_TXTIDX_SEGSIZE, &span)<=0 ) {
+			pthread_mutex_lock(&idx->lock);
+			idx->done=true;
+			pthread_mutex_unlock(&idx->lock);
+			txtidx_writeHead(idx, idx->nsegs, idx->indexed, true);
+			break;
+		}
+
+		/* Sort bigrams by key, and offsets in each key keep ascending */
+		np=txtidx_collect(src->addr, src->size, span.off, span.off+span.nbytes, pairs);
+		qsort(pairs, np, sizeof(uint64_t), txtidx_cmpu64);
+
+		for(nkeys=0, i=0; i<np; i++) {
+			if( i==0 || (pairs[i]>>32)!=(pairs[i-1]>>32) )
+				nkeys++;
+		}
+		free(table);
+		table=malloc((nkeys>0?nkeys:1)*sizeof(EGI_TXTIDX_KEY));
+		if(table==NULL) {
+			EGI_PLOG(LOGLV_ERROR, "%s: Fail to malloc key table.", __func__);
+			break;
+		}
+
+		/* Key table and posting lists of delta varint offsets */
+		for(dlen=0, k=-1, i=0; i<np; i++) {
+			key=pairs[i]>>32;
+			pos=(unsigned int)pairs[i];
+			if( k<0 || key!=table[k].key ) {
+				k++;
+				table[k].key=key;
+				table[k].dataoff=dlen;
+				last=start;
+			}
+			dlen+=txtidx_putVarint(data+dlen, pos-last);
+			last=pos;
+		}
+
+		sh.start=start;
+		sh.end=span.off+span.nbytes;
+		sh.nkeys=nkeys;
+		sh.datasize=dlen;
+		seg.start=sh.start;
+		seg.end=sh.end;
+		seg.nkeys=nkeys;
+		seg.datasize=dlen;
+		seg.tableoff=idx->fend+sizeof(sh);
+		seg.dataoff=seg.tableoff+(long)nkeys*sizeof(EGI_TXTIDX_KEY);
+		done = sh.end>=src->size;
+
+		if( pwrite(idx->fd, &sh, sizeof(sh), idx->fend)!=sizeof(sh)
+		    || pwrite(idx->fd, table, nkeys*sizeof(EGI_TXTIDX_KEY), seg.tableoff)!=nkeys*sizeof(EGI_TXTIDX_KEY)
+		    || pwrite(idx->fd, data, dlen, seg.dataoff)!=dlen
+		    || txtidx_writeHead(idx, idx->nsegs+1, sh.end, done)!=0 ) {
+			EGI_PLOG(LOGLV_ERROR, "%s: Fail to write index segment: %s", __func__, strerror(errno));
+			break;
+		}
+
+		pthread_mutex_lock(&idx->lock);
+		if( txtidx_addSeg(idx, &seg)!=0 ) {
+			pthread_mutex_unlock(&idx->lock);
+			break;
+		}
+		idx->fend=seg.dataoff+dlen;
+		idx->indexed=sh.end;
+		idx->done=done;
+		pthread_mutex_unlock(&idx->lock);
+	}
+
+END_FUNC:
+	free(table);
+	free(data);
+	free(pairs);
+	return (void *)0;
+}
+
+
+/*-------------------------------------------------------
+Open a txt book for search, and start building its index
+in background.
+
+@fpath:	Path of the book, in UTF-8.
+
+Return:
+	Pointer to EGI_TXTIDX	OK
+	NULL			Fails
+--------------------------------------------------------*/
+EGI_TXTIDX* egi_txtidx_open(const char *fpath)
+{
+	EGI_TXTIDX *idx;
+
+	if(fpath==NULL) {
+		printf("%s: Input fpath is NULL!\n",__func__);
+		return NULL;
+	}
+
+	idx=calloc(1, sizeof(EGI_TXTIDX));
+	if(idx==NULL)
+		return NULL;
+	idx->fd=-1;
+
+	idx->src=egi_txtsrc_open(fpath, 0);
+	if( idx->src==NULL || idx->src->size >= 0xFFFFFFFFULL ) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to open '%s', or it's too big.", __func__, fpath);
+		goto END_FAIL;
+	}
+
+	idx->idxpath=malloc(strlen(fpath)+8);
+	if(idx->idxpath==NULL)
+		goto END_FAIL;
+	sprintf(idx->idxpath, "%s.txtidx", fpath);
+
+	if( txtidx_loadIndex(idx)!=0 ) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to load or create index '%s'.", __func__, idx->idxpath);
+		goto END_FAIL;
+	}
+	if(idx->nsegs>0)
+		EGI_PLOG(LOGLV_INFO, "%s: Load %d index segments from '%s'%s.", __func__, idx->nsegs,
+							idx->idxpath, idx->done ? "" : ", to resume");
+
+	if( pthread_mutex_init(&idx->lock, NULL)!=0 )
+		goto END_FAIL;
+	if( pthread_create(&idx->thread, NULL, txtidx_thread, idx)!=0 ) {
+		EGI_PLOG(LOGLV_ERROR, "%s: Fail to create index thread.", __func__);
+		pthread_mutex_destroy(&idx->lock);
+		goto END_FAIL;
+	}
+
+	return idx;
+
+END_FAIL:
+	if(idx->fd>=0)
+		close(idx->fd);
+	egi_txtsrc_close(&idx->src);
+	free(idx->segs);
+	free(idx->idxpath);
+	free(idx);
+	return NULL;
+}
+
+
+/*----------------------------------------------------
+Stop building the index and close it. Segments built
+are kept in the sidecar file, so it resumes next time.
+-----------------------------------------------------*/
+void egi_txtidx_close(EGI_TXTIDX **idx)
+{
+	EGI_TXTIDX *ix;
+
+	if(idx==NULL || *idx==NULL)
+		return;
+	ix=*idx;
+
+	ix->quit=true;
+	pthread_join(ix->thread, NULL);
+
+	pthread_mutex_destroy(&ix->lock);
+	close(ix->fd);
+	egi_txtsrc_close(&ix->src);
+	free(ix->segs);
+	free(ix->idxpath);
+	free(ix);
+
+	*idx=NULL;
+}
+
+
+/*--------------------------------------------
+Get progress of building the index.
+
+@done:	To pass out if it's finished, or NULL.
+
+Return:
+	Bytes of the text indexed.
+---------------------------------------------*/
+size_t egi_txtidx_progress(EGI_TXTIDX *idx, bool *done)
+{
+	size_t indexed;
+
+	if(idx==NULL)
+		return 0;
+
+	pthread_mutex_lock(&idx->lock);
+	indexed=idx->indexed;
+	if(done)
+		*done=idx->done;
+	pthread_mutex_unlock(&idx->lock);
+
+	return indexed;
+}
+
+
+/*------------------------------------------------------------
+Look up a key in a segment of the mmaped index file.
+Return its posting list, and pass out end of it, or NULL if
+the key isn't in the segment.
+-------------------------------------------------------------*/
+static const unsigned char* txtidx_lookup(const unsigned char *map, const EGI_TXTIDX_SEG *seg,
+					  unsigned int key, const unsigned char **pend)
+{
+	const EGI_TXTIDX_KEY *table=(const EGI_TXTIDX_KEY *)(map+seg->tableoff);
+	int lo=0, hi=seg->nkeys-1, mid;
+
+	while(lo<=hi) {
+		mid=(lo+hi)/2;
+		if(table[mid].key==key) {
+			*pend=map+seg->dataoff+( mid+1<(int)seg->nkeys ? table[mid+1].dataoff : seg->datasize );
+			return map+seg->dataoff+table[mid].dataoff;
+		}
+		else if(table[mid].key<key)
+			lo=mid+1;
+		else
+			hi=mid-1;
+	}
+
+	return NULL;
+}
+
+/*------------------------------------------------------------
+Scan the text for the folded query from offset from.
+Return number of matches put to offs.
+-------------------------------------------------------------*/
+static int txtidx_scan(const unsigned char *p, size_t size, size_t from,
+			const unsigned char *q, size_t qlen, unsigned int *offs, int max)
+{
+	const unsigned char *pc;
+	size_t i;
+	int n=0;
+	bool letter = q[0]>='a' && q[0]<='z';
+
+	for(i=from; n<max && i+qlen<=size; i++) {
+		if(!letter) {
+			/* No case to fold, let memchr() find the first byte */
+			pc=memchr(p+i, q[0], size-qlen+1-i);
+			if(pc==NULL)
+				break;
+			i=pc-p;
+		}
+		else if( txtidx_fold(p[i])!=q[0] )
+			continue;
+
+		if( txtidx_match(p+i, q, qlen) )
+			offs[n++]=i;
+	}
+
+	return n;
+}
+
+/*--------------------------------------------------------------------
+Search a txt book. ASCII letters are matched case insensitively.
+Indexed text is searched by the rarest bigram in the query, and text
+not indexed yet is scanned, a query of a single character is scanned.
+
+@idx:	Pointer to an EGI_TXTIDX
+@query:	String to search, in UTF-8.
+@from:	Search hits at or after this offset of the text.
+@offs:	To pass out byte offsets of hits, in ascending order.
+@max:	Max. number of hits to pass out.
+
+Return:
+	>=0	OK, number of hits.
+	<0	Fails
+---------------------------------------------------------------------*/
+int egi_txtidx_search(EGI_TXTIDX *idx, const char *query, size_t from, unsigned int *offs, int max)
+{
+	const unsigned char *text;
+	const unsigned char *pd, *pend;
+	unsigned char *map=MAP_FAILED;
+	unsigned char *q=NULL;
+	wchar_t *wcs=NULL;
+	size_t *pre=NULL;
+	EGI_TXTIDX_SEG *segs=NULL;
+	int nsegs;
+	long fend=0;
+	size_t indexed=0;
+	size_t qlen, used, sum;
+	size_t tailfrom=from;
+	unsigned int key=0, pos, delta, start;
+	unsigned long total, mintotal=(unsigned long)-1;
+	int i, j, jbest=0;
+	int m;
+	int n=0;
+
+	if(idx==NULL || query==NULL || offs==NULL || max<=0) {
+		printf("%s: Input param invalid!\n",__func__);
+		return -1;
+	}
+	text=idx->src->addr;
+
+	qlen=strlen(query);
+	if(qlen==0)
+		return 0;
+
+	q=malloc(qlen);
+	wcs=malloc(qlen*sizeof(wchar_t));
+	pre=malloc((qlen+1)*sizeof(size_t));
+	if(q==NULL || wcs==NULL || pre==NULL) {
+		n=-2;
+		goto END_FUNC;
+	}
+	for(i=0; i<(int)qlen; i++)
+		q[i]=txtidx_fold((unsigned char)query[i]);
+
+	/* Characters of the query, and offsets of them */
+	m=egi_txtsrc_decode(q, qlen, wcs, qlen, &used);
+	for(sum=0, j=0; j<m; j++) {
+		pre[j]=sum;
+		sum+=txtidx_uft8len(wcs[j]);
+	}
+	if( m<=0 || used!=qlen || sum!=qlen ) {
+		printf("%s: Query is not a valid UTF-8 string!\n",__func__);
+		n=-3;
+		goto END_FUNC;
+	}
+
+	/* Take a snapshot of segments */
+	if(m>=2) {
+		pthread_mutex_lock(&idx->lock);
+		nsegs=idx->nsegs;
+		if(nsegs>0) {
+			segs=malloc(nsegs*sizeof(EGI_TXTIDX_SEG));
+			if(segs!=NULL) {
+				memcpy(segs, idx->segs, nsegs*sizeof(EGI_TXTIDX_SEG));
+				fend=idx->fend;
+				indexed=idx->indexed;
+			}
+		}
+		pthread_mutex_unlock(&idx->lock);
+
+		if(segs!=NULL)
+			map=mmap(NULL, fend, PROT_READ, MAP_SHARED, idx->fd, 0);
+		if(map==MAP_FAILED) {
+			free(segs);
+			segs=NULL;
+		}
+	}
+
+	if(segs!=NULL) {
+		/* Take the rarest bigram of the query, by sizes of its posting lists */
+		for(j=0; j<m-1; j++) {
+			key=txtidx_key(wcs[j], wcs[j+1]);
+			for(total=0, i=0; i<nsegs; i++) {
+				pd=txtidx_lookup(map, &segs[i], key, &pend);
+				if(pd!=NULL)
+					total+=pend-pd;
+			}
+			if(total<mintotal) {
+				mintotal=total;
+				jbest=j;
+			}
+		}
+		key=txtidx_key(wcs[jbest], wcs[jbest+1]);
+
+		/* Verify offsets of the bigram with the text */
+		for(i=0; i<nsegs && n<max; i++) {
+			if(segs[i].end<=from)
+				continue;
+			pd=txtidx_lookup(map, &segs[i], key, &pend);
+			if(pd==NULL)
+				continue;
+
+			pos=segs[i].start;
+			while( pd<pend && n<max ) {
+				pd+=txtidx_getVarint(pd, &delta);
+				pos+=delta;
+				if(pos<pre[jbest])
+					continue;
+				start=pos-pre[jbest];
+				if( start>=from && start+qlen<=idx->src->size && txtidx_match(text+start, q, qlen) )
+					offs[n++]=start;
+			}
+		}
+
+		/* Hits with the bigram out of indexed text are to be scanned */
+		if( indexed>pre[jbest] && indexed-pre[jbest] > tailfrom )
+			tailfrom=indexed-pre[jbest];
+	}
+
+	/* Scan the rest */
+	if(n<max)
+		n+=txtidx_scan(text, idx->src->size, tailfrom, q, qlen, offs+n, max-n);
+
+END_FUNC:
+	if(map!=MAP_FAILED)
+		munmap(map, fend);
+	free(segs);
+	free(pre);
+	free(wcs);
+	free(q);
+
+	return n;
+}
@@ -0,0 +1,72 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+Full-text search in an UTF-8 txt book, with an on-disk bigram index.
+
+1. egi_txtidx_open() opens the book as an EGI_TXTSRC, and a thread
+   builds an inverted index of every bigram(2 adjacent characters,
+   ASCII letters case folded) in background, so CJK words as well as
+   western ones are searchable.
+2. The index is built in segments of EGI_TXTIDX_SEGSIZE bytes of
+   text, each segment is a sorted key table followed by posting lists
+   of delta varint offsets. Segments are appended to a sidecar file
+   (fpath.txtidx), so building resumes from the last segment next time.
+3. egi_txtidx_search() looks up the rarest bigram of the query, and
+   verifies the candidates against the text. Text not indexed yet is
+   scanned, so results are always complete. Hits are byte offsets of
+   the text, use FTbook_pageOfOffset() to get pages of them.
+
+Example:
+	idx=egi_txtidx_open("/mmc/xyj_uft8.txt");
+	n=egi_txtidx_search(idx, "悟空", 0, offs, 100);
+	for(i=0; i<n; i++)
+		page=FTbook_pageOfOffset(book, offs[i], true);
+	egi_txtidx_close(&idx);
+
+Midas Zhou
+-----------------------------------------------------------------*/
+#ifndef __EGI_TXTIDX_H__
+#define __EGI_TXTIDX_H__
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "egi_txtsrc.h"
+
+#define EGI_TXTIDX_SEGSIZE	(256*1024)	/* Text bytes in an index segment */
+
+/* A segment of the index in the sidecar file */
+typedef struct egi_txtidx_seg {
+	unsigned int	start;		/* Text covered, [start, end) */
+	unsigned int	end;
+	unsigned int	nkeys;
+	unsigned int	datasize;	/* Of the posting lists */
+	long		tableoff;	/* File offset of the key table */
+	long		dataoff;	/* File offset of the posting lists */
+} EGI_TXTIDX_SEG;
+
+typedef struct egi_txtidx EGI_TXTIDX;
+struct egi_txtidx {
+	EGI_TXTSRC		*src;		/* The book */
+	char			*idxpath;	/* Sidecar index file */
+	int			fd;		/* Of the index file */
+
+	EGI_TXTIDX_SEG		*segs;
+	int			nsegs;
+	int			capacity;
+	long			fend;		/* End of the last segment in the file */
+	unsigned int		indexed;	/* Text indexed, [0, indexed) */
+	bool			done;
+
+	pthread_t		thread;
+	bool			quit;
+	pthread_mutex_t		lock;
+};
+
+EGI_TXTIDX*	egi_txtidx_open(const char *fpath);
+void		egi_txtidx_close(EGI_TXTIDX **idx);
+size_t		egi_txtidx_progress(EGI_TXTIDX *idx, bool *done);
+int		egi_txtidx_search(EGI_TXTIDX *idx, const char *query, size_t from, unsigned int *offs, int max);
+
+#endif
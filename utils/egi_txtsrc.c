@@ -0,0 +1,370 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+A read-only UTF-8 text source over a mmaped file, see egi_txtsrc.h
+
+Midas Zhou
+-----------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "egi_txtsrc.h"
+
+/* Masks for a machine word of bytes */
+#define TXTSRC_ONES	((unsigned long)-1/0xFF)	/* 0x0101...01 */
+#define TXTSRC_HIGHS	(TXTSRC_ONES*0x80)		/* 0x8080...80 */
+
+
+/*-------------------------------------------------------------
+Open a txt file as a text source.
+
+@fpath:		Path of the txt file.
+@readahead:	Read-ahead window size in bytes, it's rounded
+		up to multiples of pages.
+		0 to use EGI_TXTSRC_READAHEAD.
+Return:
+	Pointer to EGI_TXTSRC	OK
+	NULL			Fails
+--------------------------------------------------------------*/
+EGI_TXTSRC* egi_txtsrc_open(const char *fpath, size_t readahead)
+{
+	EGI_TXTSRC *src;
+	struct stat sb;
+	unsigned char *addr;
+	long pgsize;
+	int fd;
+
+	if(fpath==NULL) {
+		printf("%s: Input fpath is NULL!\n",__func__);
+		return NULL;
+	}
+
+	fd=open(fpath, O_RDONLY|O_CLOEXEC);
+	if(fd<0) {
+		printf("%s: Fail to open '%s': %s\n",__func__, fpath, strerror(errno));
+		return NULL;
+	}
+	if( fstat(fd, &sb)<0 || (unsigned long long)sb.st_size >= SIZE_MAX/2 ) {
+		printf("%s: Fail to fstat '%s', or it's too big.\n",__func__, fpath);
+		close(fd);
+		return NULL;
+	}
+
+	src=calloc(1, sizeof(EGI_TXTSRC));
+	if(src==NULL) {
+		close(fd);
+		return NULL;
+	}
+	src->fpath=strdup(fpath);
+	if(src->fpath==NULL) {
+		close(fd);
+		free(src);
+		return NULL;
+	}
+	src->size=sb.st_size;
+	src->mtime=sb.st_mtime;
+
+	pgsize=sysconf(_SC_PAGESIZE);
+	if(readahead==0)
+		readahead=EGI_TXTSRC_READAHEAD;
+	src->readahead=(readahead+pgsize-1)/pgsize*pgsize;
+
+	/* Mmap the file over zeroed pages, so there's '\0' after the end of it,
+	 * even if its size is multiples of pages.
+	 */
+	src->mapsize=(src->size/pgsize+1)*pgsize;
+	addr=mmap(NULL, src->mapsize, PROT_READ, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if(addr==MAP_FAILED) {
+		printf("%s: Fail to mmap: %s\n",__func__, strerror(errno));
+		goto END_FAIL;
+	}
+	if( src->size>0 && mmap(addr, src->size, PROT_READ, MAP_PRIVATE|MAP_FIXED, fd, 0)==MAP_FAILED ) {
+		printf("%s: Fail to mmap '%s': %s\n",__func__, fpath, strerror(errno));
+		munmap(addr, src->mapsize);
+		goto END_FAIL;
+	}
+	close(fd);
+	src->addr=addr;
+
+	/* Mostly read through from the beginning */
+	madvise(addr, src->size, MADV_SEQUENTIAL);
+
+	return src;
+
+END_FAIL:
+	close(fd);
+	free(src->fpath);
+	free(src);
+	return NULL;
+}
+
+
+/*-----------------------------
+Unmap and free a text source.
+------------------------------*/
+void egi_txtsrc_close(EGI_TXTSRC **src)
+{
+	if(src==NULL || *src==NULL)
+		return;
+
+	munmap((void *)(*src)->addr, (*src)->mapsize);
+	free((*src)->fpath);
+	free(*src);
+
+	*src=NULL;
+}
+
+
+/*----------------------------------------------------------------
+Move the read-ahead window of a text source to cover offset off.
+The window is 2*readahead long starting at the readahead boundary
+below off. Pages in the new window are advised to be read ahead,
+and pages left behind by the old window are dropped from the
+mapping, they'll fault in again from page cache or the file if
+accessed later.
+
+@src:	Pointer to an EGI_TXTSRC
+@off:	Offset in the text.
+-----------------------------------------------------------------*/
+void egi_txtsrc_advise(EGI_TXTSRC *src, size_t off)
+{
+	size_t win, end, oldend;
+	unsigned char *addr;
+
+	if(src==NULL || src->size==0)
+		return;
+
+	win=off/src->readahead*src->readahead;
+	if( src->advised && win==src->win )
+		return;
+
+	addr=(unsigned char *)src->addr;
+	end=win+2*src->readahead;
+	if(end>src->mapsize)
+		end=src->mapsize;
+	if(win<end)
+		madvise(addr+win, end-win, MADV_WILLNEED);
+
+	/* Drop the part of the old window out of the new one */
+	if(src->advised) {
+		oldend=src->win+2*src->readahead;
+		if(oldend>src->mapsize)
+			oldend=src->mapsize;
+		if( src->win < win )
+			madvise(addr+src->win, (oldend<win ? oldend : win)-src->win, MADV_DONTNEED);
+		if( oldend > end ) {
+			if( src->win > end )
+				end=src->win;
+			madvise(addr+end, oldend-end, MADV_DONTNEED);
+		}
+	}
+
+	src->win=win;
+	src->advised=true;
+}
+
+
+/*---------------------------------------------------------------------
+Get a span of the text, without copying.
+The span starts at off, or the next character boundary if off is in
+the middle of a character, and ends at the last character boundary
+within maxbytes. The read-ahead window is moved to the span.
+
+@src:		Pointer to an EGI_TXTSRC
+@off:		Offset in the text.
+@maxbytes:	Max. length of the span, in bytes.
+@span:		Pointer to pass out the span.
+
+Return:
+	>0	OK, length of the span in bytes.
+	0	End of the text.
+	<0	Fails
+----------------------------------------------------------------------*/
+int egi_txtsrc_span(EGI_TXTSRC *src, size_t off, size_t maxbytes, EGI_TXTSPAN *span)
+{
+	const unsigned char *addr;
+	size_t end, k;
+	int len;
+
+	if(src==NULL || span==NULL || maxbytes==0 || maxbytes>INT32_MAX) {
+		printf("%s: Input param invalid!\n",__func__);
+		return -1;
+	}
+	addr=src->addr;
+
+	/* Skip continuation bytes */
+	for(k=0; k<3 && off<src->size && (addr[off]&0xC0)==0x80; k++)
+		off++;
+	if(off>=src->size) {
+		span->ptr=addr+src->size;
+		span->off=src->size;
+		span->nbytes=0;
+		return 0;
+	}
+
+	end=off+maxbytes;
+	if(end>=src->size) {
+		end=src->size;
+	}
+	else {
+		/* Don't cut a character in the end */
+		for(k=end-1; k>off && end-k<4 && (addr[k]&0xC0)==0x80; k--);
+		if(addr[k]>=0xF0)
+			len=4;
+		else if(addr[k]>=0xE0)
+			len=3;
+		else if(addr[k]>=0xC0)
+			len=2;
+		else
+			len=1;
+		if( k+len>end && k>off )
+			end=k;
+	}
+
+	egi_txtsrc_advise(src, off);
+
+	span->ptr=addr+off;
+	span->off=off;
+	span->nbytes=end-off;
+
+	return end-off;
+}
+
+
+/*----------------------------------------------------------------------
+Decode UTF-8 text to UNICODE, in a batch.
+Runs of ASCII chars are checked and converted a machine word at a time.
+Illegal bytes are skipped, as char_uft8_to_unicode() callers do. A
+character cut by the end of the text is left, and is not counted in
+*used, so decoding may go on with more text after it.
+
+@p:		Pointer to UTF-8 text.
+@nbytes:	Length of the text, in bytes.
+@wcs:		To pass out UNICODEs.
+@maxchars:	Max. number of UNICODEs to decode.
+@used:		To pass out bytes decoded, or skipped. It may be NULL.
+
+Return:
+	>=0	OK, number of UNICODEs decoded.
+	<0	Fails
+-----------------------------------------------------------------------*/
+int egi_txtsrc_decode(const unsigned char *p, size_t nbytes, wchar_t *wcs, size_t maxchars, size_t *used)
+{
+	size_t i=0;
+	size_t n=0;
+	unsigned long w;
+	unsigned int c;
+	int len;
+	int k;
+
+	if(p==NULL || wcs==NULL) {
+		printf("%s: Input param invalid!\n",__func__);
+		return -1;
+	}
+
+	while( i<nbytes && n<maxchars ) {
+		c=p[i];
+
+		/* ASCII */
+		if(c<0x80) {
+			wcs[n++]=c;
+			i++;
+
+			/* Fast path: whole words of ASCII from a word boundary */
+			if( ((uintptr_t)(p+i)&(sizeof(long)-1))==0 ) {
+				while( nbytes-i>=sizeof(long) && maxchars-n>=sizeof(long) ) {
+					w=*(const unsigned long *)(p+i);
+					if(w&TXTSRC_HIGHS)
+						break;
+					for(k=0; k<(int)sizeof(long); k++)
+						wcs[n+k]=p[i+k];
+					n+=sizeof(long);
+					i+=sizeof(long);
+				}
+			}
+			continue;
+		}
+
+		/* Multi-byte */
+		if(c>=0xF8 || c<0xC0) {
+			i++;		/* Illegal starting byte */
+			continue;
+		}
+		else if(c>=0xF0) {
+			len=4;
+			c&=0x07;
+		}
+		else if(c>=0xE0) {
+			len=3;
+			c&=0x0F;
+		}
+		else {
+			len=2;
+			c&=0x1F;
+		}
+
+		for(k=1; k<len && i+k<nbytes; k++) {
+			if( (p[i+k]&0xC0)!=0x80 )
+				break;
+			c=(c<<6)|(p[i+k]&0x3F);
+		}
+		if(k<len) {
+			if(i+k>=nbytes)
+				break;	/* Cut by the end */
+			i++;		/* Illegal */
+			continue;
+		}
+
+		wcs[n++]=c;
+		i+=len;
+	}
+
+	if(used)
+		*used=i;
+
+	return n;
+}
+
+
+/*------------------------------------------------------------
+Count UTF-8 characters in a text, a machine word at a time.
+It counts bytes other than continuation bytes(10XXXXXX).
+
+@p:		Pointer to UTF-8 text.
+@nbytes:	Length of the text, in bytes.
+
+Return:
+	Number of characters.
+-------------------------------------------------------------*/
+size_t egi_txtsrc_count(const unsigned char *p, size_t nbytes)
+{
+	size_t i=0;
+	size_t cont=0;
+	unsigned long w;
+
+	if(p==NULL)
+		return 0;
+
+	for(; i<nbytes && ((uintptr_t)(p+i)&(sizeof(long)-1)); i++)
+		cont += (p[i]&0xC0)==0x80;
+
+	for(; nbytes-i>=sizeof(long); i+=sizeof(long)) {
+		w=*(const unsigned long *)(p+i);
+		/* 0x80 in each continuation byte, then sum them up */
+		w=(w & ~(w<<1) & TXTSRC_HIGHS)>>7;
+		cont += (w*TXTSRC_ONES)>>((sizeof(long)-1)*8);
+	}
+
+	for(; i<nbytes; i++)
+		cont += (p[i]&0xC0)==0x80;
+
+	return nbytes-cont;
+}
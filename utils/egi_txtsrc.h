@@ -0,0 +1,68 @@
+/*------------------------------------------------------------------
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+A read-only UTF-8 text source over a mmaped file.
+
+1. The file is mmaped over zeroed pages, so there's always a '\0'
+   after the end of the text, and the text can be passed to functions
+   which expect a C string, such as FTsymbol_uft8strings_writeFB().
+2. egi_txtsrc_span() hands out a span of the text at an offset, cut
+   at UTF-8 character boundaries, without copying. It also advises
+   the kernel to read ahead the window after the span, and to drop
+   the window left behind, so even a 100MB+ novel is read through
+   with a constant resident size.
+3. egi_txtsrc_decode() decodes UTF-8 to UNICODE in batches, ASCII
+   runs are detected and converted a machine word at a time.
+
+Example:
+	EGI_TXTSRC *src=egi_txtsrc_open("/mmc/xyj_uft8.txt", 0);
+	EGI_TXTSPAN span;
+	wchar_t wcs[256];
+	size_t off=0, used;
+	int n;
+
+	while( egi_txtsrc_span(src, off, 1024, &span) > 0 ) {
+		n=egi_txtsrc_decode(span.ptr, span.nbytes, wcs, 256, &used);
+		...
+		off += used;
+	}
+	egi_txtsrc_close(&src);
+
+Midas Zhou
+-----------------------------------------------------------------*/
+#ifndef __EGI_TXTSRC_H__
+#define __EGI_TXTSRC_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+#define EGI_TXTSRC_READAHEAD	(256*1024)	/* Default read-ahead window, in bytes */
+
+typedef struct egi_txtsrc {
+	char			*fpath;
+	const unsigned char	*addr;		/* Mmaped text, followed by '\0' at least */
+	size_t			size;		/* Size of the text */
+	size_t			mapsize;
+	long long		mtime;
+	size_t			readahead;	/* Read-ahead window size, multiples of pages */
+	size_t			win;		/* Start of the current window, page aligned */
+	bool			advised;	/* If the window is advised */
+} EGI_TXTSRC;
+
+typedef struct egi_txtspan {
+	const unsigned char	*ptr;		/* Start of the span, in the mmaped text */
+	size_t			off;		/* Offset of the span in the text */
+	size_t			nbytes;		/* Length of the span, it ends at a character boundary */
+} EGI_TXTSPAN;
+
+EGI_TXTSRC*	egi_txtsrc_open(const char *fpath, size_t readahead);
+void		egi_txtsrc_close(EGI_TXTSRC **src);
+void		egi_txtsrc_advise(EGI_TXTSRC *src, size_t off);
+int		egi_txtsrc_span(EGI_TXTSRC *src, size_t off, size_t maxbytes, EGI_TXTSPAN *span);
+int		egi_txtsrc_decode(const unsigned char *p, size_t nbytes, wchar_t *wcs, size_t maxchars, size_t *used);
+size_t		egi_txtsrc_count(const unsigned char *p, size_t nbytes);
+
+#endif
@@ -472,6 +472,16 @@ char ** egi_alloc_search_files(const char* path, const char* fext,  int *pcount
 
 		/* Clear buff and save full path of the matched files */
 		fpbuff[num]=calloc(1, len_path+strlen(file->d_name)+2);
+		if(fpbuff[num]==NULL) {
+			EGI_PLOG(LOGLV_ERROR,"egi_alloc_search_files(): Fail to calloc fpbuff[%d].\n", num);
+			/* free the list built so far */
+			while(num>0)
+				free(fpbuff[--num]);
+			free(fpbuff);
+			closedir(dir);
+			if(pcount!=NULL) *pcount=-1;
+			return NULL;
+		}
 		sprintf(fpbuff[num], "%s/%s", path, file->d_name);
 		//printf("egi_alloc_search_files2(): push %s ...OK\n",fpbuff[num]);
 
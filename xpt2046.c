@@ -10,6 +10,14 @@ Midas Zhou
 ----------------------------------------------------------------*/
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
 #include "spi.h"
 #include "xpt2046.h"
 #include "egi_debug.h"
@@ -26,6 +34,22 @@ static float factY=2.95;
 static uint8_t  tbaseX=62;
 static uint8_t  tbaseY=60;
 
+/* Adaptive sampling, see xpt_getfilt_xy() */
+static unsigned int idle_hz=XPT_IDLE_HZ;
+static unsigned int active_hz=XPT_ACTIVE_HZ;
+static int z1min=XPT_Z1_MIN;
+static float euro_mincutoff=XPT_EURO_MINCUTOFF;
+static float euro_beta=XPT_EURO_BETA;
+static int penirq_fd=-1;		/* sysfs GPIO value file of PENIRQ */
+static unsigned long spi_transfers;	/* Counter of SPI transfers */
+
+/* An 1-euro filter */
+typedef struct xpt_euro {
+	bool	init;
+	float	x;		/* Last filtered value */
+	float	dx;		/* Last filtered speed */
+} XPT_EURO;
+
 /*--------------------------------------
 Set mapping factor factX/factY
 --------------------------------------*/
@@ -95,6 +119,7 @@ static int xpt_read_xy(uint8_t *xp, uint8_t *yp)
 	SPI_Write_then_Read(&cmd, 1, xp, 2); /* return 2bytes valid X value */
 	cmd=XPT_CMD_READYP;
 	SPI_Write_then_Read(&cmd, 1, yp, 2); /* return 2byte valid Y value */
+	spi_transfers += 2;
 
 	/*  Valify data,
 		when untouched: Xp[0]=0, Xp[1]=0
@@ -360,3 +385,294 @@ int xpt_getraw_xy(uint16_t *rawx, uint16_t *rawy)
 
 	return ret;
 }
+
+
+/*----------------------------------------------------------------
+Initiate the adaptive sampler, read its parameters in EGI config
+file if any, see xpt2046.h. If xpt_penirq_gpio is configured, the
+PENIRQ pin is opened as a sysfs GPIO, to wake up the sampler when
+the pad is touched.
+----------------------------------------------------------------*/
+void xpt_init_sampler(void)
+{
+	char strval[EGI_CONFIG_VMAX];
+	char path[64];
+	int fd;
+	int gpio=-1;
+
+	memset(strval,0,sizeof(strval));
+	if( egi_get_config_value("TOUCH_PAD", "xpt_idle_hz", strval) ==0 )
+		idle_hz=atoi(strval);
+	memset(strval,0,sizeof(strval));
+	if( egi_get_config_value("TOUCH_PAD", "xpt_active_hz", strval) ==0 )
+		active_hz=atoi(strval);
+	xpt_set_rates(idle_hz, active_hz);
+
+	memset(strval,0,sizeof(strval));
+	if( egi_get_config_value("TOUCH_PAD", "xpt_z1min", strval) ==0 )
+		z1min=atoi(strval);
+	memset(strval,0,sizeof(strval));
+	if( egi_get_config_value("TOUCH_PAD", "xpt_euro_mincutoff", strval) ==0 )
+		euro_mincutoff=atof(strval);
+	memset(strval,0,sizeof(strval));
+	if( egi_get_config_value("TOUCH_PAD", "xpt_euro_beta", strval) ==0 )
+		euro_beta=atof(strval);
+
+	memset(strval,0,sizeof(strval));
+	if( egi_get_config_value("TOUCH_PAD", "xpt_penirq_gpio", strval) ==0 )
+		gpio=atoi(strval);
+	printf("%s: idle %dHz, active %dHz, z1min=%d, 1-euro mincutoff=%.2f beta=%.3f, PENIRQ gpio %d\n",
+			__func__, idle_hz, active_hz, z1min, euro_mincutoff, euro_beta, gpio);
+	if(gpio<0 || penirq_fd>=0)
+		return;
+
+	/* Export PENIRQ GPIO, it's low when touched. EBUSY if already exported. */
+	fd=open("/sys/class/gpio/export", O_WRONLY);
+	snprintf(strval, sizeof(strval), "%d", gpio);
+	if( fd<0 || ( write(fd, strval, strlen(strval))<0 && errno!=EBUSY ) ) {
+		printf("%s: Fail to export PENIRQ gpio%d: %s, sample at idle rate.\n",__func__, gpio, strerror(errno));
+		if(fd>=0)
+			close(fd);
+		return;
+	}
+	close(fd);
+	snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/edge", gpio);
+	fd=open(path, O_WRONLY);
+	if( fd<0 || write(fd, "falling", 7)!=7 ) {
+		printf("%s: Fail to set PENIRQ gpio%d edge, sample at idle rate.\n",__func__, gpio);
+		if(fd>=0)
+			close(fd);
+		return;
+	}
+	close(fd);
+	snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/value", gpio);
+	penirq_fd=open(path, O_RDONLY|O_CLOEXEC);
+	if(penirq_fd<0)
+		printf("%s: Fail to open '%s', sample at idle rate.\n",__func__, path);
+}
+
+
+/*---------------------------------------------
+Set sampling rates of the adaptive sampler.
+
+@idle:		Rate when untouched, 1-1000Hz.
+@active:	Rate when touched, 1-1000Hz.
+---------------------------------------------*/
+void xpt_set_rates(int idle, int active)
+{
+	if(idle<1)
+		idle=1;
+	else if(idle>1000)
+		idle=1000;
+	if(active<1)
+		active=1;
+	else if(active>1000)
+		active=1000;
+
+	idle_hz=idle;
+	active_hz=active;
+}
+
+
+/*-------------------------------------------------
+Return sampling period in ms, at the idle rate or
+at the active rate.
+-------------------------------------------------*/
+unsigned int xpt_period_ms(bool touched)
+{
+	return 1000/(touched ? active_hz : idle_hz);
+}
+
+
+/*------------------------------------------------------------
+Wait for PENIRQ falling, that's the pad is touched.
+
+@ms:	Timeout in ms.
+
+Return:
+	1	PENIRQ is low, touched.
+	0	Time out, or PENIRQ is high.
+	<0	PENIRQ is not available, the caller shall poll
+		the pad at the idle rate.
+-------------------------------------------------------------*/
+int xpt_wait_penirq(int ms)
+{
+	struct pollfd pfd;
+	char val;
+
+	if(penirq_fd<0)
+		return -1;
+
+	/* Check the level first, an edge may be missed while sampling */
+	if( lseek(penirq_fd, 0, SEEK_SET)<0 || read(penirq_fd, &val, 1)!=1 )
+		return -2;
+	if(val=='0')
+		return 1;
+
+	pfd.fd=penirq_fd;
+	pfd.events=POLLPRI|POLLERR;
+	if( poll(&pfd, 1, ms)<=0 )
+		return 0;
+
+	if( lseek(penirq_fd, 0, SEEK_SET)<0 || read(penirq_fd, &val, 1)!=1 )
+		return -2;
+
+	return val=='0' ? 1 : 0;
+}
+
+
+/*------------------------------
+Close PENIRQ GPIO.
+------------------------------*/
+void xpt_close_penirq(void)
+{
+	if(penirq_fd>=0) {
+		close(penirq_fd);
+		penirq_fd=-1;
+	}
+}
+
+
+/*--------------------------------------
+Read XPT Z1 pressure, ~0 when untouched.
+--------------------------------------*/
+static int xpt_read_z1(void)
+{
+	uint8_t cmd=XPT_CMD_READZ1;
+	uint8_t zp[2];
+
+	SPI_Write_then_Read(&cmd, 1, zp, 2);
+	spi_transfers++;
+
+	return zp[0];
+}
+
+
+/*----------------------------------------------------------------
+Filter a value with an 1-euro filter: a low-pass filter whose
+cutoff frequency rises with speed, so it removes jitter of a still
+point, while keeps lag small for a moving point.
+
+@f:	The filter, f->init is false for the first value.
+@x:	The value.
+@dt:	Time since the last value, in seconds.
+
+Return:
+	Filtered value
+----------------------------------------------------------------*/
+static float xpt_euro_filter(XPT_EURO *f, float x, float dt)
+{
+	float a, cutoff, dx;
+
+	if(!f->init || dt<=0) {
+		f->init=true;
+		f->x=x;
+		f->dx=0;
+		return x;
+	}
+
+	/* Filtered speed */
+	a=2*M_PI*XPT_EURO_DCUTOFF*dt;
+	a=a/(1+a);
+	dx=(x-f->x)/dt;
+	f->dx += a*(dx-f->dx);
+
+	cutoff=euro_mincutoff+euro_beta*fabsf(f->dx);
+	a=2*M_PI*cutoff*dt;
+	a=a/(1+a);
+	f->x += a*(x-f->x);
+
+	return f->x;
+}
+
+
+/* Median of XPT_MEDIAN_NUM values */
+static uint8_t xpt_median(uint8_t *v)
+{
+	uint8_t t;
+	int i,j;
+
+	/* Insertion sort, it's short */
+	for(i=1; i<XPT_MEDIAN_NUM; i++) {
+		t=v[i];
+		for(j=i; j>0 && v[j-1]>t; j--)
+			v[j]=v[j-1];
+		v[j]=t;
+	}
+
+	return v[XPT_MEDIAN_NUM/2];
+}
+
+
+/*-------------------------------------------------------------------------------
+The adaptive sampler, to replace xpt_getavg_xy().
+Each call reads Z1 first, and only if it's touched, XPT_MEDIAN_NUM X/Y samples
+are read. Their medians are mapped to LCD coordinates and filtered by 1-euro
+filters, so a point costs 1+2*XPT_MEDIAN_NUM SPI transfers, instead of
+2*XPT_SAMPLE_NUMBER by xpt_getavg_xy(), and every touched call gets a point.
+The caller shall call it at the rate of xpt_period_ms(), see egi_touch_loopread().
+
+@sx,sy:		Pointer to pass out x,y in tft-LCD coordinate.
+
+Return:
+	XPT_READ_STATUS_COMPLETE	OK, (sx,sy) is ready.
+	XPT_READ_STATUS_GOING		Untouched, but not confirmed as pen-up yet.
+	XPT_READ_STATUS_PENUP		Pen-up.
+-------------------------------------------------------------------------------*/
+int xpt_getfilt_xy(uint16_t *sx, uint16_t *sy)
+{
+	static XPT_EURO	fx, fy;		/* 1-euro filters of x,y */
+	static struct timespec ts_last;
+	static int nfail=XPT_PENUP_FILTCOUNT;
+	uint8_t xs[XPT_MEDIAN_NUM], ys[XPT_MEDIAN_NUM];
+	uint8_t xp[2], yp[2];
+	struct timespec ts;
+	float dt;
+	int i;
+
+	/* Check pressure, then read samples */
+	for(i=0; i<XPT_MEDIAN_NUM; i++) {
+		if( i==0 && xpt_read_z1() < z1min )
+			break;
+		if( xpt_read_xy(xp,yp)!=0 )
+			break;
+		xs[i]=xp[0];
+		ys[i]=yp[0];
+	}
+
+	/* Untouched, or released during sampling */
+	if(i<XPT_MEDIAN_NUM) {
+		fx.init=false;
+		fy.init=false;
+		if( ++nfail >= XPT_PENUP_FILTCOUNT ) {
+			nfail=XPT_PENUP_FILTCOUNT;
+			return XPT_READ_STATUS_PENUP;
+		}
+		return XPT_READ_STATUS_GOING;
+	}
+	nfail=0;
+
+	/* Median, then map and filter */
+	xp[0]=xpt_median(xs);
+	yp[0]=xpt_median(ys);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	dt=(ts.tv_sec-ts_last.tv_sec)+(ts.tv_nsec-ts_last.tv_nsec)/1.0e9;
+	ts_last=ts;
+
+	*sx=(int)lroundf( xpt_euro_filter(&fx, (xp[0]-tbaseX)*factX + LCD_SIZE_X/2, dt) );
+	*sy=(int)lroundf( xpt_euro_filter(&fy, (yp[0]-tbaseY)*factY + LCD_SIZE_Y/2, dt) );
+	EGI_PDEBUG(DBG_TOUCH,"xp=%d, yp=%d;  sx=%d, sy=%d\n",xp[0],yp[0],*sx,*sy);
+
+	return XPT_READ_STATUS_COMPLETE;
+}
+
+
+/*--------------------------------------------
+Return number of SPI transfers to the XPT since
+start, for benchmarks.
+--------------------------------------------*/
+unsigned long xpt_spi_transfers(void)
+{
+	return spi_transfers;
+}
@@ -11,6 +11,9 @@ Midas Zhou
 #ifndef __XPT2046_H__
 #define __XPT2046_H__
 
+#include <stdint.h>
+#include <stdbool.h>
+
 
 /*--------------   8BITS CONTROL COMMAND FOR XPT2046   -------------------
 [7] 	S 		-- 1:  new control bits,
@@ -30,6 +33,7 @@ Midas Zhou
 ---------------------------------------------------------------*/
 #define XPT_CMD_READXP  0xD0 //0xD0 //1101,0000  /* read X position data */
 #define XPT_CMD_READYP  0x90 //0x90 //1001,0000 /* read Y position data */
+#define XPT_CMD_READZ1  0xB0 //1011,0000 /* read Z1 pressure data, ~0 when untouched */
 
 /* ----- XPT bias and limit value ----- */
 #define XPT_XP_MIN 7
@@ -49,6 +53,19 @@ Midas Zhou
 
 #define XPT_PENUP_READCOUNT 5 /* use to detect pen-up scenario */
 
+/* ------ adaptive sampling, see xpt_getfilt_xy() ------
+ * Config. values in [TOUCH_PAD] of EGI config file override defaults:
+ *	xpt_idle_hz, xpt_active_hz, xpt_z1min, xpt_euro_mincutoff, xpt_euro_beta, xpt_penirq_gpio
+ */
+#define XPT_IDLE_HZ		20	/* Sampling rate when untouched */
+#define XPT_ACTIVE_HZ		200	/* Sampling rate when touched */
+#define XPT_Z1_MIN		4	/* Z1 above it means touched */
+#define XPT_MEDIAN_NUM		3	/* X/Y samples for a median, odd number */
+#define XPT_PENUP_FILTCOUNT	2	/* Consecutive untouched samples for pen-up */
+#define XPT_EURO_MINCUTOFF	1.0	/* 1-euro filter: min. cutoff frequency in Hz */
+#define XPT_EURO_BETA		0.05	/* 1-euro filter: cutoff increase with speed */
+#define XPT_EURO_DCUTOFF	1.0	/* 1-euro filter: cutoff frequency of speed in Hz */
+
 /* status for XPT touch data reading */
 #define XPT_READ_STATUS_COMPLETE      0   /* touched!! OK, reading session is just finished, data is ready.*/
 #define XPT_READ_STATUS_GOING    1        /* touched!! session is going on,  data is NOT ready.*/
@@ -63,4 +80,12 @@ void xpt_init_factors(void);
 int xpt_getavg_xy(uint16_t *avgsx, uint16_t *avgsy);
 int xpt_getraw_xy(uint16_t *rawx, uint16_t *rawy);
 
+void xpt_init_sampler(void);
+void xpt_set_rates(int idle, int active);
+unsigned int xpt_period_ms(bool touched);
+int xpt_wait_penirq(int ms);
+void xpt_close_penirq(void);
+int xpt_getfilt_xy(uint16_t *sx, uint16_t *sy);
+unsigned long xpt_spi_transfers(void);
+
 #endif